@@ -1,8 +1,34 @@
 # Compile HLSL files for given target.
 
+# Function: shader_permutation_keys
+# Usage: shader_permutation_keys(<file> <key> [<key> ...])
+# Declares the preprocessor keys a shader is built with. target_shader_sources
+# then compiles one variant per combination of them, each key defined as 0 or 1,
+# so the shader branches with #if instead of at run time.
+# Bit i of a variant's permutation bits is set when the i-th key is 1.
+function(shader_permutation_keys file)
+    set(MAX_PERMUTATION_KEYS 8)
+
+    list(LENGTH ARGN key_count)
+    if(key_count GREATER MAX_PERMUTATION_KEYS)
+        message(FATAL_ERROR "[Error]: ${file} declares ${key_count} permutation keys, at most ${MAX_PERMUTATION_KEYS} are allowed")
+    endif()
+
+    get_filename_component(file_abs ${file} ABSOLUTE)
+    set_source_files_properties(${file_abs} PROPERTIES SHADER_PERMUTATION_KEYS "${ARGN}")
+endfunction()
+
 # Function: target_shader_sources
 # Usage: target_shader_sources(<target> <PRIVATE> [<file> <shader profile> ...])
+# Compiled shaders are also packed into <target>.shaders by shader_packer, and
+# <target>.permutations lists every variant in it, read by shader_permutations.
+# With SHADER_COMPILE_CACHE on, fxc runs through shader_cache, which skips it
+# for any variant compiled before from the same preprocessed source and options.
 function(target_shader_sources target_project)
+    option(SHADER_ARCHIVE_COMPRESSION "Compress shaders in packed archives" OFF)
+    option(SHADER_COMPILE_CACHE "Reuse shaders compiled before from the same preprocessed source and options" ON)
+    set(SHADER_CACHE_DIR "${CMAKE_BINARY_DIR}/shader_cache" CACHE PATH "Where shader_cache keeps compiled shaders")
+
     # Find the shader compiler
     find_program(FXC fxc DOC "DirectX Shader Compiler")
     if ("${FXC}" STREQUAL "FXC-NOTFOUND")
@@ -15,15 +41,23 @@ function(target_shader_sources target_project)
 
     set(FXC_FLAGS
         /nologo    # don't display copyright info
-        /Zi        # include debugging info
-        /Od        # disable optimizations
         /E main    # entry point is always main()
     )
-    
+
+    # Debug builds include debugging info and disable optimizations,
+    # any other configuration gets fully optimized shaders.
+    set(FXC_CONFIG_FLAGS "$<IF:$<CONFIG:Debug>,/Zi;/Od,/O3>")
+
+    set(FXC_COMMAND ${FXC})
+    set(FXC_DEPENDS)
+    if(SHADER_COMPILE_CACHE)
+        set(FXC_COMMAND shader_cache compile ${SHADER_CACHE_DIR} ${FXC})
+        set(FXC_DEPENDS shader_cache)
+    endif()
+
     set(IS_FILE ON)     # a hacky means to alternate between
-    set(FXC_SOURCES)    # source file name  and  
+    set(FXC_SOURCES)    # source file name  and
     set(FXC_PROFILES)   # profile to use when compiling
-    set(FXC_OUTPUTS)    # output file list
     # Loop through the <file profile> pairs
     foreach(file_profile ${TARGET_SHADER_SOURCES_PRIVATE})
         # assume File is 1st param
@@ -32,11 +66,6 @@ function(target_shader_sources target_project)
             get_filename_component(file_abs ${file_profile} ABSOLUTE)
             list(APPEND FXC_SOURCES ${file_abs})
 
-            # Get file name and append .cso extension, and add to Outputs List
-            # Put the output file in same dir as executable.
-            get_filename_component(file_we ${file_profile} NAME_WE)
-            list(APPEND FXC_OUTPUTS ${EXECUTABLE_OUTPUT_PATH}/${file_we}.cso)
-
             # Flip flag for next item
             set(IS_FILE OFF)
         # profile is 2nd param
@@ -47,16 +76,97 @@ function(target_shader_sources target_project)
         endif()
     endforeach()
 
-    # Lenght of Source, Profile and Output Lists should match
-    foreach(src prof out IN ZIP_LISTS FXC_SOURCES FXC_PROFILES FXC_OUTPUTS)
+    set(FXC_OUTPUTS)    # output file list
+    set(MANIFEST "# shader\tbits\tname\tprofile\tsource\t[key=value ...]\n")
+
+    # Lenght of Source and Profile Lists should match
+    foreach(src prof IN ZIP_LISTS FXC_SOURCES FXC_PROFILES)
         get_filename_component(file ${src} NAME)
-        # Call FXC and pass the parameters src, prof and out along with fxc_flags
-        add_custom_command(
-            TARGET ${target_project} POST_BUILD
-            COMMAND ${FXC} ${FXC_FLAGS} /T ${prof} /Fo ${out} ${src}
-            WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR}
-            COMMENT "Building Shader ${file}"
-        )
+        get_filename_component(file_we ${src} NAME_WE)
+        get_filename_component(src_dir ${src} DIRECTORY)
+
+        # Headers beside a shader may be included by it, a change to one rebuilds it.
+        file(GLOB includes CONFIGURE_DEPENDS ${src_dir}/*.hlsli)
+
+        get_source_file_property(keys ${src} SHADER_PERMUTATION_KEYS)
+        if(NOT keys)
+            set(keys)
+        endif()
+        list(LENGTH keys key_count)
+        math(EXPR last_bits "(1 << ${key_count}) - 1")
+
+        # One output per variant, in same dir as executable. A shader
+        # without keys has one, named after its file like before.
+        foreach(bits RANGE ${last_bits})
+            set(name ${file_we})
+            if(key_count GREATER 0)
+                set(name ${file_we}.${bits})
+            endif()
+
+            set(fxc_defines)
+            set(manifest_defines)
+            set(bit 0)
+            foreach(key ${keys})
+                math(EXPR value "(${bits} >> ${bit}) & 1")
+                list(APPEND fxc_defines /D ${key}=${value})
+                string(APPEND manifest_defines "\t${key}=${value}")
+                math(EXPR bit "${bit} + 1")
+            endforeach()
+
+            # Each variant is its own build rule, so the build tool
+            # compiles them in parallel, and only again when the source changes.
+            set(out ${EXECUTABLE_OUTPUT_PATH}/${name}.cso)
+            add_custom_command(
+                OUTPUT ${out}
+                COMMAND ${FXC_COMMAND} ${FXC_FLAGS} "${FXC_CONFIG_FLAGS}" ${fxc_defines} /T ${prof} /Fo ${out} ${src}
+                DEPENDS ${src} ${includes} ${FXC_DEPENDS}
+                WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR}
+                COMMENT "Building Shader ${file} (${name})"
+                COMMAND_EXPAND_LISTS
+                VERBATIM
+            )
+            list(APPEND FXC_OUTPUTS ${out})
+            string(APPEND MANIFEST "${file_we}\t${bits}\t${name}\t${prof}\t${src}${manifest_defines}\n")
+        endforeach()
     endforeach()
-    
-endfunction()
\ No newline at end of file
+
+    # Pack the compiled shaders into one archive, loaded at run time by name.
+    # Its file name reaches the code as SHADER_ARCHIVE_NAME, and the
+    # manifest's as SHADER_MANIFEST_NAME.
+    set(SHADER_ARCHIVE ${EXECUTABLE_OUTPUT_PATH}/${target_project}.shaders)
+    set(SHADER_MANIFEST ${EXECUTABLE_OUTPUT_PATH}/${target_project}.permutations)
+    set(PACKER_FLAGS)
+    if(SHADER_ARCHIVE_COMPRESSION)
+        list(APPEND PACKER_FLAGS --compress)
+    endif()
+
+    # How many of the variants compiled since the last report came from the cache.
+    set(CACHE_REPORT)
+    if(SHADER_COMPILE_CACHE)
+        set(CACHE_REPORT COMMAND shader_cache stats --reset ${SHADER_CACHE_DIR})
+    endif()
+
+    file(WRITE ${SHADER_MANIFEST} ${MANIFEST})
+
+    add_custom_command(
+        OUTPUT ${SHADER_ARCHIVE}
+        COMMAND shader_packer ${PACKER_FLAGS} ${SHADER_ARCHIVE} ${FXC_OUTPUTS}
+        ${CACHE_REPORT}
+        DEPENDS shader_packer ${FXC_OUTPUTS}
+        WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR}
+        COMMENT "Packing Shaders into ${target_project}.shaders"
+        VERBATIM
+    )
+    add_custom_target(${target_project}_shaders
+        DEPENDS ${SHADER_ARCHIVE}
+        SOURCES ${FXC_SOURCES}
+    )
+    add_dependencies(${target_project} ${target_project}_shaders)
+
+    target_compile_definitions(${target_project}
+        PRIVATE
+            SHADER_ARCHIVE_NAME="${target_project}.shaders"
+            SHADER_MANIFEST_NAME="${target_project}.permutations"
+    )
+
+endfunction()
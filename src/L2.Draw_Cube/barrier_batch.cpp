@@ -0,0 +1,195 @@
+#include "barrier_batch.h"
+
+#include <algorithm>
+#include <iterator>
+#include <cassert>
+
+using namespace learning_dx12;
+
+namespace
+{
+	auto find_last_touching(std::vector<D3D12_RESOURCE_BARRIER> &pending, ID3D12Resource *resource)
+	{
+		return std::find_if(pending.rbegin(), pending.rend(), [&](const D3D12_RESOURCE_BARRIER &b)
+		{
+			switch (b.Type)
+			{
+				case D3D12_RESOURCE_BARRIER_TYPE_TRANSITION:
+					return b.Transition.pResource == resource;
+				case D3D12_RESOURCE_BARRIER_TYPE_ALIASING:
+					return b.Aliasing.pResourceBefore == resource
+					    or b.Aliasing.pResourceAfter == resource
+					    or b.Aliasing.pResourceAfter == nullptr;
+				case D3D12_RESOURCE_BARRIER_TYPE_UAV:
+					return b.UAV.pResource == resource
+					    or b.UAV.pResource == nullptr;
+			}
+			return true;
+		});
+	}
+
+	auto is_same_transition(const D3D12_RESOURCE_TRANSITION_BARRIER &a, const D3D12_RESOURCE_TRANSITION_BARRIER &b) -> bool
+	{
+		return a.pResource == b.pResource
+		   and a.Subresource == b.Subresource
+		   and a.StateBefore == b.StateBefore
+		   and a.StateAfter == b.StateAfter;
+	}
+}
+
+auto barrier_stats::operator +=(const barrier_stats &other) -> barrier_stats &
+{
+	requested += other.requested;
+	submitted += other.submitted;
+	cancelled += other.cancelled;
+	flushes += other.flushes;
+	return *this;
+}
+
+barrier_batch::barrier_batch() = default;
+barrier_batch::~barrier_batch() = default;
+
+void barrier_batch::add(const D3D12_RESOURCE_BARRIER &barrier)
+{
+	stats.requested++;
+
+	auto is_plain_transition = barrier.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION
+	                       and barrier.Flags == D3D12_RESOURCE_BARRIER_FLAG_NONE;
+	if (is_plain_transition
+	    and barrier.Transition.StateBefore == barrier.Transition.StateAfter)
+	{
+		stats.cancelled++;
+		return;
+	}
+
+	if (is_plain_transition and merge_transition(barrier.Transition))
+	{
+		return;
+	}
+
+	auto is_split_end = barrier.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION
+	                and barrier.Flags == D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+	if (is_split_end and fold_split_end(barrier.Transition))
+	{
+		track_split(barrier);
+		return;
+	}
+
+	track_split(barrier);
+	pending.push_back(barrier);
+}
+
+void barrier_batch::flush(dx_cmd_list cmd_list)
+{
+	if (pending.empty())
+	{
+		return;
+	}
+
+	cmd_list->ResourceBarrier(static_cast<uint32_t>(pending.size()),
+	                          pending.data());
+
+	stats.submitted += static_cast<uint32_t>(pending.size());
+	stats.flushes++;
+
+	pending.clear();
+}
+
+auto barrier_batch::pending_count() const -> size_t
+{
+	return pending.size();
+}
+
+// Splits begun on this list that haven't been ended yet, 
+// must be zero by the time the list is closed.
+auto barrier_batch::open_split_count() const -> size_t
+{
+	return open_splits.size();
+}
+
+auto barrier_batch::get_stats() const -> barrier_stats
+{
+	return stats;
+}
+
+void barrier_batch::reset_stats()
+{
+	stats = {};
+}
+
+// Only the most recent pending barrier touching the same resource can be 
+// merged with, anything else (aliasing, UAV, split) in between stops it.
+auto barrier_batch::merge_transition(const D3D12_RESOURCE_TRANSITION_BARRIER &transition) -> bool
+{
+	auto previous = find_last_touching(pending, transition.pResource);
+
+	if (previous == pending.rend())
+	{
+		return false;
+	}
+
+	auto &prev = *previous;
+	if (prev.Type != D3D12_RESOURCE_BARRIER_TYPE_TRANSITION
+	    or prev.Flags != D3D12_RESOURCE_BARRIER_FLAG_NONE
+	    or prev.Transition.Subresource != transition.Subresource
+	    or prev.Transition.StateAfter != transition.StateBefore)
+	{
+		return false;
+	}
+
+	prev.Transition.StateAfter = transition.StateAfter;
+	stats.cancelled++;
+
+	if (prev.Transition.StateBefore == prev.Transition.StateAfter)
+	{
+		pending.erase(std::next(previous).base());
+		stats.cancelled++;
+	}
+
+	return true;
+}
+
+// Nothing has run between the two halves if the begin is still pending, 
+// so a split buys nothing and the pair becomes a plain transition.
+auto barrier_batch::fold_split_end(const D3D12_RESOURCE_TRANSITION_BARRIER &transition) -> bool
+{
+	auto previous = find_last_touching(pending, transition.pResource);
+
+	if (previous == pending.rend()
+	    or previous->Type != D3D12_RESOURCE_BARRIER_TYPE_TRANSITION
+	    or previous->Flags != D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY
+	    or not is_same_transition(previous->Transition, transition))
+	{
+		return false;
+	}
+
+	previous->Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+	stats.cancelled++;
+
+	return true;
+}
+
+void barrier_batch::track_split(const D3D12_RESOURCE_BARRIER &barrier)
+{
+	if (barrier.Type != D3D12_RESOURCE_BARRIER_TYPE_TRANSITION)
+	{
+		return;
+	}
+
+	if (barrier.Flags == D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY)
+	{
+		open_splits.push_back(barrier.Transition);
+		return;
+	}
+
+	if (barrier.Flags == D3D12_RESOURCE_BARRIER_FLAG_END_ONLY)
+	{
+		auto begun = std::find_if(open_splits.begin(), open_splits.end(), [&](const D3D12_RESOURCE_TRANSITION_BARRIER &t)
+		{
+			return is_same_transition(t, barrier.Transition);
+		});
+		assert(begun != open_splits.end());
+
+		open_splits.erase(begun);
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "dx_wrapped_types.h"
+
+#include <d3d12.h>
+
+#include <vector>
+
+namespace learning_dx12
+{
+	struct barrier_stats
+	{
+		uint32_t requested;  // barriers handed to the batch
+		uint32_t submitted;  // barriers that made it to ResourceBarrier
+		uint32_t cancelled;  // transitions folded away before submission
+		uint32_t flushes;    // ResourceBarrier calls made
+
+		auto operator +=(const barrier_stats &other) -> barrier_stats &;
+	};
+
+	// Holds on to barriers until the next flush, then submits them all in 
+	// one ResourceBarrier call. A transition that continues a pending one 
+	// (A->B then B->C) is merged into it, and if that brings the resource 
+	// back to where it started (A->B->A) both are dropped, as are 
+	// transitions into the state the resource is already in.
+	// The end half of a split barrier whose begin half hasn't been flushed 
+	// yet turns the pair back into one ordinary transition.
+	class barrier_batch
+	{
+	public:
+		barrier_batch();
+		~barrier_batch();
+
+		void add(const D3D12_RESOURCE_BARRIER &barrier);
+		void flush(dx_cmd_list cmd_list);
+
+		auto pending_count() const -> size_t;
+		auto open_split_count() const -> size_t;
+		auto get_stats() const -> barrier_stats;
+		void reset_stats();
+
+	private:
+		auto merge_transition(const D3D12_RESOURCE_TRANSITION_BARRIER &transition) -> bool;
+		auto fold_split_end(const D3D12_RESOURCE_TRANSITION_BARRIER &transition) -> bool;
+		void track_split(const D3D12_RESOURCE_BARRIER &barrier);
+
+	private:
+		std::vector<D3D12_RESOURCE_BARRIER> pending{};
+		std::vector<D3D12_RESOURCE_TRANSITION_BARRIER> open_splits{}; // begun, not yet ended
+		barrier_stats stats{};
+	};
+}
@@ -0,0 +1,27 @@
+#include "binary_file.h"
+
+#include <fstream>
+#include <system_error>
+
+using namespace learning_dx12;
+
+// write fills a file beside file_path, which is then renamed over it,
+// so an interrupted save leaves the previous file. False if either failed.
+auto learning_dx12::replace_file(const std::filesystem::path &file_path,
+                                 const std::function<void(std::ostream &)> &write) -> bool
+{
+	auto temp_path = file_path;
+	temp_path += ".tmp";
+	{
+		auto file = std::ofstream(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+		write(file);
+		if (not file)
+		{
+			return false;
+		}
+	}
+
+	auto error = std::error_code{};
+	std::filesystem::rename(temp_path, file_path, error);
+	return not error;
+}
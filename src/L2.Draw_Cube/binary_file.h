@@ -0,0 +1,26 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <istream>
+#include <ostream>
+
+namespace learning_dx12
+{
+	// Plain values read and written as their bytes, for the
+	// headers of files only this program reads back.
+	template <typename T>
+	auto read_value(std::istream &file, T &value) -> bool
+	{
+		return static_cast<bool>(file.read(reinterpret_cast<char *>(&value), sizeof(T)));
+	}
+
+	template <typename T>
+	void write_value(std::ostream &file, const T &value)
+	{
+		file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+	}
+
+	auto replace_file(const std::filesystem::path &file_path,
+	                  const std::function<void(std::ostream &)> &write) -> bool;
+}
@@ -3,6 +3,8 @@
 #include "d3dx12.h"
 
 #include <cppitertools/enumerate.hpp>
+#include <algorithm>
+#include <iterator>
 #include <string>
 
 using namespace learning_dx12;
@@ -33,52 +35,162 @@ cmd_queue::cmd_queue(dx_device device, cmd_queue_type type_) :
 	cmd_queue(device, type_, frame_buffer_count)
 {}
 
-cmd_queue::cmd_queue(dx_device device, cmd_queue_type type_, size_t buffer_count) :
-	type{type_}
+auto dx_cmd_list_backend::create_allocator() -> dx_cmd_allocator
 {
-	command_allocators.resize(buffer_count);
-	fences.resize(buffer_count);
+	auto allocator = dx_cmd_allocator{};
+	auto hr = device->CreateCommandAllocator(type,
+	                                         __uuidof(ID3D12CommandAllocator),
+	                                         allocator.put_void());
+	assert(SUCCEEDED(hr));
 
-	create_command_queue(device);
-	create_command_allocators(device);
-	create_command_list(device);
-	create_fences(device);
-	create_fence_event_handle();
+	return allocator;
+}
 
-	command_allocators.shrink_to_fit();
-	fences.shrink_to_fit();
+void dx_cmd_list_backend::reset_allocator(dx_cmd_allocator &allocator)
+{
+	auto hr = allocator->Reset();
+	assert(SUCCEEDED(hr));
 }
 
-cmd_queue::~cmd_queue()
+auto dx_cmd_list_backend::create_list(dx_cmd_allocator &allocator) -> dx_cmd_list
 {
-	for (int i = 0; i < fences.size(); i++)
+	auto list = dx_cmd_list{};
+	auto hr = device->CreateCommandList(NULL,
+	                                    type,
+	                                    allocator.get(),
+	                                    nullptr,
+	                                    __uuidof(ID3D12CommandList),
+	                                    list.put_void());
+	assert(SUCCEEDED(hr));
+
+	if (not list_name.empty())
 	{
-		set_frame_complete_signal(i);
-		wait_for_previous_frame(i);
+		list->SetName(list_name.c_str());
 	}
 
+	return list;
+}
+
+void dx_cmd_list_backend::reset_list(dx_cmd_list &list, dx_cmd_allocator &allocator)
+{
+	auto hr = list->Reset(allocator.get(), nullptr);
+	assert(SUCCEEDED(hr));
+}
+
+cmd_queue::cmd_queue(dx_device device_, cmd_queue_type type_, size_t buffer_count) :
+	type{type_}, device{device_},
+	list_backend{device_, map_to_cmd_list_type(type_), {}},
+	command_lists{list_backend}
+{
+	frame_fence_values.resize(buffer_count);
+
+	create_command_queue();
+	create_fence();
+	create_fence_event_handle();
+
+	frame_fence_values.shrink_to_fit();
+}
+
+cmd_queue::~cmd_queue()
+{
+	wait_for_fence_value(signal());
+
 	::CloseHandle(fence_event);
 }
 
-void cmd_queue::set_command_list_barrier(CD3DX12_RESOURCE_BARRIER &barrier)
+// Barriers are held back until flush_command_list_barriers, or the list 
+// being closed. Flush right before the draw/dispatch/copy that needs them.
+void cmd_queue::set_command_list_barrier(dx_cmd_list cmd_list, CD3DX12_RESOURCE_BARRIER &barrier)
+{
+	auto lock = std::lock_guard{ command_lists_mutex };
+
+	auto &open_list = command_lists.find(cmd_list);
+	open_list.recording.barriers.add(barrier);
+}
+
+void cmd_queue::flush_command_list_barriers(dx_cmd_list cmd_list)
+{
+	auto lock = std::lock_guard{ command_lists_mutex };
+
+	command_lists.find(cmd_list).recording.barriers.flush(cmd_list);
+}
+
+// Totals for the most recent submission, across all of its lists.
+auto cmd_queue::get_barrier_stats() const -> barrier_stats
+{
+	auto lock = std::lock_guard{ command_lists_mutex };
+
+	return last_barrier_stats;
+}
+
+// Resources given to transition must be in registry, which has 
+// to outlive this queue. Share one registry between all queues.
+void cmd_queue::set_state_registry(resource_state_registry &registry)
+{
+	state_registry = &registry;
+}
+
+// Records the state resource needs from here on in cmd_list. Barriers 
+// within the list are batched like set_command_list_barrier ones, the 
+// barrier into the list's first-use state is worked out at submission.
+void cmd_queue::transition(dx_cmd_list cmd_list, ID3D12Resource *resource, D3D12_RESOURCE_STATES state, uint32_t subresource)
+{
+	assert(state_registry);
+	auto traits = state_registry->get_traits(resource);
+
+	auto lock = std::lock_guard{ command_lists_mutex };
+
+	auto &open_list = command_lists.find(cmd_list);
+	auto barriers = std::vector<D3D12_RESOURCE_BARRIER>{};
+	open_list.recording.states.transition(resource, traits, state, subresource, barriers);
+
+	for (auto &barrier : barriers)
+	{
+		open_list.recording.barriers.add(barrier);
+	}
+}
+
+// Totals for the most recent submission, across all of its lists.
+auto cmd_queue::get_state_stats() const -> state_tracker_stats
 {
-	command_list->ResourceBarrier(1, &barrier);
+	auto lock = std::lock_guard{ command_lists_mutex };
+
+	return last_state_stats;
 }
 
 auto cmd_queue::get_command_list(uint8_t buffer_index) -> dx_cmd_list
 {
 	wait_for_previous_frame(buffer_index);
 
-	open_command_list(buffer_index);
+	{
+		auto lock = std::lock_guard{ command_lists_mutex };
+		frame_buffer_index = buffer_index;
+	}
 
-	return command_list;
+	return checkout_command_list(primary_list_order);
+}
+
+// Thread-safe. Only valid after the primary list for this buffer_index 
+// has been retrieved, as that is where the frame's fence is waited on.
+// Lists are submitted in ascending submit_order, asking for the same 
+// order twice in one frame returns the same list.
+auto cmd_queue::get_command_list(uint8_t buffer_index, uint32_t submit_order) -> dx_cmd_list
+{
+	assert(submit_order > transient_list_order);
+
+	{
+		auto lock = std::lock_guard{ command_lists_mutex };
+		assert(buffer_index == frame_buffer_index);
+	}
+
+	return checkout_command_list(submit_order);
 }
 
 void cmd_queue::execute_commands(uint8_t buffer_index)
 {
-	close_command_list();
+	close_command_lists();
 
-	execute_command_list();
+	execute_command_lists();
 
 	set_frame_complete_signal(buffer_index);
 }
@@ -88,34 +200,93 @@ void cmd_queue::wait_for_execute_finish(uint8_t buffer_index)
 	wait_for_previous_frame(buffer_index);
 }
 
+// Transient work (uploads and such) isn't tied to a frame slot, 
+// so these never wait on the GPU before handing out a list.
+// Thread-safe, every call gets a list of its own, so threads can 
+// record uploads side by side. They go out in the order asked for.
 auto cmd_queue::get_command_list() -> dx_cmd_list
 {
-	return get_command_list(0);
+	auto lock = std::lock_guard{ command_lists_mutex };
+
+	return command_lists.checkout_separate(transient_list_order, fence->GetCompletedValue()).list;
 }
 
 void cmd_queue::execute_commands()
 {
-	execute_commands(0);
+	close_command_lists();
+
+	execute_command_lists();
 }
 
 void cmd_queue::wait_for_execute_finish()
 {
-	wait_for_execute_finish(0);
+	wait_for_fence_value(fence_value);
 }
 
-void cmd_queue::set_name(LPCWSTR name_prefix)
+auto cmd_queue::get_fence() const -> dx_fence
+{
+	return fence;
+}
+
+// Value signaled after the most recent submission, 
+// hand it to a fence_waiter to be told when that work is done.
+auto cmd_queue::get_fence_value() const -> uint64_t
+{
+	return fence_value;
+}
+
+// Makes this queue wait, on the GPU, for other to reach value. 
+// Anything submitted here afterwards will not start until then, 
+// but the CPU carries on. Waits already covered by an earlier, 
+// larger value, or by work that has already finished, are skipped.
+void cmd_queue::wait_on_gpu(const cmd_queue &other, uint64_t value)
+{
+	assert(&other != this);
+	assert(value <= other.fence_value);
+
+	if (not gpu_waits.needs_wait(other, value, other.fence->GetCompletedValue()))
+	{
+		return;
+	}
+
+	auto hr = command_queue->Wait(other.fence.get(), value);
+	assert(SUCCEEDED(hr));
+
+	gpu_waits.add_wait(other, value);
+}
+
+auto cmd_queue::get_gpu_wait_value(const cmd_queue &other) const -> uint64_t
+{
+	return gpu_waits.get_wait_value(other);
+}
+
+auto cmd_queue::get_allocator_stats() const -> list_pool::allocator_pool::pool_stats
 {
-	auto name = std::wstring{name_prefix};
+	auto lock = std::lock_guard{ command_lists_mutex };
 
-	name += L" queue";
-	command_queue->SetName(name.c_str());
+	return command_lists.get_allocator_stats();
+}
 
+void cmd_queue::set_name(LPCWSTR name_prefix)
+{
 	name = name_prefix;
-	name += L" cmd list";
-	command_list->SetName(name.c_str());
+
+	auto queue_name = name + L" queue";
+	command_queue->SetName(queue_name.c_str());
+
+	auto fence_name = name + L" fence";
+	fence->SetName(fence_name.c_str());
+
+	auto lock = std::lock_guard{ command_lists_mutex };
+
+	list_backend.list_name = name + L" cmd list";
+	command_lists.for_each_list([&](dx_cmd_list &list)
+	{
+		list->SetName(list_backend.list_name.c_str());
+	});
 }
 
-void cmd_queue::create_command_queue(dx_device device)
+void cmd_queue::create_command_queue()
 {
 	auto desc = D3D12_COMMAND_QUEUE_DESC{};
 	desc.Type = map_to_cmd_list_type(type);
@@ -129,46 +300,13 @@ void cmd_queue::create_command_queue(dx_device device)
 	assert(SUCCEEDED(hr));
 }
 
-void cmd_queue::create_command_allocators(dx_device device)
+void cmd_queue::create_fence()
 {
-	for (auto &allocator : command_allocators)
-	{
-		auto hr = device->CreateCommandAllocator(map_to_cmd_list_type(type),
-		                                         __uuidof(ID3D12CommandAllocator),
-		                                         allocator.put_void());
-		assert(SUCCEEDED(hr));
-	}
-}
-
-void cmd_queue::create_command_list(dx_device device)
-{
-	auto hr = device->CreateCommandList(NULL,
-	                                    map_to_cmd_list_type(type),
-	                                    command_allocators.front().get(),
-	                                    nullptr,
-	                                    __uuidof(ID3D12CommandList),
-	                                    command_list.put_void());
+	auto hr = device->CreateFence(fence_value,
+	                              D3D12_FENCE_FLAG_NONE,
+	                              __uuidof(ID3D12Fence),
+	                              fence.put_void());
 	assert(SUCCEEDED(hr));
-
-	close_command_list();
-}
-
-void cmd_queue::create_fences(dx_device device)
-{
-	auto create_fence = [&](dx_fence &fence)
-	{
-		auto hr = device->CreateFence(0,
-		                              D3D12_FENCE_FLAG_NONE,
-		                              __uuidof(ID3D12Fence),
-		                              fence.put_void());
-		assert(SUCCEEDED(hr));
-	};
-
-	for (auto &fence : fences)
-	{
-		create_fence(fence.fence);
-		fence.value = {};
-	}
 }
 
 void cmd_queue::create_fence_event_handle()
@@ -180,39 +318,106 @@ void cmd_queue::create_fence_event_handle()
 	assert(fence_event);
 }
 
-void cmd_queue::open_command_list(uint8_t buffer_index)
+auto cmd_queue::checkout_command_list(uint32_t submit_order) -> dx_cmd_list
 {
-	auto allocator = command_allocators.at(buffer_index);
-	allocator->Reset();
-	command_list->Reset(allocator.get(), nullptr);
+	auto lock = std::lock_guard{ command_lists_mutex };
+
+	return command_lists.checkout(submit_order, fence->GetCompletedValue()).list;
 }
 
-void cmd_queue::close_command_list()
+// Already closed list holding nothing but the given barriers.
+auto cmd_queue::record_fixup_list(const std::vector<D3D12_RESOURCE_BARRIER> &barriers) -> open_cmd_list
 {
-	auto hr = command_list->Close();
+	auto fixup_list = command_lists.checkout_unlisted(fence->GetCompletedValue());
+
+	fixup_list.list->ResourceBarrier(static_cast<uint32_t>(barriers.size()),
+	                                 barriers.data());
+
+	auto hr = fixup_list.list->Close();
 	assert(SUCCEEDED(hr));
+
+	return fixup_list;
+}
+
+void cmd_queue::close_command_lists()
+{
+	auto lock = std::lock_guard{ command_lists_mutex };
+
+	last_barrier_stats = {};
+	for (auto &open_list : command_lists.get_open_lists())
+	{
+		auto &barriers = open_list.recording.barriers;
+		assert(barriers.open_split_count() == 0);
+		barriers.flush(open_list.list);
+		last_barrier_stats += barriers.get_stats();
+
+		auto hr = open_list.list->Close();
+		assert(SUCCEEDED(hr));
+	}
 }
 
-void cmd_queue::execute_command_list()
+void cmd_queue::execute_command_lists()
 {
-	auto cmd_lists = std::array{ (ID3D12CommandList *const)
-		command_list.get()
-	};
+	auto lock = std::lock_guard{ command_lists_mutex };
+
+	auto submitted_lists = command_lists.take_submission();
+	if (submitted_lists.empty())
+	{
+		return;
+	}
+
+	// Lists are resolved in submission order, each one that needs its 
+	// resources moved into their first-use states gets a list of 
+	// fix-up barriers submitted right in front of it.
+	auto submission = state_submission{ type == cmd_queue_type::copy };
+	auto fixup_lists = std::vector<open_cmd_list>{};
+
+	auto cmd_lists = std::vector<ID3D12CommandList *>{};
+	cmd_lists.reserve(submitted_lists.size());
+	for (auto &open_list : submitted_lists)
+	{
+		if (state_registry)
+		{
+			auto &states = open_list.recording.states;
+			auto fixups = state_registry->resolve(states, submission);
+			if (not fixups.empty())
+			{
+				auto &fixup_list = fixup_lists.emplace_back(record_fixup_list(fixups));
+				cmd_lists.push_back(fixup_list.list.get());
+			}
+			submission.stats += states.get_stats();
+		}
+
+		cmd_lists.push_back(open_list.list.get());
+	}
 
 	command_queue->ExecuteCommandLists(static_cast<uint32_t>(cmd_lists.size()),
 	                                   cmd_lists.data());
+
+	if (state_registry)
+	{
+		state_registry->finish_submission(submission);
+	}
+	last_state_stats = submission.stats;
+
+	auto submitted_value = signal();
+	command_lists.release(submitted_lists, submitted_value);
+	command_lists.release(fixup_lists, submitted_value);
 }
 
 void cmd_queue::wait_for_previous_frame(uint8_t buffer_index)
 {
-	auto& [fence, signal_value] = fences.at(buffer_index);
+	wait_for_fence_value(frame_fence_values.at(buffer_index));
+}
 
-	if (fence->GetCompletedValue() >= signal_value)
+void cmd_queue::wait_for_fence_value(uint64_t value)
+{
+	if (fence->GetCompletedValue() >= value)
 	{
 		return;
 	}
 
-	auto hr = fence->SetEventOnCompletion(signal_value, fence_event);
+	auto hr = fence->SetEventOnCompletion(value, fence_event);
 	assert(SUCCEEDED(hr));
 
 	::WaitForSingleObject(fence_event, INFINITE);
@@ -220,11 +425,16 @@ void cmd_queue::wait_for_previous_frame(uint8_t buffer_index)
 
 void cmd_queue::set_frame_complete_signal(uint8_t buffer_index)
 {
-	auto& [fence, signal_value] = fences.at(buffer_index);
+	frame_fence_values.at(buffer_index) = fence_value;
+}
 
-	signal_value++;
+auto cmd_queue::signal() -> uint64_t
+{
+	fence_value++;
 
 	auto hr = command_queue->Signal(fence.get(),
-	                                signal_value);
+	                                fence_value);
 	assert(SUCCEEDED(hr));
-}
\ No newline at end of file
+
+	return fence_value;
+}
@@ -1,12 +1,19 @@
 #pragma once
 
 #include "dx_wrapped_types.h"
+#include "command_list_pool.h"
+#include "queue_dependencies.h"
+#include "barrier_batch.h"
+#include "resource_state_tracker.h"
 
 #include <winrt/base.h>
 #include <d3d12.h>
 #include <dxgi1_6.h>
 
 #include <vector>
+#include <string>
+#include <mutex>
+#include <limits>
 
 struct CD3DX12_RESOURCE_BARRIER;
 
@@ -20,22 +27,57 @@ namespace learning_dx12
 		copy,
 	};
 
-	class cmd_queue
+	// command_list_pool's backend, lists and allocators come from the device.
+	struct dx_cmd_list_backend
 	{
-		struct frame_fence
+		using allocator_type = dx_cmd_allocator;
+		using list_type = dx_cmd_list;
+
+		struct recording_type
 		{
-			dx_fence fence;
-			uint64_t value;
+			barrier_batch barriers;
+			cmd_list_state_tracker states;
 		};
 
+		auto create_allocator() -> dx_cmd_allocator;
+		void reset_allocator(dx_cmd_allocator &allocator);
+		auto create_list(dx_cmd_allocator &allocator) -> dx_cmd_list;
+		void reset_list(dx_cmd_list &list, dx_cmd_allocator &allocator);
+
+		dx_device device;
+		D3D12_COMMAND_LIST_TYPE type;
+		std::wstring list_name;
+	};
+
+	class cmd_queue
+	{
+		using list_pool = command_list_pool<dx_cmd_list_backend>;
+		using open_cmd_list = list_pool::open_list;
+
+	public:
+		// Transient lists go ahead of the frame's in a submission, so
+		// uploads recorded during a frame land before the lists using them.
+		// Each get_command_list() call gets its own transient list.
+		static constexpr auto transient_list_order = uint32_t{ 0 };
+		static constexpr auto primary_list_order = uint32_t{ 1 };
+		static constexpr auto epilogue_list_order = std::numeric_limits<uint32_t>::max();
+
 	public:
 		cmd_queue(dx_device device, cmd_queue_type type);
 		cmd_queue(dx_device device, cmd_queue_type type, size_t buffer_count);
 		cmd_queue() = delete;
 		~cmd_queue();
 
-		void set_command_list_barrier(CD3DX12_RESOURCE_BARRIER &transition_barrier);
+		void set_command_list_barrier(dx_cmd_list cmd_list, CD3DX12_RESOURCE_BARRIER &transition_barrier);
+		void flush_command_list_barriers(dx_cmd_list cmd_list);
+		auto get_barrier_stats() const -> barrier_stats;
+
+		void set_state_registry(resource_state_registry &registry);
+		void transition(dx_cmd_list cmd_list, ID3D12Resource *resource, D3D12_RESOURCE_STATES state,
+		                uint32_t subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+		auto get_state_stats() const -> state_tracker_stats;
 		auto get_command_list(uint8_t buffer_index ) -> dx_cmd_list;
+		auto get_command_list(uint8_t buffer_index, uint32_t submit_order) -> dx_cmd_list;
 		void execute_commands(uint8_t buffer_index);
 		void wait_for_execute_finish(uint8_t buffer_index);
 
@@ -43,32 +85,53 @@ namespace learning_dx12
 		void execute_commands();
 		void wait_for_execute_finish();
 
+		auto get_fence() const -> dx_fence;
+		auto get_fence_value() const -> uint64_t;
+
+		void wait_on_gpu(const cmd_queue &other, uint64_t value);
+		auto get_gpu_wait_value(const cmd_queue &other) const -> uint64_t;
+
+		auto get_allocator_stats() const -> list_pool::allocator_pool::pool_stats;
+
 		void set_name(LPCWSTR name_prefix);
 
 	private:
-		void create_command_queue(dx_device device);
-		void create_command_allocators(dx_device device);
-		void create_command_list(dx_device device);
-		void create_fences(dx_device device);
+		void create_command_queue();
+		void create_fence();
 		void create_fence_event_handle();
 
-		void open_command_list(uint8_t buffer_index);
-		void close_command_list();
-		void execute_command_list();
+		auto checkout_command_list(uint32_t submit_order) -> dx_cmd_list;
+		auto record_fixup_list(const std::vector<D3D12_RESOURCE_BARRIER> &barriers) -> open_cmd_list;
+
+		void close_command_lists();
+		void execute_command_lists();
 
 		void wait_for_previous_frame(uint8_t buffer_index);
+		void wait_for_fence_value(uint64_t value);
 		void set_frame_complete_signal(uint8_t buffer_index);
+		auto signal() -> uint64_t;
 
 	private:
 		const cmd_queue_type type{};
+		dx_device device{};
 		dx_cmd_queue command_queue{};
 		
-		std::vector<dx_cmd_allocator> command_allocators{};
-		dx_cmd_list command_list;
-
-		std::vector<frame_fence> fences{};
+		dx_cmd_list_backend list_backend;
+		list_pool command_lists; // must not outlive list_backend
+		mutable std::mutex command_lists_mutex{};
+		uint8_t frame_buffer_index{};
+		barrier_stats last_barrier_stats{};
+		state_tracker_stats last_state_stats{};
+		resource_state_registry *state_registry{};
+		std::wstring name{};
+
+		dx_fence fence{};
+		uint64_t fence_value{};
+		std::vector<uint64_t> frame_fence_values{};
 		HANDLE fence_event;
 
+		queue_dependencies<cmd_queue> gpu_waits{};
+
 	private:
 		friend class directx_12;
 	};
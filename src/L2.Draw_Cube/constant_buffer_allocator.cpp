@@ -0,0 +1,88 @@
+#include "constant_buffer_allocator.h"
+
+#include "d3dx12.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace learning_dx12;
+
+constant_buffer_allocator::constant_buffer_allocator(dx_device device, uint8_t frame_count) :
+	constant_buffer_allocator(device, frame_count, default_page_size)
+{}
+
+constant_buffer_allocator::constant_buffer_allocator(dx_device device, uint8_t frame_count, uint64_t page_size_) :
+	page_size{page_size_}
+{
+	assert(page_size % D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT == 0);
+
+	pages.reserve(frame_count);
+	for (auto i = uint8_t{}; i < frame_count; i++)
+	{
+		pages.emplace_back(page_size);
+	}
+
+	create_buffer(device);
+}
+
+constant_buffer_allocator::~constant_buffer_allocator()
+{
+	buffer->Unmap(0, nullptr);
+}
+
+void constant_buffer_allocator::begin_frame(uint8_t frame_index)
+{
+	active_page = frame_index;
+	pages.at(active_page).reset();
+}
+
+auto constant_buffer_allocator::allocate(uint64_t size) -> std::optional<constant_allocation>
+{
+	auto offset = pages.at(active_page).allocate(size, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+	if (not offset)
+	{
+		return std::nullopt;
+	}
+
+	auto page_offset = active_page * page_size + *offset;
+	return constant_allocation{
+		cpu_base + page_offset,
+		gpu_base + page_offset,
+		buffer.get(),
+		page_offset
+	};
+}
+
+auto constant_buffer_allocator::get_high_water() const -> uint64_t
+{
+	auto high_water = uint64_t{};
+	for (auto &page : pages)
+	{
+		high_water = std::max(high_water, page.get_high_water());
+	}
+	return high_water;
+}
+
+void constant_buffer_allocator::set_name(LPCWSTR name)
+{
+	buffer->SetName(name);
+}
+
+void constant_buffer_allocator::create_buffer(dx_device device)
+{
+	auto buffer_size = page_size * pages.size();
+	auto hr = device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+	                                          D3D12_HEAP_FLAG_NONE,
+	                                          &CD3DX12_RESOURCE_DESC::Buffer(buffer_size),
+	                                          D3D12_RESOURCE_STATE_GENERIC_READ,
+	                                          nullptr,
+	                                          __uuidof(ID3D12Resource),
+	                                          buffer.put_void());
+	assert(SUCCEEDED(hr));
+
+	auto read_range = CD3DX12_RANGE(0, 0);
+	hr = buffer->Map(0, &read_range, reinterpret_cast<void **>(&cpu_base));
+	assert(SUCCEEDED(hr));
+
+	gpu_base = buffer->GetGPUVirtualAddress();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "dx_wrapped_types.h"
+#include "linear_allocator.h"
+
+#include <d3d12.h>
+
+#include <vector>
+#include <cstring>
+#include <optional>
+
+namespace learning_dx12
+{
+	struct constant_allocation
+	{
+		void *cpu_address;
+		D3D12_GPU_VIRTUAL_ADDRESS gpu_address;
+		ID3D12Resource *resource; // for calls taking a buffer and offset
+		uint64_t offset;
+	};
+
+	// Mapped upload memory split into one page per frame in flight.
+	// Blocks are 256-byte aligned so their address can go straight 
+	// into SetGraphicsRootConstantBufferView. begin_frame throws away 
+	// everything in that frame's page, so only call it once the frame's 
+	// fence has been waited on. Once a page is full allocate returns 
+	// nothing, leave out whatever needed the space.
+	class constant_buffer_allocator
+	{
+	public:
+		static constexpr auto default_page_size = uint64_t{ 1024 * 1024 };
+
+	public:
+		constant_buffer_allocator(dx_device device, uint8_t frame_count);
+		constant_buffer_allocator(dx_device device, uint8_t frame_count, uint64_t page_size);
+		constant_buffer_allocator() = delete;
+		~constant_buffer_allocator();
+
+		void begin_frame(uint8_t frame_index);
+		auto allocate(uint64_t size) -> std::optional<constant_allocation>;
+
+		template <typename T>
+		auto allocate(const T &data) -> std::optional<constant_allocation>
+		{
+			auto allocation = allocate(sizeof(T));
+			if (allocation)
+			{
+				std::memcpy(allocation->cpu_address, &data, sizeof(T));
+			}
+			return allocation;
+		}
+
+		auto get_high_water() const -> uint64_t;
+
+		void set_name(LPCWSTR name);
+
+	private:
+		void create_buffer(dx_device device);
+
+	private:
+		const uint64_t page_size{};
+		std::vector<linear_allocator> pages{};
+		uint8_t active_page{};
+
+		dx_resource buffer{};
+		uint8_t *cpu_base{};
+		D3D12_GPU_VIRTUAL_ADDRESS gpu_base{};
+	};
+}
@@ -0,0 +1,88 @@
+#include "cube_instances.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace learning_dx12;
+using namespace DirectX;
+
+namespace
+{
+	constexpr auto cube_spacing = 3.0f; // cubes are 2 wide
+
+	auto get_grid_side(uint32_t count) -> uint32_t
+	{
+		auto side = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(count))));
+		return std::max(side, 1u);
+	}
+}
+
+auto learning_dx12::make_cube_grid(uint32_t count) -> std::vector<cube_instance>
+{
+	auto side = get_grid_side(count);
+	auto offset = (side - 1) * cube_spacing / 2.0f;
+	auto tint_scale = side > 1 ? 0.75f / (side - 1) : 0.0f;
+
+	auto instances = std::vector<cube_instance>(count);
+	for (auto i = uint32_t{}; i < count; i++)
+	{
+		auto x = i % side,
+		     y = (i / side) % side,
+		     z = i / (side * side);
+
+		auto &instance = instances[i];
+		XMStoreFloat4x4(&instance.world, XMMatrixTranslation(x * cube_spacing - offset,
+		                                                     y * cube_spacing - offset,
+		                                                     z * cube_spacing - offset));
+		instance.color = { 0.25f + x * tint_scale, 0.25f + y * tint_scale, 0.25f + z * tint_scale, 1.0f };
+	}
+	return instances;
+}
+
+auto learning_dx12::get_cube_grid_extent(uint32_t count) -> float
+{
+	return get_grid_side(count) * cube_spacing;
+}
+
+instance_count_sweep::instance_count_sweep(uint32_t first_count, uint32_t last_count_) :
+	instance_count{ std::max(first_count, 1u) },
+	last_count{ last_count_ }
+{}
+
+instance_count_sweep::~instance_count_sweep() = default;
+
+auto instance_count_sweep::is_done() const -> bool
+{
+	return instance_count > last_count;
+}
+
+auto instance_count_sweep::get_instance_count() const -> uint32_t
+{
+	return std::min(instance_count, last_count);
+}
+
+auto instance_count_sweep::add_frame(double frame_ms) -> std::optional<sweep_result>
+{
+	if (is_done())
+	{
+		return std::nullopt;
+	}
+
+	frames++;
+	if (frames <= warm_up_frames)
+	{
+		return std::nullopt;
+	}
+
+	measured_ms += frame_ms;
+	if (frames < warm_up_frames + measured_frames)
+	{
+		return std::nullopt;
+	}
+
+	auto result = sweep_result{ instance_count, measured_ms / measured_frames };
+	instance_count *= 2;
+	frames = 0;
+	measured_ms = 0.0;
+	return result;
+}
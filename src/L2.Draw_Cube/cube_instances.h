@@ -0,0 +1,61 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace learning_dx12
+{
+	// Matches cube_instance in vertex_shader.hlsl, read by SV_InstanceID.
+	struct cube_instance
+	{
+		DirectX::XMFLOAT4X4 world;
+		DirectX::XMFLOAT4 color;
+	};
+
+	// Bounds the per-frame instance buffer, 20 MB a frame in flight.
+	constexpr auto max_cube_instances = uint32_t{ 1 } << 18;
+
+	// Cubes on a grid as close to a cube as the count allows, centred on the origin
+	// and tinted by where they are on it.
+	auto make_cube_grid(uint32_t count) -> std::vector<cube_instance>;
+
+	// Width of the grid make_cube_grid lays out, to keep the camera far enough away.
+	auto get_cube_grid_extent(uint32_t count) -> float;
+
+	struct sweep_result
+	{
+		uint32_t instance_count;
+		double frame_ms;
+	};
+
+	// Benchmark scene timing, doubles the instance count from first to last,
+	// averaging the frame time at each. The first frames at a count are
+	// skipped, they include building and uploading the new grid.
+	class instance_count_sweep
+	{
+	public:
+		static constexpr auto warm_up_frames = uint32_t{ 30 };
+		static constexpr auto measured_frames = uint32_t{ 120 };
+
+	public:
+		instance_count_sweep(uint32_t first_count, uint32_t last_count);
+		instance_count_sweep() = delete;
+		~instance_count_sweep();
+
+		auto is_done() const -> bool;
+		auto get_instance_count() const -> uint32_t;
+
+		// Returns the count's result once it has been measured, the next
+		// frame is then drawn with the next count.
+		auto add_frame(double frame_ms) -> std::optional<sweep_result>;
+
+	private:
+		uint32_t instance_count{};
+		uint32_t last_count{};
+		uint32_t frames{};
+		double measured_ms{};
+	};
+}
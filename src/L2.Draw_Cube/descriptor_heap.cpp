@@ -0,0 +1,215 @@
+#include "descriptor_heap.h"
+
+#include "d3dx12.h"
+
+#include <cppitertools/enumerate.hpp>
+#include <algorithm>
+#include <cassert>
+
+using namespace learning_dx12;
+
+auto descriptor_range::cpu_at(uint32_t offset, uint32_t increment) const -> D3D12_CPU_DESCRIPTOR_HANDLE
+{
+	assert(offset < count);
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(cpu, offset, increment);
+}
+
+auto descriptor_range::gpu_at(uint32_t offset, uint32_t increment) const -> D3D12_GPU_DESCRIPTOR_HANDLE
+{
+	assert(offset < count);
+	return CD3DX12_GPU_DESCRIPTOR_HANDLE(gpu, offset, increment);
+}
+
+cpu_descriptor_heap::cpu_descriptor_heap(dx_device device_, D3D12_DESCRIPTOR_HEAP_TYPE type_) :
+	cpu_descriptor_heap(device_, type_, default_page_size)
+{}
+
+cpu_descriptor_heap::cpu_descriptor_heap(dx_device device_, D3D12_DESCRIPTOR_HEAP_TYPE type_, uint32_t page_size_) :
+	type{type_}, page_size{page_size_}, device{device_}
+{
+	increment_size = device->GetDescriptorHandleIncrementSize(type);
+}
+
+cpu_descriptor_heap::~cpu_descriptor_heap() = default;
+
+auto cpu_descriptor_heap::allocate(uint32_t count) -> descriptor_range
+{
+	auto make_range = [&](uint32_t page, uint32_t index) -> descriptor_range
+	{
+		auto start = pages.at(page).heap->GetCPUDescriptorHandleForHeapStart();
+		return {
+			CD3DX12_CPU_DESCRIPTOR_HANDLE(start, index, increment_size),
+			{},
+			page,
+			index,
+			count
+		};
+	};
+
+	for (auto &&[page, heap_page] : pages | iter::enumerate)
+	{
+		auto index = heap_page.allocator.allocate(count);
+		if (index)
+		{
+			return make_range(static_cast<uint32_t>(page), *index);
+		}
+	}
+
+	pages.push_back(create_page(std::max(page_size, count)));
+
+	auto index = pages.back().allocator.allocate(count);
+	assert(index);
+
+	return make_range(static_cast<uint32_t>(pages.size() - 1), *index);
+}
+
+void cpu_descriptor_heap::free(descriptor_range &range)
+{
+	pages.at(range.page).allocator.free(range.index, range.count);
+	range = {};
+}
+
+auto cpu_descriptor_heap::get_increment_size() const -> uint32_t
+{
+	return increment_size;
+}
+
+auto cpu_descriptor_heap::create_page(uint32_t descriptor_count) -> heap_page
+{
+	auto desc = D3D12_DESCRIPTOR_HEAP_DESC{};
+	desc.Type = type;
+	desc.NumDescriptors = descriptor_count;
+	desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+
+	auto heap = dx_descriptor_heap{};
+	auto hr = device->CreateDescriptorHeap(&desc,
+	                                       __uuidof(ID3D12DescriptorHeap),
+	                                       heap.put_void());
+	assert(SUCCEEDED(hr));
+
+	return { heap, free_list_allocator{ descriptor_count } };
+}
+
+gpu_descriptor_heap::gpu_descriptor_heap(dx_device device, D3D12_DESCRIPTOR_HEAP_TYPE type,
+                                         uint32_t persistent_count_, uint32_t dynamic_count) :
+	persistent_count{persistent_count_},
+	persistent{persistent_count_},
+	dynamic{dynamic_count}
+{
+	assert(type == D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV
+	    or type == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER);
+
+	auto desc = D3D12_DESCRIPTOR_HEAP_DESC{};
+	desc.Type = type;
+	desc.NumDescriptors = persistent_count + dynamic_count;
+	desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+
+	auto hr = device->CreateDescriptorHeap(&desc,
+	                                       __uuidof(ID3D12DescriptorHeap),
+	                                       heap.put_void());
+	assert(SUCCEEDED(hr));
+
+	increment_size = device->GetDescriptorHandleIncrementSize(type);
+	cpu_start = heap->GetCPUDescriptorHandleForHeapStart();
+	gpu_start = heap->GetGPUDescriptorHandleForHeapStart();
+}
+
+gpu_descriptor_heap::~gpu_descriptor_heap() = default;
+
+auto gpu_descriptor_heap::allocate_persistent(uint32_t count) -> descriptor_range
+{
+	auto index = persistent.allocate(count);
+	assert(index);
+
+	return make_range(*index, count);
+}
+
+void gpu_descriptor_heap::free_persistent(descriptor_range &range)
+{
+	persistent.free(range.index, range.count);
+	range = {};
+}
+
+auto gpu_descriptor_heap::allocate_dynamic(uint32_t count) -> descriptor_range
+{
+	auto offset = dynamic.allocate(count, 1);
+	assert(offset);
+
+	return make_range(persistent_count + static_cast<uint32_t>(*offset), count);
+}
+
+void gpu_descriptor_heap::finish_frame(uint64_t fence_value)
+{
+	dynamic.finish_batch(fence_value);
+}
+
+void gpu_descriptor_heap::release_completed(uint64_t completed_fence_value)
+{
+	dynamic.release_completed(completed_fence_value);
+}
+
+auto gpu_descriptor_heap::get_heap() const -> dx_descriptor_heap
+{
+	return heap;
+}
+
+auto gpu_descriptor_heap::get_increment_size() const -> uint32_t
+{
+	return increment_size;
+}
+
+void gpu_descriptor_heap::set_name(LPCWSTR name)
+{
+	heap->SetName(name);
+}
+
+auto gpu_descriptor_heap::make_range(uint32_t index, uint32_t count) const -> descriptor_range
+{
+	return {
+		CD3DX12_CPU_DESCRIPTOR_HANDLE(cpu_start, index, increment_size),
+		CD3DX12_GPU_DESCRIPTOR_HANDLE(gpu_start, index, increment_size),
+		0,
+		index,
+		count
+	};
+}
+
+descriptor_copy_batch::descriptor_copy_batch(D3D12_DESCRIPTOR_HEAP_TYPE type_) :
+	type{type_}
+{}
+
+descriptor_copy_batch::~descriptor_copy_batch() = default;
+
+void descriptor_copy_batch::add(D3D12_CPU_DESCRIPTOR_HANDLE destination, D3D12_CPU_DESCRIPTOR_HANDLE source, uint32_t count)
+{
+	destinations.push_back(destination);
+	destination_sizes.push_back(count);
+	sources.push_back(source);
+	source_sizes.push_back(count);
+}
+
+void descriptor_copy_batch::flush(dx_device device)
+{
+	if (destinations.empty())
+	{
+		return;
+	}
+
+	device->CopyDescriptors(static_cast<uint32_t>(destinations.size()),
+	                        destinations.data(),
+	                        destination_sizes.data(),
+	                        static_cast<uint32_t>(sources.size()),
+	                        sources.data(),
+	                        source_sizes.data(),
+	                        type);
+
+	destinations.clear();
+	destination_sizes.clear();
+	sources.clear();
+	source_sizes.clear();
+}
+
+auto descriptor_copy_batch::size() const -> size_t
+{
+	return destinations.size();
+}
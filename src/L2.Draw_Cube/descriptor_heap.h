@@ -0,0 +1,123 @@
+#pragma once
+
+#include "dx_wrapped_types.h"
+#include "free_list_allocator.h"
+#include "ring_allocator.h"
+
+#include <d3d12.h>
+
+#include <vector>
+
+namespace learning_dx12
+{
+	struct descriptor_range
+	{
+		D3D12_CPU_DESCRIPTOR_HANDLE cpu;
+		D3D12_GPU_DESCRIPTOR_HANDLE gpu;
+		uint32_t page;
+		uint32_t index;
+		uint32_t count;
+
+		auto cpu_at(uint32_t offset, uint32_t increment) const -> D3D12_CPU_DESCRIPTOR_HANDLE;
+		auto gpu_at(uint32_t offset, uint32_t increment) const -> D3D12_GPU_DESCRIPTOR_HANDLE;
+	};
+
+	// CPU-only (staging) descriptors, RTV/DSV or views to be copied into 
+	// the shader visible heap later. Adds another heap page whenever the 
+	// existing ones are full, so it never runs out.
+	class cpu_descriptor_heap
+	{
+	public:
+		static constexpr auto default_page_size = uint32_t{ 256 };
+
+	public:
+		cpu_descriptor_heap(dx_device device, D3D12_DESCRIPTOR_HEAP_TYPE type);
+		cpu_descriptor_heap(dx_device device, D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t page_size);
+		cpu_descriptor_heap() = delete;
+		~cpu_descriptor_heap();
+
+		auto allocate(uint32_t count = 1) -> descriptor_range;
+		void free(descriptor_range &range);
+
+		auto get_increment_size() const -> uint32_t;
+
+	private:
+		struct heap_page
+		{
+			dx_descriptor_heap heap;
+			free_list_allocator allocator;
+		};
+
+		auto create_page(uint32_t descriptor_count) -> heap_page;
+
+	private:
+		const D3D12_DESCRIPTOR_HEAP_TYPE type{};
+		const uint32_t page_size{};
+		uint32_t increment_size{};
+		dx_device device{};
+
+		std::vector<heap_page> pages{};
+	};
+
+	// Shader visible heap split in two. The front is for descriptors that 
+	// live across frames and are allocated and freed individually. The rest is 
+	// a ring that per-frame tables are carved out of, handed back in bulk 
+	// once the fence given to finish_frame has been reached.
+	class gpu_descriptor_heap
+	{
+	public:
+		gpu_descriptor_heap(dx_device device, D3D12_DESCRIPTOR_HEAP_TYPE type, 
+		                    uint32_t persistent_count, uint32_t dynamic_count);
+		gpu_descriptor_heap() = delete;
+		~gpu_descriptor_heap();
+
+		auto allocate_persistent(uint32_t count = 1) -> descriptor_range;
+		void free_persistent(descriptor_range &range);
+
+		auto allocate_dynamic(uint32_t count) -> descriptor_range;
+		void finish_frame(uint64_t fence_value);
+		void release_completed(uint64_t completed_fence_value);
+
+		auto get_heap() const -> dx_descriptor_heap;
+		auto get_increment_size() const -> uint32_t;
+
+		void set_name(LPCWSTR name);
+
+	private:
+		auto make_range(uint32_t index, uint32_t count) const -> descriptor_range;
+
+	private:
+		const uint32_t persistent_count{};
+		uint32_t increment_size{};
+
+		dx_descriptor_heap heap{};
+		D3D12_CPU_DESCRIPTOR_HANDLE cpu_start{};
+		D3D12_GPU_DESCRIPTOR_HANDLE gpu_start{};
+
+		free_list_allocator persistent;
+		ring_allocator dynamic;
+	};
+
+	// Collects descriptor copies and issues them in a single CopyDescriptors.
+	// Sources must be in CPU-only heaps, they are only read at flush.
+	class descriptor_copy_batch
+	{
+	public:
+		descriptor_copy_batch(D3D12_DESCRIPTOR_HEAP_TYPE type);
+		descriptor_copy_batch() = delete;
+		~descriptor_copy_batch();
+
+		void add(D3D12_CPU_DESCRIPTOR_HANDLE destination, D3D12_CPU_DESCRIPTOR_HANDLE source, uint32_t count = 1);
+		void flush(dx_device device);
+
+		auto size() const -> size_t;
+
+	private:
+		const D3D12_DESCRIPTOR_HEAP_TYPE type{};
+
+		std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> destinations{};
+		std::vector<uint32_t> destination_sizes{};
+		std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> sources{};
+		std::vector<uint32_t> source_sizes{};
+	};
+}
@@ -3,7 +3,8 @@
 
 #include "directx12.h"
 #include "cmd_queue.h"
-#include "gpu_resource.h"
+#include "fence_waiter.h"
+#include "gpu_heap_allocator.h"
 
 #include "d3dx12.h"
 
@@ -23,7 +24,8 @@ using namespace learning_dx12;
 namespace
 {
 	constexpr auto vsync_enabled = TRUE;
-	constexpr auto dsv_buffer_count = 1;
+	constexpr auto persistent_descriptor_count = 1024u;
+	constexpr auto dynamic_descriptor_count = 4096u;
 
 	auto get_window_size(HWND hWnd) -> std::tuple<uint32_t, uint32_t>
 	{
@@ -193,35 +195,63 @@ directx_12::directx_12(HWND hWnd) :
 
 	create_device(adaptor);
 	
+	heap_allocator = std::make_unique<gpu_heap_allocator>(device);
+	completion_waiter = std::make_unique<fence_waiter>();
+	resource_states = std::make_unique<resource_state_registry>();
+
 	command_queue = std::make_unique<cmd_queue>(device, cmd_queue_type::direct);
 	command_queue->set_name(L"render targets");
+	command_queue->set_state_registry(*resource_states);
 
 	create_swapchain(factory);
-	create_rendertarget_heap();
+	create_descriptor_heaps();
 	create_back_buffers();
-
-	create_depthstencil_heap();
 	create_depthstencil_buffer();
 }
 
-directx_12::~directx_12() = default;
+// The depth buffer's memory goes back to heap_allocator,
+// which outlives the rest, once the GPU is done with it.
+directx_12::~directx_12()
+{
+	wait_for_gpu();
+	release_depthstencil_buffer();
+}
 
 auto directx_12::get_cmd_list() -> dx_cmd_list
 {
 	auto cmd_list = command_queue->get_command_list(active_back_buffer_index);
 
-	auto barrier = back_buffers.at(active_back_buffer_index)->transition_to(resource_state::render_target);
-	command_queue->set_command_list_barrier(barrier);
+	shader_visible_heap->release_completed(command_queue->get_fence()->GetCompletedValue());
+	auto heaps = std::array{ shader_visible_heap->get_heap().get() };
+	cmd_list->SetDescriptorHeaps(static_cast<uint32_t>(heaps.size()), heaps.data());
+
+	command_queue->transition(cmd_list, back_buffers.at(active_back_buffer_index).get(), D3D12_RESOURCE_STATE_RENDER_TARGET);
+	command_queue->transition(cmd_list, depthstencil_buffer.resource.get(), D3D12_RESOURCE_STATE_DEPTH_WRITE);
+
+	return cmd_list;
+}
+
+auto directx_12::get_cmd_list(uint32_t submit_order) -> dx_cmd_list
+{
+	assert(submit_order > cmd_queue::primary_list_order);
+	assert(submit_order != cmd_queue::epilogue_list_order);
+
+	auto cmd_list = command_queue->get_command_list(active_back_buffer_index, submit_order);
+
+	auto heaps = std::array{ shader_visible_heap->get_heap().get() };
+	cmd_list->SetDescriptorHeaps(static_cast<uint32_t>(heaps.size()), heaps.data());
 
 	return cmd_list;
 }
 
 void directx_12::present()
 {
-	auto barrier = back_buffers.at(active_back_buffer_index)->transition_to(resource_state::present);
-	command_queue->set_command_list_barrier(barrier);
+	auto cmd_list = command_queue->get_command_list(active_back_buffer_index, cmd_queue::epilogue_list_order);
+
+	command_queue->transition(cmd_list, back_buffers.at(active_back_buffer_index).get(), D3D12_RESOURCE_STATE_PRESENT);
 
 	command_queue->execute_commands(active_back_buffer_index);
+	shader_visible_heap->finish_frame(command_queue->get_fence_value());
 
 	auto hr = swapchain->Present(vsync_enabled, present_flags);
 	assert(SUCCEEDED(hr));
@@ -229,25 +259,99 @@ void directx_12::present()
 	active_back_buffer_index = swapchain->GetCurrentBackBufferIndex();
 }
 
+// Queued with the rest of the list's barriers, goes out at the next flush.
+void directx_12::set_barrier(dx_cmd_list cmd_list, CD3DX12_RESOURCE_BARRIER &barrier)
+{
+	command_queue->set_command_list_barrier(cmd_list, barrier);
+}
+
+void directx_12::flush_barriers(dx_cmd_list cmd_list)
+{
+	command_queue->flush_command_list_barriers(cmd_list);
+}
+
+auto directx_12::get_barrier_stats() const -> barrier_stats
+{
+	return command_queue->get_barrier_stats();
+}
+
+void directx_12::transition(dx_cmd_list cmd_list, ID3D12Resource *resource, D3D12_RESOURCE_STATES state, uint32_t subresource)
+{
+	command_queue->transition(cmd_list, resource, state, subresource);
+}
+
+auto directx_12::get_state_stats() const -> state_tracker_stats
+{
+	return command_queue->get_state_stats();
+}
+
+void directx_12::gpu_wait(const cmd_queue &queue, uint64_t value)
+{
+	command_queue->wait_on_gpu(queue, value);
+}
+
+void directx_12::wait_for_gpu()
+{
+	command_queue->wait_for_execute_finish();
+}
+
+// Runs on the fence waiter's thread once the GPU has finished
+// everything submitted to the direct queue so far.
+void directx_12::when_gpu_done(std::function<void()> callback)
+{
+	completion_waiter->when_reached(command_queue->get_fence(),
+	                                command_queue->get_fence_value(),
+	                                std::move(callback));
+}
+
 auto directx_12::get_device() const -> dx_device
 {
 	return device;
 }
 
-auto directx_12::get_rendertarget() const -> D3D12_CPU_DESCRIPTOR_HANDLE
+auto directx_12::get_frame_index() const -> uint8_t
 {
-	auto rtv_handle = CD3DX12_CPU_DESCRIPTOR_HANDLE(rendertarget_heap->GetCPUDescriptorHandleForHeapStart(),
-													active_back_buffer_index,
-													rendertarget_heap_size);
+	return active_back_buffer_index;
+}
 
-	return rtv_handle;
+auto directx_12::get_fence_waiter() const -> fence_waiter &
+{
+	return *completion_waiter;
 }
 
-auto directx_12::get_depthstencil() const -> D3D12_CPU_DESCRIPTOR_HANDLE
+auto directx_12::get_heap_allocator() const -> gpu_heap_allocator &
+{
+	return *heap_allocator;
+}
+
+auto directx_12::get_descriptor_heap() const -> gpu_descriptor_heap &
 {
-	auto dsv_handle = depthstencil_heap->GetCPUDescriptorHandleForHeapStart();
+	return *shader_visible_heap;
+}
+
+auto directx_12::get_resource_states() const -> resource_state_registry &
+{
+	return *resource_states;
+}
+
+auto directx_12::get_back_buffer() const -> ID3D12Resource *
+{
+	return back_buffers.at(active_back_buffer_index).get();
+}
+
+auto directx_12::get_depthstencil_buffer() const -> ID3D12Resource *
+{
+	return depthstencil_buffer.resource.get();
+}
+
+auto directx_12::get_rendertarget() const -> D3D12_CPU_DESCRIPTOR_HANDLE
+{
+	return back_buffer_views.at(active_back_buffer_index).cpu;
+}
 
-	return dsv_handle;
+auto directx_12::get_depthstencil() const -> D3D12_CPU_DESCRIPTOR_HANDLE
+{
+	return depthstencil_view.cpu;
 }
 
 void directx_12::create_device(dxgi_adaptor_4 adaptor)
@@ -298,37 +402,20 @@ void directx_12::create_swapchain(dxgi_factory_4 factory)
 	active_back_buffer_index = swapchain->GetCurrentBackBufferIndex();
 }
 
-void directx_12::create_rendertarget_heap()
-{
-	auto desc = D3D12_DESCRIPTOR_HEAP_DESC{};
-	desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-	desc.NumDescriptors = frame_buffer_count;
-
-	rendertarget_heap_size = device->GetDescriptorHandleIncrementSize(desc.Type);
-
-	auto hr = device->CreateDescriptorHeap(&desc,
-	                                       __uuidof(ID3D12DescriptorHeap),
-	                                       rendertarget_heap.put_void());
-	assert(SUCCEEDED(hr));
-}
-
-void directx_12::create_depthstencil_heap()
+void directx_12::create_descriptor_heaps()
 {
-	auto desc = D3D12_DESCRIPTOR_HEAP_DESC{};
-	desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
-	desc.NumDescriptors = dsv_buffer_count;
-
-	auto hr = device->CreateDescriptorHeap(&desc,
-	                                       __uuidof(ID3D12DescriptorHeap),
-	                                       depthstencil_heap.put_void());
-	assert(SUCCEEDED(hr));
+	rendertarget_heap = std::make_unique<cpu_descriptor_heap>(device, D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+	depthstencil_heap = std::make_unique<cpu_descriptor_heap>(device, D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
+
+	shader_visible_heap = std::make_unique<gpu_descriptor_heap>(device,
+	                                                            D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
+	                                                            persistent_descriptor_count,
+	                                                            dynamic_descriptor_count);
+	shader_visible_heap->set_name(L"shader visible heap");
 }
 
 void directx_12::create_back_buffers()
 {
-	auto rendertarget_handle = CD3DX12_CPU_DESCRIPTOR_HANDLE(
-									rendertarget_heap->GetCPUDescriptorHandleForHeapStart());
-
 	for (auto &&[i, back_buffer] : back_buffers | iter::enumerate)
 	{
 		auto buffer = dx_resource{};
@@ -337,19 +424,27 @@ void directx_12::create_back_buffers()
 		                               buffer.put_void());
 		assert(SUCCEEDED(hr));
 
+		auto &view = back_buffer_views.at(i);
+		view = rendertarget_heap->allocate();
 		device->CreateRenderTargetView(buffer.get(),
 		                               nullptr,
-		                               rendertarget_handle);
-
-		rendertarget_handle.Offset(rendertarget_heap_size);
+		                               view.cpu);
 
-		back_buffer = std::make_unique<gpu_resource>(buffer, resource_state::present);
+		resource_states->add(buffer.get(),
+		                     make_resource_traits(buffer->GetDesc()),
+		                     D3D12_RESOURCE_STATE_PRESENT);
+		back_buffer = buffer;
 	}
-
 }
 
+// Also re-creates it, the GPU must be done with the old one by then.
 void directx_12::create_depthstencil_buffer()
 {
+	if (depthstencil_buffer.resource)
+	{
+		release_depthstencil_buffer();
+	}
+
 	auto [width, height] = get_window_size(hWnd);
 
 	auto clear_value = D3D12_CLEAR_VALUE{};
@@ -361,15 +456,10 @@ void directx_12::create_depthstencil_buffer()
 	                                                1, 0, 1, 0,
 	                                                D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
 
-	dx_resource buffer{};
-	auto hr = device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-	                                          D3D12_HEAP_FLAG_NONE,
-	                                          &buffer_desc,
-	                                          D3D12_RESOURCE_STATE_DEPTH_WRITE,
-	                                          &clear_value,
-	                                          __uuidof(ID3D12Resource),
-	                                          buffer.put_void());
-	assert(SUCCEEDED(hr));
+	depthstencil_buffer = heap_allocator->create_resource(buffer_desc,
+	                                                      D3D12_RESOURCE_STATE_DEPTH_WRITE,
+	                                                      &clear_value);
+	auto buffer = depthstencil_buffer.resource;
 
 	auto desc = D3D12_DEPTH_STENCIL_VIEW_DESC{};
 	desc.Format = DXGI_FORMAT_D32_FLOAT;
@@ -377,10 +467,19 @@ void directx_12::create_depthstencil_buffer()
 	desc.Texture2D.MipSlice = 0;
 	desc.Flags = D3D12_DSV_FLAG_NONE;
 
+	depthstencil_view = depthstencil_heap->allocate();
 	device->CreateDepthStencilView(buffer.get(),
 	                               &desc,
-	                               depthstencil_heap->GetCPUDescriptorHandleForHeapStart());
+	                               depthstencil_view.cpu);
 
-	depthstencil_buffer = std::make_unique<gpu_resource>(buffer, resource_state::present);
+	resource_states->add(buffer.get(),
+	                     make_resource_traits(buffer_desc),
+	                     D3D12_RESOURCE_STATE_DEPTH_WRITE);
 }
 
+void directx_12::release_depthstencil_buffer()
+{
+	resource_states->remove(depthstencil_buffer.resource.get());
+	depthstencil_heap->free(depthstencil_view);
+	heap_allocator->free(depthstencil_buffer);
+}
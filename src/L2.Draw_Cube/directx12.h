@@ -1,12 +1,17 @@
 #pragma once
 
 #include "dx_wrapped_types.h"
+#include "descriptor_heap.h"
+#include "barrier_batch.h"
+#include "resource_state_tracker.h"
+#include "gpu_heap_allocator.h"
 
 #include <winrt/base.h>
 #include <d3d12.h>
 #include <dxgi1_6.h>
 
 #include <array>
+#include <functional>
 #include <memory>
 
 #ifdef _DEBUG
@@ -19,7 +24,7 @@ struct CD3DX12_RESOURCE_BARRIER;
 namespace learning_dx12
 {
 	class cmd_queue;
-	class gpu_resource;
+	class fence_waiter;
 
 	class directx_12
 	{
@@ -29,36 +34,66 @@ namespace learning_dx12
 		~directx_12();
 
 		auto get_cmd_list() -> dx_cmd_list;
+		auto get_cmd_list(uint32_t submit_order) -> dx_cmd_list;
 		void present();
 
+		void set_barrier(dx_cmd_list cmd_list, CD3DX12_RESOURCE_BARRIER &barrier);
+		void flush_barriers(dx_cmd_list cmd_list);
+		auto get_barrier_stats() const -> barrier_stats;
+
+		void transition(dx_cmd_list cmd_list, ID3D12Resource *resource, D3D12_RESOURCE_STATES state,
+		                uint32_t subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+		auto get_state_stats() const -> state_tracker_stats;
+
+		void gpu_wait(const cmd_queue &queue, uint64_t value);
+		void wait_for_gpu();
+		void when_gpu_done(std::function<void()> callback);
+
 		auto get_device() const -> dx_device;
+		auto get_frame_index() const -> uint8_t;
+		auto get_fence_waiter() const -> fence_waiter &;
+		auto get_heap_allocator() const -> gpu_heap_allocator &;
+		auto get_descriptor_heap() const -> gpu_descriptor_heap &;
+		auto get_resource_states() const -> resource_state_registry &;
+		auto get_back_buffer() const -> ID3D12Resource *;
+		auto get_depthstencil_buffer() const -> ID3D12Resource *;
 		auto get_rendertarget() const -> D3D12_CPU_DESCRIPTOR_HANDLE;
 		auto get_depthstencil() const -> D3D12_CPU_DESCRIPTOR_HANDLE;
 
 	private:
 		void create_device(dxgi_adaptor_4 adaptor);
 		void create_swapchain(dxgi_factory_4 factory);
-		void create_rendertarget_heap();
-		void create_depthstencil_heap();
+		void create_descriptor_heaps();
 		void create_back_buffers();
 		void create_depthstencil_buffer();
+		void release_depthstencil_buffer();
 		
 	private:
-		using gpu_resource_p = std::unique_ptr<gpu_resource>;
 		using cmd_queue_p = std::unique_ptr<cmd_queue>;
+		using fence_waiter_p = std::unique_ptr<fence_waiter>;
+		using heap_allocator_p = std::unique_ptr<gpu_heap_allocator>;
+		using cpu_descriptor_heap_p = std::unique_ptr<cpu_descriptor_heap>;
+		using gpu_descriptor_heap_p = std::unique_ptr<gpu_descriptor_heap>;
+		using state_registry_p = std::unique_ptr<resource_state_registry>;
 
 		HWND hWnd{};
 		dx_device device{};
+		heap_allocator_p heap_allocator{}; // must outlive every placed resource
+		state_registry_p resource_states{}; // must outlive every queue using it
 		dx_swapchain swapchain{};
 		
-		dx_descriptor_heap rendertarget_heap{};
-		uint32_t rendertarget_heap_size{};
-		std::array<gpu_resource_p, frame_buffer_count> back_buffers{};
+		cpu_descriptor_heap_p rendertarget_heap{};
+		cpu_descriptor_heap_p depthstencil_heap{};
+		gpu_descriptor_heap_p shader_visible_heap{};
+
+		std::array<dx_resource, frame_buffer_count> back_buffers{};
+		std::array<descriptor_range, frame_buffer_count> back_buffer_views{};
 		uint8_t active_back_buffer_index{};
 
-		dx_descriptor_heap depthstencil_heap{};
-		gpu_resource_p depthstencil_buffer{};
+		placed_resource depthstencil_buffer{};
+		descriptor_range depthstencil_view{};
 
+		fence_waiter_p completion_waiter{};
 		cmd_queue_p command_queue{}; // must be destroyed before all the buffers
 
 		uint32_t present_flags = {};
@@ -4,13 +4,31 @@
 
 #include "directx12.h"
 #include "cmd_queue.h"
-#include "gpu_resource.h"
+#include "upload_ring_buffer.h"
+#include "constant_buffer_allocator.h"
+#include "cube_instances.h"
+#include "gpu_heap_allocator.h"
+#include "frame_graph.h"
+#include "frustum_culling.h"
+#include "indirect_draw.h"
+#include "pipeline_state_cache.h"
+#include "root_layout_planner.h"
+#include "root_signature_registry.h"
+#include "shader_archive.h"
+#include "shader_permutations.h"
+#include "shader_reload_service.h"
 #include "clock.h"
 
+#include <fmt/format.h>
+
+#include <algorithm>
 #include <array>
-#include <vector>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <iterator>
+#include <vector>
+#include <string_view>
 
 using namespace learning_dx12;
 using namespace DirectX;
@@ -49,70 +67,89 @@ namespace {
 		4, 0, 3, 4, 3, 7,
 	};
 
-	auto read_binary_file(const std::filesystem::path &file_path) -> std::vector<byte>
+	// Points into the memory mapped archive, nothing is read or copied here.
+	auto get_shader(shader_archive &shaders, std::string_view name) -> shader_bytes
 	{
-		std::vector<byte> buffer;
+		auto shader = shaders.find(name);
+		assert(shader);
+		return *shader;
+	}
 
-		std::ifstream inFile(file_path, std::ios::in | std::ios::binary);
-		inFile.unsetf(std::ios::skipws);
+	// The vertex shader has a variant per draw path, the pixel shader just one.
+	auto get_variant(const shader_permutations &permutations, std::string_view shader,
+	                 permutation_bits bits = 0) -> const shader_variant &
+	{
+		auto variant = permutations.find(shader, bits);
+		assert(variant);
+		return *variant;
+	}
+
+	// Indices of the cube's root parameters, in declaration order.
+	constexpr auto draw_parameter = size_t{ 0 };
+	constexpr auto view_projection_parameter = size_t{ 1 };
+	constexpr auto instances_parameter = size_t{ 2 };
 
-		assert(inFile.is_open());
+	// Cubes are drawn instanced, their transform and color read from the
+	// instance buffer by SV_InstanceID, offset by the draw's first instance
+	// when drawn indirectly. That is the only argument changing between draws.
+	auto get_cube_root_parameters() -> std::vector<root_parameter_declaration>
+	{
+		return {
+			{ "draw_cb", "draw_constants", root_data_kind::constants, update_frequency::per_draw,
+			  1, D3D12_SHADER_VISIBILITY_VERTEX },
+			{ "view_projection_cb", "view_projection", root_data_kind::constants, update_frequency::per_frame,
+			  sizeof(XMMATRIX) / sizeof(uint32_t), D3D12_SHADER_VISIBILITY_VERTEX },
+			{ "instances", "StructuredBuffer<cube_instance>", root_data_kind::buffer_srv, update_frequency::per_frame,
+			  0, D3D12_SHADER_VISIBILITY_VERTEX },
+		};
+	}
 
-		inFile.seekg(0, std::ios::end);
-		buffer.reserve(inFile.tellg());
-		inFile.seekg(0, std::ios::beg);
+	// Shaders declare their root parameters by including root_layout.hlsli,
+	// checked in beside them, so it has to say what the plan does. Only
+	// reported, what to put in the file is up to whoever changed the plan.
+	void check_root_layout_hlsl(const root_layout &layout, const std::filesystem::path &shader_source)
+	{
+		auto hlsl_path = shader_source.parent_path() / "root_layout.hlsli";
+		auto hlsl = emit_hlsl(layout);
 
-		std::copy(std::istream_iterator<byte>(inFile),
-		          std::istream_iterator<byte>(),
-		          std::back_inserter(buffer));
+		auto file = std::ifstream(hlsl_path, std::ios::in | std::ios::binary);
+		auto current = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		if (current == hlsl)
+		{
+			return;
+		}
 
-		return buffer;
+		auto report = fmt::format("{} doesn't match the root signature, the shaders should see:\n{}",
+		                          hlsl_path.string(), hlsl);
+		::OutputDebugStringA(report.c_str());
 	}
 
-	auto create_buffer_and_upload(dx_device device, dx_cmd_list cmd_list,
+	// Each indirect draw stands in for a distinct mesh, with its own
+	// buffer views, so the command signature has something to change.
+	constexpr auto cubes_per_indirect_draw = uint32_t{ 64 };
+	constexpr auto max_indirect_draws = max_cube_instances / cubes_per_indirect_draw;
+	static_assert(max_indirect_draws * sizeof(indirect_draw_command) + D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT
+	              <= constant_buffer_allocator::default_page_size);
+
+	auto create_buffer_and_upload(gpu_heap_allocator &heap_allocator, resource_state_registry &resource_states,
+	                              cmd_queue &copy_queue, dx_cmd_list cmd_list, upload_ring_buffer &upload_ring,
 								  size_t buffer_size, const void *buffer_data,
 								  D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE)
-		-> std::pair<dx_resource, dx_resource>
+		-> placed_resource
 	{
-		auto buffer = dx_resource{};
-		auto hr = device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		                                          D3D12_HEAP_FLAG_NONE,
-		                                          &CD3DX12_RESOURCE_DESC::Buffer(buffer_size, flags),
-		                                          D3D12_RESOURCE_STATE_COPY_DEST,
-		                                          nullptr,
-		                                          __uuidof(ID3D12Resource),
-		                                          buffer.put_void());
-		assert(SUCCEEDED(hr));
-		//buffer->SetName(L"destination buffer");
-
-		auto inter_buff = dx_resource{};
-		hr = device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-		                                     D3D12_HEAP_FLAG_NONE,
-		                                     &CD3DX12_RESOURCE_DESC::Buffer(buffer_size),
-		                                     D3D12_RESOURCE_STATE_GENERIC_READ,
-		                                     nullptr,
-		                                     __uuidof(ID3D12Resource),
-		                                     inter_buff.put_void());
-		assert(SUCCEEDED(hr));
-		//inter_buff->SetName(L"intermediate buffer");
-
-		auto sub_res_data = D3D12_SUBRESOURCE_DATA{};
-		sub_res_data.pData = buffer_data;
-		sub_res_data.RowPitch = buffer_size;
-		sub_res_data.SlicePitch = buffer_size;
-
-		auto result = UpdateSubresources(cmd_list.get(),
-		                                 buffer.get(),
-		                                 inter_buff.get(),
-		                                 0, 0, 1,
-		                                 &sub_res_data);
-		assert(result == buffer_size);
-
-		return
-		{
-			buffer,
-			inter_buff
-		};
+		auto buffer_desc = CD3DX12_RESOURCE_DESC::Buffer(buffer_size, flags);
+		auto buffer = heap_allocator.create_resource(buffer_desc,
+		                                             D3D12_RESOURCE_STATE_COPY_DEST);
+		resource_states.add(buffer.resource.get(),
+		                    make_resource_traits(buffer_desc),
+		                    D3D12_RESOURCE_STATE_COPY_DEST);
+		copy_queue.transition(cmd_list, buffer.resource.get(), D3D12_RESOURCE_STATE_COPY_DEST);
+		//buffer.resource->SetName(L"destination buffer");
+
+		auto uploaded = upload_ring.upload(cmd_list, buffer.resource, 0, buffer_data, buffer_size);
+		assert(uploaded);
+
+		return buffer;
 	}
 }
 
@@ -120,23 +157,51 @@ draw_cube::draw_cube(HWND hWnd)
 {
 	dx = std::make_unique<directx_12>(hWnd);
 
-	auto copy_buffer_count = 1;
-	copy_queue = std::make_unique<cmd_queue>(dx->get_device(), cmd_queue_type::copy, copy_buffer_count);
+	copy_queue = std::make_unique<cmd_queue>(dx->get_device(), cmd_queue_type::copy);
 	copy_queue->set_name(L"copy queue");
+	copy_queue->set_state_registry(dx->get_resource_states());
+
+	upload_ring = std::make_unique<upload_ring_buffer>(dx->get_device());
+	upload_ring->set_name(L"upload ring buffer");
+
+	constant_buffers = std::make_unique<constant_buffer_allocator>(dx->get_device(), frame_buffer_count);
+	constant_buffers->set_name(L"per-frame constant buffer");
+
+	instance_buffers = std::make_unique<constant_buffer_allocator>(dx->get_device(), frame_buffer_count,
+	                                                               max_cube_instances * sizeof(cube_instance));
+	instance_buffers->set_name(L"per-frame instance buffer");
+
+	indirect_buffers = std::make_unique<constant_buffer_allocator>(dx->get_device(), frame_buffer_count);
+	indirect_buffers->set_name(L"per-frame indirect argument buffer");
+
+	culler = std::make_unique<frustum_culler>();
+
+	frame = std::make_unique<frame_graph>(dx->get_device());
+
+	root_signatures = std::make_unique<root_signature_registry>(dx->get_device(), "root_signatures.bin");
+
+	shaders = std::make_unique<shader_archive>(SHADER_ARCHIVE_NAME);
+	assert(shaders->is_open());
+
+	permutations = std::make_unique<shader_permutations>(SHADER_MANIFEST_NAME);
+	assert(permutations->is_open());
 
 	auto cmd_list = copy_queue->get_command_list();
 
-	auto copy_vertex_buffer = dx_resource{};
-	create_vertex_buffer(cmd_list, copy_vertex_buffer);
-	
-	auto copy_index_buffer = dx_resource{};
-	create_index_buffer(cmd_list, copy_index_buffer);
+	create_vertex_buffer(cmd_list);
+	create_index_buffer(cmd_list);
+	set_instance_count(1);
 	
 	create_root_signature();
-	create_pipeline_state(cmd_list);
+	request_pipeline_state();
 
 	copy_queue->execute_commands();
-	copy_queue->wait_for_execute_finish();
+
+	// Render queue waits on the GPU for the copies to land, 
+	// staging space is recycled once the copy queue is done with it.
+	auto copy_done = copy_queue->get_fence_value();
+	upload_ring->finish_batch(copy_done);
+	dx->gpu_wait(*copy_queue, copy_done);
 
 	RECT rect{};
 	::GetClientRect(hWnd, &rect);
@@ -150,7 +215,23 @@ draw_cube::draw_cube(HWND hWnd)
 
 }
 
-draw_cube::~draw_cube() = default;
+draw_cube::~draw_cube()
+{
+	dx->wait_for_gpu();
+
+	reloader = nullptr;
+	compiler = nullptr;
+	pipelines->save();
+	root_signatures->save();
+
+	auto &resource_states = dx->get_resource_states();
+	resource_states.remove(vertex_buffer.resource.get());
+	resource_states.remove(index_buffer.resource.get());
+
+	auto &heap_allocator = dx->get_heap_allocator();
+	heap_allocator.free(vertex_buffer);
+	heap_allocator.free(index_buffer);
+}
 
 auto draw_cube::continue_draw() const -> bool
 {
@@ -159,24 +240,161 @@ auto draw_cube::continue_draw() const -> bool
 
 void draw_cube::update(const game_clock &clk)
 {
-	auto angle = XMConvertToRadians(static_cast<float>(clk.get_total_s()) * 90.0f);
-	const auto rotation_axis = XMVectorSet(0.0f, 1.0f, 1.0f, 0.0f);
-	//model = XMMatrixRotationAxis(rotation_axis, angle);
-	model = XMMatrixTranslation(0.0f, 0.0f, 0.0f);
+	update_sweep(clk.get_delta_ms());
 
-	const auto eye_pos = XMVectorSet(0.0f, 0.0f, -10.0f, 1.0f);
+	// Backs away as the grid grows, so every cube stays in view.
+	auto extent = get_cube_grid_extent(instance_count);
+	const auto eye_pos = XMVectorSet(0.0f, 0.0f, -(10.0f + extent * 1.5f), 1.0f);
 	const auto tgt_pos = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
 	const auto up_dir = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
 	view = XMMatrixLookAtLH(eye_pos, tgt_pos, up_dir);
 
 	auto aspect_ratio = view_port.Width / view_port.Height;
-	projection = XMMatrixPerspectiveFovLH(field_of_view, aspect_ratio, 0.1f, 100.0f);
+	projection = XMMatrixPerspectiveFovLH(field_of_view, aspect_ratio, 0.1f, 100.0f + extent * 3.0f);
+
+	auto view_proj = XMFLOAT4X4{};
+	XMStoreFloat4x4(&view_proj, XMMatrixMultiply(view, projection));
+	culler->cull(extract_frustum_planes(view_proj.m), cube_bounds, visible_cubes);
+}
+
+void draw_cube::set_instance_count(uint32_t count)
+{
+	instance_count = std::clamp(count, 1u, max_cube_instances);
+	instances = make_cube_grid(instance_count);
+
+	// Cubes are only translated, so their boxes are the unit cube moved.
+	cube_bounds.resize(instance_count);
+	for (auto i = uint32_t{}; i < instance_count; i++)
+	{
+		auto &world = instances[i].world;
+		cube_bounds.set(i, world._41, world._42, world._43, 1.0f, 1.0f, 1.0f);
+	}
+	visible_cubes.clear(); // indices into the old grid, culled again next update
+
+	auto meshes = std::vector<indirect_mesh>{
+		{ vertex_buffer_view, index_buffer_view, static_cast<uint32_t>(cube_indicies.size()) },
+	};
+	auto items = std::vector<indirect_draw_item>{};
+	for (auto first = uint32_t{}; first < instance_count; first += cubes_per_indirect_draw)
+	{
+		items.push_back({ 0, first, std::min(cubes_per_indirect_draw, instance_count - first) });
+	}
+	cube_draw_commands = build_indirect_commands(meshes, items);
+	cube_draws_visible.assign(cube_draw_commands.size(), 1);
+}
+
+// Reports each count's average frame time as the debug output,
+// and the next count's grid is drawn from the next frame.
+void draw_cube::update_sweep(double frame_ms)
+{
+	if (not sweep)
+	{
+		return;
+	}
+
+	auto result = sweep->add_frame(frame_ms);
+	if (not result)
+	{
+		return;
+	}
+
+	auto report = fmt::format("{} instances: {:>7}, visible: {:>7}, frame: {:.3f} ms\n",
+	                          draw_indirect ? "indirect" : "direct",
+	                          result->instance_count,
+	                          visible_cubes.size(),
+	                          result->frame_ms);
+	::OutputDebugStringA(report.c_str());
+
+	if (sweep->is_done())
+	{
+		sweep.reset();
+		return;
+	}
+	set_instance_count(sweep->get_instance_count());
 }
 
 void draw_cube::render()
 {
+	// Pipelines rebuilt after a shader changed are swapped in here,
+	// never while a frame is being recorded.
+	reloader->begin_frame();
+
+	// Staging space of uploads the copy queue has finished goes back to the ring.
+	upload_ring->release_completed(copy_queue->get_fence()->GetCompletedValue());
+
 	auto cmd_list = dx->get_cmd_list();
+	constant_buffers->begin_frame(dx->get_frame_index());
+	instance_buffers->begin_frame(dx->get_frame_index());
+	indirect_buffers->begin_frame(dx->get_frame_index());
+
+	// get_cmd_list hands the back buffer over as a render target, 
+	// and present takes it back from there.
+	frame->reset();
+	auto back_buffer = frame->import_resource("back buffer",
+	                                          dx->get_back_buffer(),
+	                                          graph_access::render_target,
+	                                          graph_access::render_target);
+	auto depth_buffer = frame->import_resource("depth buffer",
+	                                           dx->get_depthstencil_buffer(),
+	                                           graph_access::depth_write,
+	                                           graph_access::depth_write);
+
+	auto clear_pass = frame->add_pass("clear", [&](dx_cmd_list pass_list)
+	{
+		clear_targets(pass_list);
+	});
+	auto cube_pass = frame->add_pass("cube", [&](dx_cmd_list pass_list)
+	{
+		draw_cubes(pass_list);
+	});
+
+	auto &graph = frame->get_graph();
+	graph.write(clear_pass, back_buffer, graph_access::render_target);
+	graph.write(clear_pass, depth_buffer, graph_access::depth_write);
+	graph.modify(cube_pass, back_buffer, graph_access::render_target);
+	graph.modify(cube_pass, depth_buffer, graph_access::depth_write);
+
+	frame->execute(*dx, cmd_list);
+
+	dx->present();
+}
+
+auto draw_cube::on_key_press(uintptr_t wParam, uintptr_t lParam) -> bool
+{
+	auto &key = wParam;
+
+	switch (key)
+	{
+	case VK_ESCAPE:
+		continue_to_draw = false;
+		break;	
+	case VK_ADD:
+	case VK_OEM_PLUS:
+		set_instance_count(instance_count * 2);
+		break;
+	case VK_SUBTRACT:
+	case VK_OEM_MINUS:
+		set_instance_count(instance_count / 2);
+		break;
+	case 'I':
+		draw_indirect = not draw_indirect;
+		break;
+	case 'B':
+		sweep.emplace(1, max_cube_instances);
+		set_instance_count(sweep->get_instance_count());
+		break;
+	}
+
+	return true;
+}
 
+auto draw_cube::on_mouse_move(uintptr_t wParam, uintptr_t lParam) -> bool
+{
+	return true;
+}
+
+void draw_cube::clear_targets(dx_cmd_list cmd_list)
+{
 	auto rtv = dx->get_rendertarget();
 	auto dsv = dx->get_depthstencil();
 
@@ -189,9 +407,32 @@ void draw_cube::render()
 	                                1.0f,
 	                                0, 0,
 	                                nullptr);
+}
+
+void draw_cube::draw_cubes(dx_cmd_list cmd_list)
+{
+	// Cubes aren't drawn until their pipeline has compiled,
+	// it goes to the front of the queue while they wait.
+	auto pipeline = reloader->get_pipeline(draw_indirect ? cube_indirect_pipeline : cube_pipeline);
+	auto pipeline_state = compiler->get(pipeline);
+	if (not pipeline_state)
+	{
+		compiler->boost(pipeline);
+		return;
+	}
+
+	auto rtv = dx->get_rendertarget();
+	auto dsv = dx->get_depthstencil();
+
+	// Buffers decay to COMMON after every submission and are promoted 
+	// straight back on first use, so neither of these costs a barrier.
+	dx->transition(cmd_list, vertex_buffer.resource.get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+	dx->transition(cmd_list, index_buffer.resource.get(), D3D12_RESOURCE_STATE_INDEX_BUFFER);
+	dx->flush_barriers(cmd_list);
+
 	cmd_list->OMSetRenderTargets(1, &rtv, FALSE, &dsv);
 
-	cmd_list->SetPipelineState(pipeline_state.get());
+	cmd_list->SetPipelineState(pipeline_state);
 	cmd_list->SetGraphicsRootSignature(root_signature.get());
 
 	cmd_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
@@ -201,72 +442,147 @@ void draw_cube::render()
 	cmd_list->RSSetViewports(1, &view_port);
 	cmd_list->RSSetScissorRects(1, &scissor_rect);
 
-	auto mvp = XMMatrixMultiply(model, view);
-	mvp = XMMatrixMultiply(mvp, projection);
-	cmd_list->SetGraphicsRoot32BitConstants(0, sizeof(XMMATRIX) / 4, &mvp, 0);
+	auto view_proj = XMMatrixMultiply(view, projection);
+	auto &view_proj_parameter = cube_root_layout.parameters[view_projection_parameter];
+	if (view_proj_parameter.binding == root_binding::constants)
+	{
+		cmd_list->SetGraphicsRoot32BitConstants(view_proj_parameter.root_index, sizeof(view_proj) / sizeof(uint32_t), &view_proj, 0);
+	}
+	else
+	{
+		auto view_proj_cb = constant_buffers->allocate(view_proj);
+		if (not view_proj_cb)
+		{
+			return;
+		}
+		cmd_list->SetGraphicsRootConstantBufferView(view_proj_parameter.root_index, view_proj_cb->gpu_address);
+	}
 
-	cmd_list->DrawIndexedInstanced(static_cast<uint32_t>(cube_indicies.size()),
-	                               1, 0, 0, 0);
+	auto &instances_root = cube_root_layout.parameters[instances_parameter];
+	assert(instances_root.binding == root_binding::descriptor);
 
-	dx->present();
-}
+	if (draw_indirect)
+	{
+		draw_cubes_indirect(cmd_list, instances_root.root_index);
+		return;
+	}
 
-auto draw_cube::on_key_press(uintptr_t wParam, uintptr_t lParam) -> bool
-{
-	auto &key = wParam;
+	if (visible_cubes.empty())
+	{
+		return;
+	}
 
-	switch (key)
+	// Only the cubes that survived culling, gathered back to back.
+	auto instance_data = instance_buffers->allocate(visible_cubes.size() * sizeof(cube_instance));
+	if (not instance_data)
 	{
-	case VK_ESCAPE:
-		continue_to_draw = false;
-		break;	
+		return;
+	}
+	auto gathered = static_cast<cube_instance *>(instance_data->cpu_address);
+	for (auto i : visible_cubes)
+	{
+		*gathered++ = instances[i];
 	}
+	cmd_list->SetGraphicsRootShaderResourceView(instances_root.root_index, instance_data->gpu_address);
 
-	return true;
+	// The direct variant reads instances from the start and ignores the
+	// first instance, but every root argument still has to be set.
+	auto &draw_root = cube_root_layout.parameters[draw_parameter];
+	cmd_list->SetGraphicsRoot32BitConstant(draw_root.root_index, 0, 0);
+	cmd_list->DrawIndexedInstanced(static_cast<uint32_t>(cube_indicies.size()),
+	                               static_cast<uint32_t>(visible_cubes.size()), 0, 0, 0);
 }
 
-auto draw_cube::on_mouse_move(uintptr_t wParam, uintptr_t lParam) -> bool
+// Stands in for a culling pass on the GPU writing the argument buffer,
+// a draw is kept if any of its cubes is visible. The GPU reads the draw
+// count from a buffer too, so such a pass can compact them in its place.
+void draw_cube::draw_cubes_indirect(dx_cmd_list cmd_list, uint32_t instances_root_index)
 {
-	return true;
+	std::fill(cube_draws_visible.begin(), cube_draws_visible.end(), uint8_t{});
+	for (auto i : visible_cubes)
+	{
+		cube_draws_visible[i / cubes_per_indirect_draw] = 1;
+	}
+
+	auto commands = compact_indirect_commands(cube_draw_commands, cube_draws_visible);
+	auto draw_count = static_cast<uint32_t>(commands.size());
+	if (draw_count == 0)
+	{
+		return;
+	}
+
+	// Only the kept draws' instances, packed into this frame's page and
+	// read straight from upload memory by the vertex shader.
+	auto runs = pack_indirect_instances(commands);
+	auto packed_count = commands.back().first_instance + commands.back().draw.InstanceCount;
+	auto arguments_size = commands.size() * sizeof(indirect_draw_command);
+	auto instance_data = instance_buffers->allocate(packed_count * sizeof(cube_instance));
+	auto arguments = indirect_buffers->allocate(arguments_size);
+	auto count = indirect_buffers->allocate<uint32_t>(draw_count);
+	if (not instance_data or not arguments or not count)
+	{
+		return;
+	}
+
+	auto packed = static_cast<cube_instance *>(instance_data->cpu_address);
+	for (auto &run : runs)
+	{
+		std::memcpy(packed, instances.data() + run.first_instance, run.instance_count * sizeof(cube_instance));
+		packed += run.instance_count;
+	}
+	cmd_list->SetGraphicsRootShaderResourceView(instances_root_index, instance_data->gpu_address);
+
+	std::memcpy(arguments->cpu_address, commands.data(), arguments_size);
+
+	cmd_list->ExecuteIndirect(draw_signature.get(),
+	                          draw_count,
+	                          arguments->resource,
+	                          arguments->offset,
+	                          count->resource,
+	                          count->offset);
 }
 
-void draw_cube::create_vertex_buffer(dx_cmd_list cmd_list, dx_resource &copy_buffer)
+void draw_cube::create_vertex_buffer(dx_cmd_list cmd_list)
 {
 	auto buffer_size = cube_vertices.size() * sizeof(vertex_pos_color);
-	auto buffer_pair = create_buffer_and_upload(dx->get_device(),
-	                                            cmd_list,
-	                                            buffer_size,
-	                                            static_cast<const void *>(cube_vertices.data()));
-	vertex_buffer = buffer_pair.first;
-	copy_buffer = buffer_pair.second;
-
-	vertex_buffer_view.BufferLocation = vertex_buffer->GetGPUVirtualAddress();
+	vertex_buffer = create_buffer_and_upload(dx->get_heap_allocator(),
+	                                         dx->get_resource_states(),
+	                                         *copy_queue,
+	                                         cmd_list,
+	                                         *upload_ring,
+	                                         buffer_size,
+	                                         static_cast<const void *>(cube_vertices.data()));
+
+	vertex_buffer_view.BufferLocation = vertex_buffer.resource->GetGPUVirtualAddress();
 	vertex_buffer_view.SizeInBytes = static_cast<uint32_t>(buffer_size);
 	vertex_buffer_view.StrideInBytes = sizeof(vertex_pos_color);
 }
 
-void draw_cube::create_index_buffer(dx_cmd_list cmd_list, dx_resource &copy_buffer)
+void draw_cube::create_index_buffer(dx_cmd_list cmd_list)
 {
 	auto buffer_size = cube_indicies.size() * sizeof(uint32_t);
-	auto buffer_pair = create_buffer_and_upload(dx->get_device(),
-	                                                            cmd_list,
-	                                                            buffer_size,
-	                                                            static_cast<const void *>(cube_indicies.data()));
-	index_buffer = buffer_pair.first;
-	copy_buffer = buffer_pair.second;
-
-	index_buffer_view.BufferLocation = index_buffer->GetGPUVirtualAddress();
-	index_buffer_view.Format = DXGI_FORMAT_R16_UINT;
+	index_buffer = create_buffer_and_upload(dx->get_heap_allocator(),
+	                                        dx->get_resource_states(),
+	                                        *copy_queue,
+	                                        cmd_list,
+	                                        *upload_ring,
+	                                        buffer_size,
+	                                        static_cast<const void *>(cube_indicies.data()));
+
+	index_buffer_view.BufferLocation = index_buffer.resource->GetGPUVirtualAddress();
+	index_buffer_view.Format = DXGI_FORMAT_R32_UINT;
 	index_buffer_view.SizeInBytes = static_cast<uint32_t>(buffer_size);
 }
 
+// Laid out by plan_root_layout, from what the shaders declare and how often it changes.
 void draw_cube::create_root_signature()
 {
-	auto parameters = std::array<D3D12_ROOT_PARAMETER1, 1>{};
-	CD3DX12_ROOT_PARAMETER1::InitAsConstants(parameters[0], 
-	                                         sizeof(XMMATRIX) / 4,
-	                                         0, 0,
-	                                         D3D12_SHADER_VISIBILITY_VERTEX);
+	cube_root_layout = plan_root_layout(get_cube_root_parameters());
+	assert(cube_root_layout.fits);
+
+#ifdef _DEBUG
+	check_root_layout_hlsl(cube_root_layout, get_variant(*permutations, "vertex_shader").source_file);
+#endif
 
 	constexpr auto flags = D3D12_ROOT_SIGNATURE_FLAGS
 	{
@@ -277,39 +593,65 @@ void draw_cube::create_root_signature()
 		D3D12_ROOT_SIGNATURE_FLAG_DENY_PIXEL_SHADER_ROOT_ACCESS
 	};
 
-	auto desc = D3D12_VERSIONED_ROOT_SIGNATURE_DESC{};
-	CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC::Init_1_1(desc,
-	                                                static_cast<uint32_t>(parameters.size()),
-	                                                parameters.data(),
-	                                                0,
-	                                                nullptr,
-	                                                flags);
-
-	auto rs_blob = dx_blob{};
-	auto err_blob = dx_blob{};
-	auto hr = D3D12SerializeVersionedRootSignature(&desc,
-	                                               rs_blob.put(),
-	                                               err_blob.put());
-	assert(SUCCEEDED(hr));
-
-	hr = dx->get_device()->CreateRootSignature(0,
-	                                           rs_blob->GetBufferPointer(),
-	                                           rs_blob->GetBufferSize(),
-	                                           __uuidof(ID3D12RootSignature),
-	                                           root_signature.put_void());
-	assert(SUCCEEDED(hr));
+	auto signature_layout = root_signature_layout{ cube_root_layout, flags };
+
+	auto registered = root_signatures->get_or_create(signature_layout.get_desc());
+	root_signature = registered.root_signature;
+	root_signature_hash = registered.hash;
 	root_signature->SetName(L"Root Signature");
+
+	auto &draw_root = cube_root_layout.parameters[draw_parameter];
+	assert(draw_root.binding == root_binding::constants);
+	draw_signature = create_draw_command_signature(dx->get_device(), root_signature, draw_root.root_index);
+}
+
+// Compiled in the background, draw_cubes skips drawing until it's ready.
+// One pipeline per draw path, each rebuilt whenever its shaders' source
+// or output changes.
+void draw_cube::request_pipeline_state()
+{
+	indirect_instances_bit = permutations->get_key_bit("vertex_shader", "INDIRECT_INSTANCES");
+	assert(indirect_instances_bit);
+
+	auto &vs_variant = get_variant(*permutations, "vertex_shader");
+	auto &vs_indirect_variant = get_variant(*permutations, "vertex_shader", indirect_instances_bit);
+	auto &ps_variant = get_variant(*permutations, "pixel_shader");
+	auto vso = get_shader(*shaders, vs_variant.name);
+	auto vso_indirect = get_shader(*shaders, vs_indirect_variant.name);
+	auto pso = get_shader(*shaders, ps_variant.name);
+
+	// Pipelines stored for different shaders are no use,
+	// the library is thrown out when any of them change.
+	auto shader_hash = hash_bytes(vso.data, vso.size);
+	shader_hash = hash_bytes(vso_indirect.data, vso_indirect.size, shader_hash);
+	shader_hash = hash_bytes(pso.data, pso.size, shader_hash);
+	pipelines = std::make_unique<pipeline_state_cache>(dx->get_device(), "pipelines.bin", shader_hash);
+	compiler = std::make_unique<pipeline_compiler>(*pipelines);
+
+	reloader = std::make_unique<shader_reload_service>(*compiler);
+	reloader->add_shader(vs_variant, vso);
+	reloader->add_shader(vs_indirect_variant, vso_indirect);
+	reloader->add_shader(ps_variant, pso);
+
+	cube_pipeline = reloader->add_pipeline({ vs_variant.name, ps_variant.name }, [this]()
+	{
+		return request_cube_pipeline(0);
+	});
+	cube_indirect_pipeline = reloader->add_pipeline({ vs_indirect_variant.name, ps_variant.name }, [this]()
+	{
+		return request_cube_pipeline(indirect_instances_bit);
+	});
 }
 
-void draw_cube::create_pipeline_state(dx_cmd_list cmd_list)
+auto draw_cube::request_cube_pipeline(permutation_bits vs_bits) -> pipeline_handle
 {
-	auto vso = read_binary_file("vertex_shader.cso");
-	auto vs = CD3DX12_SHADER_BYTECODE(vso.data(),
-									  vso.size() * sizeof(byte));
+	auto vso = reloader->get_shader(get_variant(*permutations, "vertex_shader", vs_bits).name);
+	auto vs = CD3DX12_SHADER_BYTECODE(vso.data,
+									  vso.size);
 	
-	auto pso = read_binary_file("pixel_shader.cso");
-	auto ps = CD3DX12_SHADER_BYTECODE(pso.data(),
-									  pso.size() * sizeof(byte));
+	auto pso = reloader->get_shader(get_variant(*permutations, "pixel_shader").name);
+	auto ps = CD3DX12_SHADER_BYTECODE(pso.data,
+									  pso.size);
 
 	auto il = D3D12_INPUT_LAYOUT_DESC{};
 	il.NumElements = static_cast<uint32_t>(input_elements_desc.size());
@@ -328,8 +670,5 @@ void draw_cube::create_pipeline_state(dx_cmd_list cmd_list)
 	desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
 	desc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
 
-	auto hr = dx->get_device()->CreateGraphicsPipelineState(&desc,
-															__uuidof(ID3D12PipelineState),
-															pipeline_state.put_void());
-	assert(SUCCEEDED(hr));
+	return compiler->request(desc, root_signature_hash);
 }
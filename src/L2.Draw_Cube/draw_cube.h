@@ -1,18 +1,34 @@
 #pragma once
 
 #include "dx_wrapped_types.h"
+#include "cube_instances.h"
+#include "frustum_culling.h"
+#include "gpu_heap_allocator.h"
+#include "indirect_draw.h"
+#include "pipeline_compiler.h"
+#include "root_layout_planner.h"
+#include "shader_dependency_graph.h"
+#include "shader_permutations.h"
 
 #include <DirectXMath.h>
 
 #include <Windows.h>
 #include <memory>
+#include <optional>
+#include <vector>
 
 namespace learning_dx12
 {
 	class game_clock;
 	class directx_12;
 	class cmd_queue;
-	class gpu_resource;
+	class upload_ring_buffer;
+	class constant_buffer_allocator;
+	class frame_graph;
+	class pipeline_state_cache;
+	class root_signature_registry;
+	class shader_archive;
+	class shader_reload_service;
 
 	class draw_cube
 	{
@@ -31,33 +47,69 @@ namespace learning_dx12
 		auto on_window_resize(uintptr_t wParam, uintptr_t lParam) -> bool;
 
 	private:
-		void create_vertex_buffer(dx_cmd_list cmd_list, dx_resource &copy_buffer);
-		void create_index_buffer(dx_cmd_list cmd_list, dx_resource &copy_buffer);
+		void clear_targets(dx_cmd_list cmd_list);
+		void draw_cubes(dx_cmd_list cmd_list);
+		void draw_cubes_indirect(dx_cmd_list cmd_list, uint32_t instances_root_index);
+
+		void set_instance_count(uint32_t count);
+		void update_sweep(double frame_ms);
+
+		void create_vertex_buffer(dx_cmd_list cmd_list);
+		void create_index_buffer(dx_cmd_list cmd_list);
 
 		void create_root_signature();
-		void create_pipeline_state(dx_cmd_list cmd_list);
+		void request_pipeline_state();
+		auto request_cube_pipeline(permutation_bits vs_bits) -> pipeline_handle;
 
 	private:
+		std::unique_ptr<directx_12> dx{}; // destroyed last, after the gpu is flushed
+
 		bool continue_to_draw { true };
 
-		dx_resource vertex_buffer{};
+		placed_resource vertex_buffer{};
 		D3D12_VERTEX_BUFFER_VIEW vertex_buffer_view{};
-		dx_resource index_buffer{};
+		placed_resource index_buffer{};
 		D3D12_INDEX_BUFFER_VIEW index_buffer_view{};
 
+		root_layout cube_root_layout{};
 		dx_root_signature root_signature{};
-		dx_pipeline_state pipeline_state{};
+		uint64_t root_signature_hash{};
+		dx_command_signature draw_signature{};
+		permutation_bits indirect_instances_bit{}; // of the vertex shader
+		reloadable_pipeline cube_pipeline{};
+		reloadable_pipeline cube_indirect_pipeline{};
 
 		D3D12_VIEWPORT view_port{};
 		D3D12_RECT scissor_rect{};
 
 		float field_of_view{};
 
-		DirectX::XMMATRIX model;
+		uint32_t instance_count{};
+		std::vector<cube_instance> instances{};
+		std::optional<instance_count_sweep> sweep{};
+
+		box_bounds cube_bounds{};               // one per instance
+		std::vector<uint32_t> visible_cubes{}; // culled against this frame's view
+
+		bool draw_indirect{};
+		std::vector<indirect_draw_command> cube_draw_commands{}; // one per cubes_per_indirect_draw instances
+		std::vector<uint8_t> cube_draws_visible{};
+
 		DirectX::XMMATRIX view;
 		DirectX::XMMATRIX projection;
 
-		std::unique_ptr<directx_12> dx{};
+		std::unique_ptr<frustum_culler> culler{};
+		std::unique_ptr<frame_graph> frame{};
+		std::unique_ptr<shader_archive> shaders{};
+		std::unique_ptr<shader_permutations> permutations{};
+		std::unique_ptr<root_signature_registry> root_signatures{};
+		std::unique_ptr<pipeline_state_cache> pipelines{};
+		std::unique_ptr<pipeline_compiler> compiler{}; // must not outlive pipelines
+		std::unique_ptr<shader_reload_service> reloader{}; // must not outlive compiler or shaders
+		std::unique_ptr<constant_buffer_allocator> constant_buffers{}; // for constants the root layout moved out of the root
+		std::unique_ptr<constant_buffer_allocator> instance_buffers{};
+		std::unique_ptr<constant_buffer_allocator> indirect_buffers{};
+		std::unique_ptr<upload_ring_buffer> upload_ring{}; // must outlive copy_queue
 		std::unique_ptr<cmd_queue> copy_queue{};
 	};
 }
\ No newline at end of file
@@ -0,0 +1,258 @@
+#include "frame_graph.h"
+
+#include "directx12.h"
+
+#include "d3dx12.h"
+
+#include <cppitertools/enumerate.hpp>
+
+#include <array>
+#include <memory>
+#include <utility>
+#include <cassert>
+
+using namespace learning_dx12;
+
+namespace
+{
+	constexpr auto access_to_states = std::array{
+		std::pair{ graph_access::render_target,    D3D12_RESOURCE_STATE_RENDER_TARGET },
+		std::pair{ graph_access::depth_write,      D3D12_RESOURCE_STATE_DEPTH_WRITE },
+		std::pair{ graph_access::depth_read,       D3D12_RESOURCE_STATE_DEPTH_READ },
+		std::pair{ graph_access::shader_read,      D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE },
+		std::pair{ graph_access::unordered_access, D3D12_RESOURCE_STATE_UNORDERED_ACCESS },
+		std::pair{ graph_access::copy_source,      D3D12_RESOURCE_STATE_COPY_SOURCE },
+		std::pair{ graph_access::copy_dest,        D3D12_RESOURCE_STATE_COPY_DEST },
+		std::pair{ graph_access::present,          D3D12_RESOURCE_STATE_PRESENT },
+	};
+}
+
+// Combined read accesses map to the combined states.
+auto learning_dx12::map_to_resource_states(graph_access access) -> D3D12_RESOURCE_STATES
+{
+	auto states = D3D12_RESOURCE_STATE_COMMON;
+	for (auto &[bit, state] : access_to_states)
+	{
+		if ((access & bit) != graph_access::none)
+		{
+			states |= state;
+		}
+	}
+
+	return states;
+}
+
+auto learning_dx12::map_to_barrier_flags(barrier_split split) -> D3D12_RESOURCE_BARRIER_FLAGS
+{
+	switch (split)
+	{
+	case barrier_split::begin:
+		return D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+	case barrier_split::end:
+		return D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+	case barrier_split::none:
+		break;
+	}
+	return D3D12_RESOURCE_BARRIER_FLAG_NONE;
+}
+
+frame_graph::frame_graph(dx_device device) :
+	transients{ device }
+{}
+
+frame_graph::~frame_graph() = default;
+
+void frame_graph::reset()
+{
+	graph.clear();
+	callbacks.clear();
+	bound_resources.clear();
+	transient_entries.clear();
+}
+
+auto frame_graph::import_resource(std::string_view name, ID3D12Resource *resource,
+                                  graph_access initial_access, graph_access final_access) -> graph_resource
+{
+	auto handle = graph.import_resource(name, initial_access, final_access);
+
+	bound_resources.resize(handle + 1);
+	bound_resources[handle] = resource;
+
+	return handle;
+}
+
+// Created in the state its first pass needs. Contents don't survive
+// the frame, render targets and depth buffers are discarded before
+// their first pass, so that pass must clear or fully write them.
+auto frame_graph::create_resource(std::string_view name, const D3D12_RESOURCE_DESC &desc,
+                                  const D3D12_CLEAR_VALUE *clear_value) -> graph_resource
+{
+	auto handle = graph.add_resource(name);
+
+	auto entry = transient_entry{ handle, {} };
+	entry.desc.desc = desc;
+	entry.desc.has_clear_value = (clear_value != nullptr);
+	if (clear_value)
+	{
+		entry.desc.clear_value = *clear_value;
+	}
+	transient_entries.push_back(entry);
+
+	return handle;
+}
+
+auto frame_graph::add_pass(std::string_view name, pass_callback callback) -> graph_pass
+{
+	auto pass = graph.add_pass(name);
+
+	callbacks.resize(pass + 1);
+	callbacks[pass] = std::move(callback);
+
+	return pass;
+}
+
+// Reads and writes of each pass are declared through this.
+auto frame_graph::get_graph() -> render_graph &
+{
+	return graph;
+}
+
+// Only valid inside pass callbacks, transient resources
+// may be created again the next time the graph changes.
+auto frame_graph::get_resource(graph_resource resource) const -> ID3D12Resource *
+{
+	return bound_resources.at(resource);
+}
+
+// Records every pass that survived culling on cmd_list, each batch's
+// barriers go out in one flush before the first pass of the batch.
+void frame_graph::execute(directx_12 &dx, dx_cmd_list cmd_list)
+{
+	bound_resources.resize(graph.get_resource_count());
+
+	auto &compiled = cache.get(graph);
+	realize_transients(dx, compiled);
+
+	for (auto &&[batch_index, batch] : compiled.batches | iter::enumerate)
+	{
+		record_aliasing(dx, cmd_list, static_cast<uint32_t>(batch_index));
+		record_barriers(dx, cmd_list, batch.barriers);
+		dx.flush_barriers(cmd_list);
+		discard_transients(cmd_list, static_cast<uint32_t>(batch_index));
+
+		for (auto i = batch.first_pass; i < batch.first_pass + batch.pass_count; i++)
+		{
+			callbacks.at(compiled.pass_order[i])(cmd_list);
+		}
+	}
+
+	record_barriers(dx, cmd_list, compiled.final_barriers);
+}
+
+auto frame_graph::get_cache_stats() const -> render_graph_cache::cache_stats
+{
+	return cache.get_stats();
+}
+
+auto frame_graph::get_transient_stats() const -> transient_resource_pool::pool_stats
+{
+	return transients.get_stats();
+}
+
+// Transients no kept pass uses are never created. Lifetimes are in
+// batches, as barriers, aliasing ones included, only go out between them.
+void frame_graph::realize_transients(directx_12 &dx, const compiled_graph &compiled)
+{
+	live_transients.clear();
+	auto descs = std::vector<transient_desc>{};
+
+	for (auto i = 0u; i < transient_entries.size(); i++)
+	{
+		auto &[handle, desc] = transient_entries[i];
+		if (compiled.first_batch[handle] == compiled_graph::unused)
+		{
+			continue;
+		}
+
+		desc.initial_state = map_to_resource_states(compiled.first_access[handle]);
+		desc.first_use = compiled.first_batch[handle];
+		desc.last_use = compiled.last_batch[handle];
+
+		live_transients.push_back(i);
+		descs.push_back(desc);
+	}
+
+	// Rare, only when the graph's shape or a description changes. Frames in
+	// flight may still use what the rebuild replaced, so it is let go on the
+	// fence waiter's thread once the GPU is past them, without a stall here.
+	auto rebuilding = transients.needs_rebuild(descs);
+	realized = &transients.realize(descs);
+	if (rebuilding)
+	{
+		auto retired = std::make_shared<transient_resource_pool::retired_transients>(transients.take_retired());
+		dx.when_gpu_done([retired]() {});
+	}
+
+	for (auto i = 0u; i < live_transients.size(); i++)
+	{
+		auto handle = transient_entries[live_transients[i]].handle;
+		bound_resources[handle] = (*realized)[i].resource.get();
+	}
+}
+
+void frame_graph::record_barriers(directx_12 &dx, dx_cmd_list cmd_list, const std::vector<graph_barrier> &barriers)
+{
+	for (auto &barrier : barriers)
+	{
+		auto resource = bound_resources.at(barrier.resource);
+		assert(resource);
+
+		auto d3d_barrier = barrier.is_uav
+		                 ? CD3DX12_RESOURCE_BARRIER::UAV(resource)
+		                 : CD3DX12_RESOURCE_BARRIER::Transition(resource,
+		                                                        map_to_resource_states(barrier.before),
+		                                                        map_to_resource_states(barrier.after),
+		                                                        D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+		                                                        map_to_barrier_flags(barrier.split));
+		dx.set_barrier(cmd_list, d3d_barrier);
+	}
+}
+
+void frame_graph::record_aliasing(directx_12 &dx, dx_cmd_list cmd_list, uint32_t batch)
+{
+	for (auto i = 0u; i < live_transients.size(); i++)
+	{
+		auto &[handle, desc] = transient_entries[live_transients[i]];
+		auto previous = (*realized)[i].previous;
+		if (desc.first_use != batch or previous == transient_placement::no_previous)
+		{
+			continue;
+		}
+
+		auto before = (previous == transient_placement::any_previous)
+		            ? nullptr
+		            : (*realized)[previous].resource.get();
+		auto barrier = CD3DX12_RESOURCE_BARRIER::Aliasing(before, bound_resources[handle]);
+		dx.set_barrier(cmd_list, barrier);
+	}
+}
+
+// Placed render targets and depth buffers must be cleared, copied to or
+// discarded before anything else each time their memory becomes theirs,
+// which for transients is every frame. Discard is the cheapest. The final
+// barriers of the frame before left them in initial_state, as required.
+void frame_graph::discard_transients(dx_cmd_list cmd_list, uint32_t batch)
+{
+	for (auto i = 0u; i < live_transients.size(); i++)
+	{
+		auto &[handle, desc] = transient_entries[live_transients[i]];
+		auto discardable = desc.initial_state == D3D12_RESOURCE_STATE_RENDER_TARGET
+		                or desc.initial_state == D3D12_RESOURCE_STATE_DEPTH_WRITE;
+		if (desc.first_use != batch or not discardable)
+		{
+			continue;
+		}
+
+		cmd_list->DiscardResource(bound_resources[handle], nullptr);
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "dx_wrapped_types.h"
+#include "render_graph.h"
+#include "transient_resource_pool.h"
+
+#include <d3d12.h>
+
+#include <functional>
+#include <string_view>
+#include <vector>
+
+namespace learning_dx12
+{
+	class directx_12;
+
+	auto map_to_resource_states(graph_access access) -> D3D12_RESOURCE_STATES;
+	auto map_to_barrier_flags(barrier_split split) -> D3D12_RESOURCE_BARRIER_FLAGS;
+
+	// Ties a render_graph to real resources and the code that records each
+	// pass. The graph is declared again every frame, between reset and
+	// execute, but only compiled when what it declares has changed.
+	// Resources made with create_resource only exist while passes use
+	// them, and share memory with others that are never alive at once.
+	// Transitions the graph splits are begun and ended within one execute,
+	// on the list it is given.
+	class frame_graph
+	{
+	public:
+		using pass_callback = std::function<void(dx_cmd_list)>;
+
+	public:
+		frame_graph(dx_device device);
+		frame_graph() = delete;
+		~frame_graph();
+
+		void reset();
+
+		auto import_resource(std::string_view name, ID3D12Resource *resource,
+		                     graph_access initial_access, graph_access final_access) -> graph_resource;
+		auto create_resource(std::string_view name, const D3D12_RESOURCE_DESC &desc,
+		                     const D3D12_CLEAR_VALUE *clear_value = nullptr) -> graph_resource;
+		auto add_pass(std::string_view name, pass_callback callback) -> graph_pass;
+
+		auto get_graph() -> render_graph &;
+		auto get_resource(graph_resource resource) const -> ID3D12Resource *;
+		void execute(directx_12 &dx, dx_cmd_list cmd_list);
+
+		auto get_cache_stats() const -> render_graph_cache::cache_stats;
+		auto get_transient_stats() const -> transient_resource_pool::pool_stats;
+
+	private:
+		void realize_transients(directx_12 &dx, const compiled_graph &compiled);
+		void record_barriers(directx_12 &dx, dx_cmd_list cmd_list, const std::vector<graph_barrier> &barriers);
+		void record_aliasing(directx_12 &dx, dx_cmd_list cmd_list, uint32_t batch);
+		void discard_transients(dx_cmd_list cmd_list, uint32_t batch);
+
+	private:
+		render_graph graph{};
+		render_graph_cache cache{};
+
+		std::vector<pass_callback> callbacks{};
+		std::vector<ID3D12Resource *> bound_resources{};
+
+		struct transient_entry
+		{
+			graph_resource handle;
+			transient_desc desc;
+		};
+
+		transient_resource_pool transients;
+		std::vector<transient_entry> transient_entries{};
+		std::vector<uint32_t> live_transients{};   // into transient_entries, the ones kept passes use
+		const std::vector<transient_resource> *realized{}; // matches live_transients
+	};
+}
@@ -0,0 +1,202 @@
+#include "gpu_heap_allocator.h"
+
+#include "d3dx12.h"
+
+#include <cppitertools/enumerate.hpp>
+#include <algorithm>
+#include <cassert>
+
+using namespace learning_dx12;
+
+namespace
+{
+	constexpr auto min_block_size = uint64_t{ D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT };
+}
+
+auto learning_dx12::map_to_heap_flags(heap_category category) -> D3D12_HEAP_FLAGS
+{
+	switch (category)
+	{
+		case heap_category::buffers:
+			return D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+		case heap_category::rt_ds_textures:
+			return D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+		case heap_category::other_textures:
+			return D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+	}
+	assert(false);
+	return {};
+}
+
+auto learning_dx12::get_heap_category(const D3D12_RESOURCE_DESC &desc) -> heap_category
+{
+	if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+	{
+		return heap_category::buffers;
+	}
+
+	constexpr auto rt_ds_flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET 
+	                           | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+	if (desc.Flags & rt_ds_flags)
+	{
+		return heap_category::rt_ds_textures;
+	}
+
+	return heap_category::other_textures;
+}
+
+gpu_heap_allocator::gpu_heap_allocator(dx_device device_) :
+	gpu_heap_allocator(device_, default_heap_size)
+{}
+
+gpu_heap_allocator::gpu_heap_allocator(dx_device device_, uint64_t heap_size_) :
+	heap_size{heap_size_}, device{device_}
+{
+	assert(heap_size % D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT == 0);
+}
+
+gpu_heap_allocator::~gpu_heap_allocator() = default;
+
+auto gpu_heap_allocator::create_resource(const D3D12_RESOURCE_DESC &desc,
+                                         D3D12_RESOURCE_STATES initial_state,
+                                         const D3D12_CLEAR_VALUE *clear_value) -> placed_resource
+{
+	auto info = device->GetResourceAllocationInfo(0, 1, &desc);
+	assert(info.SizeInBytes != UINT64_MAX);
+
+	auto category = get_heap_category(desc);
+	if (is_committed(category, info.SizeInBytes))
+	{
+		return create_committed(desc, initial_state, clear_value, category, info.SizeInBytes);
+	}
+
+	auto [heap_index, offset] = find_space(category, info.SizeInBytes, info.Alignment);
+
+	auto &block = pools.at(static_cast<size_t>(category)).at(heap_index);
+
+	auto allocation = placed_resource{ {}, category, heap_index, offset, info.SizeInBytes };
+	auto hr = device->CreatePlacedResource(block.heap.get(),
+	                                       offset,
+	                                       &desc,
+	                                       initial_state,
+	                                       clear_value,
+	                                       __uuidof(ID3D12Resource),
+	                                       allocation.resource.put_void());
+	assert(SUCCEEDED(hr));
+
+	return allocation;
+}
+
+// The resource must no longer be in use by the GPU.
+// Committed ones take their memory with them.
+void gpu_heap_allocator::free(placed_resource &allocation)
+{
+	assert(allocation.resource);
+	allocation.resource = nullptr;
+
+	if (allocation.heap_index == committed_heap_index)
+	{
+		auto &totals = committed.at(static_cast<size_t>(allocation.category));
+		totals.count--;
+		totals.size -= allocation.size;
+		return;
+	}
+
+	auto &block = pools.at(static_cast<size_t>(allocation.category)).at(allocation.heap_index);
+	block.allocator.free(allocation.offset);
+}
+
+auto gpu_heap_allocator::get_stats(heap_category category) const -> heap_stats
+{
+	auto stats = heap_stats{};
+
+	for (auto &block : pools.at(static_cast<size_t>(category)))
+	{
+		auto block_stats = block.allocator.get_stats();
+		stats.heap_count++;
+		stats.reserved += block_stats.capacity;
+		stats.allocated += block_stats.allocated;
+		stats.requested += block_stats.requested;
+		stats.allocation_count += block_stats.allocation_count;
+		stats.largest_free_block = std::max(stats.largest_free_block, block_stats.largest_free_block);
+	}
+
+	auto free_bytes = stats.reserved - stats.allocated;
+	stats.fragmentation = (free_bytes == 0) ? 0.0f
+	                    : 1.0f - static_cast<float>(stats.largest_free_block) / static_cast<float>(free_bytes);
+
+	auto &totals = committed.at(static_cast<size_t>(category));
+	stats.committed_count = totals.count;
+	stats.committed_size = totals.size;
+
+	return stats;
+}
+
+auto gpu_heap_allocator::is_committed(heap_category category, uint64_t size) const -> bool
+{
+	return size > heap_size
+	    or (category == heap_category::rt_ds_textures and size >= committed_rt_ds_size);
+}
+
+auto gpu_heap_allocator::create_committed(const D3D12_RESOURCE_DESC &desc,
+                                          D3D12_RESOURCE_STATES initial_state,
+                                          const D3D12_CLEAR_VALUE *clear_value,
+                                          heap_category category,
+                                          uint64_t size) -> placed_resource
+{
+	auto heap_properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+
+	auto allocation = placed_resource{ {}, category, committed_heap_index, 0, size };
+	auto hr = device->CreateCommittedResource(&heap_properties,
+	                                          D3D12_HEAP_FLAG_NONE,
+	                                          &desc,
+	                                          initial_state,
+	                                          clear_value,
+	                                          __uuidof(ID3D12Resource),
+	                                          allocation.resource.put_void());
+	assert(SUCCEEDED(hr));
+
+	auto &totals = committed.at(static_cast<size_t>(category));
+	totals.count++;
+	totals.size += size;
+
+	return allocation;
+}
+
+auto gpu_heap_allocator::create_heap(heap_category category, uint64_t size) -> dx_heap
+{
+	auto desc = CD3DX12_HEAP_DESC(size,
+	                              D3D12_HEAP_TYPE_DEFAULT,
+	                              D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT,
+	                              map_to_heap_flags(category));
+
+	auto heap = dx_heap{};
+	auto hr = device->CreateHeap(&desc,
+	                             __uuidof(ID3D12Heap),
+	                             heap.put_void());
+	assert(SUCCEEDED(hr));
+
+	return heap;
+}
+
+auto gpu_heap_allocator::find_space(heap_category category, uint64_t size, uint64_t alignment) -> std::pair<uint32_t, uint64_t>
+{
+	auto &blocks = pools.at(static_cast<size_t>(category));
+
+	for (auto &&[index, block] : blocks | iter::enumerate)
+	{
+		auto offset = block.allocator.allocate(size, alignment);
+		if (offset)
+		{
+			return { static_cast<uint32_t>(index), *offset };
+		}
+	}
+
+	blocks.push_back({ create_heap(category, heap_size),
+	                   buddy_allocator{ heap_size, min_block_size } });
+
+	auto offset = blocks.back().allocator.allocate(size, alignment);
+	assert(offset);
+
+	return { static_cast<uint32_t>(blocks.size() - 1), *offset };
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "dx_wrapped_types.h"
+#include "buddy_allocator.h"
+
+#include <d3d12.h>
+
+#include <array>
+#include <limits>
+#include <vector>
+
+namespace learning_dx12
+{
+	// Heap tier 1 hardware can't mix buffers, render target/depth textures
+	// and other textures in the same heap, so each gets its own pool.
+	enum class heap_category
+	{
+		buffers,
+		rt_ds_textures,
+		other_textures,
+	};
+
+	auto get_heap_category(const D3D12_RESOURCE_DESC &desc) -> heap_category;
+	auto map_to_heap_flags(heap_category category) -> D3D12_HEAP_FLAGS;
+
+	struct placed_resource
+	{
+		dx_resource resource;
+		heap_category category;
+		uint32_t heap_index; // committed_heap_index if it has a heap of its own
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	// Reserves large ID3D12Heap blocks and places resources inside them 
+	// instead of giving each resource its own implicit heap.
+	// Anything bigger than a block, and render targets and depth buffers
+	// from committed_rt_ds_size up, are committed resources instead. A buddy
+	// block would round them up to the next power of two, a 1080p depth
+	// buffer's 8.3 MB to 16 MB, and the driver may give them memory of
+	// their own.
+	class gpu_heap_allocator
+	{
+	public:
+		struct heap_stats
+		{
+			uint32_t heap_count;
+			uint64_t reserved;
+			uint64_t allocated;
+			uint64_t requested;
+			uint64_t largest_free_block;
+			uint32_t allocation_count;
+			float fragmentation;
+			uint32_t committed_count;
+			uint64_t committed_size;
+		};
+
+		static constexpr auto default_heap_size = uint64_t{ 64 * 1024 * 1024 };
+		static constexpr auto committed_rt_ds_size = uint64_t{ 4 * 1024 * 1024 };
+		static constexpr auto committed_heap_index = std::numeric_limits<uint32_t>::max();
+
+	public:
+		gpu_heap_allocator(dx_device device);
+		gpu_heap_allocator(dx_device device, uint64_t heap_size);
+		gpu_heap_allocator() = delete;
+		~gpu_heap_allocator();
+
+		auto create_resource(const D3D12_RESOURCE_DESC &desc,
+		                     D3D12_RESOURCE_STATES initial_state,
+		                     const D3D12_CLEAR_VALUE *clear_value = nullptr) -> placed_resource;
+		void free(placed_resource &allocation);
+
+		auto get_stats(heap_category category) const -> heap_stats;
+
+	private:
+		struct heap_block
+		{
+			dx_heap heap;
+			buddy_allocator allocator;
+		};
+
+		struct committed_totals
+		{
+			uint32_t count;
+			uint64_t size;
+		};
+
+		using heap_blocks = std::vector<heap_block>;
+
+		auto is_committed(heap_category category, uint64_t size) const -> bool;
+		auto create_committed(const D3D12_RESOURCE_DESC &desc,
+		                      D3D12_RESOURCE_STATES initial_state,
+		                      const D3D12_CLEAR_VALUE *clear_value,
+		                      heap_category category,
+		                      uint64_t size) -> placed_resource;
+		auto create_heap(heap_category category, uint64_t size) -> dx_heap;
+		auto find_space(heap_category category, uint64_t size, uint64_t alignment) -> std::pair<uint32_t, uint64_t>;
+
+	private:
+		const uint64_t heap_size{};
+		dx_device device{};
+
+		std::array<heap_blocks, 3> pools{};
+		std::array<committed_totals, 3> committed{};
+	};
+}
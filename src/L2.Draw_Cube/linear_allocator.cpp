@@ -0,0 +1,48 @@
+#include "linear_allocator.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace learning_dx12;
+
+linear_allocator::linear_allocator(uint64_t capacity_) :
+	capacity{capacity_}
+{}
+
+linear_allocator::~linear_allocator() = default;
+
+auto linear_allocator::allocate(uint64_t size, uint64_t alignment) -> std::optional<uint64_t>
+{
+	assert(alignment > 0 and (alignment & (alignment - 1)) == 0);
+
+	auto aligned_offset = (offset + alignment - 1) & ~(alignment - 1);
+	if (aligned_offset + size > capacity)
+	{
+		return std::nullopt;
+	}
+
+	offset = aligned_offset + size;
+	high_water = std::max(high_water, offset);
+
+	return aligned_offset;
+}
+
+void linear_allocator::reset()
+{
+	offset = 0;
+}
+
+auto linear_allocator::get_capacity() const -> uint64_t
+{
+	return capacity;
+}
+
+auto linear_allocator::get_used() const -> uint64_t
+{
+	return offset;
+}
+
+auto linear_allocator::get_high_water() const -> uint64_t
+{
+	return high_water;
+}
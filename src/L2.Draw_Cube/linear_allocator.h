@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+namespace learning_dx12
+{
+	// Bump allocator over a fixed range of offsets. Nothing is freed 
+	// individually, reset() hands the whole range back at once.
+	class linear_allocator
+	{
+	public:
+		linear_allocator(uint64_t capacity);
+		linear_allocator() = delete;
+		~linear_allocator();
+
+		auto allocate(uint64_t size, uint64_t alignment) -> std::optional<uint64_t>;
+		void reset();
+
+		auto get_capacity() const -> uint64_t;
+		auto get_used() const -> uint64_t;
+		auto get_high_water() const -> uint64_t;
+
+	private:
+		const uint64_t capacity{};
+		uint64_t offset{};
+		uint64_t high_water{};
+	};
+}
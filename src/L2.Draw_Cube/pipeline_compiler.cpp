@@ -0,0 +1,241 @@
+#include "pipeline_compiler.h"
+
+#include "pipeline_state_cache.h"
+#include "pipeline_state_hash.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace learning_dx12;
+
+namespace
+{
+	// Half the cores, the render thread and the driver's own threads need the rest.
+	auto default_thread_count() -> uint32_t
+	{
+		return std::max(1u, std::thread::hardware_concurrency() / 2);
+	}
+}
+
+pipeline_compiler::pipeline_compiler(pipeline_state_cache &cache_) :
+	pipeline_compiler(cache_, default_thread_count())
+{}
+
+pipeline_compiler::pipeline_compiler(pipeline_state_cache &cache_, uint32_t thread_count) :
+	cache{ cache_ }
+{
+	assert(thread_count > 0);
+
+	workers.reserve(thread_count);
+	for (auto i = 0u; i < thread_count; i++)
+	{
+		workers.emplace_back(&pipeline_compiler::work_loop, this);
+	}
+}
+
+// Requests no worker has started on yet are dropped,
+// ones being compiled are finished first.
+pipeline_compiler::~pipeline_compiler()
+{
+	{
+		auto lock = std::lock_guard{ queue_mutex };
+		stop_working = true;
+	}
+	queue_changed.notify_all();
+
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+// Asking for a description that was asked for before returns the same
+// handle, raising its priority if this request's is higher.
+auto pipeline_compiler::request(const D3D12_GRAPHICS_PIPELINE_STATE_DESC &desc, uint64_t root_signature_hash,
+                                pipeline_priority priority) -> pipeline_handle
+{
+	auto hash = hash_pipeline_desc(desc, root_signature_hash);
+
+	{
+		auto lock = std::lock_guard{ queue_mutex };
+		stats.requested++;
+
+		auto found = handles.find(hash);
+		if (found != handles.end())
+		{
+			stats.duplicates++;
+			auto &entry = entries[found->second];
+			if (not entry.ready and priority > entry.priority)
+			{
+				entry.priority = priority;
+				stats.boosted++;
+			}
+			return found->second;
+		}
+	}
+
+	auto source = copy_desc(desc);
+
+	auto handle = pipeline_handle{};
+	{
+		auto lock = std::lock_guard{ queue_mutex };
+		handle = static_cast<pipeline_handle>(entries.size());
+
+		// Copied without the lock, so someone else may have got here first.
+		auto [found, inserted] = handles.emplace(hash, handle);
+		if (not inserted)
+		{
+			stats.duplicates++;
+			return found->second;
+		}
+
+		auto &entry = entries.emplace_back();
+		entry.source = std::move(source);
+		entry.root_signature_hash = root_signature_hash;
+		entry.priority = priority;
+		entry.sequence = next_sequence++;
+
+		queue.push_back(handle);
+	}
+	queue_changed.notify_one();
+
+	return handle;
+}
+
+void pipeline_compiler::boost(pipeline_handle handle, pipeline_priority priority)
+{
+	auto lock = std::lock_guard{ queue_mutex };
+
+	auto &entry = entries.at(handle);
+	if (entry.ready or priority <= entry.priority)
+	{
+		return;
+	}
+
+	entry.priority = priority;
+	stats.boosted++;
+}
+
+auto pipeline_compiler::is_ready(pipeline_handle handle) const -> bool
+{
+	return entries.at(handle).ready.load(std::memory_order_acquire);
+}
+
+// Fallback, possibly null, until the pipeline has been compiled.
+auto pipeline_compiler::get(pipeline_handle handle, ID3D12PipelineState *fallback) const -> ID3D12PipelineState *
+{
+	auto &entry = entries.at(handle);
+	if (not entry.ready.load(std::memory_order_acquire))
+	{
+		return fallback;
+	}
+	return entry.pipeline.get();
+}
+
+auto pipeline_compiler::get_stats() const -> compiler_stats
+{
+	auto lock = std::lock_guard{ queue_mutex };
+
+	auto current = stats;
+	current.queued = static_cast<uint32_t>(queue.size());
+	return current;
+}
+
+auto pipeline_compiler::copy_desc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC &desc) -> std::unique_ptr<owned_desc>
+{
+	auto owned = std::make_unique<owned_desc>();
+	auto &copy = owned->desc;
+	copy = desc;
+	copy.CachedPSO = {};
+
+	owned->root_signature.copy_from(desc.pRootSignature);
+
+	owned->shaders.reserve(5);
+	for (auto shader : { &copy.VS, &copy.PS, &copy.DS, &copy.HS, &copy.GS })
+	{
+		if (not shader->pShaderBytecode or shader->BytecodeLength == 0)
+		{
+			continue;
+		}
+
+		auto bytes = static_cast<const uint8_t *>(shader->pShaderBytecode);
+		auto &shader_copy = owned->shaders.emplace_back(bytes, bytes + shader->BytecodeLength);
+		shader->pShaderBytecode = shader_copy.data();
+	}
+
+	// Reserved up front, the names must not move once pointed at.
+	owned->semantic_names.reserve(desc.InputLayout.NumElements + desc.StreamOutput.NumEntries);
+
+	auto &layout = copy.InputLayout;
+	owned->input_elements.assign(layout.pInputElementDescs,
+	                             layout.pInputElementDescs + layout.NumElements);
+	for (auto &element : owned->input_elements)
+	{
+		element.SemanticName = owned->semantic_names.emplace_back(element.SemanticName).c_str();
+	}
+	layout.pInputElementDescs = owned->input_elements.data();
+
+	auto &stream_output = copy.StreamOutput;
+	owned->stream_output_entries.assign(stream_output.pSODeclaration,
+	                                    stream_output.pSODeclaration + stream_output.NumEntries);
+	for (auto &entry : owned->stream_output_entries)
+	{
+		if (entry.SemanticName)
+		{
+			entry.SemanticName = owned->semantic_names.emplace_back(entry.SemanticName).c_str();
+		}
+	}
+	stream_output.pSODeclaration = owned->stream_output_entries.data();
+
+	owned->stream_output_strides.assign(stream_output.pBufferStrides,
+	                                    stream_output.pBufferStrides + stream_output.NumStrides);
+	stream_output.pBufferStrides = owned->stream_output_strides.data();
+
+	return owned;
+}
+
+void pipeline_compiler::work_loop()
+{
+	while (auto entry = take_next())
+	{
+		// Only this worker touches the entry until it is marked ready.
+		entry->pipeline = cache.get_or_create(entry->source->desc, entry->root_signature_hash);
+		entry->source = nullptr;
+		entry->ready.store(true, std::memory_order_release);
+
+		auto lock = std::lock_guard{ queue_mutex };
+		stats.compiled++;
+	}
+}
+
+// Highest priority first, oldest first among equals. Null once stopping.
+auto pipeline_compiler::take_next() -> pipeline_entry *
+{
+	auto lock = std::unique_lock{ queue_mutex };
+	queue_changed.wait(lock, [&]()
+	{
+		return stop_working or not queue.empty();
+	});
+
+	if (stop_working)
+	{
+		return nullptr;
+	}
+
+	auto next = std::max_element(queue.begin(), queue.end(), [&](pipeline_handle a, pipeline_handle b)
+	{
+		auto &entry_a = entries[a],
+		     &entry_b = entries[b];
+		if (entry_a.priority != entry_b.priority)
+		{
+			return entry_a.priority < entry_b.priority;
+		}
+		return entry_a.sequence > entry_b.sequence;
+	});
+
+	auto handle = *next;
+	*next = queue.back();
+	queue.pop_back();
+
+	return &entries[handle];
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "dx_wrapped_types.h"
+
+#include <d3d12.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace learning_dx12
+{
+	class pipeline_state_cache;
+
+	using pipeline_handle = uint32_t;
+
+	// Queued requests with a higher priority are compiled first.
+	enum class pipeline_priority : uint8_t
+	{
+		background,
+		normal,
+		visible, // something on screen is waiting to draw with it
+	};
+
+	// Compiles pipeline states on a pool of worker threads, through a
+	// pipeline_state_cache, so the render loop never waits on a compile.
+	// Requests come from the render thread, which checks each frame whether
+	// a pipeline is ready, and skips the draw or uses a fallback until it is.
+	class pipeline_compiler
+	{
+	public:
+		struct compiler_stats
+		{
+			uint32_t requested;
+			uint32_t duplicates; // requests answered with an existing handle
+			uint32_t compiled;
+			uint32_t boosted;
+			uint32_t queued;     // waiting for a worker
+		};
+
+	public:
+		pipeline_compiler(pipeline_state_cache &cache);
+		pipeline_compiler(pipeline_state_cache &cache, uint32_t thread_count);
+		pipeline_compiler() = delete;
+		~pipeline_compiler();
+
+		auto request(const D3D12_GRAPHICS_PIPELINE_STATE_DESC &desc, uint64_t root_signature_hash,
+		             pipeline_priority priority = pipeline_priority::normal) -> pipeline_handle;
+		void boost(pipeline_handle handle, pipeline_priority priority = pipeline_priority::visible);
+
+		auto is_ready(pipeline_handle handle) const -> bool;
+		auto get(pipeline_handle handle, ID3D12PipelineState *fallback = nullptr) const -> ID3D12PipelineState *;
+
+		auto get_stats() const -> compiler_stats;
+
+	private:
+		// Everything the description points at is copied in here,
+		// so callers don't have to keep it alive until it compiles.
+		struct owned_desc
+		{
+			D3D12_GRAPHICS_PIPELINE_STATE_DESC desc;
+			dx_root_signature root_signature;
+			std::vector<std::vector<uint8_t>> shaders;
+			std::vector<D3D12_INPUT_ELEMENT_DESC> input_elements;
+			std::vector<D3D12_SO_DECLARATION_ENTRY> stream_output_entries;
+			std::vector<uint32_t> stream_output_strides;
+			std::vector<std::string> semantic_names;
+		};
+
+		struct pipeline_entry
+		{
+			std::unique_ptr<owned_desc> source{}; // released once compiled
+			uint64_t root_signature_hash{};
+			pipeline_priority priority{};
+			uint64_t sequence{};
+			dx_pipeline_state pipeline{};
+			std::atomic<bool> ready{ false };
+		};
+
+		static auto copy_desc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC &desc) -> std::unique_ptr<owned_desc>;
+
+		void work_loop();
+		auto take_next() -> pipeline_entry *;
+
+	private:
+		pipeline_state_cache &cache;
+
+		std::deque<pipeline_entry> entries{}; // indexed by handle, never moves an entry
+		std::unordered_map<uint64_t, pipeline_handle> handles{};
+		std::vector<pipeline_handle> queue{};
+		uint64_t next_sequence{};
+		compiler_stats stats{};
+
+		mutable std::mutex queue_mutex{};
+		std::condition_variable queue_changed{};
+		bool stop_working{ false };
+
+		std::vector<std::thread> workers{};
+	};
+}
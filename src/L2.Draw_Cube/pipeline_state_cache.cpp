@@ -0,0 +1,196 @@
+#include "pipeline_state_cache.h"
+
+#include "binary_file.h"
+
+#include <fstream>
+#include <cassert>
+
+using namespace learning_dx12;
+
+namespace
+{
+	// Identifies the adapter and user mode driver the device was made on,
+	// the same adapter is found again through the device's LUID.
+	auto make_expected_header(dx_device device, uint64_t content_hash) -> pipeline_library_header
+	{
+		auto header = pipeline_library_header{};
+		header.magic = pipeline_library_header::file_magic;
+		header.version = pipeline_library_header::file_version;
+		header.content_hash = content_hash;
+
+		auto factory = dxgi_factory_4{};
+		auto hr = CreateDXGIFactory2(0,
+		                             __uuidof(IDXGIFactory4),
+		                             factory.put_void());
+		assert(SUCCEEDED(hr));
+
+		auto adaptor = dxgi_adaptor_1{};
+		hr = factory->EnumAdapterByLuid(device->GetAdapterLuid(),
+		                                __uuidof(IDXGIAdapter1),
+		                                adaptor.put_void());
+		assert(SUCCEEDED(hr));
+
+		auto desc = DXGI_ADAPTER_DESC1{};
+		adaptor->GetDesc1(&desc);
+		header.vendor_id = desc.VendorId;
+		header.device_id = desc.DeviceId;
+
+		auto umd_version = LARGE_INTEGER{};
+		if (SUCCEEDED(adaptor->CheckInterfaceSupport(__uuidof(IDXGIDevice), &umd_version)))
+		{
+			header.driver_version = static_cast<uint64_t>(umd_version.QuadPart);
+		}
+
+		return header;
+	}
+}
+
+pipeline_state_cache::pipeline_state_cache(dx_device device_, std::filesystem::path file_path_, uint64_t content_hash) :
+	device{ device_ },
+	file_path{ std::move(file_path_) }
+{
+	expected_header = make_expected_header(device, content_hash);
+	load_library();
+}
+
+pipeline_state_cache::~pipeline_state_cache() = default;
+
+// Looked up in memory, then in the library, and only compiled when
+// neither has it. Newly compiled pipelines go into the library.
+// No lock is held while compiling, if two threads race on the same
+// description both compile it and the first one in is kept.
+auto pipeline_state_cache::get_or_create(const D3D12_GRAPHICS_PIPELINE_STATE_DESC &desc, uint64_t root_signature_hash) -> dx_pipeline_state
+{
+	auto hash = hash_pipeline_desc(desc, root_signature_hash);
+
+	{
+		auto lock = std::lock_guard{ pipelines_mutex };
+		auto found = pipelines.find(hash);
+		if (found != pipelines.end())
+		{
+			stats.memory_hits++;
+			return found->second;
+		}
+	}
+
+	auto name = make_pipeline_name(hash);
+	auto pipeline = dx_pipeline_state{};
+
+	// Fails when the library has nothing by this name.
+	auto loaded = false;
+	if (library)
+	{
+		auto lock = std::lock_guard{ library_mutex };
+		loaded = SUCCEEDED(library->LoadGraphicsPipeline(name.c_str(),
+		                                                 &desc,
+		                                                 __uuidof(ID3D12PipelineState),
+		                                                 pipeline.put_void()));
+	}
+
+	if (not loaded)
+	{
+		pipeline = nullptr;
+		auto hr = device->CreateGraphicsPipelineState(&desc,
+		                                              __uuidof(ID3D12PipelineState),
+		                                              pipeline.put_void());
+		assert(SUCCEEDED(hr));
+	}
+
+	auto lock = std::lock_guard{ pipelines_mutex };
+	auto [entry, inserted] = pipelines.emplace(hash, pipeline);
+	if (not inserted)
+	{
+		stats.memory_hits++;
+		return entry->second;
+	}
+
+	if (loaded)
+	{
+		stats.library_hits++;
+		return pipeline;
+	}
+
+	stats.created++;
+	auto library_lock = std::lock_guard{ library_mutex };
+	if (library and SUCCEEDED(library->StorePipeline(name.c_str(), pipeline.get())))
+	{
+		library_changed = true;
+	}
+
+	return pipeline;
+}
+
+void pipeline_state_cache::save()
+{
+	auto lock = std::lock_guard{ library_mutex };
+	if (not library or not library_changed)
+	{
+		return;
+	}
+
+	auto size = library->GetSerializedSize();
+	auto data = std::vector<uint8_t>(size);
+	auto hr = library->Serialize(data.data(), size);
+	assert(SUCCEEDED(hr));
+
+	auto header = expected_header;
+	header.library_size = size;
+
+	library_changed = not replace_file(file_path, [&](std::ostream &file)
+	{
+		write_value(file, header);
+		file.write(reinterpret_cast<const char *>(data.data()), data.size());
+	});
+}
+
+auto pipeline_state_cache::get_stats() const -> cache_stats
+{
+	auto lock = std::lock_guard{ pipelines_mutex };
+	return stats;
+}
+
+// A missing file just means an empty library. One that is stale, or that
+// the driver rejects, is discarded and replaced at the next save.
+void pipeline_state_cache::load_library()
+{
+	auto file = std::ifstream(file_path, std::ios::in | std::ios::binary | std::ios::ate);
+	if (file.is_open())
+	{
+		auto file_size = static_cast<uint64_t>(file.tellg());
+		auto header = pipeline_library_header{};
+		file.seekg(0, std::ios::beg);
+
+		auto current = file_size >= sizeof(header)
+		           and read_value(file, header)
+		           and is_library_current(header, expected_header, file_size - sizeof(header));
+		if (current)
+		{
+			library_data.resize(header.library_size);
+			file.read(reinterpret_cast<char *>(library_data.data()), library_data.size());
+			create_library(library_data.data(), library_data.size());
+		}
+
+		if (library)
+		{
+			return;
+		}
+		stats.library_discarded = true;
+	}
+
+	library_data.clear();
+	create_library(nullptr, 0);
+}
+
+// The driver checks its own version too, a blob it can't use fails to load.
+void pipeline_state_cache::create_library(const void *data, size_t size)
+{
+	library = nullptr;
+	auto hr = device->CreatePipelineLibrary(data,
+	                                        size,
+	                                        __uuidof(ID3D12PipelineLibrary),
+	                                        library.put_void());
+	if (FAILED(hr))
+	{
+		library = nullptr;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "dx_wrapped_types.h"
+#include "pipeline_state_hash.h"
+
+#include <d3d12.h>
+
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace learning_dx12
+{
+	// Pipeline states keyed by hash_pipeline_desc, so identical descriptions
+	// share one pipeline. Backed by an ID3D12PipelineLibrary stored in a file,
+	// pipelines built on an earlier run are loaded from it instead of being
+	// compiled again. The file is ignored when the adapter, driver or
+	// content_hash differs from when it was saved.
+	// get_or_create may be called from several threads at once, and
+	// pipelines that aren't cached yet are compiled in parallel.
+	class pipeline_state_cache
+	{
+	public:
+		struct cache_stats
+		{
+			uint32_t memory_hits;  // already created this run
+			uint32_t library_hits; // loaded from the library
+			uint32_t created;      // compiled from scratch
+			bool library_discarded;
+		};
+
+	public:
+		pipeline_state_cache(dx_device device, std::filesystem::path file_path, uint64_t content_hash);
+		pipeline_state_cache() = delete;
+		~pipeline_state_cache();
+
+		auto get_or_create(const D3D12_GRAPHICS_PIPELINE_STATE_DESC &desc, uint64_t root_signature_hash) -> dx_pipeline_state;
+		void save();
+
+		auto get_stats() const -> cache_stats;
+
+	private:
+		void load_library();
+		void create_library(const void *data, size_t size);
+
+	private:
+		dx_device device{};
+		std::filesystem::path file_path{};
+		pipeline_library_header expected_header{};
+
+		std::vector<uint8_t> library_data{}; // read by library for as long as it lives
+		dx_pipeline_library library{};      // null if the OS doesn't support them
+		bool library_changed{};
+		std::mutex library_mutex{};          // loading the same pipeline twice at once isn't safe
+
+		std::unordered_map<uint64_t, dx_pipeline_state> pipelines{};
+		cache_stats stats{};
+		mutable std::mutex pipelines_mutex{};
+	};
+}
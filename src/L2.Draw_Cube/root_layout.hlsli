@@ -0,0 +1,4 @@
+// Generated by plan_root_layout, 19 DWORDs, 1 root arguments set per draw.
+ConstantBuffer<draw_constants> draw_cb : register(b0);
+ConstantBuffer<view_projection> view_projection_cb : register(b1);
+StructuredBuffer<cube_instance> instances : register(t0);
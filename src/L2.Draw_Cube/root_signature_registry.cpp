@@ -0,0 +1,173 @@
+#include "root_signature_registry.h"
+
+#include "binary_file.h"
+#include "pipeline_state_hash.h"
+
+#include <fstream>
+#include <cassert>
+
+using namespace learning_dx12;
+
+namespace
+{
+	// Blobs are the runtime's own format, not the driver's,
+	// so unlike pipeline libraries they survive driver updates.
+	struct blob_file_header
+	{
+		static constexpr auto file_magic = uint32_t{ 0x47495352 }; // "RSIG"
+		static constexpr auto file_version = uint32_t{ 1 };
+
+		uint32_t magic;
+		uint32_t version;
+		uint64_t blob_count;
+	};
+
+	struct blob_entry_header
+	{
+		uint64_t hash;
+		uint64_t size;
+	};
+}
+
+root_signature_registry::root_signature_registry(dx_device device_, std::filesystem::path file_path_) :
+	device{ device_ },
+	file_path{ std::move(file_path_) }
+{
+	load_blobs();
+}
+
+root_signature_registry::~root_signature_registry() = default;
+
+// Descriptions that hash the same get the same root signature object.
+auto root_signature_registry::get_or_create(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC &desc) -> registered_root_signature
+{
+	auto hash = hash_root_signature_desc(desc);
+
+	auto lock = std::lock_guard{ registry_mutex };
+
+	auto found = root_signatures.find(hash);
+	if (found != root_signatures.end())
+	{
+		stats.object_hits++;
+		return { found->second, hash };
+	}
+
+	auto root_signature = dx_root_signature{};
+
+	// A blob the runtime rejects is serialized again and replaced.
+	auto blob = blobs.find(hash);
+	if (blob != blobs.end())
+	{
+		root_signature = create_from_blob(blob->second);
+		if (root_signature)
+		{
+			stats.blob_hits++;
+		}
+	}
+
+	if (not root_signature)
+	{
+		auto rs_blob = dx_blob{};
+		auto err_blob = dx_blob{};
+		auto hr = D3D12SerializeVersionedRootSignature(&desc,
+		                                               rs_blob.put(),
+		                                               err_blob.put());
+		assert(SUCCEEDED(hr));
+
+		auto bytes = static_cast<const uint8_t *>(rs_blob->GetBufferPointer());
+		auto &stored = blobs[hash];
+		stored.assign(bytes, bytes + rs_blob->GetBufferSize());
+		blobs_changed = true;
+		stats.serialized++;
+
+		root_signature = create_from_blob(stored);
+		assert(root_signature);
+	}
+
+	root_signatures.emplace(hash, root_signature);
+	stats.object_count = static_cast<uint32_t>(root_signatures.size());
+
+	return { root_signature, hash };
+}
+
+void root_signature_registry::save()
+{
+	auto lock = std::lock_guard{ registry_mutex };
+	if (not blobs_changed)
+	{
+		return;
+	}
+
+	blobs_changed = not replace_file(file_path, [&](std::ostream &file)
+	{
+		write_value(file, blob_file_header{ blob_file_header::file_magic,
+		                                    blob_file_header::file_version,
+		                                    blobs.size() });
+		for (auto &[hash, blob] : blobs)
+		{
+			write_value(file, blob_entry_header{ hash, blob.size() });
+			file.write(reinterpret_cast<const char *>(blob.data()), blob.size());
+		}
+	});
+}
+
+auto root_signature_registry::get_stats() const -> registry_stats
+{
+	auto lock = std::lock_guard{ registry_mutex };
+	return stats;
+}
+
+// Anything wrong with the file and none of it is used.
+void root_signature_registry::load_blobs()
+{
+	auto file = std::ifstream(file_path, std::ios::in | std::ios::binary | std::ios::ate);
+	if (not file.is_open())
+	{
+		return;
+	}
+
+	auto file_size = static_cast<uint64_t>(file.tellg());
+	file.seekg(0, std::ios::beg);
+
+	auto header = blob_file_header{};
+	if (not read_value(file, header)
+	    or header.magic != blob_file_header::file_magic
+	    or header.version != blob_file_header::file_version)
+	{
+		return;
+	}
+
+	for (auto i = uint64_t{}; i < header.blob_count; i++)
+	{
+		auto entry = blob_entry_header{};
+		if (not read_value(file, entry)
+		    or entry.size > file_size - static_cast<uint64_t>(file.tellg()))
+		{
+			blobs.clear();
+			return;
+		}
+
+		auto &blob = blobs[entry.hash];
+		blob.resize(entry.size);
+		if (not file.read(reinterpret_cast<char *>(blob.data()), blob.size()))
+		{
+			blobs.clear();
+			return;
+		}
+	}
+}
+
+auto root_signature_registry::create_from_blob(const std::vector<uint8_t> &blob) -> dx_root_signature
+{
+	auto root_signature = dx_root_signature{};
+	auto hr = device->CreateRootSignature(0,
+	                                      blob.data(),
+	                                      blob.size(),
+	                                      __uuidof(ID3D12RootSignature),
+	                                      root_signature.put_void());
+	if (FAILED(hr))
+	{
+		return nullptr;
+	}
+	return root_signature;
+}
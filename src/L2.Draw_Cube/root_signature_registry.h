@@ -0,0 +1,59 @@
+#pragma once
+
+#include "dx_wrapped_types.h"
+
+#include <d3d12.h>
+
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace learning_dx12
+{
+	struct registered_root_signature
+	{
+		dx_root_signature root_signature;
+		uint64_t hash; // hash_root_signature_desc, what pipelines using it are keyed by
+	};
+
+	// One root signature object per distinct description, shared by all who
+	// ask for it. Serialized blobs are kept in a file, so on later runs
+	// root signatures are created straight from them without serializing.
+	class root_signature_registry
+	{
+	public:
+		struct registry_stats
+		{
+			uint32_t object_hits; // already created this run
+			uint32_t blob_hits;   // created from a stored blob
+			uint32_t serialized;
+			uint32_t object_count;
+		};
+
+	public:
+		root_signature_registry(dx_device device, std::filesystem::path file_path);
+		root_signature_registry() = delete;
+		~root_signature_registry();
+
+		auto get_or_create(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC &desc) -> registered_root_signature;
+		void save();
+
+		auto get_stats() const -> registry_stats;
+
+	private:
+		void load_blobs();
+		auto create_from_blob(const std::vector<uint8_t> &blob) -> dx_root_signature;
+
+	private:
+		dx_device device{};
+		std::filesystem::path file_path{};
+
+		std::unordered_map<uint64_t, std::vector<uint8_t>> blobs{};
+		std::unordered_map<uint64_t, dx_root_signature> root_signatures{};
+		bool blobs_changed{};
+
+		registry_stats stats{};
+		mutable std::mutex registry_mutex{};
+	};
+}
@@ -0,0 +1,430 @@
+#include "shader_reload_service.h"
+
+#include <d3dcompiler.h>
+#include <Windows.h>
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+#include <utility>
+
+using namespace learning_dx12;
+
+namespace
+{
+	// What target_shader_sources passes to fxc, so a reloaded shader
+	// only differs from a built one by the edit that caused it.
+#ifdef NDEBUG
+	constexpr auto compile_flags = UINT{ D3DCOMPILE_OPTIMIZATION_LEVEL3 };
+#else
+	constexpr auto compile_flags = UINT{ D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION };
+#endif // NDEBUG
+
+	constexpr auto default_poll_interval = std::chrono::milliseconds{ 250 };
+
+	// Empty files count as unreadable, a build may not have finished writing them.
+	auto read_file(const std::filesystem::path &file_path) -> std::optional<std::vector<uint8_t>>
+	{
+		auto file = std::ifstream(file_path, std::ios::in | std::ios::binary | std::ios::ate);
+		if (not file.is_open())
+		{
+			return std::nullopt;
+		}
+
+		auto bytes = std::vector<uint8_t>(static_cast<size_t>(file.tellg()));
+		file.seekg(0, std::ios::beg);
+		if (bytes.empty() or not file.read(reinterpret_cast<char *>(bytes.data()), bytes.size()))
+		{
+			return std::nullopt;
+		}
+		return bytes;
+	}
+
+	// Opens includes relative to the file including them,
+	// and remembers every one it opened.
+	class include_recorder final : public ID3DInclude
+	{
+	public:
+		include_recorder(std::filesystem::path source_directory_) :
+			source_directory{ std::move(source_directory_) }
+		{}
+
+		HRESULT __stdcall Open(D3D_INCLUDE_TYPE, LPCSTR file_name, LPCVOID parent_data,
+		                       LPCVOID *data, UINT *size) override
+		{
+			auto directory = source_directory;
+			auto parent = std::find_if(opened.begin(), opened.end(), [&](const opened_file &file)
+			{
+				return file.bytes.data() == parent_data;
+			});
+			if (parent != opened.end())
+			{
+				directory = parent->file_path.parent_path();
+			}
+
+			auto file_path = (directory / file_name).lexically_normal();
+			auto bytes = read_file(file_path);
+			if (not bytes)
+			{
+				return E_FAIL;
+			}
+
+			auto &added = opened.emplace_back(opened_file{ file_path, std::move(*bytes) });
+			*data = added.bytes.data();
+			*size = static_cast<UINT>(added.bytes.size());
+			return S_OK;
+		}
+
+		// Kept until the recorder goes, so parents can still be looked up.
+		HRESULT __stdcall Close(LPCVOID) override
+		{
+			return S_OK;
+		}
+
+		auto get_files() const -> std::vector<std::filesystem::path>
+		{
+			auto files = std::vector<std::filesystem::path>{};
+			std::transform(opened.begin(), opened.end(),
+			               std::back_inserter(files),
+			               [](const opened_file &file)
+			{
+				return file.file_path;
+			});
+			return files;
+		}
+
+	private:
+		struct opened_file
+		{
+			std::filesystem::path file_path;
+			std::vector<uint8_t> bytes;
+		};
+
+		std::filesystem::path source_directory;
+		std::deque<opened_file> opened{};
+	};
+
+	// Null terminated, and pointing into defines.
+	auto make_macros(const std::vector<shader_define> &defines) -> std::vector<D3D_SHADER_MACRO>
+	{
+		auto macros = std::vector<D3D_SHADER_MACRO>{};
+		for (auto &define : defines)
+		{
+			macros.push_back({ define.name.c_str(), define.value.c_str() });
+		}
+		macros.push_back({ nullptr, nullptr });
+		return macros;
+	}
+
+	auto make_shader_files(const std::filesystem::path &source_file, const std::filesystem::path &output_file,
+	                       std::vector<std::filesystem::path> includes) -> std::vector<std::filesystem::path>
+	{
+		includes.push_back(source_file);
+		includes.push_back(output_file);
+		return includes;
+	}
+}
+
+shader_reload_service::shader_reload_service(pipeline_compiler &compiler_) :
+	shader_reload_service(compiler_, default_poll_interval)
+{}
+
+shader_reload_service::shader_reload_service(pipeline_compiler &compiler_, std::chrono::milliseconds poll_interval_) :
+	compiler{ compiler_ },
+	poll_interval{ poll_interval_ }
+{
+	watch_thread = std::thread(&shader_reload_service::watch_loop, this);
+}
+
+// A reload in progress is finished, its result is dropped.
+shader_reload_service::~shader_reload_service()
+{
+	{
+		auto lock = std::lock_guard{ watch_mutex };
+		stop_watching = true;
+	}
+	watch_stopped.notify_all();
+
+	watch_thread.join();
+}
+
+// Files are watched from the next poll, its includes are found first.
+void shader_reload_service::add_shader(const shader_variant &variant, shader_bytes bytecode)
+{
+	shaders[variant.name] = { bytecode, {} };
+
+	auto source = shader_source{ variant.source_file.lexically_normal(),
+	                             variant.profile,
+	                             variant.defines,
+	                             std::filesystem::path{ variant.name + ".cso" }.lexically_normal() };
+
+	auto lock = std::lock_guard{ watch_mutex };
+	dependencies.set_shader_files(variant.name, make_shader_files(source.source_file, source.output_file, {}));
+	sources[variant.name] = std::move(source);
+	undiscovered_shaders.push_back(variant.name);
+}
+
+auto shader_reload_service::get_shader(const std::string &name) const -> shader_bytes
+{
+	return shaders.at(name).bytecode;
+}
+
+// The builder is called once now, and again every time one of the shaders changes.
+auto shader_reload_service::add_pipeline(const std::vector<std::string> &pipeline_shaders, pipeline_builder builder)
+	-> reloadable_pipeline
+{
+	auto pipeline = static_cast<reloadable_pipeline>(pipelines.size());
+	auto handle = builder();
+	pipelines.push_back({ std::move(builder), handle, std::nullopt });
+
+	auto lock = std::lock_guard{ watch_mutex };
+	dependencies.set_pipeline_shaders(pipeline, pipeline_shaders);
+	return pipeline;
+}
+
+auto shader_reload_service::get_pipeline(reloadable_pipeline pipeline) const -> pipeline_handle
+{
+	return pipelines.at(pipeline).current;
+}
+
+// Reloaded shaders are put in place, the pipelines using them are requested
+// again, and rebuilt pipelines that have finished compiling are swapped in.
+// A pipeline rebuilt again before its last rebuild was ready skips that one.
+void shader_reload_service::begin_frame()
+{
+	auto changed = take_reloaded();
+	if (not changed.empty())
+	{
+		auto changed_names = std::vector<std::string>{};
+		for (auto &shader : changed)
+		{
+			auto &entry = shaders.at(shader.name);
+			entry.reloaded = std::move(shader.bytecode);
+			entry.bytecode = { entry.reloaded.data(), entry.reloaded.size() };
+			changed_names.push_back(shader.name);
+		}
+
+		auto affected = std::vector<reloadable_pipeline>{};
+		{
+			auto lock = std::lock_guard{ watch_mutex };
+			affected = dependencies.get_affected_pipelines(changed_names);
+			stats.pipelines_rebuilt += static_cast<uint32_t>(affected.size());
+		}
+
+		for (auto pipeline : affected)
+		{
+			auto &entry = pipelines.at(pipeline);
+			entry.pending = entry.builder();
+		}
+	}
+
+	auto swapped = uint32_t{};
+	for (auto &entry : pipelines)
+	{
+		if (entry.pending and compiler.is_ready(*entry.pending))
+		{
+			entry.current = *entry.pending;
+			entry.pending.reset();
+			swapped++;
+		}
+	}
+
+	if (swapped > 0)
+	{
+		auto lock = std::lock_guard{ watch_mutex };
+		stats.pipelines_swapped += swapped;
+	}
+}
+
+auto shader_reload_service::get_stats() const -> reload_stats
+{
+	auto lock = std::lock_guard{ watch_mutex };
+	return stats;
+}
+
+// Nothing is reloaded until the files have stopped changing for a whole
+// poll, so a half written save, or a build writing several outputs,
+// causes one reload instead of several.
+void shader_reload_service::watch_loop()
+{
+	while (true)
+	{
+		{
+			auto lock = std::unique_lock{ watch_mutex };
+			if (watch_stopped.wait_for(lock, poll_interval, [this] { return stop_watching; }))
+			{
+				return;
+			}
+		}
+
+		discover_includes();
+
+		auto files = std::vector<std::filesystem::path>{};
+		{
+			auto lock = std::lock_guard{ watch_mutex };
+			files = dependencies.get_files();
+		}
+
+		auto changed = find_changed_files(files);
+		if (not changed.empty() or unsettled_files.empty())
+		{
+			unsettled_files.insert(unsettled_files.end(), changed.begin(), changed.end());
+			continue;
+		}
+
+		reload_shaders(std::exchange(unsettled_files, {}));
+	}
+}
+
+void shader_reload_service::discover_includes()
+{
+	auto discover = std::vector<std::pair<std::string, shader_source>>{};
+	{
+		auto lock = std::lock_guard{ watch_mutex };
+		for (auto &name : undiscovered_shaders)
+		{
+			discover.emplace_back(name, sources.at(name));
+		}
+		undiscovered_shaders.clear();
+	}
+
+	for (auto &[name, source] : discover)
+	{
+		auto files = make_shader_files(source.source_file, source.output_file, find_includes(source));
+
+		auto lock = std::lock_guard{ watch_mutex };
+		dependencies.set_shader_files(name, files);
+	}
+}
+
+// A file is only compared once it has been seen, the first sight of it isn't a change.
+// Files that can't be read right now keep their last time.
+auto shader_reload_service::find_changed_files(const std::vector<std::filesystem::path> &files)
+	-> std::vector<std::filesystem::path>
+{
+	auto changed = std::vector<std::filesystem::path>{};
+	for (auto &file : files)
+	{
+		auto error = std::error_code{};
+		auto write_time = std::filesystem::last_write_time(file, error);
+		if (error)
+		{
+			continue;
+		}
+
+		auto [known, added] = write_times.try_emplace(file, write_time);
+		if (not added and known->second != write_time)
+		{
+			known->second = write_time;
+			changed.push_back(file);
+		}
+	}
+
+	if (not changed.empty())
+	{
+		auto lock = std::lock_guard{ watch_mutex };
+		stats.files_changed += static_cast<uint32_t>(changed.size());
+	}
+	return changed;
+}
+
+// When a shader's output changed it was built elsewhere, by the build,
+// and is read back as it is. Otherwise it is compiled from source here.
+void shader_reload_service::reload_shaders(const std::vector<std::filesystem::path> &changed_files)
+{
+	auto affected = std::vector<std::pair<std::string, shader_source>>{};
+	{
+		auto lock = std::lock_guard{ watch_mutex };
+		for (auto &name : dependencies.get_affected_shaders(changed_files))
+		{
+			affected.emplace_back(name, sources.at(name));
+		}
+	}
+
+	for (auto &[name, source] : affected)
+	{
+		auto output_changed = std::find(changed_files.begin(), changed_files.end(),
+		                                source.output_file) != changed_files.end();
+
+		auto includes = std::vector<std::filesystem::path>{};
+		auto bytecode = output_changed ? read_file(source.output_file)
+		                               : compile_shader(source, includes);
+
+		auto lock = std::lock_guard{ watch_mutex };
+		if (not bytecode)
+		{
+			stats.shader_errors++;
+			continue;
+		}
+
+		if (not output_changed)
+		{
+			dependencies.set_shader_files(name, make_shader_files(source.source_file, source.output_file, includes));
+		}
+		reloaded.push_back({ name, std::move(*bytecode) });
+		stats.shaders_reloaded++;
+	}
+}
+
+auto shader_reload_service::take_reloaded() -> std::vector<reloaded_shader>
+{
+	auto lock = std::lock_guard{ watch_mutex };
+	return std::exchange(reloaded, {});
+}
+
+// Preprocessing is enough to open every include, nothing is compiled.
+auto shader_reload_service::find_includes(const shader_source &source) -> std::vector<std::filesystem::path>
+{
+	auto text = read_file(source.source_file);
+	if (not text)
+	{
+		return {};
+	}
+
+	auto recorder = include_recorder{ source.source_file.parent_path() };
+	auto macros = make_macros(source.defines);
+	auto preprocessed = dx_blob{};
+	auto errors = dx_blob{};
+	::D3DPreprocess(text->data(),
+	                text->size(),
+	                source.source_file.string().c_str(),
+	                macros.data(),
+	                &recorder,
+	                preprocessed.put(),
+	                errors.put());
+	return recorder.get_files();
+}
+
+// Errors go to the debugger output, the caller keeps the old bytecode.
+auto shader_reload_service::compile_shader(const shader_source &source, std::vector<std::filesystem::path> &includes)
+	-> std::optional<std::vector<uint8_t>>
+{
+	auto recorder = include_recorder{ source.source_file.parent_path() };
+	auto macros = make_macros(source.defines);
+	auto code = dx_blob{};
+	auto errors = dx_blob{};
+	auto hr = ::D3DCompileFromFile(source.source_file.wstring().c_str(),
+	                               macros.data(),
+	                               &recorder,
+	                               "main",
+	                               source.profile.c_str(),
+	                               compile_flags,
+	                               0,
+	                               code.put(),
+	                               errors.put());
+	if (errors)
+	{
+		::OutputDebugStringA(static_cast<const char *>(errors->GetBufferPointer()));
+	}
+	if (FAILED(hr))
+	{
+		return std::nullopt;
+	}
+
+	includes = recorder.get_files();
+
+	auto bytes = static_cast<const uint8_t *>(code->GetBufferPointer());
+	return std::vector<uint8_t>(bytes, bytes + code->GetBufferSize());
+}
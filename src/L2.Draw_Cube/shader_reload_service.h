@@ -0,0 +1,126 @@
+#pragma once
+
+#include "pipeline_compiler.h"
+#include "shader_archive.h"
+#include "shader_dependency_graph.h"
+#include "shader_permutations.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace learning_dx12
+{
+	// Watches the files shaders are built from, sources, what they include
+	// and the compiled .cso outputs. A background thread recompiles a shader
+	// when its source changes, or reads it back when only its output does.
+	// Pipelines using it are then requested again from the compiler, and each
+	// replaces the one it rebuilds at the start of the first frame after it
+	// is ready. Until then, and if a shader fails to compile, the old
+	// pipeline keeps being used.
+	// Everything but the watching happens on the render thread.
+	class shader_reload_service
+	{
+	public:
+		// Builds a pipeline from whatever get_shader returns when it is called.
+		using pipeline_builder = std::function<pipeline_handle()>;
+
+		struct reload_stats
+		{
+			uint32_t files_changed;
+			uint32_t shaders_reloaded;
+			uint32_t shader_errors;     // old bytecode kept
+			uint32_t pipelines_rebuilt;
+			uint32_t pipelines_swapped;
+		};
+
+	public:
+		shader_reload_service(pipeline_compiler &compiler);
+		shader_reload_service(pipeline_compiler &compiler, std::chrono::milliseconds poll_interval);
+		shader_reload_service() = delete;
+		~shader_reload_service();
+
+		// Bytecode must stay valid until the shader is reloaded, or the service is destroyed.
+		// The variant is known by its archive name, its output is that name with .cso.
+		void add_shader(const shader_variant &variant, shader_bytes bytecode);
+		auto get_shader(const std::string &name) const -> shader_bytes;
+
+		auto add_pipeline(const std::vector<std::string> &shaders, pipeline_builder builder) -> reloadable_pipeline;
+		auto get_pipeline(reloadable_pipeline pipeline) const -> pipeline_handle;
+
+		// Call between frames, nothing recorded before it sees a swapped pipeline.
+		void begin_frame();
+
+		auto get_stats() const -> reload_stats;
+
+	private:
+		struct shader_source
+		{
+			std::filesystem::path source_file;
+			std::string profile;
+			std::vector<shader_define> defines;
+			std::filesystem::path output_file;
+		};
+
+		struct shader_entry
+		{
+			shader_bytes bytecode{};
+			std::vector<uint8_t> reloaded{}; // owns bytecode once reloaded
+		};
+
+		struct pipeline_entry
+		{
+			pipeline_builder builder{};
+			pipeline_handle current{};
+			std::optional<pipeline_handle> pending{};
+		};
+
+		struct reloaded_shader
+		{
+			std::string name;
+			std::vector<uint8_t> bytecode;
+		};
+
+		void watch_loop();
+		void discover_includes();
+		auto find_changed_files(const std::vector<std::filesystem::path> &files) -> std::vector<std::filesystem::path>;
+		void reload_shaders(const std::vector<std::filesystem::path> &changed_files);
+		auto take_reloaded() -> std::vector<reloaded_shader>;
+
+		static auto find_includes(const shader_source &source) -> std::vector<std::filesystem::path>;
+		static auto compile_shader(const shader_source &source, std::vector<std::filesystem::path> &includes)
+			-> std::optional<std::vector<uint8_t>>;
+
+	private:
+		pipeline_compiler &compiler;
+		std::chrono::milliseconds poll_interval{};
+
+		// Render thread only.
+		std::map<std::string, shader_entry> shaders{};
+		std::vector<pipeline_entry> pipelines{};
+
+		// Watcher thread only.
+		std::map<std::filesystem::path, std::filesystem::file_time_type> write_times{};
+		std::vector<std::filesystem::path> unsettled_files{};
+
+		// Shared, behind watch_mutex.
+		shader_dependency_graph dependencies{};
+		std::map<std::string, shader_source> sources{};
+		std::vector<std::string> undiscovered_shaders{}; // includes not found yet
+		std::vector<reloaded_shader> reloaded{};
+		reload_stats stats{};
+
+		mutable std::mutex watch_mutex{};
+		std::condition_variable watch_stopped{};
+		bool stop_watching{ false };
+
+		std::thread watch_thread{};
+	};
+}
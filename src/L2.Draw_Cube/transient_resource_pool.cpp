@@ -0,0 +1,199 @@
+#include "transient_resource_pool.h"
+
+#include "d3dx12.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+using namespace learning_dx12;
+
+namespace
+{
+	constexpr auto heap_categories = std::array{
+		heap_category::buffers,
+		heap_category::rt_ds_textures,
+		heap_category::other_textures,
+	};
+
+	auto same_resource_desc(const D3D12_RESOURCE_DESC &a, const D3D12_RESOURCE_DESC &b) -> bool
+	{
+		return a.Dimension == b.Dimension
+		   and a.Alignment == b.Alignment
+		   and a.Width == b.Width
+		   and a.Height == b.Height
+		   and a.DepthOrArraySize == b.DepthOrArraySize
+		   and a.MipLevels == b.MipLevels
+		   and a.Format == b.Format
+		   and a.SampleDesc.Count == b.SampleDesc.Count
+		   and a.SampleDesc.Quality == b.SampleDesc.Quality
+		   and a.Layout == b.Layout
+		   and a.Flags == b.Flags;
+	}
+
+	// Only the half of the clear value union that applies to the format is compared.
+	auto same_clear_value(const transient_desc &a, const transient_desc &b) -> bool
+	{
+		if (a.has_clear_value != b.has_clear_value)
+		{
+			return false;
+		}
+		if (not a.has_clear_value)
+		{
+			return true;
+		}
+
+		auto &ca = a.clear_value,
+		     &cb = b.clear_value;
+		if (a.desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)
+		{
+			return ca.Format == cb.Format
+			   and ca.DepthStencil.Depth == cb.DepthStencil.Depth
+			   and ca.DepthStencil.Stencil == cb.DepthStencil.Stencil;
+		}
+
+		return ca.Format == cb.Format
+		   and std::equal(std::begin(ca.Color), std::end(ca.Color), std::begin(cb.Color));
+	}
+
+	auto same_transient(const transient_desc &a, const transient_desc &b) -> bool
+	{
+		return same_resource_desc(a.desc, b.desc)
+		   and same_clear_value(a, b)
+		   and a.initial_state == b.initial_state
+		   and a.first_use == b.first_use
+		   and a.last_use == b.last_use;
+	}
+}
+
+transient_resource_pool::transient_resource_pool(dx_device device_) :
+	device{ device_ }
+{}
+
+transient_resource_pool::~transient_resource_pool() = default;
+
+// A rebuild retires the current resources and heaps rather than
+// releasing them, see take_retired.
+auto transient_resource_pool::needs_rebuild(const std::vector<transient_desc> &descs) const -> bool
+{
+	return not std::equal(descs.begin(), descs.end(),
+	                      current_descs.begin(), current_descs.end(),
+	                      same_transient);
+}
+
+// One resource per desc, in the same order.
+auto transient_resource_pool::realize(const std::vector<transient_desc> &descs) -> const std::vector<transient_resource> &
+{
+	if (needs_rebuild(descs))
+	{
+		rebuild(descs);
+	}
+
+	return resources;
+}
+
+auto transient_resource_pool::take_retired() -> retired_transients
+{
+	auto taken = std::move(retired);
+	retired = {};
+	return taken;
+}
+
+auto transient_resource_pool::get_stats() const -> pool_stats
+{
+	return stats;
+}
+
+void transient_resource_pool::rebuild(const std::vector<transient_desc> &descs)
+{
+	std::move(resources.begin(), resources.end(), std::back_inserter(retired.resources));
+	resources.clear();
+	resources.resize(descs.size());
+
+	// New placements would alias memory the GPU may still be using
+	// for the old ones, so every heap is replaced too.
+	for (auto &heap : heaps)
+	{
+		if (heap)
+		{
+			retired.heaps.push_back(std::move(heap));
+		}
+	}
+	current_descs = descs;
+
+	stats.heap_size = 0;
+	stats.naive_size = 0;
+	stats.resource_count = static_cast<uint32_t>(descs.size());
+	stats.aliased_count = 0;
+	stats.rebuild_count++;
+
+	for (auto category : heap_categories)
+	{
+		auto members = std::vector<uint32_t>{};
+		auto requests = std::vector<transient_request>{};
+
+		for (auto index = 0u; index < descs.size(); index++)
+		{
+			auto &transient = descs[index];
+			if (get_heap_category(transient.desc) != category)
+			{
+				continue;
+			}
+
+			auto info = device->GetResourceAllocationInfo(0, 1, &transient.desc);
+			assert(info.SizeInBytes != UINT64_MAX);
+
+			members.push_back(index);
+			requests.push_back({ info.SizeInBytes, info.Alignment, transient.first_use, transient.last_use });
+		}
+
+		if (members.empty())
+		{
+			continue;
+		}
+
+		auto plan = plan_transient_memory(requests);
+		auto heap = create_heap(category, plan.heap_size);
+
+		stats.heap_size += plan.heap_size;
+		stats.naive_size += plan.naive_size;
+		stats.aliased_count += plan.aliased_count;
+
+		for (auto i = 0u; i < members.size(); i++)
+		{
+			auto &transient = descs[members[i]];
+			auto &placement = plan.placements[i];
+			auto &resource = resources[members[i]];
+
+			auto hr = device->CreatePlacedResource(heap.get(),
+			                                       placement.offset,
+			                                       &transient.desc,
+			                                       transient.initial_state,
+			                                       transient.has_clear_value ? &transient.clear_value : nullptr,
+			                                       __uuidof(ID3D12Resource),
+			                                       resource.resource.put_void());
+			assert(SUCCEEDED(hr));
+
+			resource.previous = (placement.previous < members.size())
+			                  ? members[placement.previous]
+			                  : placement.previous;
+		}
+	}
+}
+
+auto transient_resource_pool::create_heap(heap_category category, uint64_t size) -> dx_heap
+{
+	auto &heap = heaps.at(static_cast<size_t>(category));
+
+	auto desc = CD3DX12_HEAP_DESC(std::max(size, uint64_t{ D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT }),
+	                              D3D12_HEAP_TYPE_DEFAULT,
+	                              D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT,
+	                              map_to_heap_flags(category));
+
+	auto hr = device->CreateHeap(&desc,
+	                             __uuidof(ID3D12Heap),
+	                             heap.put_void());
+	assert(SUCCEEDED(hr));
+
+	return heap;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "dx_wrapped_types.h"
+#include "gpu_heap_allocator.h"
+#include "transient_memory_planner.h"
+
+#include <d3d12.h>
+
+#include <array>
+#include <vector>
+
+namespace learning_dx12
+{
+	struct transient_desc
+	{
+		D3D12_RESOURCE_DESC desc;
+		D3D12_CLEAR_VALUE clear_value;
+		bool has_clear_value;
+		D3D12_RESOURCE_STATES initial_state;
+		uint32_t first_use;
+		uint32_t last_use;
+	};
+
+	struct transient_resource
+	{
+		dx_resource resource;
+		uint32_t previous; // as transient_placement::previous, an index into the same set
+	};
+
+	// Placed resources that only live for part of a frame. Their memory is
+	// planned by plan_transient_memory, one heap per heap_category, and they
+	// are only created again when the set of descriptions changes.
+	class transient_resource_pool
+	{
+	public:
+		struct pool_stats
+		{
+			uint64_t heap_size;    // across categories
+			uint64_t naive_size;   // what committed resources would have needed
+			uint32_t resource_count;
+			uint32_t aliased_count;
+			uint32_t rebuild_count;
+		};
+
+		// What rebuilds replaced. Frames still in flight may be using it, so
+		// whoever takes it keeps it alive until the GPU has moved past them.
+		struct retired_transients
+		{
+			std::vector<transient_resource> resources;
+			std::vector<dx_heap> heaps;
+		};
+
+	public:
+		transient_resource_pool(dx_device device);
+		transient_resource_pool() = delete;
+		~transient_resource_pool();
+
+		auto needs_rebuild(const std::vector<transient_desc> &descs) const -> bool;
+		auto realize(const std::vector<transient_desc> &descs) -> const std::vector<transient_resource> &;
+		auto take_retired() -> retired_transients;
+
+		auto get_stats() const -> pool_stats;
+
+	private:
+		void rebuild(const std::vector<transient_desc> &descs);
+		auto create_heap(heap_category category, uint64_t size) -> dx_heap;
+
+	private:
+		dx_device device{};
+
+		std::vector<transient_desc> current_descs{};
+		std::vector<transient_resource> resources{};
+
+		std::array<dx_heap, 3> heaps{};
+		retired_transients retired{};
+
+		pool_stats stats{};
+	};
+}
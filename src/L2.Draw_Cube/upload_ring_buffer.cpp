@@ -0,0 +1,104 @@
+#include "upload_ring_buffer.h"
+
+#include "d3dx12.h"
+
+#include <cassert>
+#include <cstring>
+
+using namespace learning_dx12;
+
+namespace
+{
+	// CopyBufferRegion has no alignment rules of its own, 
+	// this just keeps source rows from straddling cache lines.
+	constexpr auto copy_alignment = uint64_t{ 16 };
+}
+
+upload_ring_buffer::upload_ring_buffer(dx_device device) :
+	upload_ring_buffer(device, default_capacity)
+{}
+
+upload_ring_buffer::upload_ring_buffer(dx_device device, uint64_t capacity) :
+	allocator{capacity}
+{
+	create_buffer(device, capacity);
+}
+
+upload_ring_buffer::~upload_ring_buffer()
+{
+	buffer->Unmap(0, nullptr);
+}
+
+auto upload_ring_buffer::allocate(uint64_t size, uint64_t alignment) -> std::optional<upload_allocation>
+{
+	auto offset = allocator.allocate(size, alignment);
+	if (not offset)
+	{
+		return std::nullopt;
+	}
+
+	return upload_allocation{
+		cpu_base + *offset,
+		gpu_base + *offset,
+		buffer.get(),
+		*offset
+	};
+}
+
+auto upload_ring_buffer::upload(dx_cmd_list cmd_list, dx_resource destination, uint64_t destination_offset,
+                                const void *data, uint64_t size) -> bool
+{
+	auto staging = allocate(size, copy_alignment);
+	if (not staging)
+	{
+		return false;
+	}
+
+	std::memcpy(staging->cpu_address, data, size);
+
+	cmd_list->CopyBufferRegion(destination.get(),
+	                           destination_offset,
+	                           staging->resource,
+	                           staging->offset,
+	                           size);
+	return true;
+}
+
+void upload_ring_buffer::finish_batch(uint64_t fence_value)
+{
+	allocator.finish_batch(fence_value);
+}
+
+void upload_ring_buffer::release_completed(uint64_t completed_fence_value)
+{
+	allocator.release_completed(completed_fence_value);
+}
+
+auto upload_ring_buffer::get_stats() const -> ring_allocator::ring_stats
+{
+	return allocator.get_stats();
+}
+
+void upload_ring_buffer::set_name(LPCWSTR name)
+{
+	buffer->SetName(name);
+}
+
+void upload_ring_buffer::create_buffer(dx_device device, uint64_t capacity)
+{
+	auto hr = device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+	                                          D3D12_HEAP_FLAG_NONE,
+	                                          &CD3DX12_RESOURCE_DESC::Buffer(capacity),
+	                                          D3D12_RESOURCE_STATE_GENERIC_READ,
+	                                          nullptr,
+	                                          __uuidof(ID3D12Resource),
+	                                          buffer.put_void());
+	assert(SUCCEEDED(hr));
+
+	// Upload heaps can stay mapped forever, CPU never reads from it.
+	auto read_range = CD3DX12_RANGE(0, 0);
+	hr = buffer->Map(0, &read_range, reinterpret_cast<void **>(&cpu_base));
+	assert(SUCCEEDED(hr));
+
+	gpu_base = buffer->GetGPUVirtualAddress();
+}
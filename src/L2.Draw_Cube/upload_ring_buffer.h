@@ -0,0 +1,54 @@
+#pragma once
+
+#include "dx_wrapped_types.h"
+#include "ring_allocator.h"
+
+#include <d3d12.h>
+
+#include <optional>
+
+namespace learning_dx12
+{
+	struct upload_allocation
+	{
+		void *cpu_address;
+		D3D12_GPU_VIRTUAL_ADDRESS gpu_address;
+		ID3D12Resource *resource;
+		uint64_t offset;
+	};
+
+	// One large UPLOAD heap buffer that stays mapped for its whole life.
+	// Staging space is sub-allocated from it and handed back in batches 
+	// as the GPU passes the fence value given to finish_batch.
+	class upload_ring_buffer
+	{
+	public:
+		static constexpr auto default_capacity = uint64_t{ 16 * 1024 * 1024 };
+
+	public:
+		upload_ring_buffer(dx_device device);
+		upload_ring_buffer(dx_device device, uint64_t capacity);
+		upload_ring_buffer() = delete;
+		~upload_ring_buffer();
+
+		auto allocate(uint64_t size, uint64_t alignment) -> std::optional<upload_allocation>;
+		auto upload(dx_cmd_list cmd_list, dx_resource destination, uint64_t destination_offset,
+		            const void *data, uint64_t size) -> bool;
+
+		void finish_batch(uint64_t fence_value);
+		void release_completed(uint64_t completed_fence_value);
+
+		auto get_stats() const -> ring_allocator::ring_stats;
+
+		void set_name(LPCWSTR name);
+
+	private:
+		void create_buffer(dx_device device, uint64_t capacity);
+
+	private:
+		ring_allocator allocator;
+		dx_resource buffer{};
+		uint8_t *cpu_base{};
+		D3D12_GPU_VIRTUAL_ADDRESS gpu_base{};
+	};
+}
@@ -1,9 +1,20 @@
-struct projection
+struct draw_constants
+{
+	uint first_instance;
+};
+
+struct view_projection
 {
 	matrix data;
 };
 
-ConstantBuffer<projection> projection_cb : register(b0);
+struct cube_instance
+{
+	matrix world;
+	float4 color;
+};
+
+#include "root_layout.hlsli"
 
 struct vertex_pos_color
 {
@@ -17,12 +28,21 @@ struct vertex_shader_output
 	float4 color: COLOR;
 };
 
-vertex_shader_output main(vertex_pos_color in_v)
+vertex_shader_output main(vertex_pos_color in_v, uint instance_id: SV_InstanceID)
 {
 	vertex_shader_output out_v;
 
-	out_v.position = mul(projection_cb.data, float4(in_v.position, 1.0f));
-	out_v.color = float4(in_v.color, 1.0f);
+#if INDIRECT_INSTANCES
+	// Each indirect draw's instances start where its root constant says.
+	cube_instance instance = instances[draw_cb.first_instance + instance_id];
+#else
+	// The direct draw gathers the visible cubes from the start.
+	cube_instance instance = instances[instance_id];
+#endif
+	float4 world_position = mul(instance.world, float4(in_v.position, 1.0f));
+
+	out_v.position = mul(view_projection_cb.data, world_position);
+	out_v.color = float4(in_v.color, 1.0f) * instance.color;
 
 	return out_v;
 }
\ No newline at end of file
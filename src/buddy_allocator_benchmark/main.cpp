@@ -0,0 +1,176 @@
+#include "buddy_allocator.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// Times allocations and frees of resource sized blocks in one of
+// gpu_heap_allocator's heaps, and reports how much the power-of-two
+// rounding costs, for random churn and for window sized depth buffers.
+// Usage: buddy_allocator_benchmark [<operations> [<runs>]]
+
+namespace
+{
+	using namespace learning_dx12;
+
+	constexpr auto default_operation_count = 1'000'000;
+	constexpr auto default_runs = 10;
+
+	constexpr auto kb = uint64_t{ 1024 };
+	constexpr auto mb = 1024 * kb;
+	constexpr auto heap_size = 64 * mb;        // gpu_heap_allocator's default
+	constexpr auto min_block_size = 64 * kb;   // D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT
+	constexpr auto msaa_alignment = 4 * mb;    // D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT
+	constexpr auto committed_rt_ds_size = 4 * mb; // gpu_heap_allocator's cut-off
+
+	struct operation
+	{
+		bool is_free;
+		uint64_t size;      // or which live allocation to free, modulo their count
+		uint64_t alignment;
+	};
+
+	// Placed resources from one 64 KB tile up to 8 MB, spread evenly across
+	// orders of magnitude, one in ten MSAA aligned. Frees are slightly less
+	// likely than allocations, so the heap fills up and then churns.
+	auto make_workload(int operation_count) -> std::vector<operation>
+	{
+		auto random = std::mt19937{ 42 };
+		auto log_size = std::uniform_real_distribution<double>{ std::log2(double(min_block_size)), std::log2(8.0 * mb) };
+		auto percent = std::uniform_int_distribution<int>{ 0, 99 };
+
+		auto workload = std::vector<operation>(operation_count);
+		for (auto &op : workload)
+		{
+			op.is_free = percent(random) < 48;
+			op.size = op.is_free ? random() : static_cast<uint64_t>(std::exp2(log_size(random)));
+			op.alignment = percent(random) < 10 ? msaa_alignment : min_block_size;
+		}
+		return workload;
+	}
+
+	struct churn_result
+	{
+		uint64_t allocation_count;
+		uint64_t failed_count;
+		buddy_allocator::buddy_stats final_stats;
+	};
+
+	auto run_churn(const std::vector<operation> &workload) -> churn_result
+	{
+		auto buddy = buddy_allocator{ heap_size, min_block_size };
+		auto live = std::vector<uint64_t>{};
+		live.reserve(heap_size / min_block_size);
+
+		auto result = churn_result{};
+		for (auto &op : workload)
+		{
+			if (op.is_free)
+			{
+				if (not live.empty())
+				{
+					auto victim = op.size % live.size();
+					buddy.free(live[victim]);
+					live[victim] = live.back();
+					live.pop_back();
+				}
+				continue;
+			}
+
+			auto offset = buddy.allocate(op.size, op.alignment);
+			if (offset)
+			{
+				live.push_back(*offset);
+				result.allocation_count++;
+			}
+			else
+			{
+				result.failed_count++;
+			}
+		}
+
+		result.final_stats = buddy.get_stats();
+		return result;
+	}
+
+	template <typename function>
+	auto time_median_ms(int runs, const function &run) -> double
+	{
+		auto times = std::vector<double>{};
+		for (auto i = 0; i < runs; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			run();
+			auto end = std::chrono::steady_clock::now();
+			times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		}
+
+		std::sort(times.begin(), times.end());
+		return times[times.size() / 2];
+	}
+
+	// D32 laid out in 64 KB tiles of 128x128 texels, which is
+	// what GetResourceAllocationInfo reports for a depth buffer.
+	void print_depth_buffers()
+	{
+		struct resolution
+		{
+			uint32_t width;
+			uint32_t height;
+		};
+
+		fmt::print("depth buffers (D32) in a {} MB heap:\n", heap_size / mb);
+		for (auto [width, height] : std::array{ resolution{ 1280, 720 }, resolution{ 1920, 1080 },
+		                                        resolution{ 2560, 1440 }, resolution{ 3840, 2160 } })
+		{
+			auto size = uint64_t{ (width + 127) / 128 } * ((height + 127) / 128) * min_block_size;
+
+			auto buddy = buddy_allocator{ heap_size, min_block_size };
+			buddy.allocate(size, min_block_size);
+			auto block = buddy.get_stats().allocated;
+
+			fmt::print("  {:>4}x{:<4} {:6.2f} MB in a {:5.2f} MB block, {:4.1f}% wasted{}\n",
+			           width, height,
+			           size / double(mb),
+			           block / double(mb),
+			           100.0 * (block - size) / block,
+			           size >= committed_rt_ds_size ? ", committed instead" : "");
+		}
+	}
+}
+
+auto main(int argc, char *argv[]) -> int
+{
+	auto operation_count = argc > 1 ? std::max(1, std::atoi(argv[1])) : default_operation_count;
+	auto runs = argc > 2 ? std::max(1, std::atoi(argv[2])) : default_runs;
+
+	auto workload = make_workload(operation_count);
+
+	auto result = churn_result{};
+	auto ms = time_median_ms(runs, [&]
+	{
+		result = run_churn(workload);
+	});
+
+	auto &stats = result.final_stats;
+	fmt::print("{} operations on a {} MB heap, {:.1f} ns each\n", operation_count, heap_size / mb, ms * 1e6 / operation_count);
+	fmt::print("  {} allocated, {} failed for lack of a large enough block\n", result.allocation_count, result.failed_count);
+	fmt::print("  at the end {} live, {:.1f} MB in blocks for {:.1f} MB requested, {:.1f}% lost to rounding\n",
+	           stats.allocation_count,
+	           stats.allocated / double(mb),
+	           stats.requested / double(mb),
+	           stats.allocated == 0 ? 0.0 : 100.0 * (stats.allocated - stats.requested) / stats.allocated);
+	fmt::print("  {:.1f} MB free, largest block {:.1f} MB, fragmentation {:.2f}\n",
+	           (stats.capacity - stats.allocated) / double(mb),
+	           stats.largest_free_block / double(mb),
+	           stats.fragmentation);
+
+	print_depth_buffers();
+	return 0;
+}
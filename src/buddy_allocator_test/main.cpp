@@ -0,0 +1,201 @@
+#include "buddy_allocator.h"
+#include "test_checks.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+// Checks buddy_allocator's splitting and merging directly, then fuzzes it
+// with random allocations and frees against a model of what it should
+// have handed out.
+
+namespace
+{
+	using namespace learning_dx12;
+
+	constexpr auto kb = uint64_t{ 1024 };
+	constexpr auto mb = 1024 * kb;
+
+	auto block_for(uint64_t size, uint64_t alignment, uint64_t min_block_size) -> uint64_t
+	{
+		auto block = min_block_size;
+		while (block < std::max(size, alignment))
+		{
+			block <<= 1;
+		}
+		return block;
+	}
+
+	void test_split_and_merge(test_checks &checks)
+	{
+		auto buddy = buddy_allocator{ 1 * mb, 64 * kb };
+
+		auto offsets = std::vector<uint64_t>{};
+		for (auto i = 0; i < 16; i++)
+		{
+			offsets.push_back(buddy.allocate(64 * kb, 64 * kb).value_or(UINT64_MAX));
+		}
+		std::sort(offsets.begin(), offsets.end());
+
+		auto packed = true;
+		for (auto i = 0u; i < offsets.size(); i++)
+		{
+			packed = packed and offsets[i] == i * 64 * kb;
+		}
+		checks.check(packed, "smallest blocks fill the whole range");
+		checks.check(not buddy.allocate(1, 1), "nothing left once full");
+
+		for (auto i = 0u; i < offsets.size(); i += 2)
+		{
+			buddy.free(offsets[i]);
+		}
+		auto stats = buddy.get_stats();
+		checks.check_equal(stats.largest_free_block, 64 * kb, "every other block free, no buddies to merge");
+		checks.check(not buddy.allocate(128 * kb, 1), "so no room for a larger block");
+
+		for (auto i = 1u; i < offsets.size(); i += 2)
+		{
+			buddy.free(offsets[i]);
+		}
+		stats = buddy.get_stats();
+		checks.check(buddy.is_empty(), "empty once everything is freed");
+		checks.check_equal(stats.free_block_count, 1u, "buddies merged back into one block");
+		checks.check_equal(stats.largest_free_block, 1 * mb, "the whole range");
+	}
+
+	void test_sizes(test_checks &checks)
+	{
+		auto buddy = buddy_allocator{ 64 * mb, 64 * kb };
+
+		auto aligned = buddy.allocate(100, 4 * mb);
+		checks.check(aligned and *aligned % (4 * mb) == 0, "alignment above the size is honoured");
+
+		auto stats = buddy.get_stats();
+		checks.check_equal(stats.allocated, 4 * mb, "the block is as large as the alignment");
+		checks.check_equal(stats.requested, uint64_t{ 100 }, "requested size is what was asked for");
+
+		checks.check(not buddy.allocate(64 * mb + 1, 1), "larger than the range fails");
+
+		// Why gpu_heap_allocator commits large render targets and depth buffers.
+		auto depth_1080p = uint64_t{ 15 * 9 } * 64 * kb; // D32 in 128x128 texel tiles
+		auto depth = buddy.allocate(depth_1080p, 64 * kb);
+		checks.check(depth.has_value(), "a 1080p depth buffer fits");
+		checks.check_equal(buddy.get_stats().allocated - stats.allocated, 16 * mb, "but takes a 16 MB block");
+	}
+
+	// Live allocations never overlap, are aligned to their block, and the
+	// stats agree with the model. A failure only happens when no free block
+	// is large enough, and freeing everything merges back to one block.
+	void test_fuzz(test_checks &checks, uint32_t seed)
+	{
+		constexpr auto capacity = 64 * mb;
+		constexpr auto min_block_size = 64 * kb;
+		constexpr auto operation_count = 20'000;
+
+		struct allocation
+		{
+			uint64_t size;
+			uint64_t block;
+		};
+
+		auto buddy = buddy_allocator{ capacity, min_block_size };
+		auto live = std::map<uint64_t, allocation>{};
+
+		auto random = std::mt19937{ seed };
+		auto log_size = std::uniform_real_distribution<double>{ 0.0, std::log2(double(capacity) / 2) };
+		auto alignments = std::array{ uint64_t{ 1 }, 4 * kb, 64 * kb, 4 * mb };
+		auto pick_alignment = std::uniform_int_distribution<size_t>{ 0, alignments.size() - 1 };
+		auto coin = std::uniform_int_distribution<int>{ 0, 99 };
+
+		auto valid = true, failures_legitimate = true;
+		auto failed_count = 0, allocated_count = 0;
+		for (auto operation = 0; operation < operation_count and valid; operation++)
+		{
+			if (not live.empty() and coin(random) < 45)
+			{
+				auto victim = std::next(live.begin(), std::uniform_int_distribution<size_t>{ 0, live.size() - 1 }(random));
+				buddy.free(victim->first);
+				live.erase(victim);
+				continue;
+			}
+
+			auto size = std::max(uint64_t{ 1 }, static_cast<uint64_t>(std::exp2(log_size(random))));
+			auto alignment = alignments[pick_alignment(random)];
+			auto block = block_for(size, alignment, min_block_size);
+
+			auto largest_free = buddy.get_stats().largest_free_block;
+			auto offset = buddy.allocate(size, alignment);
+			if (not offset)
+			{
+				failed_count++;
+				failures_legitimate = failures_legitimate and largest_free < block;
+				continue;
+			}
+			allocated_count++;
+
+			auto begin = *offset, end = *offset + block;
+			auto next = live.lower_bound(begin);
+			auto clear_of_next = next == live.end() or end <= next->first;
+			auto clear_of_previous = next == live.begin() or std::prev(next)->first + std::prev(next)->second.block <= begin;
+
+			valid = end <= capacity
+			    and begin % block == 0
+			    and clear_of_next
+			    and clear_of_previous;
+			live[begin] = { size, block };
+
+			auto stats = buddy.get_stats();
+			auto allocated = uint64_t{}, requested = uint64_t{};
+			for (auto &[o, a] : live)
+			{
+				allocated += a.block;
+				requested += a.size;
+			}
+			valid = valid
+			    and stats.allocated == allocated
+			    and stats.requested == requested
+			    and stats.allocation_count == live.size();
+		}
+
+		auto what = fmt::format("seed {}: ", seed);
+		checks.check(valid, what + "allocations are aligned, in range, apart, and counted");
+		checks.check(failures_legitimate, what + "allocations only fail when no free block is large enough");
+		checks.check(allocated_count > operation_count / 4 and failed_count > 0, what + "the fuzz both filled and emptied the range");
+
+		auto remaining = std::vector<uint64_t>{};
+		std::transform(live.begin(), live.end(), std::back_inserter(remaining), [](auto &entry)
+		{
+			return entry.first;
+		});
+		std::shuffle(remaining.begin(), remaining.end(), random);
+		for (auto offset : remaining)
+		{
+			buddy.free(offset);
+		}
+
+		auto stats = buddy.get_stats();
+		checks.check(buddy.is_empty() and stats.allocated == 0 and stats.requested == 0, what + "nothing allocated after freeing everything");
+		checks.check(stats.free_block_count == 1 and stats.largest_free_block == capacity, what + "merged back into one block");
+	}
+}
+
+auto main() -> int
+{
+	auto checks = test_checks{};
+
+	test_split_and_merge(checks);
+	test_sizes(checks);
+	for (auto seed : { 1u, 2u, 3u, 42u })
+	{
+		test_fuzz(checks, seed);
+	}
+
+	return checks.get_exit_code();
+}
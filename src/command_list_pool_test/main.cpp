@@ -0,0 +1,268 @@
+#include "command_list_pool.h"
+#include "test_checks.h"
+
+#include <fmt/format.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Drives command_list_pool with a mock device that keeps the GPU's
+// completed fence value itself, and flags any allocator reset while
+// work submitted with it could still be running.
+
+namespace
+{
+	using namespace learning_dx12;
+
+	struct mock_list
+	{
+		uint32_t id;
+
+		auto operator==(const mock_list &other) const -> bool
+		{
+			return id == other.id;
+		}
+	};
+
+	struct mock_device
+	{
+		using allocator_type = uint32_t;
+		using list_type = mock_list;
+
+		struct recording_type
+		{
+			std::string commands;
+		};
+
+		auto create_allocator() -> uint32_t
+		{
+			return allocator_count++;
+		}
+
+		void reset_allocator(uint32_t &allocator)
+		{
+			auto busy = busy_until.find(allocator);
+			if (busy != busy_until.end() and busy->second > completed_value)
+			{
+				early_reset_count++;
+			}
+		}
+
+		auto create_list(uint32_t &) -> mock_list
+		{
+			return { list_count++ };
+		}
+
+		void reset_list(mock_list &, uint32_t &)
+		{
+			list_reset_count++;
+		}
+
+		uint32_t allocator_count{};
+		uint32_t list_count{};
+		uint32_t list_reset_count{};
+		uint32_t early_reset_count{};
+
+		uint64_t submitted_value{};
+		uint64_t completed_value{};
+		std::unordered_map<uint32_t, uint64_t> busy_until{};
+	};
+
+	using pool_type = command_list_pool<mock_device>;
+
+	// What cmd_queue does at the end of a frame, minus the device calls.
+	auto submit(mock_device &device, pool_type &pool) -> std::vector<uint32_t>
+	{
+		auto submission = pool.take_submission();
+
+		auto orders = std::vector<uint32_t>{};
+		device.submitted_value++;
+		for (auto &open : submission)
+		{
+			orders.push_back(open.submit_order);
+			device.busy_until[open.allocator.allocator] = device.submitted_value;
+		}
+
+		pool.release(submission, device.submitted_value);
+		return orders;
+	}
+
+	void test_checkout(test_checks &checks)
+	{
+		auto device = mock_device{};
+		auto pool = pool_type{ device };
+
+		auto first = pool.checkout(5, 0).list;
+		auto second = pool.checkout(2, 0).list;
+		auto again = pool.checkout(5, 0).list;
+
+		checks.check(first == again, "same submit order gives back the same list");
+		checks.check(not (first == second), "different submit orders get different lists");
+		checks.check_equal(pool.get_open_lists().size(), size_t{ 2 }, "open lists");
+
+		pool.find(second).recording.commands += "draw";
+		checks.check_equal(pool.checkout(2, 0).recording.commands, std::string{ "draw" }, "find returns the list's own recording");
+	}
+
+	// What cmd_queue hands out for transient work, one list per caller.
+	void test_checkout_separate(test_checks &checks)
+	{
+		auto device = mock_device{};
+		auto pool = pool_type{ device };
+
+		auto frame = pool.checkout(1, 0).list;
+		auto first = pool.checkout_separate(0, 0).list;
+		auto second = pool.checkout_separate(0, 0).list;
+
+		checks.check(not (first == second) and not (first == frame), "each separate checkout gets a list of its own");
+		checks.check_equal(pool.get_open_lists().size(), size_t{ 3 }, "all of them open");
+
+		auto submission = pool.take_submission();
+		checks.check(submission.size() == 3 and submission[0].list == first and submission[1].list == second
+		             and submission[2].list == frame, "submitted under their order, in the order asked for");
+		pool.release(submission, 1);
+	}
+
+	void test_submit_order(test_checks &checks)
+	{
+		auto device = mock_device{};
+		auto pool = pool_type{ device };
+
+		for (auto order : { 7u, 1u, UINT32_MAX, 0u, 3u })
+		{
+			pool.checkout(order, 0);
+		}
+
+		auto orders = submit(device, pool);
+		checks.check(orders == std::vector<uint32_t>{ 0u, 1u, 3u, 7u, UINT32_MAX }, "lists are submitted in ascending order");
+		checks.check(pool.get_open_lists().empty(), "nothing left open after a submission");
+	}
+
+	void test_recycling(test_checks &checks)
+	{
+		auto device = mock_device{};
+		auto pool = pool_type{ device };
+
+		pool.checkout(0, device.completed_value);
+		pool.checkout(1, device.completed_value);
+		submit(device, pool);
+
+		// GPU still busy, so the allocators can't be reused yet, the lists can.
+		pool.checkout(0, device.completed_value);
+		pool.checkout(1, device.completed_value);
+		checks.check_equal(device.allocator_count, 4u, "pool grows while the GPU is behind");
+		checks.check_equal(device.list_count, 2u, "closed lists are reused straight away");
+		submit(device, pool);
+
+		device.completed_value = 1;
+		pool.checkout(0, device.completed_value);
+		pool.checkout(1, device.completed_value);
+		checks.check_equal(device.allocator_count, 4u, "allocators are reused once their fence completes");
+		submit(device, pool);
+
+		auto unlisted = pool.checkout_unlisted(device.completed_value);
+		checks.check(pool.get_open_lists().empty(), "unlisted lists aren't part of the submission");
+		auto fixups = std::vector<pool_type::open_list>{ unlisted };
+		pool.release(fixups, device.submitted_value);
+
+		checks.check_equal(device.early_reset_count, 0u, "no allocator reset before its fence completed");
+	}
+
+	// Two frames in flight, recorded on several lists each, for a while.
+	void test_steady_frames(test_checks &checks)
+	{
+		constexpr auto frames_in_flight = 2u;
+		constexpr auto lists_per_frame = 4u;
+
+		auto device = mock_device{};
+		auto pool = pool_type{ device };
+
+		for (auto frame = 0u; frame < 1000; frame++)
+		{
+			if (device.submitted_value >= frames_in_flight)
+			{
+				device.completed_value = device.submitted_value - frames_in_flight + 1;
+			}
+
+			for (auto order = 0u; order < lists_per_frame; order++)
+			{
+				pool.checkout(order, device.completed_value);
+			}
+			submit(device, pool);
+		}
+
+		auto stats = pool.get_allocator_stats();
+		checks.check(stats.pooled_count <= lists_per_frame * (frames_in_flight + 1), "live allocator count stays bounded");
+		checks.check(stats.trimmed_count > 0, "worn out allocators are replaced over a long session");
+		checks.check_equal(device.list_count, lists_per_frame, "one list per submit order is enough");
+		checks.check_equal(device.early_reset_count, 0u, "no allocator reset before its fence completed");
+	}
+
+	void test_idle_trim(test_checks &checks)
+	{
+		auto device = mock_device{};
+		auto pool = pool_type{ device };
+
+		for (auto order = 0u; order < 64; order++)
+		{
+			pool.checkout(order, device.completed_value);
+		}
+		submit(device, pool);
+
+		for (auto frame = 0; frame < 4; frame++)
+		{
+			device.completed_value = device.submitted_value;
+			pool.checkout(0, device.completed_value);
+			submit(device, pool);
+		}
+
+		auto stats = pool.get_allocator_stats();
+		checks.check(stats.pooled_count <= pool_type::allocator_pool::default_max_idle_count + 1, "idle allocators beyond the limit are released");
+		checks.check_equal(stats.trimmed_count + stats.pooled_count, stats.created_count, "every allocator is pooled or trimmed");
+	}
+
+	// However heavy the lists recorded with it were, an allocator is
+	// released once it has been reused max_reuse_count times.
+	void test_retire_worn_out(test_checks &checks)
+	{
+		constexpr auto max_reuse_count = size_t{ 4 };
+
+		auto device = mock_device{};
+		auto allocators = cmd_allocator_pool<mock_device>{ device, max_reuse_count, 16 };
+
+		auto ids = std::vector<uint32_t>{};
+		for (auto use = size_t{}; use < max_reuse_count * 3; use++)
+		{
+			auto entry = allocators.acquire(device.completed_value);
+			ids.push_back(entry.allocator);
+
+			device.submitted_value++;
+			device.busy_until[entry.allocator] = device.submitted_value;
+			allocators.release(entry, device.submitted_value);
+			device.completed_value = device.submitted_value;
+		}
+
+		auto stats = allocators.get_stats();
+		checks.check_equal(stats.created_count, size_t{ 3 }, "a new allocator after every max_reuse_count + 1 uses");
+		checks.check_equal(stats.trimmed_count, size_t{ 2 }, "worn out allocators are released");
+		checks.check(ids.front() == ids[max_reuse_count] and ids.front() != ids[max_reuse_count + 1], "reused up to the limit, then replaced");
+		checks.check_equal(device.early_reset_count, 0u, "no allocator reset before its fence completed");
+	}
+}
+
+auto main() -> int
+{
+	auto checks = test_checks{};
+
+	test_checkout(checks);
+	test_checkout_separate(checks);
+	test_submit_order(checks);
+	test_recycling(checks);
+	test_steady_frames(checks);
+	test_idle_trim(checks);
+	test_retire_worn_out(checks);
+
+	return checks.get_exit_code();
+}
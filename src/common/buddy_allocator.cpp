@@ -0,0 +1,155 @@
+#include "buddy_allocator.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace learning_dx12;
+
+namespace
+{
+	constexpr auto is_power_of_two(uint64_t value) -> bool
+	{
+		return value != 0 and (value & (value - 1)) == 0;
+	}
+
+	constexpr auto log2(uint64_t value) -> uint32_t
+	{
+		auto result = uint32_t{};
+		while (value >>= 1)
+		{
+			result++;
+		}
+		return result;
+	}
+}
+
+buddy_allocator::buddy_allocator(uint64_t capacity_, uint64_t min_block_size_) :
+	capacity{capacity_},
+	min_block_size{min_block_size_},
+	level_count{log2(capacity_ / min_block_size_) + 1}
+{
+	assert(is_power_of_two(capacity));
+	assert(is_power_of_two(min_block_size));
+	assert(capacity >= min_block_size);
+
+	free_blocks.resize(level_count);
+	free_blocks.front().insert(0);
+}
+
+buddy_allocator::~buddy_allocator() = default;
+
+auto buddy_allocator::allocate(uint64_t size, uint64_t alignment) -> std::optional<uint64_t>
+{
+	assert(size > 0);
+	assert(is_power_of_two(alignment));
+
+	auto needed = std::max(size, alignment);
+	if (needed > capacity)
+	{
+		return std::nullopt;
+	}
+
+	auto level = level_for_size(needed);
+
+	// Find the smallest free block that is big enough
+	auto found = level;
+	while (free_blocks[found].empty())
+	{
+		if (found == 0)
+		{
+			return std::nullopt;
+		}
+		found--;
+	}
+
+	auto offset = *free_blocks[found].begin();
+	free_blocks[found].erase(free_blocks[found].begin());
+
+	// Split it down, putting the upper halves back on the free lists
+	while (found < level)
+	{
+		found++;
+		free_blocks[found].insert(offset + block_size(found));
+	}
+
+	allocations[offset] = { level, size };
+	allocated += block_size(level);
+	requested += size;
+
+	return offset;
+}
+
+void buddy_allocator::free(uint64_t offset)
+{
+	auto allocation = allocations.find(offset);
+	assert(allocation != allocations.end());
+
+	auto [level, size] = allocation->second;
+	allocations.erase(allocation);
+	allocated -= block_size(level);
+	requested -= size;
+
+	// Merge with the buddy for as long as it is free too
+	while (level > 0)
+	{
+		auto buddy = offset ^ block_size(level);
+		auto &level_blocks = free_blocks[level];
+
+		auto buddy_block = level_blocks.find(buddy);
+		if (buddy_block == level_blocks.end())
+		{
+			break;
+		}
+
+		level_blocks.erase(buddy_block);
+		offset = std::min(offset, buddy);
+		level--;
+	}
+
+	free_blocks[level].insert(offset);
+}
+
+auto buddy_allocator::get_stats() const -> buddy_stats
+{
+	auto stats = buddy_stats{};
+	stats.capacity = capacity;
+	stats.allocated = allocated;
+	stats.requested = requested;
+	stats.allocation_count = static_cast<uint32_t>(allocations.size());
+
+	for (auto level = uint32_t{}; level < level_count; level++)
+	{
+		auto count = free_blocks[level].size();
+		stats.free_block_count += static_cast<uint32_t>(count);
+		if (count > 0 and stats.largest_free_block == 0)
+		{
+			stats.largest_free_block = block_size(level);
+		}
+	}
+
+	auto free_bytes = capacity - allocated;
+	stats.fragmentation = (free_bytes == 0) ? 0.0f
+	                    : 1.0f - static_cast<float>(stats.largest_free_block) / static_cast<float>(free_bytes);
+
+	return stats;
+}
+
+auto buddy_allocator::is_empty() const -> bool
+{
+	return allocations.empty();
+}
+
+auto buddy_allocator::level_for_size(uint64_t size) const -> uint32_t
+{
+	auto level = level_count - 1;
+	while (level > 0 and block_size(level) < size)
+	{
+		level--;
+	}
+	return level;
+}
+
+auto buddy_allocator::block_size(uint32_t level) const -> uint64_t
+{
+	return capacity >> level;
+}
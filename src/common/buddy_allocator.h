@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace learning_dx12
+{
+	// Power-of-two buddy allocator over a range of offsets. Every block is 
+	// aligned to its own size, so any alignment up to the block size is 
+	// free, as is the 64 KB / 4 MB placement alignment of D3D12 heaps.
+	class buddy_allocator
+	{
+	public:
+		struct buddy_stats
+		{
+			uint64_t capacity;
+			uint64_t allocated;
+			uint64_t requested;
+			uint64_t largest_free_block;
+			uint32_t allocation_count;
+			uint32_t free_block_count;
+			float fragmentation; // 0 = all free space is in one block
+		};
+
+	public:
+		buddy_allocator(uint64_t capacity, uint64_t min_block_size);
+		buddy_allocator() = delete;
+		~buddy_allocator();
+
+		auto allocate(uint64_t size, uint64_t alignment) -> std::optional<uint64_t>;
+		void free(uint64_t offset);
+
+		auto get_stats() const -> buddy_stats;
+		auto is_empty() const -> bool;
+
+	private:
+		auto level_for_size(uint64_t size) const -> uint32_t;
+		auto block_size(uint32_t level) const -> uint64_t;
+
+	private:
+		struct allocation_info
+		{
+			uint32_t level;
+			uint64_t requested;
+		};
+
+		uint64_t capacity{};
+		uint64_t min_block_size{};
+		uint32_t level_count{};
+
+		// level 0 is the whole range, each level after is half the size
+		std::vector<std::set<uint64_t>> free_blocks{};
+		std::unordered_map<uint64_t, allocation_info> allocations{};
+
+		uint64_t allocated{};
+		uint64_t requested{};
+	};
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+
+namespace learning_dx12
+{
+	// D3D12 has no way to query how much memory an allocator is holding on to,
+	// and a reset keeps all of it, so an allocator only ever grows to the
+	// heaviest list recorded with it. Allocators are released rather than reset
+	// once they have been reused max_reuse_count times, so one blown up by a
+	// heavy frame doesn't hold on to that memory for the rest of the session.
+	// backend_type creates and resets the allocators, cmd_queue's goes to the
+	// device, so the pool itself can be driven by a mock one.
+	//   allocator_type
+	//   create_allocator() -> allocator_type
+	//   reset_allocator(allocator_type &)
+	template <typename backend_type>
+	class cmd_allocator_pool
+	{
+	public:
+		using allocator_type = typename backend_type::allocator_type;
+
+		struct allocator_entry
+		{
+			allocator_type allocator;
+			size_t reuse_count;
+		};
+
+		struct pool_stats
+		{
+			size_t created_count;
+			size_t trimmed_count;
+			size_t pooled_count;
+		};
+
+		static constexpr auto default_max_reuse_count = size_t{ 256 };
+		static constexpr auto default_max_idle_count = size_t{ 16 };
+
+	public:
+		cmd_allocator_pool(backend_type &backend);
+		cmd_allocator_pool(backend_type &backend, size_t max_reuse_count, size_t max_idle_count);
+		cmd_allocator_pool() = delete;
+
+		auto acquire(uint64_t completed_fence_value) -> allocator_entry;
+		void release(allocator_entry entry, uint64_t fence_value);
+
+		auto get_stats() const -> pool_stats;
+
+	private:
+		struct tagged_allocator
+		{
+			allocator_entry entry;
+			uint64_t fence_value;
+		};
+
+		auto create_allocator() -> allocator_entry;
+		void trim_idle(uint64_t completed_fence_value);
+
+	private:
+		const size_t max_reuse_count{};
+		const size_t max_idle_count{};
+		backend_type &backend;
+
+		std::deque<tagged_allocator> allocators{};
+		pool_stats stats{};
+	};
+
+	template <typename backend_type>
+	cmd_allocator_pool<backend_type>::cmd_allocator_pool(backend_type &backend_) :
+		cmd_allocator_pool(backend_, default_max_reuse_count, default_max_idle_count)
+	{}
+
+	template <typename backend_type>
+	cmd_allocator_pool<backend_type>::cmd_allocator_pool(backend_type &backend_, size_t max_reuse_count_, size_t max_idle_count_) :
+		max_reuse_count{max_reuse_count_}, max_idle_count{max_idle_count_}, backend{backend_}
+	{}
+
+	// Allocators are queued in submission order, so only the front one
+	// needs checking. If the GPU hasn't passed it yet, none of the others
+	// are free either, and the pool grows instead.
+	template <typename backend_type>
+	auto cmd_allocator_pool<backend_type>::acquire(uint64_t completed_fence_value) -> allocator_entry
+	{
+		trim_idle(completed_fence_value);
+
+		if (allocators.empty()
+		    or allocators.front().fence_value > completed_fence_value)
+		{
+			return create_allocator();
+		}
+
+		auto entry = allocators.front().entry;
+		allocators.pop_front();
+
+		backend.reset_allocator(entry.allocator);
+		entry.reuse_count++;
+
+		return entry;
+	}
+
+	// Has to wait out its fence before it is reset, or released.
+	template <typename backend_type>
+	void cmd_allocator_pool<backend_type>::release(allocator_entry entry, uint64_t fence_value)
+	{
+		allocators.push_back({ entry, fence_value });
+	}
+
+	template <typename backend_type>
+	auto cmd_allocator_pool<backend_type>::get_stats() const -> pool_stats
+	{
+		auto current = stats;
+		current.pooled_count = allocators.size();
+		return current;
+	}
+
+	template <typename backend_type>
+	auto cmd_allocator_pool<backend_type>::create_allocator() -> allocator_entry
+	{
+		auto entry = allocator_entry{ backend.create_allocator(), 0 };
+
+		stats.created_count++;
+
+		return entry;
+	}
+
+	// Completed allocators always form the front of the queue, so both worn
+	// out ones and any idle ones beyond max_idle_count are dropped from there.
+	template <typename backend_type>
+	void cmd_allocator_pool<backend_type>::trim_idle(uint64_t completed_fence_value)
+	{
+		auto is_idle = [&](const tagged_allocator &a)
+		{
+			return a.fence_value <= completed_fence_value;
+		};
+
+		auto idle_end = std::find_if_not(allocators.begin(), allocators.end(), is_idle);
+		auto retired = std::remove_if(allocators.begin(), idle_end, [&](const tagged_allocator &a)
+		{
+			return a.entry.reuse_count >= max_reuse_count;
+		});
+		stats.trimmed_count += std::distance(retired, idle_end);
+		allocators.erase(retired, idle_end);
+
+		auto idle_count = static_cast<size_t>(std::count_if(allocators.begin(), allocators.end(), is_idle));
+		while (idle_count > max_idle_count)
+		{
+			allocators.pop_front();
+			idle_count--;
+			stats.trimmed_count++;
+		}
+	}
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include "cmd_allocator_pool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+namespace learning_dx12
+{
+	// The command lists a queue has open for its next submission, each
+	// checked out under a submit order, and the closed ones kept for reuse.
+	// Lists and their allocators are recycled once the fence value they
+	// were submitted with completes. On top of cmd_allocator_pool's needs,
+	// backend_type provides
+	//   list_type, equality comparable
+	//   recording_type, whatever else is kept per open list
+	//   create_list(allocator_type &) -> list_type
+	//   reset_list(list_type &, allocator_type &)
+	template <typename backend_type>
+	class command_list_pool
+	{
+	public:
+		using allocator_pool = cmd_allocator_pool<backend_type>;
+		using list_type = typename backend_type::list_type;
+		using recording_type = typename backend_type::recording_type;
+
+		struct open_list
+		{
+			list_type list;
+			typename allocator_pool::allocator_entry allocator;
+			uint32_t submit_order;
+			recording_type recording;
+		};
+
+	public:
+		command_list_pool(backend_type &backend);
+		command_list_pool() = delete;
+
+		auto checkout(uint32_t submit_order, uint64_t completed_fence_value) -> open_list &;
+		auto checkout_separate(uint32_t submit_order, uint64_t completed_fence_value) -> open_list &;
+		auto checkout_unlisted(uint64_t completed_fence_value) -> open_list;
+		auto find(const list_type &list) -> open_list &;
+
+		auto get_open_lists() -> std::vector<open_list> &;
+		auto take_submission() -> std::vector<open_list>;
+		void release(std::vector<open_list> &submitted, uint64_t fence_value);
+
+		template <typename function_type>
+		void for_each_list(const function_type &function);
+
+		auto get_allocator_stats() const -> typename allocator_pool::pool_stats;
+
+	private:
+		auto acquire(uint64_t completed_fence_value) -> open_list;
+
+	private:
+		backend_type &backend;
+		allocator_pool allocators;
+
+		std::vector<list_type> free_lists{};
+		std::vector<open_list> open_lists{};
+	};
+
+	template <typename backend_type>
+	command_list_pool<backend_type>::command_list_pool(backend_type &backend_) :
+		backend{backend_}, allocators{backend_}
+	{}
+
+	// Asking for the same order twice before the submission is taken
+	// returns the same list, so recorders agree on it without talking.
+	template <typename backend_type>
+	auto command_list_pool<backend_type>::checkout(uint32_t submit_order, uint64_t completed_fence_value) -> open_list &
+	{
+		auto in_use = std::find_if(open_lists.begin(), open_lists.end(), [&](const open_list &ol)
+		{
+			return ol.submit_order == submit_order;
+		});
+		if (in_use != open_lists.end())
+		{
+			return *in_use;
+		}
+
+		return checkout_separate(submit_order, completed_fence_value);
+	}
+
+	// A list of its own every call, submitted under submit_order after the
+	// ones already checked out with it. For recorders on other threads
+	// that mustn't share a list.
+	template <typename backend_type>
+	auto command_list_pool<backend_type>::checkout_separate(uint32_t submit_order, uint64_t completed_fence_value) -> open_list &
+	{
+		auto &checked_out = open_lists.emplace_back(acquire(completed_fence_value));
+		checked_out.submit_order = submit_order;
+		return checked_out;
+	}
+
+	// Not part of the open lists, the caller hands it back to release
+	// itself. cmd_queue records fix-up barriers into these at submission.
+	template <typename backend_type>
+	auto command_list_pool<backend_type>::checkout_unlisted(uint64_t completed_fence_value) -> open_list
+	{
+		return acquire(completed_fence_value);
+	}
+
+	template <typename backend_type>
+	auto command_list_pool<backend_type>::find(const list_type &list) -> open_list &
+	{
+		auto open = std::find_if(open_lists.begin(), open_lists.end(), [&](const open_list &ol)
+		{
+			return ol.list == list;
+		});
+		assert(open != open_lists.end());
+
+		return *open;
+	}
+
+	template <typename backend_type>
+	auto command_list_pool<backend_type>::get_open_lists() -> std::vector<open_list> &
+	{
+		return open_lists;
+	}
+
+	// Every open list in ascending submit order, lists checked out
+	// under the same order keep the order they were checked out in.
+	template <typename backend_type>
+	auto command_list_pool<backend_type>::take_submission() -> std::vector<open_list>
+	{
+		auto submission = std::move(open_lists);
+		open_lists.clear();
+
+		std::stable_sort(submission.begin(), submission.end(), [](const open_list &a, const open_list &b)
+		{
+			return a.submit_order < b.submit_order;
+		});
+		return submission;
+	}
+
+	// Lists can be reset straight away, their allocators only once
+	// fence_value completes.
+	template <typename backend_type>
+	void command_list_pool<backend_type>::release(std::vector<open_list> &submitted, uint64_t fence_value)
+	{
+		for (auto &submitted_list : submitted)
+		{
+			allocators.release(submitted_list.allocator, fence_value);
+			free_lists.push_back(submitted_list.list);
+		}
+		submitted.clear();
+	}
+
+	template <typename backend_type>
+	template <typename function_type>
+	void command_list_pool<backend_type>::for_each_list(const function_type &function)
+	{
+		for (auto &list : free_lists)
+		{
+			function(list);
+		}
+		for (auto &open : open_lists)
+		{
+			function(open.list);
+		}
+	}
+
+	template <typename backend_type>
+	auto command_list_pool<backend_type>::get_allocator_stats() const -> typename allocator_pool::pool_stats
+	{
+		return allocators.get_stats();
+	}
+
+	template <typename backend_type>
+	auto command_list_pool<backend_type>::acquire(uint64_t completed_fence_value) -> open_list
+	{
+		auto allocator = allocators.acquire(completed_fence_value);
+
+		if (free_lists.empty())
+		{
+			return { backend.create_list(allocator.allocator), allocator, 0, {} };
+		}
+
+		auto list = free_lists.back();
+		free_lists.pop_back();
+		backend.reset_list(list, allocator.allocator);
+
+		return { list, allocator, 0, {} };
+	}
+}
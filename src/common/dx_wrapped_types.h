@@ -23,12 +23,15 @@ namespace learning_dx12
 
 	using dx_descriptor_heap = winrt::com_ptr<ID3D12DescriptorHeap>;
 	using dx_resource = winrt::com_ptr<ID3D12Resource>;
+	using dx_heap = winrt::com_ptr<ID3D12Heap>;
 	using dx_fence = winrt::com_ptr<ID3D12Fence>;
 
 	using dx_blob = winrt::com_ptr<ID3DBlob>;
 
 	using dx_pipeline_state = winrt::com_ptr<ID3D12PipelineState>;
 	using dx_root_signature = winrt::com_ptr<ID3D12RootSignature>;
+	using dx_pipeline_library = winrt::com_ptr<ID3D12PipelineLibrary>;
+	using dx_command_signature = winrt::com_ptr<ID3D12CommandSignature>;
 
 	constexpr auto frame_buffer_count = uint8_t{2};
 }
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "fence_waiter.h"
+
+#include <array>
+#include <algorithm>
+#include <iterator>
+#include <cassert>
+
+using namespace learning_dx12;
+
+fence_waiter::fence_waiter()
+{
+	fence_event = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+	assert(fence_event);
+
+	wake_event = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+	assert(wake_event);
+
+	waiter_thread = std::thread(&fence_waiter::wait_loop, this);
+}
+
+fence_waiter::~fence_waiter()
+{
+	{
+		auto lock = std::lock_guard{ pending_mutex };
+		stop_waiting = true;
+	}
+	::SetEvent(wake_event);
+
+	waiter_thread.join();
+
+	::CloseHandle(wake_event);
+	::CloseHandle(fence_event);
+}
+
+// Every fence signals the same event, the loop then checks all pending 
+// waits, so one thread can multiplex as many fences as needed. A value
+// that is already reached goes through the loop as well, the event is
+// signaled straight away, so callbacks never run on the caller's thread.
+void fence_waiter::when_reached(dx_fence fence, uint64_t value, callback_method callback)
+{
+	{
+		auto lock = std::lock_guard{ pending_mutex };
+		pending_waits.push_back({ fence, value, std::move(callback) });
+	}
+
+	auto hr = fence->SetEventOnCompletion(value, fence_event);
+	assert(SUCCEEDED(hr));
+}
+
+auto fence_waiter::when_reached(dx_fence fence, uint64_t value) -> std::future<void>
+{
+	auto promise = std::make_shared<std::promise<void>>();
+	auto future = promise->get_future();
+
+	when_reached(fence, value, [promise]()
+	{
+		promise->set_value();
+	});
+
+	return future;
+}
+
+auto fence_waiter::pending_count() const -> size_t
+{
+	auto lock = std::lock_guard{ pending_mutex };
+	return pending_waits.size();
+}
+
+void fence_waiter::wait_loop()
+{
+	auto events = std::array{ wake_event, fence_event };
+
+	while (true)
+	{
+		::WaitForMultipleObjects(static_cast<DWORD>(events.size()),
+		                         events.data(),
+		                         FALSE,
+		                         INFINITE);
+
+		for (auto &completed : take_completed())
+		{
+			completed.callback();
+		}
+
+		auto lock = std::lock_guard{ pending_mutex };
+		if (stop_waiting)
+		{
+			break;
+		}
+	}
+}
+
+auto fence_waiter::take_completed() -> std::vector<pending_wait>
+{
+	auto lock = std::lock_guard{ pending_mutex };
+
+	auto not_reached = std::stable_partition(pending_waits.begin(), pending_waits.end(), [](const pending_wait &w)
+	{
+		return w.fence->GetCompletedValue() >= w.value;
+	});
+
+	auto completed = std::vector<pending_wait>{ std::make_move_iterator(pending_waits.begin()),
+	                                            std::make_move_iterator(not_reached) };
+	pending_waits.erase(pending_waits.begin(), not_reached);
+
+	return completed;
+}
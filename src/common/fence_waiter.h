@@ -0,0 +1,54 @@
+#pragma once
+
+#include "dx_wrapped_types.h"
+
+#include <Windows.h>
+
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace learning_dx12
+{
+	// One background thread that services completion requests for any number 
+	// of fences. Callbacks run on that thread, even for values that are already
+	// reached, so they must not record into command lists owned by the main
+	// thread. Waits still pending when the waiter is destroyed are dropped.
+	class fence_waiter
+	{
+	public:
+		using callback_method = std::function<void()>;
+
+	public:
+		fence_waiter();
+		~fence_waiter();
+
+		void when_reached(dx_fence fence, uint64_t value, callback_method callback);
+		auto when_reached(dx_fence fence, uint64_t value) -> std::future<void>;
+
+		auto pending_count() const -> size_t;
+
+	private:
+		struct pending_wait
+		{
+			dx_fence fence;
+			uint64_t value;
+			callback_method callback;
+		};
+
+		void wait_loop();
+		auto take_completed() -> std::vector<pending_wait>;
+
+	private:
+		std::vector<pending_wait> pending_waits{};
+		mutable std::mutex pending_mutex{};
+
+		HANDLE fence_event{};
+		HANDLE wake_event{};
+		bool stop_waiting{ false };
+
+		std::thread waiter_thread{};
+	};
+}
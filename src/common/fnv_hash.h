@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace learning_dx12
+{
+	constexpr auto hash_seed = uint64_t{ 14695981039346656037ull };
+
+	// FNV-1a, stable across runs and builds, so hashes can be stored on disk.
+	// Pass the hash of what came before to carry on hashing in parts.
+	inline auto hash_bytes(const void *data, size_t size, uint64_t hash = hash_seed) -> uint64_t
+	{
+		auto bytes = static_cast<const uint8_t *>(data);
+		for (auto i = size_t{}; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+}
@@ -0,0 +1,83 @@
+#include "free_list_allocator.h"
+
+#include <iterator>
+#include <cassert>
+
+using namespace learning_dx12;
+
+free_list_allocator::free_list_allocator(uint32_t capacity_) :
+	capacity{capacity_}, free_count{capacity_}
+{
+	if (capacity > 0)
+	{
+		free_ranges.emplace(0, capacity);
+	}
+}
+
+free_list_allocator::~free_list_allocator() = default;
+
+auto free_list_allocator::allocate(uint32_t count) -> std::optional<uint32_t>
+{
+	assert(count > 0);
+
+	for (auto range = free_ranges.begin(); range != free_ranges.end(); range++)
+	{
+		auto [start, range_count] = *range;
+		if (range_count < count)
+		{
+			continue;
+		}
+
+		free_ranges.erase(range);
+		if (range_count > count)
+		{
+			free_ranges.emplace(start + count, range_count - count);
+		}
+
+		free_count -= count;
+		return start;
+	}
+
+	return std::nullopt;
+}
+
+void free_list_allocator::free(uint32_t start, uint32_t count)
+{
+	assert(count > 0 and start + count <= capacity);
+
+	free_count += count;
+
+	auto next = free_ranges.lower_bound(start);
+	assert(next == free_ranges.end() or start + count <= next->first);
+
+	if (next != free_ranges.begin())
+	{
+		auto prev = std::prev(next);
+		assert(prev->first + prev->second <= start);
+
+		if (prev->first + prev->second == start)
+		{
+			start = prev->first;
+			count += prev->second;
+			free_ranges.erase(prev);
+		}
+	}
+
+	if (next != free_ranges.end() and start + count == next->first)
+	{
+		count += next->second;
+		free_ranges.erase(next);
+	}
+
+	free_ranges.emplace(start, count);
+}
+
+auto free_list_allocator::get_capacity() const -> uint32_t
+{
+	return capacity;
+}
+
+auto free_list_allocator::get_free_count() const -> uint32_t
+{
+	return free_count;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <optional>
+
+namespace learning_dx12
+{
+	// First-fit allocator over [0, capacity) that hands out contiguous 
+	// ranges and merges neighbouring ranges back together when freed.
+	class free_list_allocator
+	{
+	public:
+		free_list_allocator(uint32_t capacity);
+		free_list_allocator() = delete;
+		~free_list_allocator();
+
+		auto allocate(uint32_t count) -> std::optional<uint32_t>;
+		void free(uint32_t start, uint32_t count);
+
+		auto get_capacity() const -> uint32_t;
+		auto get_free_count() const -> uint32_t;
+
+	private:
+		uint32_t capacity{};
+		uint32_t free_count{};
+		std::map<uint32_t, uint32_t> free_ranges{}; // start -> count
+	};
+}
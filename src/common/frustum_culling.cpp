@@ -0,0 +1,537 @@
+#include "frustum_culling.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define FRUSTUM_CULLING_X64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX_FUNCTION
+#else
+#define AVX_FUNCTION __attribute__((target("avx")))
+#endif // _MSC_VER
+#endif // x64
+
+using namespace learning_dx12;
+
+namespace
+{
+	constexpr auto max_lanes = size_t{ 8 };
+
+	auto round_up_to_lanes(size_t count) -> size_t
+	{
+		return (count + max_lanes - 1) / max_lanes * max_lanes;
+	}
+
+	// Clip space x, y or z against w, signs picking which side of it is inside.
+	auto get_plane(const float (&m)[4][4], int column, float sign, float w_scale) -> frustum_plane
+	{
+		auto plane = frustum_plane{ w_scale * m[0][3] + sign * m[0][column],
+		                            w_scale * m[1][3] + sign * m[1][column],
+		                            w_scale * m[2][3] + sign * m[2][column],
+		                            w_scale * m[3][3] + sign * m[3][column] };
+
+		auto length = std::sqrt(plane.a * plane.a + plane.b * plane.b + plane.c * plane.c);
+		return { plane.a / length, plane.b / length, plane.c / length, plane.d / length };
+	}
+
+	// Every lane is written, visible or not, and only those visible
+	// move the count along, so there is no branch on visibility.
+	auto write_visible(uint32_t *visible, size_t count, size_t first, uint32_t mask, size_t lanes) -> size_t
+	{
+		for (auto lane = size_t{}; lane < lanes; lane++)
+		{
+			visible[count] = static_cast<uint32_t>(first + lane);
+			count += (mask >> lane) & 1;
+		}
+		return count;
+	}
+
+	auto get_lane_mask(size_t remaining, size_t lanes) -> uint32_t
+	{
+		return remaining >= lanes ? (1u << lanes) - 1 : (1u << remaining) - 1;
+	}
+
+	// The SIMD versions add up each distance in this same order, so they round the same.
+	auto get_distance(const frustum_plane &plane, float x, float y, float z) -> float
+	{
+		return ((plane.a * x + plane.b * y) + plane.c * z) + plane.d;
+	}
+
+	auto cull_spheres_scalar(const frustum &planes, const sphere_bounds &bounds, size_t first, size_t last,
+	                         uint32_t *visible) -> size_t
+	{
+		auto count = size_t{};
+		for (auto i = first; i < last; i++)
+		{
+			auto inside = true;
+			for (auto &plane : planes)
+			{
+				inside = inside and get_distance(plane, bounds.x[i], bounds.y[i], bounds.z[i]) >= -bounds.radius[i];
+			}
+			count = write_visible(visible, count, i, inside ? 1 : 0, 1);
+		}
+		return count;
+	}
+
+	auto cull_boxes_scalar(const frustum &planes, const box_bounds &bounds, size_t first, size_t last,
+	                       uint32_t *visible) -> size_t
+	{
+		auto count = size_t{};
+		for (auto i = first; i < last; i++)
+		{
+			auto inside = true;
+			for (auto &plane : planes)
+			{
+				auto distance = get_distance(plane, bounds.x[i], bounds.y[i], bounds.z[i]);
+				auto extent = (std::abs(plane.a) * bounds.extent_x[i] + std::abs(plane.b) * bounds.extent_y[i])
+				            + std::abs(plane.c) * bounds.extent_z[i];
+				inside = inside and distance + extent >= 0.0f;
+			}
+			count = write_visible(visible, count, i, inside ? 1 : 0, 1);
+		}
+		return count;
+	}
+
+#ifdef FRUSTUM_CULLING_X64
+
+	// Plane coefficients broadcast across every lane, once per call.
+	struct sse_planes
+	{
+		__m128 a[6], b[6], c[6], d[6];
+		__m128 abs_a[6], abs_b[6], abs_c[6];
+	};
+
+	struct avx_planes
+	{
+		__m256 a[6], b[6], c[6], d[6];
+		__m256 abs_a[6], abs_b[6], abs_c[6];
+	};
+
+	auto broadcast_sse(const frustum &planes) -> sse_planes
+	{
+		auto wide = sse_planes{};
+		for (auto p = size_t{}; p < planes.size(); p++)
+		{
+			wide.a[p] = _mm_set1_ps(planes[p].a);
+			wide.b[p] = _mm_set1_ps(planes[p].b);
+			wide.c[p] = _mm_set1_ps(planes[p].c);
+			wide.d[p] = _mm_set1_ps(planes[p].d);
+			wide.abs_a[p] = _mm_set1_ps(std::abs(planes[p].a));
+			wide.abs_b[p] = _mm_set1_ps(std::abs(planes[p].b));
+			wide.abs_c[p] = _mm_set1_ps(std::abs(planes[p].c));
+		}
+		return wide;
+	}
+
+	auto get_distance_sse(const sse_planes &wide, size_t p, __m128 x, __m128 y, __m128 z) -> __m128
+	{
+		auto distance = _mm_add_ps(_mm_mul_ps(wide.a[p], x), _mm_mul_ps(wide.b[p], y));
+		distance = _mm_add_ps(distance, _mm_mul_ps(wide.c[p], z));
+		return _mm_add_ps(distance, wide.d[p]);
+	}
+
+	auto cull_spheres_sse(const frustum &planes, const sphere_bounds &bounds, size_t first, size_t last,
+	                      uint32_t *visible) -> size_t
+	{
+		auto wide = broadcast_sse(planes);
+		auto count = size_t{};
+		for (auto i = first; i < last; i += 4)
+		{
+			auto x = _mm_loadu_ps(bounds.x.data() + i);
+			auto y = _mm_loadu_ps(bounds.y.data() + i);
+			auto z = _mm_loadu_ps(bounds.z.data() + i);
+			auto negative_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(bounds.radius.data() + i));
+
+			auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (auto p = size_t{}; p < planes.size(); p++)
+			{
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(get_distance_sse(wide, p, x, y, z), negative_radius));
+			}
+
+			auto mask = static_cast<uint32_t>(_mm_movemask_ps(inside)) & get_lane_mask(last - i, 4);
+			count = mask != 0 ? write_visible(visible, count, i, mask, 4) : count;
+		}
+		return count;
+	}
+
+	auto cull_boxes_sse(const frustum &planes, const box_bounds &bounds, size_t first, size_t last,
+	                    uint32_t *visible) -> size_t
+	{
+		auto wide = broadcast_sse(planes);
+		auto count = size_t{};
+		for (auto i = first; i < last; i += 4)
+		{
+			auto x = _mm_loadu_ps(bounds.x.data() + i);
+			auto y = _mm_loadu_ps(bounds.y.data() + i);
+			auto z = _mm_loadu_ps(bounds.z.data() + i);
+			auto extent_x = _mm_loadu_ps(bounds.extent_x.data() + i);
+			auto extent_y = _mm_loadu_ps(bounds.extent_y.data() + i);
+			auto extent_z = _mm_loadu_ps(bounds.extent_z.data() + i);
+
+			auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (auto p = size_t{}; p < planes.size(); p++)
+			{
+				auto extent = _mm_add_ps(_mm_mul_ps(wide.abs_a[p], extent_x), _mm_mul_ps(wide.abs_b[p], extent_y));
+				extent = _mm_add_ps(extent, _mm_mul_ps(wide.abs_c[p], extent_z));
+				auto distance = _mm_add_ps(get_distance_sse(wide, p, x, y, z), extent);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+			}
+
+			auto mask = static_cast<uint32_t>(_mm_movemask_ps(inside)) & get_lane_mask(last - i, 4);
+			count = mask != 0 ? write_visible(visible, count, i, mask, 4) : count;
+		}
+		return count;
+	}
+
+	AVX_FUNCTION auto broadcast_avx(const frustum &planes) -> avx_planes
+	{
+		auto wide = avx_planes{};
+		for (auto p = size_t{}; p < planes.size(); p++)
+		{
+			wide.a[p] = _mm256_set1_ps(planes[p].a);
+			wide.b[p] = _mm256_set1_ps(planes[p].b);
+			wide.c[p] = _mm256_set1_ps(planes[p].c);
+			wide.d[p] = _mm256_set1_ps(planes[p].d);
+			wide.abs_a[p] = _mm256_set1_ps(std::abs(planes[p].a));
+			wide.abs_b[p] = _mm256_set1_ps(std::abs(planes[p].b));
+			wide.abs_c[p] = _mm256_set1_ps(std::abs(planes[p].c));
+		}
+		return wide;
+	}
+
+	AVX_FUNCTION auto get_distance_avx(const avx_planes &wide, size_t p, __m256 x, __m256 y, __m256 z) -> __m256
+	{
+		auto distance = _mm256_add_ps(_mm256_mul_ps(wide.a[p], x), _mm256_mul_ps(wide.b[p], y));
+		distance = _mm256_add_ps(distance, _mm256_mul_ps(wide.c[p], z));
+		return _mm256_add_ps(distance, wide.d[p]);
+	}
+
+	AVX_FUNCTION auto cull_spheres_avx(const frustum &planes, const sphere_bounds &bounds, size_t first, size_t last,
+	                                   uint32_t *visible) -> size_t
+	{
+		auto wide = broadcast_avx(planes);
+		auto count = size_t{};
+		for (auto i = first; i < last; i += 8)
+		{
+			auto x = _mm256_loadu_ps(bounds.x.data() + i);
+			auto y = _mm256_loadu_ps(bounds.y.data() + i);
+			auto z = _mm256_loadu_ps(bounds.z.data() + i);
+			auto negative_radius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(bounds.radius.data() + i));
+
+			auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (auto p = size_t{}; p < planes.size(); p++)
+			{
+				auto distance = get_distance_avx(wide, p, x, y, z);
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negative_radius, _CMP_GE_OQ));
+			}
+
+			auto mask = static_cast<uint32_t>(_mm256_movemask_ps(inside)) & get_lane_mask(last - i, 8);
+			count = mask != 0 ? write_visible(visible, count, i, mask, 8) : count;
+		}
+		return count;
+	}
+
+	AVX_FUNCTION auto cull_boxes_avx(const frustum &planes, const box_bounds &bounds, size_t first, size_t last,
+	                                 uint32_t *visible) -> size_t
+	{
+		auto wide = broadcast_avx(planes);
+		auto count = size_t{};
+		for (auto i = first; i < last; i += 8)
+		{
+			auto x = _mm256_loadu_ps(bounds.x.data() + i);
+			auto y = _mm256_loadu_ps(bounds.y.data() + i);
+			auto z = _mm256_loadu_ps(bounds.z.data() + i);
+			auto extent_x = _mm256_loadu_ps(bounds.extent_x.data() + i);
+			auto extent_y = _mm256_loadu_ps(bounds.extent_y.data() + i);
+			auto extent_z = _mm256_loadu_ps(bounds.extent_z.data() + i);
+
+			auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (auto p = size_t{}; p < planes.size(); p++)
+			{
+				auto extent = _mm256_add_ps(_mm256_mul_ps(wide.abs_a[p], extent_x), _mm256_mul_ps(wide.abs_b[p], extent_y));
+				extent = _mm256_add_ps(extent, _mm256_mul_ps(wide.abs_c[p], extent_z));
+				auto distance = _mm256_add_ps(get_distance_avx(wide, p, x, y, z), extent);
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+			}
+
+			auto mask = static_cast<uint32_t>(_mm256_movemask_ps(inside)) & get_lane_mask(last - i, 8);
+			count = mask != 0 ? write_visible(visible, count, i, mask, 8) : count;
+		}
+		return count;
+	}
+
+	// AVX needs the OS to save the wider registers too, not just the CPU to have them.
+	auto has_avx() -> bool
+	{
+#ifdef _MSC_VER
+		auto info = std::array<int, 4>{};
+		__cpuid(info.data(), 1);
+		auto osxsave = (info[2] & (1 << 27)) != 0;
+		auto avx = (info[2] & (1 << 28)) != 0;
+		return osxsave and avx and (_xgetbv(0) & 6) == 6;
+#else
+		return __builtin_cpu_supports("avx");
+#endif // _MSC_VER
+	}
+
+#endif // FRUSTUM_CULLING_X64
+
+	auto get_default_thread_count() -> uint32_t
+	{
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+}
+
+auto learning_dx12::extract_frustum_planes(const float (&view_projection)[4][4]) -> frustum
+{
+	return {
+		get_plane(view_projection, 0, +1.0f, 1.0f), // left,   w + x >= 0
+		get_plane(view_projection, 0, -1.0f, 1.0f), // right,  w - x >= 0
+		get_plane(view_projection, 1, +1.0f, 1.0f), // bottom, w + y >= 0
+		get_plane(view_projection, 1, -1.0f, 1.0f), // top,    w - y >= 0
+		get_plane(view_projection, 2, +1.0f, 0.0f), // near,   z >= 0
+		get_plane(view_projection, 2, -1.0f, 1.0f), // far,    w - z >= 0
+	};
+}
+
+void sphere_bounds::resize(size_t count_)
+{
+	count = count_;
+	auto padded = round_up_to_lanes(count);
+	for (auto component : { &x, &y, &z, &radius })
+	{
+		component->resize(padded);
+	}
+}
+
+void sphere_bounds::set(size_t index, float x_, float y_, float z_, float radius_)
+{
+	assert(index < count);
+	x[index] = x_;
+	y[index] = y_;
+	z[index] = z_;
+	radius[index] = radius_;
+}
+
+auto sphere_bounds::size() const -> size_t
+{
+	return count;
+}
+
+void box_bounds::resize(size_t count_)
+{
+	count = count_;
+	auto padded = round_up_to_lanes(count);
+	for (auto component : { &x, &y, &z, &extent_x, &extent_y, &extent_z })
+	{
+		component->resize(padded);
+	}
+}
+
+void box_bounds::set(size_t index, float x_, float y_, float z_, float extent_x_, float extent_y_, float extent_z_)
+{
+	assert(index < count);
+	x[index] = x_;
+	y[index] = y_;
+	z[index] = z_;
+	extent_x[index] = extent_x_;
+	extent_y[index] = extent_y_;
+	extent_z[index] = extent_z_;
+}
+
+auto box_bounds::size() const -> size_t
+{
+	return count;
+}
+
+auto learning_dx12::get_cull_instruction_set() -> cull_instruction_set
+{
+#ifdef FRUSTUM_CULLING_X64
+	static const auto instructions = has_avx() ? cull_instruction_set::avx : cull_instruction_set::sse;
+	return instructions;
+#else
+	return cull_instruction_set::scalar;
+#endif // FRUSTUM_CULLING_X64
+}
+
+// Ranges start on a multiple of 8, so a full set of lanes can always be read.
+auto learning_dx12::cull_spheres(const frustum &planes, const sphere_bounds &bounds, size_t first, size_t last,
+                                 uint32_t *visible, cull_instruction_set instructions) -> size_t
+{
+	assert(first % max_lanes == 0 and last <= bounds.size());
+	switch (instructions)
+	{
+#ifdef FRUSTUM_CULLING_X64
+	case cull_instruction_set::avx:
+		return cull_spheres_avx(planes, bounds, first, last, visible);
+	case cull_instruction_set::sse:
+		return cull_spheres_sse(planes, bounds, first, last, visible);
+#endif // FRUSTUM_CULLING_X64
+	default:
+		return cull_spheres_scalar(planes, bounds, first, last, visible);
+	}
+}
+
+auto learning_dx12::cull_boxes(const frustum &planes, const box_bounds &bounds, size_t first, size_t last,
+                               uint32_t *visible, cull_instruction_set instructions) -> size_t
+{
+	assert(first % max_lanes == 0 and last <= bounds.size());
+	switch (instructions)
+	{
+#ifdef FRUSTUM_CULLING_X64
+	case cull_instruction_set::avx:
+		return cull_boxes_avx(planes, bounds, first, last, visible);
+	case cull_instruction_set::sse:
+		return cull_boxes_sse(planes, bounds, first, last, visible);
+#endif // FRUSTUM_CULLING_X64
+	default:
+		return cull_boxes_scalar(planes, bounds, first, last, visible);
+	}
+}
+
+frustum_culler::frustum_culler() :
+	frustum_culler(get_default_thread_count())
+{}
+
+// The calling thread culls a range too, so one fewer worker is started.
+frustum_culler::frustum_culler(uint32_t thread_count)
+{
+	thread_count = std::max(thread_count, 1u);
+	range_visible.resize(thread_count);
+	range_counts.resize(thread_count);
+
+	for (auto worker = uint32_t{}; worker + 1 < thread_count; worker++)
+	{
+		workers.emplace_back(&frustum_culler::work_loop, this, worker);
+	}
+}
+
+frustum_culler::~frustum_culler()
+{
+	{
+		auto lock = std::lock_guard{ work_mutex };
+		stop_working = true;
+	}
+	work_ready.notify_all();
+
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void frustum_culler::cull(const frustum &planes, const sphere_bounds &bounds, std::vector<uint32_t> &visible)
+{
+	run(bounds.size(), [&](size_t first, size_t last, uint32_t *range_visible)
+	{
+		return cull_spheres(planes, bounds, first, last, range_visible);
+	}, visible);
+}
+
+void frustum_culler::cull(const frustum &planes, const box_bounds &bounds, std::vector<uint32_t> &visible)
+{
+	run(bounds.size(), [&](size_t first, size_t last, uint32_t *range_visible)
+	{
+		return cull_boxes(planes, bounds, first, last, range_visible);
+	}, visible);
+}
+
+auto frustum_culler::get_thread_count() const -> uint32_t
+{
+	return static_cast<uint32_t>(workers.size() + 1);
+}
+
+// Workers take the first ranges, the calling thread the last,
+// and no thread is woken for fewer bounds than it's worth.
+void frustum_culler::run(size_t count, const cull_range &cull_range, std::vector<uint32_t> &visible)
+{
+	auto ranges = std::clamp((count + min_bounds_per_thread - 1) / min_bounds_per_thread,
+	                         size_t{ 1 },
+	                         size_t{ get_thread_count() });
+	auto size = round_up_to_lanes((count + ranges - 1) / ranges);
+
+	for (auto range = size_t{}; range < ranges; range++)
+	{
+		if (range_visible[range].size() < size + max_lanes)
+		{
+			range_visible[range].resize(size + max_lanes);
+		}
+	}
+
+	if (ranges > 1)
+	{
+		{
+			auto lock = std::lock_guard{ work_mutex };
+			work = &cull_range;
+			work_count = count;
+			range_size = size;
+			worker_ranges = static_cast<uint32_t>(ranges - 1);
+			pending = worker_ranges;
+			generation++;
+		}
+		work_ready.notify_all();
+	}
+
+	auto last_range = ranges - 1;
+	auto first = std::min(count, last_range * size);
+	range_counts[last_range] = cull_range(first, count, range_visible[last_range].data());
+
+	if (ranges > 1)
+	{
+		auto lock = std::unique_lock{ work_mutex };
+		work_done.wait(lock, [this] { return pending == 0; });
+		work = nullptr;
+	}
+
+	auto total = size_t{};
+	for (auto range = size_t{}; range < ranges; range++)
+	{
+		total += range_counts[range];
+	}
+
+	visible.resize(total);
+	auto offset = size_t{};
+	for (auto range = size_t{}; range < ranges; range++)
+	{
+		std::memcpy(visible.data() + offset, range_visible[range].data(), range_counts[range] * sizeof(uint32_t));
+		offset += range_counts[range];
+	}
+}
+
+void frustum_culler::work_loop(uint32_t worker)
+{
+	auto seen = uint64_t{};
+	while (true)
+	{
+		auto lock = std::unique_lock{ work_mutex };
+		work_ready.wait(lock, [&] { return stop_working or generation != seen; });
+		if (stop_working)
+		{
+			return;
+		}
+
+		seen = generation;
+		if (worker >= worker_ranges)
+		{
+			continue;
+		}
+
+		auto &cull_range = *work;
+		auto first = std::min(work_count, worker * range_size);
+		auto last = std::min(work_count, first + range_size);
+		lock.unlock();
+
+		range_counts[worker] = cull_range(first, last, range_visible[worker].data());
+
+		lock.lock();
+		if (--pending == 0)
+		{
+			work_done.notify_one();
+		}
+	}
+}
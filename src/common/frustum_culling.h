@@ -0,0 +1,121 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace learning_dx12
+{
+	// ax + by + cz + d, positive inside, with a unit normal so it is a distance.
+	struct frustum_plane
+	{
+		float a, b, c, d;
+	};
+
+	// Left, right, bottom, top, near, far.
+	using frustum = std::array<frustum_plane, 6>;
+
+	// From a row major view-projection matrix, for row vectors and
+	// a [0, 1] clip depth, as DirectXMath builds them.
+	auto extract_frustum_planes(const float (&view_projection)[4][4]) -> frustum;
+
+	// Bounds are stored one array per component, so planes are tested
+	// against 4 or 8 of them at once. Arrays are padded to a multiple of
+	// 8, lanes past the end are read but never reported visible.
+	class sphere_bounds
+	{
+	public:
+		void resize(size_t count);
+		void set(size_t index, float x, float y, float z, float radius);
+		auto size() const -> size_t;
+
+	public:
+		std::vector<float> x{}, y{}, z{}, radius{};
+
+	private:
+		size_t count{};
+	};
+
+	class box_bounds
+	{
+	public:
+		void resize(size_t count);
+		void set(size_t index, float x, float y, float z, float extent_x, float extent_y, float extent_z);
+		auto size() const -> size_t;
+
+	public:
+		std::vector<float> x{}, y{}, z{};                      // centre
+		std::vector<float> extent_x{}, extent_y{}, extent_z{}; // half size
+
+	private:
+		size_t count{};
+	};
+
+	enum class cull_instruction_set : uint8_t
+	{
+		scalar,
+		sse, // 4 bounds at a time
+		avx, // 8 bounds at a time
+	};
+
+	// The widest the running CPU supports.
+	auto get_cull_instruction_set() -> cull_instruction_set;
+
+	// Writes the index of every visible bound in [first, last) to visible, in order,
+	// and returns how many. visible needs room for 8 more than last - first,
+	// lanes that aren't visible are written past the count and overwritten.
+	// The scalar set is the reference the others match exactly.
+	auto cull_spheres(const frustum &planes, const sphere_bounds &bounds, size_t first, size_t last,
+	                  uint32_t *visible, cull_instruction_set instructions = get_cull_instruction_set()) -> size_t;
+	auto cull_boxes(const frustum &planes, const box_bounds &bounds, size_t first, size_t last,
+	                uint32_t *visible, cull_instruction_set instructions = get_cull_instruction_set()) -> size_t;
+
+	// Splits culling across worker threads and the calling one, each
+	// compacting its own range, then joins the ranges into one list.
+	// Few bounds are culled on the calling thread alone.
+	class frustum_culler
+	{
+	public:
+		static constexpr auto min_bounds_per_thread = size_t{ 16 * 1024 };
+
+	public:
+		frustum_culler();
+		frustum_culler(uint32_t thread_count);
+		frustum_culler(const frustum_culler &) = delete;
+		auto operator=(const frustum_culler &) -> frustum_culler & = delete;
+		~frustum_culler();
+
+		void cull(const frustum &planes, const sphere_bounds &bounds, std::vector<uint32_t> &visible);
+		void cull(const frustum &planes, const box_bounds &bounds, std::vector<uint32_t> &visible);
+
+		auto get_thread_count() const -> uint32_t;
+
+	private:
+		using cull_range = std::function<size_t(size_t first, size_t last, uint32_t *visible)>;
+
+		void run(size_t count, const cull_range &cull_range, std::vector<uint32_t> &visible);
+		void work_loop(uint32_t worker);
+
+	private:
+		std::vector<std::vector<uint32_t>> range_visible{}; // per range, the calling thread's last
+		std::vector<size_t> range_counts{};
+
+		std::mutex work_mutex{};
+		std::condition_variable work_ready{};
+		std::condition_variable work_done{};
+		const cull_range *work{};
+		size_t work_count{};
+		size_t range_size{};
+		uint64_t generation{};
+		uint32_t worker_ranges{}; // workers given a range this time
+		uint32_t pending{};
+		bool stop_working{ false };
+
+		std::vector<std::thread> workers{};
+	};
+}
@@ -0,0 +1,114 @@
+#include "indirect_draw.h"
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+
+using namespace learning_dx12;
+
+namespace
+{
+	// Command signatures pack their arguments back to back.
+	static_assert(offsetof(indirect_draw_command, vertex_buffer) == 0);
+	static_assert(offsetof(indirect_draw_command, index_buffer) == sizeof(D3D12_VERTEX_BUFFER_VIEW));
+	static_assert(offsetof(indirect_draw_command, first_instance) == offsetof(indirect_draw_command, index_buffer) + sizeof(D3D12_INDEX_BUFFER_VIEW));
+	static_assert(offsetof(indirect_draw_command, draw) == offsetof(indirect_draw_command, first_instance) + sizeof(uint32_t));
+	static_assert(sizeof(indirect_draw_command) == offsetof(indirect_draw_command, draw) + sizeof(D3D12_DRAW_INDEXED_ARGUMENTS));
+
+	auto is_drawn(const indirect_draw_command &command) -> bool
+	{
+		return command.draw.IndexCountPerInstance > 0 and command.draw.InstanceCount > 0;
+	}
+}
+
+auto learning_dx12::create_draw_command_signature(dx_device device, dx_root_signature root_signature,
+                                                  uint32_t first_instance_root_index) -> dx_command_signature
+{
+	auto arguments = std::array<D3D12_INDIRECT_ARGUMENT_DESC, 4>{};
+	arguments[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW;
+	arguments[0].VertexBuffer.Slot = 0;
+	arguments[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW;
+	arguments[2].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+	arguments[2].Constant.RootParameterIndex = first_instance_root_index;
+	arguments[2].Constant.DestOffsetIn32BitValues = 0;
+	arguments[2].Constant.Num32BitValuesToSet = 1;
+	arguments[3].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+	auto desc = D3D12_COMMAND_SIGNATURE_DESC{};
+	desc.ByteStride = sizeof(indirect_draw_command);
+	desc.NumArgumentDescs = static_cast<uint32_t>(arguments.size());
+	desc.pArgumentDescs = arguments.data();
+
+	auto signature = dx_command_signature{};
+	auto hr = device->CreateCommandSignature(&desc,
+	                                         root_signature.get(),
+	                                         __uuidof(ID3D12CommandSignature),
+	                                         signature.put_void());
+	assert(SUCCEEDED(hr));
+
+	return signature;
+}
+
+auto learning_dx12::build_indirect_commands(const std::vector<indirect_mesh> &meshes,
+                                            const std::vector<indirect_draw_item> &items) -> std::vector<indirect_draw_command>
+{
+	auto commands = std::vector<indirect_draw_command>{};
+	commands.reserve(items.size());
+	for (auto &item : items)
+	{
+		assert(item.mesh < meshes.size());
+		auto &mesh = meshes[item.mesh];
+
+		auto command = indirect_draw_command{};
+		command.vertex_buffer = mesh.vertex_buffer;
+		command.index_buffer = mesh.index_buffer;
+		command.first_instance = item.first_instance;
+		command.draw.IndexCountPerInstance = mesh.index_count;
+		command.draw.InstanceCount = item.instance_count;
+		command.draw.StartIndexLocation = 0;
+		command.draw.BaseVertexLocation = 0;
+		command.draw.StartInstanceLocation = item.first_instance; // only offsets per-instance vertex streams
+		commands.push_back(command);
+	}
+	return commands;
+}
+
+auto learning_dx12::compact_indirect_commands(const std::vector<indirect_draw_command> &commands,
+                                              const std::vector<uint8_t> &visible) -> std::vector<indirect_draw_command>
+{
+	assert(visible.size() == commands.size());
+
+	auto offsets = std::vector<uint32_t>(commands.size());
+	auto count = uint32_t{};
+	for (auto i = size_t{}; i < commands.size(); i++)
+	{
+		offsets[i] = count;
+		count += (visible[i] != 0 and is_drawn(commands[i])) ? 1 : 0;
+	}
+
+	auto compacted = std::vector<indirect_draw_command>(count);
+	for (auto i = size_t{}; i < commands.size(); i++)
+	{
+		if (visible[i] != 0 and is_drawn(commands[i]))
+		{
+			compacted[offsets[i]] = commands[i];
+		}
+	}
+	return compacted;
+}
+
+auto learning_dx12::pack_indirect_instances(std::vector<indirect_draw_command> &commands) -> std::vector<instance_run>
+{
+	auto runs = std::vector<instance_run>{};
+	runs.reserve(commands.size());
+
+	auto packed_count = uint32_t{};
+	for (auto &command : commands)
+	{
+		runs.push_back({ command.first_instance, command.draw.InstanceCount });
+		command.first_instance = packed_count;
+		command.draw.StartInstanceLocation = packed_count;
+		packed_count += command.draw.InstanceCount;
+	}
+	return runs;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "dx_wrapped_types.h"
+
+#include <d3d12.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace learning_dx12
+{
+	// One draw of an ExecuteIndirect argument buffer, in the order the
+	// draw command signature reads its arguments. Each lands on its natural
+	// alignment with nothing in between, so this is exactly what the GPU reads.
+	struct indirect_draw_command
+	{
+		D3D12_VERTEX_BUFFER_VIEW vertex_buffer;
+		D3D12_INDEX_BUFFER_VIEW index_buffer;
+		uint32_t first_instance; // root constant, SV_InstanceID starts from 0 in every draw
+		D3D12_DRAW_INDEXED_ARGUMENTS draw;
+	};
+
+	struct indirect_mesh
+	{
+		D3D12_VERTEX_BUFFER_VIEW vertex_buffer;
+		D3D12_INDEX_BUFFER_VIEW index_buffer;
+		uint32_t index_count;
+	};
+
+	// What the scene wants drawn, a run of instances of one mesh.
+	struct indirect_draw_item
+	{
+		uint32_t mesh;
+		uint32_t first_instance;
+		uint32_t instance_count;
+	};
+
+	// Instances the scene holds for one command, first_instance on.
+	struct instance_run
+	{
+		uint32_t first_instance;
+		uint32_t instance_count;
+	};
+
+	// Sets the vertex and index buffers and one root constant, the
+	// first instance, at first_instance_root_index before every draw.
+	auto create_draw_command_signature(dx_device device, dx_root_signature root_signature,
+	                                   uint32_t first_instance_root_index) -> dx_command_signature;
+
+	// One command per item, in the same order. The CPU reference for
+	// what a GPU pass filling the argument buffer has to produce.
+	auto build_indirect_commands(const std::vector<indirect_mesh> &meshes,
+	                             const std::vector<indirect_draw_item> &items) -> std::vector<indirect_draw_command>;
+
+	// Drops commands that aren't visible or have nothing to draw, keeping
+	// the order of the rest. Each is written at the exclusive prefix sum of
+	// those kept before it, as a compaction pass on the GPU would, and the
+	// total is the draw count ExecuteIndirect reads from its count buffer.
+	auto compact_indirect_commands(const std::vector<indirect_draw_command> &commands,
+	                               const std::vector<uint8_t> &visible) -> std::vector<indirect_draw_command>;
+
+	// Packs the instances of commands back to back, in command order. Each
+	// command's first instance becomes the count packed before it, and the
+	// runs to copy from the scene's instances are returned in that order.
+	auto pack_indirect_instances(std::vector<indirect_draw_command> &commands) -> std::vector<instance_run>;
+}
@@ -0,0 +1,118 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+using namespace learning_dx12;
+
+#ifdef _WIN32
+
+// An empty file can't be mapped, it stays closed.
+mapped_file::mapped_file(const std::filesystem::path &file_path)
+{
+	file_handle = ::CreateFileW(file_path.c_str(),
+	                            GENERIC_READ,
+	                            FILE_SHARE_READ,
+	                            nullptr,
+	                            OPEN_EXISTING,
+	                            FILE_ATTRIBUTE_NORMAL,
+	                            nullptr);
+	if (file_handle == INVALID_HANDLE_VALUE)
+	{
+		file_handle = nullptr;
+		return;
+	}
+
+	auto file_size = LARGE_INTEGER{};
+	if (not ::GetFileSizeEx(file_handle, &file_size) or file_size.QuadPart == 0)
+	{
+		return;
+	}
+
+	mapping_handle = ::CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (not mapping_handle)
+	{
+		return;
+	}
+
+	view = static_cast<const uint8_t *>(::MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+	view_size = view ? static_cast<size_t>(file_size.QuadPart) : 0;
+}
+
+mapped_file::~mapped_file()
+{
+	if (view)
+	{
+		::UnmapViewOfFile(view);
+	}
+	if (mapping_handle)
+	{
+		::CloseHandle(mapping_handle);
+	}
+	if (file_handle)
+	{
+		::CloseHandle(file_handle);
+	}
+}
+
+#else
+
+// An empty file can't be mapped, it stays closed.
+mapped_file::mapped_file(const std::filesystem::path &file_path)
+{
+	file_descriptor = ::open(file_path.c_str(), O_RDONLY);
+	if (file_descriptor < 0)
+	{
+		return;
+	}
+
+	struct stat file_stat{};
+	if (::fstat(file_descriptor, &file_stat) != 0 or file_stat.st_size == 0)
+	{
+		return;
+	}
+
+	auto mapped = ::mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+	if (mapped == MAP_FAILED)
+	{
+		return;
+	}
+
+	view = static_cast<const uint8_t *>(mapped);
+	view_size = static_cast<size_t>(file_stat.st_size);
+}
+
+mapped_file::~mapped_file()
+{
+	if (view)
+	{
+		::munmap(const_cast<uint8_t *>(view), view_size);
+	}
+	if (file_descriptor >= 0)
+	{
+		::close(file_descriptor);
+	}
+}
+
+#endif // _WIN32
+
+auto mapped_file::is_open() const -> bool
+{
+	return view != nullptr;
+}
+
+auto mapped_file::data() const -> const uint8_t *
+{
+	return view;
+}
+
+auto mapped_file::size() const -> size_t
+{
+	return view_size;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace learning_dx12
+{
+	// A whole file mapped read-only into memory, for as long as this lives.
+	// Pages are read in by the OS as they are touched, nothing is copied.
+	class mapped_file
+	{
+	public:
+		mapped_file(const std::filesystem::path &file_path);
+		mapped_file() = delete;
+		mapped_file(const mapped_file &) = delete;
+		auto operator=(const mapped_file &) -> mapped_file & = delete;
+		~mapped_file();
+
+		auto is_open() const -> bool;
+		auto data() const -> const uint8_t *;
+		auto size() const -> size_t;
+
+	private:
+		const uint8_t *view{};
+		size_t view_size{};
+
+#ifdef _WIN32
+		void *file_handle{};
+		void *mapping_handle{};
+#else
+		int file_descriptor{ -1 };
+#endif // _WIN32
+	};
+}
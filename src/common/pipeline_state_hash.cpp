@@ -0,0 +1,293 @@
+#include "pipeline_state_hash.h"
+
+#include <cstring>
+#include <type_traits>
+
+using namespace learning_dx12;
+
+namespace
+{
+	// Only for scalars, structs are hashed field by field so padding never counts.
+	template <typename T>
+	auto hash_value(uint64_t hash, T value) -> uint64_t
+	{
+		static_assert(std::is_scalar_v<T>);
+		return hash_bytes(&value, sizeof(T), hash);
+	}
+
+	auto hash_string(uint64_t hash, const char *text) -> uint64_t
+	{
+		auto length = text ? std::strlen(text) : size_t{};
+		hash = hash_value(hash, length);
+		return hash_bytes(text, length, hash);
+	}
+
+	auto hash_shader(uint64_t hash, const D3D12_SHADER_BYTECODE &shader) -> uint64_t
+	{
+		auto size = shader.pShaderBytecode ? shader.BytecodeLength : size_t{};
+		hash = hash_value(hash, size);
+		return hash_bytes(shader.pShaderBytecode, size, hash);
+	}
+
+	auto hash_input_layout(uint64_t hash, const D3D12_INPUT_LAYOUT_DESC &layout) -> uint64_t
+	{
+		hash = hash_value(hash, layout.NumElements);
+		for (auto i = 0u; i < layout.NumElements; i++)
+		{
+			auto &element = layout.pInputElementDescs[i];
+			hash = hash_string(hash, element.SemanticName);
+			hash = hash_value(hash, element.SemanticIndex);
+			hash = hash_value(hash, element.Format);
+			hash = hash_value(hash, element.InputSlot);
+			hash = hash_value(hash, element.AlignedByteOffset);
+			hash = hash_value(hash, element.InputSlotClass);
+			hash = hash_value(hash, element.InstanceDataStepRate);
+		}
+		return hash;
+	}
+
+	auto hash_stream_output(uint64_t hash, const D3D12_STREAM_OUTPUT_DESC &stream_output) -> uint64_t
+	{
+		hash = hash_value(hash, stream_output.NumEntries);
+		for (auto i = 0u; i < stream_output.NumEntries; i++)
+		{
+			auto &entry = stream_output.pSODeclaration[i];
+			hash = hash_value(hash, entry.Stream);
+			hash = hash_string(hash, entry.SemanticName);
+			hash = hash_value(hash, entry.SemanticIndex);
+			hash = hash_value(hash, entry.StartComponent);
+			hash = hash_value(hash, entry.ComponentCount);
+			hash = hash_value(hash, entry.OutputSlot);
+		}
+
+		hash = hash_value(hash, stream_output.NumStrides);
+		for (auto i = 0u; i < stream_output.NumStrides; i++)
+		{
+			hash = hash_value(hash, stream_output.pBufferStrides[i]);
+		}
+
+		return hash_value(hash, stream_output.RasterizedStream);
+	}
+
+	auto hash_blend_state(uint64_t hash, const D3D12_BLEND_DESC &blend) -> uint64_t
+	{
+		hash = hash_value(hash, blend.AlphaToCoverageEnable);
+		hash = hash_value(hash, blend.IndependentBlendEnable);
+		for (auto &target : blend.RenderTarget)
+		{
+			hash = hash_value(hash, target.BlendEnable);
+			hash = hash_value(hash, target.LogicOpEnable);
+			hash = hash_value(hash, target.SrcBlend);
+			hash = hash_value(hash, target.DestBlend);
+			hash = hash_value(hash, target.BlendOp);
+			hash = hash_value(hash, target.SrcBlendAlpha);
+			hash = hash_value(hash, target.DestBlendAlpha);
+			hash = hash_value(hash, target.BlendOpAlpha);
+			hash = hash_value(hash, target.LogicOp);
+			hash = hash_value(hash, target.RenderTargetWriteMask);
+		}
+		return hash;
+	}
+
+	auto hash_rasterizer_state(uint64_t hash, const D3D12_RASTERIZER_DESC &rasterizer) -> uint64_t
+	{
+		hash = hash_value(hash, rasterizer.FillMode);
+		hash = hash_value(hash, rasterizer.CullMode);
+		hash = hash_value(hash, rasterizer.FrontCounterClockwise);
+		hash = hash_value(hash, rasterizer.DepthBias);
+		hash = hash_value(hash, rasterizer.DepthBiasClamp);
+		hash = hash_value(hash, rasterizer.SlopeScaledDepthBias);
+		hash = hash_value(hash, rasterizer.DepthClipEnable);
+		hash = hash_value(hash, rasterizer.MultisampleEnable);
+		hash = hash_value(hash, rasterizer.AntialiasedLineEnable);
+		hash = hash_value(hash, rasterizer.ForcedSampleCount);
+		return hash_value(hash, rasterizer.ConservativeRaster);
+	}
+
+	auto hash_stencil_op(uint64_t hash, const D3D12_DEPTH_STENCILOP_DESC &op) -> uint64_t
+	{
+		hash = hash_value(hash, op.StencilFailOp);
+		hash = hash_value(hash, op.StencilDepthFailOp);
+		hash = hash_value(hash, op.StencilPassOp);
+		return hash_value(hash, op.StencilFunc);
+	}
+
+	auto hash_depth_stencil_state(uint64_t hash, const D3D12_DEPTH_STENCIL_DESC &depth_stencil) -> uint64_t
+	{
+		hash = hash_value(hash, depth_stencil.DepthEnable);
+		hash = hash_value(hash, depth_stencil.DepthWriteMask);
+		hash = hash_value(hash, depth_stencil.DepthFunc);
+		hash = hash_value(hash, depth_stencil.StencilEnable);
+		hash = hash_value(hash, depth_stencil.StencilReadMask);
+		hash = hash_value(hash, depth_stencil.StencilWriteMask);
+		hash = hash_stencil_op(hash, depth_stencil.FrontFace);
+		return hash_stencil_op(hash, depth_stencil.BackFace);
+	}
+
+	auto hash_descriptor_range(uint64_t hash, const D3D12_DESCRIPTOR_RANGE &range) -> uint64_t
+	{
+		hash = hash_value(hash, range.RangeType);
+		hash = hash_value(hash, range.NumDescriptors);
+		hash = hash_value(hash, range.BaseShaderRegister);
+		hash = hash_value(hash, range.RegisterSpace);
+		return hash_value(hash, range.OffsetInDescriptorsFromTableStart);
+	}
+
+	auto hash_descriptor_range(uint64_t hash, const D3D12_DESCRIPTOR_RANGE1 &range) -> uint64_t
+	{
+		hash = hash_value(hash, range.RangeType);
+		hash = hash_value(hash, range.NumDescriptors);
+		hash = hash_value(hash, range.BaseShaderRegister);
+		hash = hash_value(hash, range.RegisterSpace);
+		hash = hash_value(hash, range.Flags);
+		return hash_value(hash, range.OffsetInDescriptorsFromTableStart);
+	}
+
+	auto hash_root_descriptor(uint64_t hash, const D3D12_ROOT_DESCRIPTOR &descriptor) -> uint64_t
+	{
+		hash = hash_value(hash, descriptor.ShaderRegister);
+		return hash_value(hash, descriptor.RegisterSpace);
+	}
+
+	auto hash_root_descriptor(uint64_t hash, const D3D12_ROOT_DESCRIPTOR1 &descriptor) -> uint64_t
+	{
+		hash = hash_value(hash, descriptor.ShaderRegister);
+		hash = hash_value(hash, descriptor.RegisterSpace);
+		return hash_value(hash, descriptor.Flags);
+	}
+
+	// Only the member of the union the parameter type selects is hashed.
+	template <typename root_parameter>
+	auto hash_root_parameter(uint64_t hash, const root_parameter &parameter) -> uint64_t
+	{
+		hash = hash_value(hash, parameter.ParameterType);
+		hash = hash_value(hash, parameter.ShaderVisibility);
+
+		switch (parameter.ParameterType)
+		{
+			case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+			{
+				auto &table = parameter.DescriptorTable;
+				hash = hash_value(hash, table.NumDescriptorRanges);
+				for (auto i = 0u; i < table.NumDescriptorRanges; i++)
+				{
+					hash = hash_descriptor_range(hash, table.pDescriptorRanges[i]);
+				}
+				return hash;
+			}
+			case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+				hash = hash_value(hash, parameter.Constants.ShaderRegister);
+				hash = hash_value(hash, parameter.Constants.RegisterSpace);
+				return hash_value(hash, parameter.Constants.Num32BitValues);
+			default:
+				return hash_root_descriptor(hash, parameter.Descriptor);
+		}
+	}
+
+	auto hash_static_sampler(uint64_t hash, const D3D12_STATIC_SAMPLER_DESC &sampler) -> uint64_t
+	{
+		hash = hash_value(hash, sampler.Filter);
+		hash = hash_value(hash, sampler.AddressU);
+		hash = hash_value(hash, sampler.AddressV);
+		hash = hash_value(hash, sampler.AddressW);
+		hash = hash_value(hash, sampler.MipLODBias);
+		hash = hash_value(hash, sampler.MaxAnisotropy);
+		hash = hash_value(hash, sampler.ComparisonFunc);
+		hash = hash_value(hash, sampler.BorderColor);
+		hash = hash_value(hash, sampler.MinLOD);
+		hash = hash_value(hash, sampler.MaxLOD);
+		hash = hash_value(hash, sampler.ShaderRegister);
+		hash = hash_value(hash, sampler.RegisterSpace);
+		return hash_value(hash, sampler.ShaderVisibility);
+	}
+
+	// D3D12_ROOT_SIGNATURE_DESC and D3D12_ROOT_SIGNATURE_DESC1 only differ in their parameters.
+	template <typename root_signature_desc>
+	auto hash_root_signature(uint64_t hash, const root_signature_desc &desc) -> uint64_t
+	{
+		hash = hash_value(hash, desc.NumParameters);
+		for (auto i = 0u; i < desc.NumParameters; i++)
+		{
+			hash = hash_root_parameter(hash, desc.pParameters[i]);
+		}
+
+		hash = hash_value(hash, desc.NumStaticSamplers);
+		for (auto i = 0u; i < desc.NumStaticSamplers; i++)
+		{
+			hash = hash_static_sampler(hash, desc.pStaticSamplers[i]);
+		}
+
+		return hash_value(hash, desc.Flags);
+	}
+}
+
+auto learning_dx12::hash_pipeline_desc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC &desc, uint64_t root_signature_hash) -> uint64_t
+{
+	auto hash = hash_value(hash_seed, root_signature_hash);
+
+	hash = hash_shader(hash, desc.VS);
+	hash = hash_shader(hash, desc.PS);
+	hash = hash_shader(hash, desc.DS);
+	hash = hash_shader(hash, desc.HS);
+	hash = hash_shader(hash, desc.GS);
+
+	hash = hash_stream_output(hash, desc.StreamOutput);
+	hash = hash_blend_state(hash, desc.BlendState);
+	hash = hash_value(hash, desc.SampleMask);
+	hash = hash_rasterizer_state(hash, desc.RasterizerState);
+	hash = hash_depth_stencil_state(hash, desc.DepthStencilState);
+	hash = hash_input_layout(hash, desc.InputLayout);
+	hash = hash_value(hash, desc.IBStripCutValue);
+	hash = hash_value(hash, desc.PrimitiveTopologyType);
+
+	// Formats past NumRenderTargets are ignored when the pipeline is created.
+	hash = hash_value(hash, desc.NumRenderTargets);
+	for (auto i = 0u; i < desc.NumRenderTargets; i++)
+	{
+		hash = hash_value(hash, desc.RTVFormats[i]);
+	}
+	hash = hash_value(hash, desc.DSVFormat);
+
+	hash = hash_value(hash, desc.SampleDesc.Count);
+	hash = hash_value(hash, desc.SampleDesc.Quality);
+	hash = hash_value(hash, desc.NodeMask);
+	return hash_value(hash, desc.Flags);
+}
+
+auto learning_dx12::hash_root_signature_desc(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC &desc) -> uint64_t
+{
+	auto hash = hash_value(hash_seed, desc.Version);
+
+	if (desc.Version == D3D_ROOT_SIGNATURE_VERSION_1_0)
+	{
+		return hash_root_signature(hash, desc.Desc_1_0);
+	}
+	return hash_root_signature(hash, desc.Desc_1_1);
+}
+
+auto learning_dx12::make_pipeline_name(uint64_t pipeline_hash) -> std::wstring
+{
+	constexpr auto digits = L"0123456789abcdef";
+
+	auto name = std::wstring(16, L'0');
+	for (auto i = name.rbegin(); i != name.rend(); ++i)
+	{
+		*i = digits[pipeline_hash & 0xf];
+		pipeline_hash >>= 4;
+	}
+	return name;
+}
+
+auto learning_dx12::is_library_current(const pipeline_library_header &header,
+                                       const pipeline_library_header &expected,
+                                       uint64_t bytes_after_header) -> bool
+{
+	return header.magic == pipeline_library_header::file_magic
+	   and header.version == pipeline_library_header::file_version
+	   and header.vendor_id == expected.vendor_id
+	   and header.device_id == expected.device_id
+	   and header.driver_version == expected.driver_version
+	   and header.content_hash == expected.content_hash
+	   and header.library_size > 0
+	   and header.library_size == bytes_after_header;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "fnv_hash.h"
+
+#include <d3d12.h>
+
+#include <cstdint>
+#include <string>
+
+namespace learning_dx12
+{
+	// Hashes everything that makes two pipeline descriptions different
+	// pipelines: shader bytecode contents, input layout, stream output,
+	// blend, rasterizer and depth stencil states, and formats.
+	// The root signature is a pointer, so hash_root_signature_desc of its
+	// description stands in for it. CachedPSO is ignored.
+	auto hash_pipeline_desc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC &desc, uint64_t root_signature_hash) -> uint64_t;
+
+	// Hashes a root signature description by what it describes, parameter
+	// by parameter, so it is the same wherever the description is stored.
+	auto hash_root_signature_desc(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC &desc) -> uint64_t;
+
+	// Pipeline library entries are found by name, this is the name for a hash.
+	auto make_pipeline_name(uint64_t pipeline_hash) -> std::wstring;
+
+	// Written in front of a serialized pipeline library. A library is only
+	// usable with the driver that produced it, and is thrown away with
+	// everything in it when the shaders it was built from change.
+	struct pipeline_library_header
+	{
+		static constexpr auto file_magic = uint32_t{ 0x4c4f5350 }; // "PSOL"
+		static constexpr auto file_version = uint32_t{ 1 };
+
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vendor_id;
+		uint32_t device_id;
+		uint64_t driver_version;
+		uint64_t content_hash; // of every shader pipelines are built from
+		uint64_t library_size; // bytes following the header
+	};
+
+	// True when a library stored with header can be loaded by the adapter,
+	// driver and shaders expected describes, and no bytes are missing.
+	auto is_library_current(const pipeline_library_header &header,
+	                        const pipeline_library_header &expected,
+	                        uint64_t bytes_after_header) -> bool;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+namespace learning_dx12
+{
+	// The fence values one queue has made the GPU wait for, per other queue.
+	// A wait already covered by an earlier, larger one, or by work that has
+	// finished, is not needed again. cmd_queue asks before it issues an
+	// ID3D12CommandQueue::Wait, queue_dependencies_test with simulated queues.
+	template <typename queue_type>
+	class queue_dependencies
+	{
+	public:
+		auto needs_wait(const queue_type &other, uint64_t value, uint64_t other_completed_value) const -> bool;
+		void add_wait(const queue_type &other, uint64_t value);
+
+		auto get_wait_value(const queue_type &other) const -> uint64_t;
+
+	private:
+		std::unordered_map<const queue_type *, uint64_t> wait_values{};
+	};
+
+	template <typename queue_type>
+	auto queue_dependencies<queue_type>::needs_wait(const queue_type &other, uint64_t value, uint64_t other_completed_value) const -> bool
+	{
+		return get_wait_value(other) < value
+		   and other_completed_value < value;
+	}
+
+	// Waits on one queue are in submission order,
+	// so a smaller value never lowers what is covered.
+	template <typename queue_type>
+	void queue_dependencies<queue_type>::add_wait(const queue_type &other, uint64_t value)
+	{
+		auto &waited_value = wait_values[&other];
+		if (waited_value < value)
+		{
+			waited_value = value;
+		}
+	}
+
+	template <typename queue_type>
+	auto queue_dependencies<queue_type>::get_wait_value(const queue_type &other) const -> uint64_t
+	{
+		auto waited = wait_values.find(&other);
+		if (waited == wait_values.end())
+		{
+			return {};
+		}
+
+		return waited->second;
+	}
+}
@@ -0,0 +1,418 @@
+#include "render_graph.h"
+
+#include "fnv_hash.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace learning_dx12;
+
+namespace
+{
+	constexpr auto write_accesses = graph_access::render_target
+	                              | graph_access::depth_write
+	                              | graph_access::unordered_access
+	                              | graph_access::copy_dest;
+
+	constexpr auto no_pass = UINT32_MAX;
+
+	auto hash_topology(const std::vector<uint32_t> &topology) -> uint64_t
+	{
+		return hash_bytes(topology.data(), topology.size() * sizeof(uint32_t));
+	}
+}
+
+auto learning_dx12::is_write_access(graph_access access) -> bool
+{
+	return (access & write_accesses) != graph_access::none;
+}
+
+render_graph::render_graph() = default;
+render_graph::~render_graph() = default;
+
+auto render_graph::add_resource(std::string_view name) -> graph_resource
+{
+	resources.push_back({ std::string{ name }, false, graph_access::none, graph_access::none });
+
+	topology.push_back(0xFFFF'0001);
+	return static_cast<graph_resource>(resources.size() - 1);
+}
+
+// Imported resources live outside the graph. They start in initial_access,
+// are put back in final_access at the end, and count as graph outputs.
+auto render_graph::import_resource(std::string_view name, graph_access initial_access, graph_access final_access) -> graph_resource
+{
+	resources.push_back({ std::string{ name }, true, initial_access, final_access });
+
+	topology.push_back(0xFFFF'0002);
+	topology.push_back(static_cast<uint32_t>(initial_access));
+	topology.push_back(static_cast<uint32_t>(final_access));
+	return static_cast<graph_resource>(resources.size() - 1);
+}
+
+auto render_graph::add_pass(std::string_view name) -> graph_pass
+{
+	passes.push_back({ std::string{ name }, {}, false });
+
+	topology.push_back(0xFFFF'0003);
+	return static_cast<graph_pass>(passes.size() - 1);
+}
+
+void render_graph::read(graph_pass pass, graph_resource resource, graph_access access)
+{
+	assert(not is_write_access(access));
+
+	add_use(pass, { resource, access, true, false });
+}
+
+// Overwrites the resource, whatever was in it before is not needed.
+void render_graph::write(graph_pass pass, graph_resource resource, graph_access access)
+{
+	assert(access != graph_access::none);
+
+	add_use(pass, { resource, access, false, true });
+}
+
+// Reads and writes the resource, blending onto a render target for example.
+void render_graph::modify(graph_pass pass, graph_resource resource, graph_access access)
+{
+	assert(access != graph_access::none);
+
+	add_use(pass, { resource, access, true, true });
+}
+
+// Keeps the pass even if nothing reads what it writes.
+void render_graph::set_side_effects(graph_pass pass)
+{
+	passes.at(pass).side_effects = true;
+
+	topology.push_back(0xFFFF'0004);
+	topology.push_back(pass);
+}
+
+void render_graph::clear()
+{
+	resources.clear();
+	passes.clear();
+	topology.clear();
+}
+
+auto render_graph::compile() const -> compiled_graph
+{
+	auto compiled = compiled_graph{};
+
+	auto kept = cull_passes();
+	auto levels = find_levels(kept);
+
+	for (auto pass = 0u; pass < passes.size(); pass++)
+	{
+		if (kept[pass])
+		{
+			compiled.pass_order.push_back(pass);
+		}
+	}
+	compiled.culled_count = static_cast<uint32_t>(passes.size() - compiled.pass_order.size());
+
+	// Declaration order is already a valid order, sorting by level keeps
+	// it valid and puts independent passes next to each other.
+	std::stable_sort(compiled.pass_order.begin(), compiled.pass_order.end(), [&](graph_pass a, graph_pass b)
+	{
+		return levels[a] < levels[b];
+	});
+
+	auto current_access = std::vector<graph_access>(resources.size());
+	auto last_was_write = std::vector<bool>(resources.size());
+	auto split_from = std::vector<uint32_t>(resources.size(), 0); // batch a split transition could begin in
+	for (auto resource = 0u; resource < resources.size(); resource++)
+	{
+		current_access[resource] = resources[resource].initial_access;
+	}
+
+	compiled.first_access = current_access;
+	compiled.first_batch.resize(resources.size(), compiled_graph::unused);
+	compiled.last_batch.resize(resources.size(), compiled_graph::unused);
+
+	auto wanted_access = std::vector<graph_access>(resources.size());
+	auto touched = std::vector<graph_resource>{};
+
+	for (auto first = 0u; first < compiled.pass_order.size();)
+	{
+		auto level = levels[compiled.pass_order[first]];
+		auto last = first;
+		while (last < compiled.pass_order.size()
+		       and levels[compiled.pass_order[last]] == level)
+		{
+			last++;
+		}
+
+		// Every pass in a level is independent of the others, so a resource
+		// is either written by one of them, or only read, by any number.
+		touched.clear();
+		for (auto i = first; i < last; i++)
+		{
+			for (auto &use : passes[compiled.pass_order[i]].uses)
+			{
+				if (wanted_access[use.resource] == graph_access::none)
+				{
+					touched.push_back(use.resource);
+				}
+				wanted_access[use.resource] = wanted_access[use.resource] | use.access;
+			}
+		}
+
+		auto batch_index = static_cast<uint32_t>(compiled.batches.size());
+		auto &batch = compiled.batches.emplace_back();
+		batch.first_pass = first;
+		batch.pass_count = last - first;
+
+		for (auto resource : touched)
+		{
+			if (compiled.first_batch[resource] == compiled_graph::unused)
+			{
+				compiled.first_batch[resource] = batch_index;
+			}
+			compiled.last_batch[resource] = batch_index;
+
+			auto wanted = wanted_access[resource];
+			auto is_write = is_write_access(wanted);
+			[[maybe_unused]] auto bits = static_cast<uint32_t>(wanted);
+			assert(not is_write or (bits & (bits - 1)) == 0);
+
+			if (current_access[resource] == graph_access::none)
+			{
+				compiled.first_access[resource] = wanted;
+			}
+			else if (current_access[resource] != wanted and split_from[resource] < batch_index)
+			{
+				// Nothing uses the resource in the batches between the two halves
+				compiled.batches[split_from[resource]].barriers.push_back({ resource, current_access[resource], wanted, false, barrier_split::begin });
+				batch.barriers.push_back({ resource, current_access[resource], wanted, false, barrier_split::end });
+				compiled.barrier_count++;
+			}
+			else if (current_access[resource] != wanted)
+			{
+				batch.barriers.push_back({ resource, current_access[resource], wanted, false, barrier_split::none });
+			}
+			else if (wanted == graph_access::unordered_access and last_was_write[resource])
+			{
+				batch.barriers.push_back({ resource, wanted, wanted, true, barrier_split::none });
+			}
+
+			current_access[resource] = wanted;
+			last_was_write[resource] = is_write;
+			split_from[resource] = batch_index + 1;
+			wanted_access[resource] = graph_access::none;
+		}
+		compiled.barrier_count += static_cast<uint32_t>(batch.barriers.size());
+
+		first = last;
+	}
+
+	// Transients keep their memory, and state, from one frame to the next,
+	// so they go back to the access they are created in and first used with.
+	for (auto resource = 0u; resource < resources.size(); resource++)
+	{
+		auto &node = resources[resource];
+		auto final_access = node.imported ? node.final_access : compiled.first_access[resource];
+		if (current_access[resource] != final_access)
+		{
+			compiled.final_barriers.push_back({ resource, current_access[resource], final_access, false, barrier_split::none });
+		}
+	}
+	compiled.barrier_count += static_cast<uint32_t>(compiled.final_barriers.size());
+
+	return compiled;
+}
+
+auto render_graph::get_topology() const -> const std::vector<uint32_t> &
+{
+	return topology;
+}
+
+auto render_graph::get_resource_count() const -> uint32_t
+{
+	return static_cast<uint32_t>(resources.size());
+}
+
+auto render_graph::get_pass_count() const -> uint32_t
+{
+	return static_cast<uint32_t>(passes.size());
+}
+
+auto render_graph::get_pass_name(graph_pass pass) const -> const std::string &
+{
+	return passes.at(pass).name;
+}
+
+auto render_graph::get_resource_name(graph_resource resource) const -> const std::string &
+{
+	return resources.at(resource).name;
+}
+
+void render_graph::add_use(graph_pass pass, const resource_use &use)
+{
+	assert(pass < passes.size());
+	assert(use.resource < resources.size());
+
+	passes[pass].uses.push_back(use);
+
+	topology.push_back(pass);
+	topology.push_back(use.resource);
+	topology.push_back(static_cast<uint32_t>(use.access));
+	topology.push_back((use.is_read ? 1u : 0u) | (use.is_write ? 2u : 0u));
+}
+
+// Walks the passes backwards, a resource is live while something later
+// still needs what is in it. A pass is kept if it writes a live resource,
+// its writes then satisfy that need and its reads become needs of their own.
+auto render_graph::cull_passes() const -> std::vector<bool>
+{
+	auto kept = std::vector<bool>(passes.size());
+	auto live = std::vector<bool>(resources.size());
+	for (auto resource = 0u; resource < resources.size(); resource++)
+	{
+		live[resource] = resources[resource].imported;
+	}
+
+	for (auto pass = passes.size(); pass-- > 0;)
+	{
+		auto &node = passes[pass];
+
+		auto needed = node.side_effects
+		           or std::any_of(node.uses.begin(), node.uses.end(), [&](const resource_use &use)
+		              {
+		                  return use.is_write and live[use.resource];
+		              });
+		if (not needed)
+		{
+			continue;
+		}
+
+		kept[pass] = true;
+		for (auto &use : node.uses)
+		{
+			if (use.is_write)
+			{
+				live[use.resource] = false;
+			}
+		}
+		for (auto &use : node.uses)
+		{
+			if (use.is_read)
+			{
+				live[use.resource] = true;
+			}
+		}
+	}
+
+	return kept;
+}
+
+// Level is one more than the deepest pass this one has to wait for:
+// the last writer of anything it reads or writes (read after write,
+// write after write) and every reader since then of anything it writes
+// (write after read). Culled passes are skipped.
+auto render_graph::find_levels(const std::vector<bool> &kept) const -> std::vector<uint32_t>
+{
+	auto levels = std::vector<uint32_t>(passes.size());
+	auto last_writer = std::vector<graph_pass>(resources.size(), no_pass);
+	auto deepest_reader = std::vector<uint32_t>(resources.size());
+	auto has_reader = std::vector<bool>(resources.size());
+
+	for (auto pass = 0u; pass < passes.size(); pass++)
+	{
+		if (not kept[pass])
+		{
+			continue;
+		}
+
+		auto level = 0u;
+		for (auto &use : passes[pass].uses)
+		{
+			auto writer = last_writer[use.resource];
+			if (writer != no_pass)
+			{
+				level = std::max(level, levels[writer] + 1);
+			}
+			if (use.is_write and has_reader[use.resource])
+			{
+				level = std::max(level, deepest_reader[use.resource] + 1);
+			}
+		}
+		levels[pass] = level;
+
+		for (auto &use : passes[pass].uses)
+		{
+			if (use.is_write)
+			{
+				last_writer[use.resource] = pass;
+				has_reader[use.resource] = false;
+				deepest_reader[use.resource] = 0;
+			}
+		}
+		for (auto &use : passes[pass].uses)
+		{
+			if (use.is_read and not use.is_write)
+			{
+				has_reader[use.resource] = true;
+				deepest_reader[use.resource] = std::max(deepest_reader[use.resource], level);
+			}
+		}
+	}
+
+	return levels;
+}
+
+render_graph_cache::render_graph_cache() :
+	render_graph_cache(default_max_entries)
+{}
+
+render_graph_cache::render_graph_cache(uint32_t max_entries_) :
+	max_entries{ max_entries_ }
+{}
+
+render_graph_cache::~render_graph_cache() = default;
+
+// Compiles graph only if no earlier graph had the same topology.
+// The reference is good until the next get or clear.
+auto render_graph_cache::get(const render_graph &graph) -> const compiled_graph &
+{
+	auto &topology = graph.get_topology();
+	auto hash = hash_topology(topology);
+
+	auto [first, last] = entries.equal_range(hash);
+	auto found = std::find_if(first, last, [&](auto &entry)
+	{
+		return entry.second.topology == topology;
+	});
+	if (found != last)
+	{
+		stats.hits++;
+		return found->second.graph;
+	}
+
+	stats.misses++;
+
+	// Topologies rarely change, when there are this many something is
+	// rebuilding the graph differently every frame, so start over.
+	if (entries.size() >= max_entries)
+	{
+		entries.clear();
+	}
+
+	auto inserted = entries.emplace(hash, cache_entry{ topology, graph.compile() });
+	stats.entry_count = static_cast<uint32_t>(entries.size());
+
+	return inserted->second.graph;
+}
+
+void render_graph_cache::clear()
+{
+	entries.clear();
+	stats.entry_count = 0;
+}
+
+auto render_graph_cache::get_stats() const -> cache_stats
+{
+	return stats;
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace learning_dx12
+{
+	// How a pass uses a resource. Read-only accesses can be combined,
+	// so one state serves every pass reading a resource at the same time.
+	enum class graph_access : uint32_t
+	{
+		none             = 0,
+		render_target    = 1 << 0,
+		depth_write      = 1 << 1,
+		depth_read       = 1 << 2,
+		shader_read      = 1 << 3,
+		unordered_access = 1 << 4,
+		copy_source      = 1 << 5,
+		copy_dest        = 1 << 6,
+		present          = 1 << 7,
+	};
+
+	constexpr auto operator |(graph_access a, graph_access b) -> graph_access
+	{
+		return static_cast<graph_access>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b));
+	}
+
+	constexpr auto operator &(graph_access a, graph_access b) -> graph_access
+	{
+		return static_cast<graph_access>(static_cast<uint32_t>(a) & static_cast<uint32_t>(b));
+	}
+
+	auto is_write_access(graph_access access) -> bool;
+
+	using graph_resource = uint32_t;
+	using graph_pass = uint32_t;
+
+	// A transition with batches in between the resource's last use and its
+	// next is split: begun right after the last, ended before the next,
+	// so the GPU can carry it out while the batches in between run.
+	enum class barrier_split : uint8_t
+	{
+		none,
+		begin,
+		end,
+	};
+
+	struct graph_barrier
+	{
+		graph_resource resource;
+		graph_access before;
+		graph_access after;
+		bool is_uav; // unordered access to unordered access, before == after
+		barrier_split split;
+	};
+
+	// Passes that don't depend on each other share a batch,
+	// its barriers all go out together before any of them run.
+	struct compiled_graph
+	{
+		static constexpr auto unused = UINT32_MAX;
+
+		struct pass_batch
+		{
+			std::vector<graph_barrier> barriers;
+			uint32_t first_pass;  // into pass_order
+			uint32_t pass_count;
+		};
+
+		std::vector<graph_pass> pass_order{};
+		std::vector<pass_batch> batches{};
+		std::vector<graph_barrier> final_barriers{}; // imported resources to their final access, transients to their first
+		std::vector<graph_access> first_access{};    // per resource, transient ones are created in it
+		std::vector<uint32_t> first_batch{};         // per resource, unused if no kept pass touches it
+		std::vector<uint32_t> last_batch{};
+		uint32_t culled_count{};
+		uint32_t barrier_count{};
+	};
+
+	// Passes are declared in an order that would be correct to run them in,
+	// along with every resource they read and write. compile() drops passes
+	// nothing depends on, groups the rest by dependency depth and works out
+	// the barriers between them. No GPU calls are made here.
+	class render_graph
+	{
+	public:
+		render_graph();
+		~render_graph();
+
+		auto add_resource(std::string_view name) -> graph_resource;
+		auto import_resource(std::string_view name, graph_access initial_access, graph_access final_access) -> graph_resource;
+
+		auto add_pass(std::string_view name) -> graph_pass;
+		void read(graph_pass pass, graph_resource resource, graph_access access);
+		void write(graph_pass pass, graph_resource resource, graph_access access);
+		void modify(graph_pass pass, graph_resource resource, graph_access access);
+		void set_side_effects(graph_pass pass);
+
+		void clear();
+
+		auto compile() const -> compiled_graph;
+		auto get_topology() const -> const std::vector<uint32_t> &;
+
+		auto get_resource_count() const -> uint32_t;
+		auto get_pass_count() const -> uint32_t;
+		auto get_pass_name(graph_pass pass) const -> const std::string &;
+		auto get_resource_name(graph_resource resource) const -> const std::string &;
+
+	private:
+		struct resource_use
+		{
+			graph_resource resource;
+			graph_access access;
+			bool is_read;
+			bool is_write;
+		};
+
+		struct resource_node
+		{
+			std::string name;
+			bool imported;
+			graph_access initial_access;
+			graph_access final_access;
+		};
+
+		struct pass_node
+		{
+			std::string name;
+			std::vector<resource_use> uses;
+			bool side_effects;
+		};
+
+		void add_use(graph_pass pass, const resource_use &use);
+
+		auto cull_passes() const -> std::vector<bool>;
+		auto find_levels(const std::vector<bool> &kept) const -> std::vector<uint32_t>;
+
+	private:
+		std::vector<resource_node> resources{};
+		std::vector<pass_node> passes{};
+
+		// Everything compile() depends on, names excluded, as a flat list.
+		std::vector<uint32_t> topology{};
+	};
+
+	// Compiled graphs keyed by topology. A frame that declares the
+	// same passes and uses as an earlier one gets its graph back as is.
+	class render_graph_cache
+	{
+	public:
+		struct cache_stats
+		{
+			uint64_t hits;
+			uint64_t misses;
+			uint32_t entry_count;
+		};
+
+		static constexpr auto default_max_entries = uint32_t{ 16 };
+
+	public:
+		render_graph_cache();
+		render_graph_cache(uint32_t max_entries);
+		~render_graph_cache();
+
+		auto get(const render_graph &graph) -> const compiled_graph &;
+		void clear();
+
+		auto get_stats() const -> cache_stats;
+
+	private:
+		struct cache_entry
+		{
+			std::vector<uint32_t> topology;
+			compiled_graph graph;
+		};
+
+		uint32_t max_entries{};
+		std::unordered_multimap<uint64_t, cache_entry> entries{};
+		cache_stats stats{};
+	};
+}
@@ -0,0 +1,440 @@
+#include "resource_state_tracker.h"
+
+#include "d3dx12.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+using namespace learning_dx12;
+
+namespace
+{
+	constexpr auto all_subresources = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+
+	constexpr auto read_only_states = D3D12_RESOURCE_STATES
+	{
+		D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER |
+		D3D12_RESOURCE_STATE_INDEX_BUFFER |
+		D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE |
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE |
+		D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT |
+		D3D12_RESOURCE_STATE_COPY_SOURCE |
+		D3D12_RESOURCE_STATE_DEPTH_READ |
+		D3D12_RESOURCE_STATE_RESOLVE_SOURCE
+	};
+
+	// Non-simultaneous-access textures can only be promoted to these.
+	constexpr auto texture_promotable_read_states = D3D12_RESOURCE_STATES
+	{
+		D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE |
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE |
+		D3D12_RESOURCE_STATE_COPY_SOURCE
+	};
+
+	auto get_plane_count(DXGI_FORMAT format) -> uint32_t
+	{
+		switch (format)
+		{
+			case DXGI_FORMAT_R24G8_TYPELESS:
+			case DXGI_FORMAT_D24_UNORM_S8_UINT:
+			case DXGI_FORMAT_R32G8X24_TYPELESS:
+			case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+			case DXGI_FORMAT_NV12:
+			case DXGI_FORMAT_P010:
+			case DXGI_FORMAT_P016:
+				return 2;
+		}
+		return 1;
+	}
+
+	// A read-only state already covers any read-only state made of a subset of its bits.
+	auto covers(D3D12_RESOURCE_STATES current, D3D12_RESOURCE_STATES wanted) -> bool
+	{
+		return current == wanted
+		    or (is_read_only_state(current)
+		        and is_read_only_state(wanted)
+		        and (current & wanted) == wanted);
+	}
+
+	// Whether earlier lists in the submission left every subresource
+	// decaying, or none, so they can be resolved as one.
+	auto decays_agree(const state_submission &submission, ID3D12Resource *resource, uint32_t subresource_count) -> bool
+	{
+		auto first = submission.decays.lower_bound({ resource, 0u });
+		auto last = submission.decays.upper_bound({ resource, all_subresources });
+
+		auto entry_count = std::distance(first, last);
+		auto decaying_count = std::count_if(first, last, [](auto &entry) { return entry.second; });
+		if (decaying_count == 0)
+		{
+			return true;
+		}
+
+		auto whole = entry_count == 1 and first->first.second == all_subresources;
+		return decaying_count == entry_count
+		   and (whole or entry_count == static_cast<ptrdiff_t>(subresource_count));
+	}
+}
+
+auto learning_dx12::make_resource_traits(const D3D12_RESOURCE_DESC &desc) -> resource_traits
+{
+	auto traits = resource_traits{};
+	traits.is_buffer = desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER;
+	traits.simultaneous_access = (desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_SIMULTANEOUS_ACCESS) != 0;
+
+	if (traits.is_buffer)
+	{
+		traits.subresource_count = 1;
+		return traits;
+	}
+
+	auto array_size = (desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D) ? 1u : desc.DepthOrArraySize;
+	traits.subresource_count = desc.MipLevels * array_size * get_plane_count(desc.Format);
+	return traits;
+}
+
+auto learning_dx12::is_read_only_state(D3D12_RESOURCE_STATES state) -> bool
+{
+	return state != D3D12_RESOURCE_STATE_COMMON
+	   and (state & ~read_only_states) == 0;
+}
+
+// Buffers and simultaneous-access textures promote out of COMMON to anything,
+// other textures only to shader resource and copy states, and COPY_DEST
+// can't be combined with a read state.
+auto learning_dx12::can_promote_from_common(const resource_traits &traits, D3D12_RESOURCE_STATES state) -> bool
+{
+	if (state == D3D12_RESOURCE_STATE_COMMON)
+	{
+		return false;
+	}
+
+	if (traits.is_buffer or traits.simultaneous_access)
+	{
+		return true;
+	}
+
+	return state == D3D12_RESOURCE_STATE_COPY_DEST
+	    or (state & ~texture_promotable_read_states) == 0;
+}
+
+subresource_states::subresource_states() = default;
+
+subresource_states::subresource_states(uint32_t count_, D3D12_RESOURCE_STATES state) :
+	count{ count_ }, uniform_state{ state }
+{}
+
+subresource_states::~subresource_states() = default;
+
+// all_subresources may only be asked for while every subresource agrees.
+auto subresource_states::get(uint32_t subresource) const -> D3D12_RESOURCE_STATES
+{
+	if (per_subresource.empty())
+	{
+		return uniform_state;
+	}
+
+	assert(subresource != all_subresources);
+	return per_subresource.at(subresource);
+}
+
+void subresource_states::set(uint32_t subresource, D3D12_RESOURCE_STATES state)
+{
+	if (subresource == all_subresources)
+	{
+		uniform_state = state;
+		per_subresource.clear();
+		return;
+	}
+
+	if (per_subresource.empty())
+	{
+		if (state == uniform_state)
+		{
+			return;
+		}
+		per_subresource.assign(count, uniform_state);
+	}
+
+	per_subresource.at(subresource) = state;
+
+	auto all_match = std::all_of(per_subresource.begin(), per_subresource.end(), [&](D3D12_RESOURCE_STATES s)
+	{
+		return s == state;
+	});
+	if (all_match)
+	{
+		uniform_state = state;
+		per_subresource.clear();
+	}
+}
+
+auto subresource_states::is_uniform() const -> bool
+{
+	return per_subresource.empty();
+}
+
+auto subresource_states::get_count() const -> uint32_t
+{
+	return count;
+}
+
+auto state_tracker_stats::operator +=(const state_tracker_stats &other) -> state_tracker_stats &
+{
+	transitions += other.transitions;
+	elided += other.elided;
+	first_uses += other.first_uses;
+	fixups += other.fixups;
+	promotions += other.promotions;
+	decays += other.decays;
+	return *this;
+}
+
+cmd_list_state_tracker::cmd_list_state_tracker() = default;
+cmd_list_state_tracker::~cmd_list_state_tracker() = default;
+
+// Barriers needed inside the list are appended to barriers,
+// transitions the subresource is already in add nothing.
+void cmd_list_state_tracker::transition(ID3D12Resource *resource, const resource_traits &traits,
+                                        D3D12_RESOURCE_STATES state, uint32_t subresource,
+                                        std::vector<D3D12_RESOURCE_BARRIER> &barriers)
+{
+	stats.transitions++;
+
+	auto [it, inserted] = resources.try_emplace(resource, local_resource{
+		traits,
+		{ traits.subresource_count, resource_state_unknown },
+		{ traits.subresource_count, resource_state_unknown },
+		std::vector<bool>(traits.subresource_count, false),
+	});
+	auto &entry = it->second;
+
+	if (subresource != all_subresources or entry.current.is_uniform())
+	{
+		transition_subresource(resource, entry, state, subresource, barriers);
+		return;
+	}
+
+	for (auto sub = 0u; sub < traits.subresource_count; sub++)
+	{
+		transition_subresource(resource, entry, state, sub, barriers);
+	}
+}
+
+auto cmd_list_state_tracker::get_resources() const -> const std::unordered_map<ID3D12Resource *, local_resource> &
+{
+	return resources;
+}
+
+auto cmd_list_state_tracker::get_stats() const -> state_tracker_stats
+{
+	return stats;
+}
+
+void cmd_list_state_tracker::reset()
+{
+	resources.clear();
+	stats = {};
+}
+
+void cmd_list_state_tracker::transition_subresource(ID3D12Resource *resource, local_resource &entry,
+                                                    D3D12_RESOURCE_STATES state, uint32_t subresource,
+                                                    std::vector<D3D12_RESOURCE_BARRIER> &barriers)
+{
+	auto current = entry.current.get(subresource);
+
+	if (current == resource_state_unknown)
+	{
+		entry.first_use.set(subresource, state);
+		entry.current.set(subresource, state);
+		stats.first_uses++;
+		return;
+	}
+
+	if (covers(current, state))
+	{
+		stats.elided++;
+		return;
+	}
+
+	barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, current, state, subresource));
+	entry.current.set(subresource, state);
+
+	if (subresource == all_subresources)
+	{
+		entry.transitioned.assign(entry.transitioned.size(), true);
+	}
+	else
+	{
+		entry.transitioned.at(subresource) = true;
+	}
+}
+
+resource_state_registry::resource_state_registry() = default;
+resource_state_registry::~resource_state_registry() = default;
+
+void resource_state_registry::add(ID3D12Resource *resource, const resource_traits &traits, D3D12_RESOURCE_STATES initial_state)
+{
+	auto lock = std::lock_guard{ resources_mutex };
+
+	auto [it, inserted] = resources.try_emplace(resource, global_resource{
+		traits,
+		{ traits.subresource_count, initial_state },
+	});
+	assert(inserted);
+}
+
+void resource_state_registry::remove(ID3D12Resource *resource)
+{
+	auto lock = std::lock_guard{ resources_mutex };
+
+	resources.erase(resource);
+}
+
+auto resource_state_registry::get_traits(ID3D12Resource *resource) const -> resource_traits
+{
+	auto lock = std::lock_guard{ resources_mutex };
+
+	return resources.at(resource).traits;
+}
+
+auto resource_state_registry::get_state(ID3D12Resource *resource, uint32_t subresource) const -> D3D12_RESOURCE_STATES
+{
+	auto lock = std::lock_guard{ resources_mutex };
+
+	return resources.at(resource).states.get(subresource);
+}
+
+// Returns the barriers that must execute before list, to take every
+// subresource it uses from its global state to its first-use state,
+// then moves the global state on to where list leaves it.
+auto resource_state_registry::resolve(const cmd_list_state_tracker &list, state_submission &submission) -> std::vector<D3D12_RESOURCE_BARRIER>
+{
+	auto lock = std::lock_guard{ resources_mutex };
+
+	auto barriers = std::vector<D3D12_RESOURCE_BARRIER>{};
+
+	for (auto &[resource, local] : list.get_resources())
+	{
+		auto global = resources.find(resource);
+		assert(global != resources.end());
+
+		auto whole_resource = local.first_use.is_uniform()
+		                  and local.current.is_uniform()
+		                  and global->second.states.is_uniform()
+		                  and std::equal(local.transitioned.begin() + 1, local.transitioned.end(), local.transitioned.begin())
+		                  and decays_agree(submission, resource, local.traits.subresource_count);
+		if (whole_resource)
+		{
+			resolve_subresource(resource, global->second, local, all_subresources, submission, barriers);
+			continue;
+		}
+
+		for (auto sub = 0u; sub < local.traits.subresource_count; sub++)
+		{
+			resolve_subresource(resource, global->second, local, sub, submission, barriers);
+		}
+	}
+
+	return barriers;
+}
+
+// Call once the ExecuteCommandLists call the submission's lists went into has been made.
+void resource_state_registry::finish_submission(state_submission &submission)
+{
+	auto lock = std::lock_guard{ resources_mutex };
+
+	for (auto &[key, decays] : submission.decays)
+	{
+		auto &[resource, sub] = key;
+		auto global = resources.find(resource);
+		if (not decays or global == resources.end())
+		{
+			continue;
+		}
+
+		global->second.states.set(sub, D3D12_RESOURCE_STATE_COMMON);
+		submission.stats.decays++;
+	}
+
+	submission.decays.clear();
+}
+
+void resource_state_registry::resolve_subresource(ID3D12Resource *resource, global_resource &global,
+                                                  const cmd_list_state_tracker::local_resource &local,
+                                                  uint32_t subresource, state_submission &submission,
+                                                  std::vector<D3D12_RESOURCE_BARRIER> &barriers)
+{
+	auto first_use = local.first_use.get(subresource);
+	if (first_use == resource_state_unknown)
+	{
+		return;
+	}
+
+	auto before = global.states.get(subresource);
+	auto after = local.current.get(subresource);
+	auto transitioned = local.transitioned.at(subresource == all_subresources ? 0 : subresource);
+	auto promoted = false;
+	auto fixed_up = false;
+
+	if (before == first_use)
+	{
+		// Nothing to fix up, the list's own barriers start from here
+	}
+	else if (covers(before, first_use) and not transitioned)
+	{
+		// Left in the wider read state it is already in. Not when the list
+		// has barriers of its own, they were recorded from first_use.
+		after = before;
+	}
+	else if (before == D3D12_RESOURCE_STATE_COMMON
+	         and can_promote_from_common(global.traits, first_use))
+	{
+		promoted = true;
+		submission.stats.promotions++;
+	}
+	else
+	{
+		barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, before, first_use, subresource));
+		submission.stats.fixups++;
+		fixed_up = true;
+	}
+
+	global.states.set(subresource, after);
+
+	// Decay entries are kept at the same granularity as this resolve,
+	// a whole-resource entry is split up before a single subresource
+	// overrides part of it.
+	auto key = std::pair{ resource, subresource };
+	auto whole_key = std::pair{ resource, all_subresources };
+	auto earlier_decays = false;
+	if (subresource == all_subresources)
+	{
+		auto first = submission.decays.lower_bound({ resource, 0u });
+		auto last = submission.decays.upper_bound(whole_key);
+		earlier_decays = std::any_of(first, last, [](auto &entry) { return entry.second; });
+		submission.decays.erase(first, last);
+	}
+	else if (auto whole = submission.decays.find(whole_key); whole != submission.decays.end())
+	{
+		for (auto sub = 0u; sub < global.traits.subresource_count; sub++)
+		{
+			submission.decays[{ resource, sub }] = whole->second;
+		}
+		submission.decays.erase(whole);
+	}
+
+	auto earlier = submission.decays.find(key);
+	if (earlier != submission.decays.end())
+	{
+		earlier_decays = earlier->second;
+	}
+
+	// Promoted read-only states decay, unless a barrier moved the subresource on.
+	auto stayed_read_only = not transitioned and not fixed_up and is_read_only_state(after);
+	submission.decays[key] = submission.copy_queue
+	                      or global.traits.is_buffer
+	                      or global.traits.simultaneous_access
+	                      or (stayed_read_only and (promoted or earlier_decays));
+}
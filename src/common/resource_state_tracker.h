@@ -0,0 +1,143 @@
+#pragma once
+
+#include <d3d12.h>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace learning_dx12
+{
+	// Marks a subresource a command list hasn't touched yet.
+	constexpr auto resource_state_unknown = static_cast<D3D12_RESOURCE_STATES>(0xFFFFFFFF);
+
+	// What the implicit promotion and decay rules need to know about a resource.
+	struct resource_traits
+	{
+		uint32_t subresource_count;
+		bool is_buffer;
+		bool simultaneous_access;
+	};
+
+	auto make_resource_traits(const D3D12_RESOURCE_DESC &desc) -> resource_traits;
+
+	auto is_read_only_state(D3D12_RESOURCE_STATES state) -> bool;
+	auto can_promote_from_common(const resource_traits &traits, D3D12_RESOURCE_STATES state) -> bool;
+
+	// One state per subresource, stored as a single value
+	// for as long as every subresource agrees.
+	class subresource_states
+	{
+	public:
+		subresource_states();
+		subresource_states(uint32_t count, D3D12_RESOURCE_STATES state);
+		~subresource_states();
+
+		auto get(uint32_t subresource) const -> D3D12_RESOURCE_STATES;
+		void set(uint32_t subresource, D3D12_RESOURCE_STATES state);
+
+		auto is_uniform() const -> bool;
+		auto get_count() const -> uint32_t;
+
+	private:
+		uint32_t count{};
+		D3D12_RESOURCE_STATES uniform_state{};
+		std::vector<D3D12_RESOURCE_STATES> per_subresource{}; // empty while uniform
+	};
+
+	struct state_tracker_stats
+	{
+		uint32_t transitions;  // transitions asked for
+		uint32_t elided;       // ones the subresource was already in
+		uint32_t first_uses;   // deferred to submit time
+		uint32_t fixups;       // barriers added at submit time
+		uint32_t promotions;   // first uses satisfied by implicit promotion
+		uint32_t decays;       // subresources that went back to COMMON
+
+		auto operator +=(const state_tracker_stats &other) -> state_tracker_stats &;
+	};
+
+	// Tracks states local to one command list. The first time a subresource
+	// is used nothing is emitted, the state it needs is remembered instead
+	// and resource_state_registry::resolve works out the barrier, if any,
+	// when the list is submitted. Later uses transition from the local state.
+	class cmd_list_state_tracker
+	{
+	public:
+		struct local_resource
+		{
+			resource_traits traits;
+			subresource_states first_use;
+			subresource_states current;
+			std::vector<bool> transitioned; // a barrier in the list starts from first_use
+		};
+
+	public:
+		cmd_list_state_tracker();
+		~cmd_list_state_tracker();
+
+		void transition(ID3D12Resource *resource, const resource_traits &traits,
+		                D3D12_RESOURCE_STATES state, uint32_t subresource,
+		                std::vector<D3D12_RESOURCE_BARRIER> &barriers);
+
+		auto get_resources() const -> const std::unordered_map<ID3D12Resource *, local_resource> &;
+		auto get_stats() const -> state_tracker_stats;
+
+		void reset();
+
+	private:
+		void transition_subresource(ID3D12Resource *resource, local_resource &entry,
+		                            D3D12_RESOURCE_STATES state, uint32_t subresource,
+		                            std::vector<D3D12_RESOURCE_BARRIER> &barriers);
+
+	private:
+		std::unordered_map<ID3D12Resource *, local_resource> resources{};
+		state_tracker_stats stats{};
+	};
+
+	// Subresources that will decay to COMMON once the ExecuteCommandLists
+	// call they were used in completes. Lists in one call are resolved
+	// into the same submission, as no decay happens between them.
+	struct state_submission
+	{
+		bool copy_queue;
+		std::map<std::pair<ID3D12Resource *, uint32_t>, bool> decays{};
+		state_tracker_stats stats{};
+	};
+
+	// Global, last known state of every tracked resource, shared by all queues.
+	class resource_state_registry
+	{
+	public:
+		resource_state_registry();
+		~resource_state_registry();
+
+		void add(ID3D12Resource *resource, const resource_traits &traits, D3D12_RESOURCE_STATES initial_state);
+		void remove(ID3D12Resource *resource);
+
+		auto get_traits(ID3D12Resource *resource) const -> resource_traits;
+		auto get_state(ID3D12Resource *resource, uint32_t subresource) const -> D3D12_RESOURCE_STATES;
+
+		auto resolve(const cmd_list_state_tracker &list, state_submission &submission) -> std::vector<D3D12_RESOURCE_BARRIER>;
+		void finish_submission(state_submission &submission);
+
+	private:
+		struct global_resource
+		{
+			resource_traits traits;
+			subresource_states states;
+		};
+
+		void resolve_subresource(ID3D12Resource *resource, global_resource &global,
+		                         const cmd_list_state_tracker::local_resource &local,
+		                         uint32_t subresource, state_submission &submission,
+		                         std::vector<D3D12_RESOURCE_BARRIER> &barriers);
+
+	private:
+		std::unordered_map<ID3D12Resource *, global_resource> resources{};
+		mutable std::mutex resources_mutex{};
+	};
+}
@@ -0,0 +1,104 @@
+#include "ring_allocator.h"
+
+#include <cassert>
+
+using namespace learning_dx12;
+
+namespace
+{
+	constexpr auto align_up(uint64_t value, uint64_t alignment) -> uint64_t
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+ring_allocator::ring_allocator(uint64_t capacity_) :
+	capacity{capacity_}
+{
+	stats.capacity = capacity;
+}
+
+ring_allocator::~ring_allocator() = default;
+
+auto ring_allocator::allocate(uint64_t size, uint64_t alignment) -> std::optional<uint64_t>
+{
+	assert(alignment > 0 and (alignment & (alignment - 1)) == 0);
+
+	auto commit = [&](uint64_t offset, uint64_t consumed) -> std::optional<uint64_t>
+	{
+		tail = offset + size;
+		used += consumed;
+		batch_size += consumed;
+		stats.allocation_count++;
+		stats.wasted_bytes += consumed - size;
+		return offset;
+	};
+
+	if (used < capacity)
+	{
+		if (tail >= head)
+		{
+			// [ free | head ... tail | free ]
+			auto offset = align_up(tail, alignment);
+			if (offset + size <= capacity)
+			{
+				return commit(offset, offset + size - tail);
+			}
+
+			// Doesn't fit at the end, skip the rest and start over from 0
+			if (size <= head)
+			{
+				return commit(0, (capacity - tail) + size);
+			}
+		}
+		else
+		{
+			// [ ... tail | free | head ... ]
+			auto offset = align_up(tail, alignment);
+			if (offset + size <= head)
+			{
+				return commit(offset, offset + size - tail);
+			}
+		}
+	}
+
+	stats.failed_count++;
+	return std::nullopt;
+}
+
+void ring_allocator::finish_batch(uint64_t fence_value)
+{
+	if (batch_size == 0)
+	{
+		return;
+	}
+
+	assert(batches.empty() or batches.back().fence_value <= fence_value);
+
+	batches.push_back({ fence_value, tail, batch_size });
+	batch_size = 0;
+}
+
+void ring_allocator::release_completed(uint64_t completed_fence_value)
+{
+	while (not batches.empty()
+	       and batches.front().fence_value <= completed_fence_value)
+	{
+		auto &batch = batches.front();
+		head = batch.end_offset;
+		used -= batch.size;
+		batches.pop_front();
+	}
+
+	if (used == 0)
+	{
+		head = tail = 0;
+	}
+}
+
+auto ring_allocator::get_stats() const -> ring_stats
+{
+	auto current = stats;
+	current.used = used;
+	return current;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+
+namespace learning_dx12
+{
+	// Offset-only ring allocator, it knows nothing about the memory it manages.
+	// Allocations made between two finish_batch calls are freed together, once 
+	// the fence value given to finish_batch has been reached.
+	class ring_allocator
+	{
+	public:
+		struct ring_stats
+		{
+			uint64_t capacity;
+			uint64_t used;
+			uint64_t allocation_count;
+			uint64_t failed_count;
+			uint64_t wasted_bytes;
+		};
+
+	public:
+		ring_allocator(uint64_t capacity);
+		ring_allocator() = delete;
+		~ring_allocator();
+
+		auto allocate(uint64_t size, uint64_t alignment) -> std::optional<uint64_t>;
+		void finish_batch(uint64_t fence_value);
+		void release_completed(uint64_t completed_fence_value);
+
+		auto get_stats() const -> ring_stats;
+
+	private:
+		struct batch_marker
+		{
+			uint64_t fence_value;
+			uint64_t end_offset;
+			uint64_t size;
+		};
+
+	private:
+		const uint64_t capacity{};
+		uint64_t head{};  // oldest byte still in use
+		uint64_t tail{};  // next byte to hand out
+		uint64_t used{};
+		uint64_t batch_size{};
+
+		std::deque<batch_marker> batches{};
+		ring_stats stats{};
+	};
+}
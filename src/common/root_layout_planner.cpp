@@ -0,0 +1,295 @@
+#include "root_layout_planner.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <optional>
+#include <tuple>
+
+using namespace learning_dx12;
+
+namespace
+{
+	constexpr auto root_descriptor_dwords = uint32_t{ 2 };
+	constexpr auto descriptor_table_dwords = uint32_t{ 1 };
+
+	// Tables are shared by everything updated as often and seen by the same stage.
+	using table_key = std::pair<update_frequency, D3D12_SHADER_VISIBILITY>;
+
+	auto get_register_type(root_data_kind kind) -> char
+	{
+		switch (kind)
+		{
+		case root_data_kind::constants:
+		case root_data_kind::constant_buffer:
+			return 'b';
+		case root_data_kind::buffer_uav:
+			return 'u';
+		default:
+			return 't';
+		}
+	}
+
+	auto get_initial_binding(root_data_kind kind) -> root_binding
+	{
+		switch (kind)
+		{
+		case root_data_kind::constants:
+			return root_binding::constants;
+		case root_data_kind::texture_srv:
+			return root_binding::table;
+		default:
+			return root_binding::descriptor;
+		}
+	}
+
+	auto get_root_size(const std::vector<root_parameter_declaration> &declarations,
+	                   const std::vector<root_binding> &bindings) -> uint32_t
+	{
+		auto size = uint32_t{};
+		auto tables = std::map<table_key, bool>{};
+		for (auto i = size_t{}; i < declarations.size(); i++)
+		{
+			auto &declaration = declarations[i];
+			switch (bindings[i])
+			{
+			case root_binding::constants:
+				size += declaration.size_dwords;
+				break;
+			case root_binding::descriptor:
+				size += root_descriptor_dwords;
+				break;
+			case root_binding::table:
+				tables[{ declaration.frequency, declaration.visibility }] = true;
+				break;
+			}
+		}
+		return size + static_cast<uint32_t>(tables.size()) * descriptor_table_dwords;
+	}
+
+	// The least frequently updated declaration that can move further out,
+	// by the most DWORDs among those. Nothing if everything is in a table.
+	auto find_demotion(const std::vector<root_parameter_declaration> &declarations,
+	                   const std::vector<root_binding> &bindings) -> std::optional<size_t>
+	{
+		auto current_size = get_root_size(declarations, bindings);
+
+		auto best = std::optional<size_t>{};
+		auto best_saving = uint32_t{};
+		for (auto i = size_t{}; i < declarations.size(); i++)
+		{
+			auto binding = bindings[i];
+			if (binding == root_binding::table
+			    or (binding == root_binding::constants and declarations[i].size_dwords <= root_descriptor_dwords))
+			{
+				continue;
+			}
+
+			auto demoted = bindings;
+			demoted[i] = binding == root_binding::constants ? root_binding::descriptor : root_binding::table;
+			auto demoted_size = get_root_size(declarations, demoted);
+			if (demoted_size >= current_size)
+			{
+				continue;
+			}
+
+			auto saving = current_size - demoted_size;
+			if (not best
+			    or declarations[i].frequency < declarations[*best].frequency
+			    or (declarations[i].frequency == declarations[*best].frequency and saving > best_saving))
+			{
+				best = i;
+				best_saving = saving;
+			}
+		}
+		return best;
+	}
+
+	auto get_range_type(char register_type) -> D3D12_DESCRIPTOR_RANGE_TYPE
+	{
+		switch (register_type)
+		{
+		case 'b':
+			return D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
+		case 'u':
+			return D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+		default:
+			return D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+		}
+	}
+
+	// Written by shaders, so not static the way constants and shader resources are.
+	auto is_static_data(char register_type) -> bool
+	{
+		return register_type != 'u';
+	}
+}
+
+auto learning_dx12::plan_root_layout(std::vector<root_parameter_declaration> declarations,
+                                     uint32_t budget_dwords) -> root_layout
+{
+	auto bindings = std::vector<root_binding>{};
+	for (auto &declaration : declarations)
+	{
+		assert(declaration.kind != root_data_kind::constants or declaration.size_dwords > 0);
+		bindings.push_back(get_initial_binding(declaration.kind));
+	}
+
+	while (get_root_size(declarations, bindings) > budget_dwords)
+	{
+		auto demotion = find_demotion(declarations, bindings);
+		if (not demotion)
+		{
+			break;
+		}
+		auto &binding = bindings[*demotion];
+		binding = binding == root_binding::constants ? root_binding::descriptor : root_binding::table;
+	}
+
+	auto layout = root_layout{};
+	layout.declarations = std::move(declarations);
+	layout.parameters.resize(layout.declarations.size());
+
+	// One slot per constant block and root descriptor, one per table.
+	auto tables = std::map<table_key, size_t>{};
+	for (auto i = size_t{}; i < layout.declarations.size(); i++)
+	{
+		auto &declaration = layout.declarations[i];
+		auto key = table_key{ declaration.frequency, declaration.visibility };
+		if (bindings[i] == root_binding::table and tables.count(key) > 0)
+		{
+			layout.slots[tables[key]].declarations.push_back(static_cast<uint32_t>(i));
+			continue;
+		}
+
+		if (bindings[i] == root_binding::table)
+		{
+			tables[key] = layout.slots.size();
+		}
+
+		auto size_dwords = bindings[i] == root_binding::constants  ? declaration.size_dwords
+		                 : bindings[i] == root_binding::descriptor ? root_descriptor_dwords
+		                                                           : descriptor_table_dwords;
+		layout.slots.push_back({ bindings[i],
+		                         declaration.frequency,
+		                         declaration.visibility,
+		                         size_dwords,
+		                         { static_cast<uint32_t>(i) } });
+	}
+
+	// Set every draw first, then inline data before indirection.
+	std::stable_sort(layout.slots.begin(), layout.slots.end(), [](const root_slot &a, const root_slot &b)
+	{
+		return std::tie(b.frequency, a.binding, a.declarations.front())
+		     < std::tie(a.frequency, b.binding, b.declarations.front());
+	});
+
+	auto next_register = std::map<char, uint32_t>{ { 'b', 0 }, { 't', 0 }, { 'u', 0 } };
+	for (auto root_index = uint32_t{}; root_index < layout.slots.size(); root_index++)
+	{
+		auto &slot = layout.slots[root_index];
+		layout.size_dwords += slot.size_dwords;
+		if (slot.frequency == update_frequency::per_draw)
+		{
+			layout.per_draw_updates++;
+		}
+
+		for (auto table_offset = uint32_t{}; table_offset < slot.declarations.size(); table_offset++)
+		{
+			auto declaration = slot.declarations[table_offset];
+			auto register_type = get_register_type(layout.declarations[declaration].kind);
+			layout.parameters[declaration] = { slot.binding,
+			                                   root_index,
+			                                   table_offset,
+			                                   register_type,
+			                                   next_register[register_type]++ };
+		}
+	}
+
+	layout.fits = layout.size_dwords <= budget_dwords;
+	return layout;
+}
+
+auto learning_dx12::emit_hlsl(const root_layout &layout) -> std::string
+{
+	auto hlsl = fmt::format("// Generated by plan_root_layout, {} DWORDs, {} root arguments set per draw.\n",
+	                        layout.size_dwords, layout.per_draw_updates);
+
+	for (auto &slot : layout.slots)
+	{
+		for (auto declaration : slot.declarations)
+		{
+			auto &source = layout.declarations[declaration];
+			auto &planned = layout.parameters[declaration];
+			auto type = planned.register_type == 'b' ? fmt::format("ConstantBuffer<{}>", source.hlsl_type)
+			                                         : source.hlsl_type;
+			hlsl += fmt::format("{} {} : register({}{});\n", type, source.name, planned.register_type, planned.shader_register);
+		}
+	}
+	return hlsl;
+}
+
+root_signature_layout::root_signature_layout(const root_layout &layout, D3D12_ROOT_SIGNATURE_FLAGS flags)
+{
+	parameters.resize(layout.slots.size());
+	ranges.resize(layout.slots.size());
+
+	for (auto root_index = size_t{}; root_index < layout.slots.size(); root_index++)
+	{
+		auto &slot = layout.slots[root_index];
+		auto &parameter = parameters[root_index];
+		auto &first = layout.parameters[slot.declarations.front()];
+		parameter.ShaderVisibility = slot.visibility;
+
+		switch (slot.binding)
+		{
+		case root_binding::constants:
+			parameter.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+			parameter.Constants = { first.shader_register, 0, slot.size_dwords };
+			break;
+
+		case root_binding::descriptor:
+			parameter.ParameterType = first.register_type == 'b' ? D3D12_ROOT_PARAMETER_TYPE_CBV
+			                        : first.register_type == 'u' ? D3D12_ROOT_PARAMETER_TYPE_UAV
+			                                                     : D3D12_ROOT_PARAMETER_TYPE_SRV;
+			parameter.Descriptor = { first.shader_register,
+			                         0,
+			                         is_static_data(first.register_type) ? D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE
+			                                                             : D3D12_ROOT_DESCRIPTOR_FLAG_NONE };
+			break;
+
+		case root_binding::table:
+			for (auto declaration : slot.declarations)
+			{
+				auto &planned = layout.parameters[declaration];
+				ranges[root_index].push_back({ get_range_type(planned.register_type),
+				                               1,
+				                               planned.shader_register,
+				                               0,
+				                               is_static_data(planned.register_type) ? D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE
+				                                                                     : D3D12_DESCRIPTOR_RANGE_FLAG_NONE,
+				                               planned.table_offset });
+			}
+			parameter.ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+			parameter.DescriptorTable = { static_cast<uint32_t>(ranges[root_index].size()),
+			                              ranges[root_index].data() };
+			break;
+		}
+	}
+
+	desc.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
+	desc.Desc_1_1.NumParameters = static_cast<uint32_t>(parameters.size());
+	desc.Desc_1_1.pParameters = parameters.data();
+	desc.Desc_1_1.NumStaticSamplers = 0;
+	desc.Desc_1_1.pStaticSamplers = nullptr;
+	desc.Desc_1_1.Flags = flags;
+}
+
+root_signature_layout::~root_signature_layout() = default;
+
+auto root_signature_layout::get_desc() const -> const D3D12_VERSIONED_ROOT_SIGNATURE_DESC &
+{
+	return desc;
+}
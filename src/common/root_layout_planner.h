@@ -0,0 +1,110 @@
+#pragma once
+
+#include <d3d12.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace learning_dx12
+{
+	// How often a parameter's data changes, least often first.
+	enum class update_frequency : uint8_t
+	{
+		per_frame,
+		per_material,
+		per_draw,
+	};
+
+	enum class root_data_kind : uint8_t
+	{
+		constants,       // a struct of 32 bit values, read as a ConstantBuffer
+		constant_buffer, // a struct in a buffer
+		buffer_srv,
+		buffer_uav,
+		texture_srv,     // only reachable through a descriptor table
+	};
+
+	// What the shaders declare, and what the application sets.
+	struct root_parameter_declaration
+	{
+		std::string name;      // of the HLSL variable
+		std::string hlsl_type; // the struct for constants and constant buffers, the whole type otherwise
+		root_data_kind kind;
+		update_frequency frequency;
+		uint32_t size_dwords;  // of the struct, constants only
+		D3D12_SHADER_VISIBILITY visibility;
+	};
+
+	// Root constants cost their size, a root descriptor 2 DWORDs,
+	// a descriptor table 1 DWORD however many descriptors it holds.
+	enum class root_binding : uint8_t
+	{
+		constants,
+		descriptor,
+		table,
+	};
+
+	struct planned_parameter
+	{
+		root_binding binding;
+		uint32_t root_index;
+		uint32_t table_offset;    // descriptors before this one in its table
+		char register_type;       // 'b', 't' or 'u'
+		uint32_t shader_register;
+	};
+
+	struct root_slot
+	{
+		root_binding binding;
+		update_frequency frequency;
+		D3D12_SHADER_VISIBILITY visibility;
+		uint32_t size_dwords;
+		std::vector<uint32_t> declarations; // in table order, one unless a table
+	};
+
+	struct root_layout
+	{
+		std::vector<root_parameter_declaration> declarations;
+		std::vector<planned_parameter> parameters; // one per declaration, same order
+		std::vector<root_slot> slots;              // by root index
+		uint32_t size_dwords;
+		uint32_t per_draw_updates;                 // root arguments set for every draw
+		bool fits;                                 // within the budget
+	};
+
+	constexpr auto root_signature_budget_dwords = uint32_t{ 64 };
+
+	// Everything starts as close to the root as it can be, constants inline and
+	// buffers as root descriptors. While over budget, the least frequently
+	// updated parameter that can move further out does: constants into a
+	// constant buffer, descriptors into their frequency's table.
+	// Slots are then ordered most frequently updated first, and registers
+	// handed out in slot order, so parameters set every draw come first.
+	// Needs no device, the same declarations always give the same layout.
+	auto plan_root_layout(std::vector<root_parameter_declaration> declarations,
+	                      uint32_t budget_dwords = root_signature_budget_dwords) -> root_layout;
+
+	// HLSL declaring every parameter at its planned register. Types named
+	// in the declarations must be defined before it is included.
+	auto emit_hlsl(const root_layout &layout) -> std::string;
+
+	// The layout as a root signature description, for root_signature_registry.
+	// Points into itself, so it can't be copied.
+	class root_signature_layout
+	{
+	public:
+		root_signature_layout(const root_layout &layout, D3D12_ROOT_SIGNATURE_FLAGS flags);
+		root_signature_layout() = delete;
+		root_signature_layout(const root_signature_layout &) = delete;
+		auto operator=(const root_signature_layout &) -> root_signature_layout & = delete;
+		~root_signature_layout();
+
+		auto get_desc() const -> const D3D12_VERSIONED_ROOT_SIGNATURE_DESC &;
+
+	private:
+		std::vector<D3D12_ROOT_PARAMETER1> parameters{};
+		std::vector<std::vector<D3D12_DESCRIPTOR_RANGE1>> ranges{}; // per parameter, empty unless a table
+		D3D12_VERSIONED_ROOT_SIGNATURE_DESC desc{};
+	};
+}
@@ -0,0 +1,468 @@
+#include "shader_archive.h"
+
+#include "fnv_hash.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace learning_dx12;
+using namespace learning_dx12::shader_archive_format;
+
+namespace
+{
+	auto align_up(uint64_t value, uint64_t alignment) -> uint64_t
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// A small LZ77 block format, in the spirit of LZ4. Each sequence is a
+	// token, whose high nibble counts literals and low nibble the match
+	// length past the minimum, 15 meaning more follows in bytes of 255.
+	// Then the literals, then a 16 bit offset back to the match. The last
+	// sequence has only literals.
+	constexpr auto min_match = size_t{ 4 };
+	constexpr auto max_offset = size_t{ 65535 };
+	constexpr auto match_table_bits = 12u;
+	constexpr auto no_position = UINT32_MAX;
+
+	auto read_u32(const uint8_t *bytes) -> uint32_t
+	{
+		auto value = uint32_t{};
+		std::memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+
+	auto hash_sequence(uint32_t sequence) -> uint32_t
+	{
+		return (sequence * 2654435761u) >> (32 - match_table_bits);
+	}
+
+	void write_length(std::vector<uint8_t> &out, size_t length)
+	{
+		for (; length >= 255; length -= 255)
+		{
+			out.push_back(255);
+		}
+		out.push_back(static_cast<uint8_t>(length));
+	}
+
+	void write_sequence(std::vector<uint8_t> &out, const uint8_t *literals, size_t literal_count,
+	                    size_t offset, size_t match_length)
+	{
+		auto literal_nibble = std::min(literal_count, size_t{ 15 });
+		auto match_nibble = offset ? std::min(match_length - min_match, size_t{ 15 }) : size_t{};
+
+		out.push_back(static_cast<uint8_t>(literal_nibble << 4 | match_nibble));
+		if (literal_nibble == 15)
+		{
+			write_length(out, literal_count - 15);
+		}
+		out.insert(out.end(), literals, literals + literal_count);
+
+		if (offset == 0)
+		{
+			return;
+		}
+
+		out.push_back(static_cast<uint8_t>(offset & 0xff));
+		out.push_back(static_cast<uint8_t>(offset >> 8));
+		if (match_nibble == 15)
+		{
+			write_length(out, match_length - min_match - 15);
+		}
+	}
+
+	auto read_length(const uint8_t *&in, const uint8_t *end, size_t &length) -> bool
+	{
+		auto byte = uint8_t{};
+		do
+		{
+			if (in == end)
+			{
+				return false;
+			}
+			byte = *in++;
+			length += byte;
+		} while (byte == 255);
+
+		return true;
+	}
+
+	template <typename T>
+	void write_at(std::vector<uint8_t> &archive, uint64_t offset, const T &value)
+	{
+		std::memcpy(archive.data() + offset, &value, sizeof(T));
+	}
+}
+
+auto shader_archive_format::hash_name(std::string_view name) -> uint64_t
+{
+	return hash_bytes(name.data(), name.size());
+}
+
+// Greedy, one candidate per hash slot. Fast rather than tight.
+auto shader_archive_format::lz_compress(const uint8_t *data, size_t size) -> std::vector<uint8_t>
+{
+	auto out = std::vector<uint8_t>{};
+	out.reserve(size);
+
+	auto table = std::vector<uint32_t>(size_t{ 1 } << match_table_bits, no_position);
+	auto anchor = size_t{},
+	     position = size_t{};
+
+	while (position + min_match <= size)
+	{
+		auto sequence = read_u32(data + position);
+		auto &slot = table[hash_sequence(sequence)];
+		auto candidate = slot;
+		slot = static_cast<uint32_t>(position);
+
+		if (candidate == no_position
+		    or position - candidate > max_offset
+		    or read_u32(data + candidate) != sequence)
+		{
+			position++;
+			continue;
+		}
+
+		auto length = min_match;
+		while (position + length < size and data[candidate + length] == data[position + length])
+		{
+			length++;
+		}
+
+		write_sequence(out, data + anchor, position - anchor, position - candidate, length);
+		position += length;
+		anchor = position;
+	}
+
+	write_sequence(out, data + anchor, size - anchor, 0, 0);
+	return out;
+}
+
+// Every read and write is bounds checked, a damaged archive fails here.
+auto shader_archive_format::lz_decompress(const uint8_t *in, size_t in_size, uint8_t *out, size_t out_size) -> bool
+{
+	auto end = in + in_size;
+	auto written = size_t{};
+
+	while (in < end)
+	{
+		auto token = *in++;
+
+		auto literal_count = static_cast<size_t>(token >> 4);
+		if (literal_count == 15 and not read_length(in, end, literal_count))
+		{
+			return false;
+		}
+		if (literal_count > static_cast<size_t>(end - in) or literal_count > out_size - written)
+		{
+			return false;
+		}
+		std::memcpy(out + written, in, literal_count);
+		in += literal_count;
+		written += literal_count;
+
+		if (in == end)
+		{
+			break;
+		}
+
+		if (end - in < 2)
+		{
+			return false;
+		}
+		auto offset = size_t{ in[0] } | size_t{ in[1] } << 8;
+		in += 2;
+
+		auto match_length = static_cast<size_t>(token & 0xf);
+		if (match_length == 15 and not read_length(in, end, match_length))
+		{
+			return false;
+		}
+		match_length += min_match;
+
+		if (offset == 0 or offset > written or match_length > out_size - written)
+		{
+			return false;
+		}
+
+		// Byte by byte, a match may overlap what it is copying.
+		for (auto i = size_t{}; i < match_length; i++)
+		{
+			out[written + i] = out[written - offset + i];
+		}
+		written += match_length;
+	}
+
+	return written == out_size;
+}
+
+shader_archive_writer::shader_archive_writer() = default;
+shader_archive_writer::~shader_archive_writer() = default;
+
+// Adding a name again replaces what it had.
+void shader_archive_writer::add(std::string_view name, const void *data, size_t size)
+{
+	auto bytes = static_cast<const uint8_t *>(data);
+	auto content_hash = hash_bytes(data, size);
+	stats.input_size += size;
+
+	auto [first, last] = blobs_by_hash.equal_range(content_hash);
+	auto same = std::find_if(first, last, [&](auto &candidate)
+	{
+		auto &blob = blobs[candidate.second];
+		return std::equal(blob.begin(), blob.end(), bytes, bytes + size);
+	});
+
+	auto blob_index = uint32_t{};
+	if (same != last)
+	{
+		blob_index = same->second;
+	}
+	else
+	{
+		blob_index = static_cast<uint32_t>(blobs.size());
+		blobs.emplace_back(bytes, bytes + size);
+		blobs_by_hash.emplace(content_hash, blob_index);
+	}
+
+	auto existing = std::find_if(entries.begin(), entries.end(), [&](auto &entry)
+	{
+		return entry.name == name;
+	});
+	if (existing != entries.end())
+	{
+		existing->blob = blob_index;
+		return;
+	}
+
+	entries.push_back({ std::string{ name }, blob_index });
+}
+
+// Blobs are compressed only when that saves at least an eighth,
+// otherwise they are stored as is and can be used in place.
+auto shader_archive_writer::build(bool compress) -> std::vector<uint8_t>
+{
+	std::sort(entries.begin(), entries.end(), [](const pending_entry &a, const pending_entry &b)
+	{
+		auto hash_a = hash_name(a.name),
+		     hash_b = hash_name(b.name);
+		if (hash_a != hash_b)
+		{
+			return hash_a < hash_b;
+		}
+		return a.name < b.name;
+	});
+
+	auto names_size = uint64_t{};
+	for (auto &entry : entries)
+	{
+		names_size += entry.name.size();
+	}
+
+	auto stored_blobs = std::vector<std::vector<uint8_t>>(blobs.size());
+	auto blob_table = std::vector<blob>(blobs.size());
+
+	auto offset = sizeof(header)
+	            + entries.size() * sizeof(entry)
+	            + blobs.size() * sizeof(blob)
+	            + names_size;
+
+	for (auto i = size_t{}; i < blobs.size(); i++)
+	{
+		auto &source = blobs[i];
+		auto &stored = stored_blobs[i];
+		auto method = compression::none;
+
+		if (compress)
+		{
+			stored = lz_compress(source.data(), source.size());
+			method = (stored.size() + stored.size() / 8 < source.size())
+			       ? compression::lz
+			       : compression::none;
+		}
+		if (method == compression::none)
+		{
+			stored = source;
+		}
+
+		offset = align_up(offset, blob_alignment);
+		blob_table[i] = { offset,
+		                  stored.size(),
+		                  source.size(),
+		                  hash_bytes(source.data(), source.size()),
+		                  method,
+		                  0 };
+		offset += stored.size();
+	}
+
+	auto archive = std::vector<uint8_t>(offset);
+
+	write_at(archive, 0, header{ file_magic,
+	                             file_version,
+	                             static_cast<uint32_t>(entries.size()),
+	                             static_cast<uint32_t>(blobs.size()),
+	                             names_size });
+
+	auto entry_offset = uint64_t{ sizeof(header) };
+	auto blob_offset = entry_offset + entries.size() * sizeof(entry);
+	auto names_offset = blob_offset + blobs.size() * sizeof(blob);
+	auto name_offset = uint32_t{};
+
+	for (auto &pending : entries)
+	{
+		write_at(archive, entry_offset, entry{ hash_name(pending.name),
+		                                       name_offset,
+		                                       static_cast<uint32_t>(pending.name.size()),
+		                                       pending.blob,
+		                                       0 });
+		std::memcpy(archive.data() + names_offset + name_offset, pending.name.data(), pending.name.size());
+
+		entry_offset += sizeof(entry);
+		name_offset += static_cast<uint32_t>(pending.name.size());
+	}
+
+	for (auto i = size_t{}; i < blobs.size(); i++)
+	{
+		write_at(archive, blob_offset + i * sizeof(blob), blob_table[i]);
+		std::memcpy(archive.data() + blob_table[i].offset, stored_blobs[i].data(), stored_blobs[i].size());
+	}
+
+	stats.entry_count = static_cast<uint32_t>(entries.size());
+	stats.blob_count = static_cast<uint32_t>(blobs.size());
+	stats.archive_size = archive.size();
+
+	return archive;
+}
+
+auto shader_archive_writer::get_stats() const -> writer_stats
+{
+	return stats;
+}
+
+shader_archive::shader_archive(const std::filesystem::path &file_path) :
+	file{ file_path }
+{
+	valid = validate();
+	if (not valid)
+	{
+		return;
+	}
+
+	auto base = file.data();
+	header = reinterpret_cast<const shader_archive_format::header *>(base);
+	entries = reinterpret_cast<const entry *>(base + sizeof(shader_archive_format::header));
+	blobs = reinterpret_cast<const blob *>(entries + header->entry_count);
+	names = reinterpret_cast<const char *>(blobs + header->blob_count);
+}
+
+shader_archive::~shader_archive() = default;
+
+auto shader_archive::is_open() const -> bool
+{
+	return valid;
+}
+
+// Binary search on the name hash, names are compared to rule out collisions.
+auto shader_archive::find(std::string_view name) -> std::optional<shader_bytes>
+{
+	if (not valid)
+	{
+		return std::nullopt;
+	}
+
+	auto name_hash = hash_name(name);
+	auto last = entries + header->entry_count;
+	auto found = std::lower_bound(entries, last, name_hash, [](const entry &e, uint64_t hash)
+	{
+		return e.name_hash < hash;
+	});
+
+	for (; found != last and found->name_hash == name_hash; ++found)
+	{
+		if (std::string_view{ names + found->name_offset, found->name_size } != name)
+		{
+			continue;
+		}
+
+		auto &stored = blobs[found->blob];
+		if (stored.method == compression::none)
+		{
+			return shader_bytes{ file.data() + stored.offset, static_cast<size_t>(stored.size) };
+		}
+
+		auto expanded = expanded_blobs.find(found->blob);
+		if (expanded == expanded_blobs.end())
+		{
+			auto bytes = std::vector<uint8_t>(static_cast<size_t>(stored.size));
+			if (not lz_decompress(file.data() + stored.offset, static_cast<size_t>(stored.stored_size),
+			                      bytes.data(), bytes.size()))
+			{
+				return std::nullopt;
+			}
+			expanded = expanded_blobs.emplace(found->blob, std::move(bytes)).first;
+		}
+		return shader_bytes{ expanded->second.data(), expanded->second.size() };
+	}
+
+	return std::nullopt;
+}
+
+auto shader_archive::get_shader_count() const -> uint32_t
+{
+	return valid ? header->entry_count : 0;
+}
+
+// Every table and blob must lie inside the file, so find never reads past it.
+auto shader_archive::validate() const -> bool
+{
+	if (not file.is_open() or file.size() < sizeof(shader_archive_format::header))
+	{
+		return false;
+	}
+
+	auto base = file.data();
+	auto file_size = static_cast<uint64_t>(file.size());
+	auto &file_header = *reinterpret_cast<const shader_archive_format::header *>(base);
+	if (file_header.magic != file_magic or file_header.version != file_version)
+	{
+		return false;
+	}
+
+	auto tables_size = sizeof(shader_archive_format::header)
+	                 + uint64_t{ file_header.entry_count } * sizeof(entry)
+	                 + uint64_t{ file_header.blob_count } * sizeof(blob);
+	if (tables_size > file_size or file_header.names_size > file_size - tables_size)
+	{
+		return false;
+	}
+
+	auto file_entries = reinterpret_cast<const entry *>(base + sizeof(shader_archive_format::header));
+	auto file_blobs = reinterpret_cast<const blob *>(file_entries + file_header.entry_count);
+
+	for (auto i = 0u; i < file_header.entry_count; i++)
+	{
+		auto &e = file_entries[i];
+		if (e.blob >= file_header.blob_count
+		    or uint64_t{ e.name_offset } + e.name_size > file_header.names_size)
+		{
+			return false;
+		}
+	}
+
+	for (auto i = 0u; i < file_header.blob_count; i++)
+	{
+		auto &b = file_blobs[i];
+		auto known_method = b.method == compression::none or b.method == compression::lz;
+		if (not known_method
+		    or b.offset > file_size
+		    or b.stored_size > file_size - b.offset
+		    or (b.method == compression::none and b.stored_size != b.size))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace learning_dx12
+{
+	// Compiled shaders packed into one file, built by shader_packer.
+	// A sorted index of name hashes points at blobs, identical blobs are
+	// stored once, and each may be compressed if that makes it smaller.
+	namespace shader_archive_format
+	{
+		constexpr auto file_magic = uint32_t{ 0x4b504853 }; // "SHPK"
+		constexpr auto file_version = uint32_t{ 1 };
+		constexpr auto blob_alignment = uint64_t{ 16 };
+
+		enum class compression : uint32_t
+		{
+			none,
+			lz,
+		};
+
+		struct header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t entry_count; // entries follow the header, then blobs, then names
+			uint32_t blob_count;
+			uint64_t names_size;
+		};
+
+		struct entry
+		{
+			uint64_t name_hash;
+			uint32_t name_offset; // into names
+			uint32_t name_size;
+			uint32_t blob;
+			uint32_t reserved;
+		};
+
+		struct blob
+		{
+			uint64_t offset; // from the start of the file
+			uint64_t stored_size;
+			uint64_t size;
+			uint64_t content_hash;
+			compression method;
+			uint32_t reserved;
+		};
+
+		auto hash_name(std::string_view name) -> uint64_t;
+
+		// The codec of lz blobs. Decompressing fails on any stream that would
+		// read or write out of bounds, or not fill out_size exactly.
+		auto lz_compress(const uint8_t *data, size_t size) -> std::vector<uint8_t>;
+		auto lz_decompress(const uint8_t *in, size_t in_size, uint8_t *out, size_t out_size) -> bool;
+	}
+
+	struct shader_bytes
+	{
+		const uint8_t *data;
+		size_t size;
+	};
+
+	// Collects shaders and lays out an archive of them.
+	class shader_archive_writer
+	{
+	public:
+		struct writer_stats
+		{
+			uint32_t entry_count;
+			uint32_t blob_count;     // after removing duplicates
+			uint64_t input_size;     // every shader added, duplicates included
+			uint64_t archive_size;
+		};
+
+	public:
+		shader_archive_writer();
+		~shader_archive_writer();
+
+		void add(std::string_view name, const void *data, size_t size);
+		auto build(bool compress) -> std::vector<uint8_t>;
+
+		auto get_stats() const -> writer_stats;
+
+	private:
+		struct pending_entry
+		{
+			std::string name;
+			uint32_t blob;
+		};
+
+		std::vector<pending_entry> entries{};
+		std::vector<std::vector<uint8_t>> blobs{};
+		std::unordered_multimap<uint64_t, uint32_t> blobs_by_hash{};
+
+		writer_stats stats{};
+	};
+
+	// Memory maps an archive and finds shaders in it by name. Uncompressed
+	// shaders point straight into the mapping, compressed ones are expanded
+	// the first time they are asked for and kept. Pointers stay valid for
+	// as long as the archive is open.
+	class shader_archive
+	{
+	public:
+		shader_archive(const std::filesystem::path &file_path);
+		shader_archive() = delete;
+		~shader_archive();
+
+		auto is_open() const -> bool;
+		auto find(std::string_view name) -> std::optional<shader_bytes>;
+
+		auto get_shader_count() const -> uint32_t;
+
+	private:
+		auto validate() const -> bool;
+
+	private:
+		mapped_file file;
+		bool valid{};
+
+		const shader_archive_format::header *header{};
+		const shader_archive_format::entry *entries{};
+		const shader_archive_format::blob *blobs{};
+		const char *names{};
+
+		std::unordered_map<uint32_t, std::vector<uint8_t>> expanded_blobs{};
+	};
+}
@@ -0,0 +1,135 @@
+#include "shader_dependency_graph.h"
+
+#include <algorithm>
+#include <iterator>
+
+using namespace learning_dx12;
+
+namespace
+{
+	// Removes one value from the set at key, and the key once its set is empty.
+	template <typename map_type, typename key_type, typename value_type>
+	void erase_from_set(map_type &map, const key_type &key, const value_type &value)
+	{
+		auto found = map.find(key);
+		if (found == map.end())
+		{
+			return;
+		}
+
+		found->second.erase(value);
+		if (found->second.empty())
+		{
+			map.erase(found);
+		}
+	}
+}
+
+shader_dependency_graph::shader_dependency_graph() = default;
+
+shader_dependency_graph::~shader_dependency_graph() = default;
+
+void shader_dependency_graph::set_shader_files(const std::string &shader, const std::vector<std::filesystem::path> &files)
+{
+	remove_shader(shader);
+
+	auto &shader_files = files_by_shader[shader];
+	for (auto &file : files)
+	{
+		auto normal = normalize(file);
+		shaders_by_file[normal].insert(shader);
+		shader_files.push_back(std::move(normal));
+	}
+}
+
+// Pipelines keep their link to the shader, it may be added again.
+void shader_dependency_graph::remove_shader(const std::string &shader)
+{
+	auto found = files_by_shader.find(shader);
+	if (found == files_by_shader.end())
+	{
+		return;
+	}
+
+	for (auto &file : found->second)
+	{
+		erase_from_set(shaders_by_file, file, shader);
+	}
+	files_by_shader.erase(found);
+}
+
+void shader_dependency_graph::set_pipeline_shaders(reloadable_pipeline pipeline, const std::vector<std::string> &shaders)
+{
+	remove_pipeline(pipeline);
+
+	for (auto &shader : shaders)
+	{
+		pipelines_by_shader[shader].insert(pipeline);
+	}
+	shaders_by_pipeline.emplace(pipeline, shaders);
+}
+
+void shader_dependency_graph::remove_pipeline(reloadable_pipeline pipeline)
+{
+	auto found = shaders_by_pipeline.find(pipeline);
+	if (found == shaders_by_pipeline.end())
+	{
+		return;
+	}
+
+	for (auto &shader : found->second)
+	{
+		erase_from_set(pipelines_by_shader, shader, pipeline);
+	}
+	shaders_by_pipeline.erase(found);
+}
+
+// Sorted, and each shader is listed once however many of its files changed.
+auto shader_dependency_graph::get_affected_shaders(const std::vector<std::filesystem::path> &changed_files) const
+	-> std::vector<std::string>
+{
+	auto affected = std::set<std::string>{};
+	for (auto &file : changed_files)
+	{
+		auto found = shaders_by_file.find(normalize(file));
+		if (found != shaders_by_file.end())
+		{
+			affected.insert(found->second.begin(), found->second.end());
+		}
+	}
+	return { affected.begin(), affected.end() };
+}
+
+// Sorted, and each pipeline is listed once however many of its shaders changed.
+auto shader_dependency_graph::get_affected_pipelines(const std::vector<std::string> &changed_shaders) const
+	-> std::vector<reloadable_pipeline>
+{
+	auto affected = std::set<reloadable_pipeline>{};
+	for (auto &shader : changed_shaders)
+	{
+		auto found = pipelines_by_shader.find(shader);
+		if (found != pipelines_by_shader.end())
+		{
+			affected.insert(found->second.begin(), found->second.end());
+		}
+	}
+	return { affected.begin(), affected.end() };
+}
+
+auto shader_dependency_graph::get_files() const -> std::vector<std::filesystem::path>
+{
+	auto files = std::vector<std::filesystem::path>{};
+	files.reserve(shaders_by_file.size());
+	std::transform(shaders_by_file.begin(), shaders_by_file.end(),
+	               std::back_inserter(files),
+	               [](const auto &file_shaders)
+	{
+		return file_shaders.first;
+	});
+	return files;
+}
+
+auto shader_dependency_graph::normalize(const std::filesystem::path &file) -> std::filesystem::path
+{
+	return file.lexically_normal();
+}
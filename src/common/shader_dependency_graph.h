@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace learning_dx12
+{
+	using reloadable_pipeline = uint32_t;
+
+	// Which files each shader is built from, and which shaders each pipeline
+	// uses, so a set of changed files can be turned into the shaders to
+	// rebuild and the pipelines to rebuild after them.
+	// Knows nothing about devices or the file system, paths are only compared
+	// after being made lexically normal. Not thread-safe.
+	class shader_dependency_graph
+	{
+	public:
+		shader_dependency_graph();
+		~shader_dependency_graph();
+
+		// Replaces whatever the shader was built from before,
+		// includes found by a new compile can differ from the last one.
+		void set_shader_files(const std::string &shader, const std::vector<std::filesystem::path> &files);
+		void remove_shader(const std::string &shader);
+
+		void set_pipeline_shaders(reloadable_pipeline pipeline, const std::vector<std::string> &shaders);
+		void remove_pipeline(reloadable_pipeline pipeline);
+
+		auto get_affected_shaders(const std::vector<std::filesystem::path> &changed_files) const -> std::vector<std::string>;
+		auto get_affected_pipelines(const std::vector<std::string> &changed_shaders) const -> std::vector<reloadable_pipeline>;
+
+		auto get_files() const -> std::vector<std::filesystem::path>;
+
+	private:
+		static auto normalize(const std::filesystem::path &file) -> std::filesystem::path;
+
+	private:
+		std::map<std::filesystem::path, std::set<std::string>> shaders_by_file{};
+		std::map<std::string, std::vector<std::filesystem::path>> files_by_shader{};
+
+		std::map<std::string, std::set<reloadable_pipeline>> pipelines_by_shader{};
+		std::map<reloadable_pipeline, std::vector<std::string>> shaders_by_pipeline{};
+	};
+}
@@ -0,0 +1,165 @@
+#include "shader_permutations.h"
+
+#include <charconv>
+#include <fstream>
+
+using namespace learning_dx12;
+
+namespace
+{
+	auto split_fields(std::string_view line) -> std::vector<std::string_view>
+	{
+		auto fields = std::vector<std::string_view>{};
+		while (true)
+		{
+			auto tab = line.find('\t');
+			fields.push_back(line.substr(0, tab));
+			if (tab == std::string_view::npos)
+			{
+				return fields;
+			}
+			line.remove_prefix(tab + 1);
+		}
+	}
+
+	// Fields are: shader, bits, name, profile, source, then key=value per key.
+	auto parse_variant(const std::vector<std::string_view> &fields, std::string &shader, shader_variant &variant) -> bool
+	{
+		if (fields.size() < 5)
+		{
+			return false;
+		}
+
+		auto [end, error] = std::from_chars(fields[1].data(), fields[1].data() + fields[1].size(), variant.bits);
+		if (error != std::errc{} or end != fields[1].data() + fields[1].size())
+		{
+			return false;
+		}
+
+		shader = fields[0];
+		variant.name = fields[2];
+		variant.profile = fields[3];
+		variant.source_file = std::filesystem::path{ fields[4] };
+
+		for (auto i = size_t{ 5 }; i < fields.size(); i++)
+		{
+			auto equals = fields[i].find('=');
+			if (equals == std::string_view::npos)
+			{
+				return false;
+			}
+			variant.defines.push_back({ std::string{ fields[i].substr(0, equals) },
+			                            std::string{ fields[i].substr(equals + 1) } });
+		}
+		return true;
+	}
+}
+
+// Anything wrong with the file and none of it is used.
+shader_permutations::shader_permutations(const std::filesystem::path &file_path)
+{
+	open = load(file_path);
+	if (not open)
+	{
+		variants.clear();
+		variant_count = 0;
+	}
+}
+
+shader_permutations::~shader_permutations() = default;
+
+auto shader_permutations::is_open() const -> bool
+{
+	return open;
+}
+
+auto shader_permutations::find(std::string_view shader, permutation_bits bits) const -> const shader_variant *
+{
+	auto found = variants.find(std::string{ shader });
+	if (found == variants.end() or bits >= found->second.size())
+	{
+		return nullptr;
+	}
+	return &found->second[bits];
+}
+
+// Keys are in the same order in every variant, the first one is enough.
+auto shader_permutations::get_key_bit(std::string_view shader, std::string_view key) const -> permutation_bits
+{
+	auto found = variants.find(std::string{ shader });
+	if (found == variants.end())
+	{
+		return 0;
+	}
+
+	auto &defines = found->second.front().defines;
+	for (auto i = size_t{}; i < defines.size(); i++)
+	{
+		if (defines[i].name == key)
+		{
+			return permutation_bits{ 1 } << i;
+		}
+	}
+	return 0;
+}
+
+auto shader_permutations::get_variant_count() const -> uint32_t
+{
+	return variant_count;
+}
+
+// Every shader must list all 2^keys variants, each exactly once.
+auto shader_permutations::load(const std::filesystem::path &file_path) -> bool
+{
+	auto file = std::ifstream(file_path);
+	if (not file.is_open())
+	{
+		return false;
+	}
+
+	auto line = std::string{};
+	while (std::getline(file, line))
+	{
+		if (line.empty() or line.front() == '#')
+		{
+			continue;
+		}
+
+		auto shader = std::string{};
+		auto variant = shader_variant{};
+		if (not parse_variant(split_fields(line), shader, variant))
+		{
+			return false;
+		}
+
+		auto &shader_variants = variants[shader];
+		auto variants_expected = size_t{ 1 } << variant.defines.size();
+		if (variant.bits >= variants_expected)
+		{
+			return false;
+		}
+		if (shader_variants.empty())
+		{
+			shader_variants.resize(variants_expected);
+		}
+		if (shader_variants.size() != variants_expected or not shader_variants[variant.bits].name.empty())
+		{
+			return false;
+		}
+
+		shader_variants[variant.bits] = std::move(variant);
+		variant_count++;
+	}
+
+	for (auto &[shader, shader_variants] : variants)
+	{
+		for (auto &variant : shader_variants)
+		{
+			if (variant.name.empty())
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace learning_dx12
+{
+	// Bit i is set when the i-th key declared with shader_permutation_keys is 1.
+	using permutation_bits = uint32_t;
+
+	struct shader_define
+	{
+		std::string name;
+		std::string value;
+	};
+
+	struct shader_variant
+	{
+		std::string name;                   // in the shader archive
+		permutation_bits bits;
+		std::string profile;
+		std::filesystem::path source_file;
+		std::vector<shader_define> defines; // one per key, in bit order
+	};
+
+	// Reads the manifest target_shader_sources writes beside the shader
+	// archive. It lists every compiled variant of every shader, so the
+	// archive name of one is found from the shader's name and the bits
+	// of the keys it was compiled with.
+	class shader_permutations
+	{
+	public:
+		shader_permutations(const std::filesystem::path &file_path);
+		shader_permutations() = delete;
+		~shader_permutations();
+
+		auto is_open() const -> bool;
+		auto find(std::string_view shader, permutation_bits bits) const -> const shader_variant *;
+
+		// Zero if the shader has no such key.
+		auto get_key_bit(std::string_view shader, std::string_view key) const -> permutation_bits;
+		auto get_variant_count() const -> uint32_t;
+
+	private:
+		auto load(const std::filesystem::path &file_path) -> bool;
+
+	private:
+		std::unordered_map<std::string, std::vector<shader_variant>> variants{}; // indexed by bits
+		uint32_t variant_count{};
+		bool open{};
+	};
+}
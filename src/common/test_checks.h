@@ -0,0 +1,46 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include <string_view>
+
+namespace learning_dx12
+{
+	// Counts and prints failed checks, a test's main returns get_exit_code()
+	// so ctest sees them. Unlike assert, checks stay on in release builds.
+	class test_checks
+	{
+	public:
+		void check(bool passed, std::string_view what)
+		{
+			checked_count++;
+			if (passed)
+			{
+				return;
+			}
+
+			failed_count++;
+			fmt::print(stderr, "  failed: {}\n", what);
+		}
+
+		template <typename actual_type, typename expected_type>
+		void check_equal(const actual_type &actual, const expected_type &expected, std::string_view what)
+		{
+			check(actual == expected, what);
+			if (not (actual == expected))
+			{
+				fmt::print(stderr, "    got {}, expected {}\n", actual, expected);
+			}
+		}
+
+		auto get_exit_code() const -> int
+		{
+			fmt::print("{} of {} checks passed\n", checked_count - failed_count, checked_count);
+			return failed_count == 0 ? 0 : 1;
+		}
+
+	private:
+		size_t checked_count{};
+		size_t failed_count{};
+	};
+}
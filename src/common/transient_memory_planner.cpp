@@ -0,0 +1,130 @@
+#include "transient_memory_planner.h"
+
+#include <algorithm>
+#include <numeric>
+#include <cassert>
+
+using namespace learning_dx12;
+
+namespace
+{
+	auto align_up(uint64_t value, uint64_t alignment) -> uint64_t
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	auto lifetimes_overlap(const transient_request &a, const transient_request &b) -> bool
+	{
+		return a.first_use <= b.last_use
+		   and b.first_use <= a.last_use;
+	}
+
+	struct memory_range
+	{
+		uint64_t begin;
+		uint64_t end;
+	};
+}
+
+auto learning_dx12::plan_transient_memory(const std::vector<transient_request> &requests) -> transient_plan
+{
+	auto plan = transient_plan{};
+	plan.placements.resize(requests.size(), { 0, transient_placement::no_previous });
+
+	auto order = std::vector<uint32_t>(requests.size());
+	std::iota(order.begin(), order.end(), 0u);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+	{
+		if (requests[a].size != requests[b].size)
+		{
+			return requests[a].size > requests[b].size;
+		}
+		return requests[a].first_use < requests[b].first_use;
+	});
+
+	auto placed = std::vector<uint32_t>{};
+	placed.reserve(requests.size());
+	auto taken = std::vector<memory_range>{};
+
+	for (auto index : order)
+	{
+		auto &request = requests[index];
+		assert(request.alignment > 0);
+		assert(request.first_use <= request.last_use);
+
+		taken.clear();
+		for (auto other : placed)
+		{
+			if (lifetimes_overlap(request, requests[other]))
+			{
+				auto offset = plan.placements[other].offset;
+				taken.push_back({ offset, offset + requests[other].size });
+			}
+		}
+		std::sort(taken.begin(), taken.end(), [](const memory_range &a, const memory_range &b)
+		{
+			return a.begin < b.begin;
+		});
+
+		auto offset = uint64_t{};
+		for (auto &range : taken)
+		{
+			if (offset + request.size <= range.begin)
+			{
+				break;
+			}
+			offset = std::max(offset, align_up(range.end, request.alignment));
+		}
+
+		plan.placements[index].offset = offset;
+		plan.heap_size = std::max(plan.heap_size, offset + request.size);
+		plan.naive_size += align_up(request.size, request.alignment);
+
+		placed.push_back(index);
+	}
+
+	// Whatever sat in the same memory and died before this one started
+	// has to be aliased away. Placement never lets the lifetimes overlap.
+	for (auto index = 0u; index < requests.size(); index++)
+	{
+		auto &request = requests[index];
+		auto begin = plan.placements[index].offset;
+		auto end = begin + request.size;
+
+		auto &placement = plan.placements[index];
+		auto shared_with_later = false;
+		for (auto other = 0u; other < requests.size(); other++)
+		{
+			auto other_begin = plan.placements[other].offset;
+			auto other_end = other_begin + requests[other].size;
+			auto shares_memory = other_begin < end and begin < other_end;
+
+			if (other == index or not shares_memory)
+			{
+				continue;
+			}
+
+			if (requests[other].last_use >= request.first_use)
+			{
+				shared_with_later = true;
+				continue;
+			}
+
+			placement.previous = (placement.previous == transient_placement::no_previous)
+			                   ? other
+			                   : transient_placement::any_previous;
+		}
+
+		if (shared_with_later and placement.previous == transient_placement::no_previous)
+		{
+			placement.previous = transient_placement::any_previous;
+		}
+
+		if (placement.previous != transient_placement::no_previous)
+		{
+			plan.aliased_count++;
+		}
+	}
+
+	return plan;
+}
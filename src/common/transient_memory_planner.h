@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace learning_dx12
+{
+	// Memory a transient resource needs, and the span of passes (or pass
+	// batches) it is alive for, first_use and last_use included.
+	struct transient_request
+	{
+		uint64_t size;
+		uint64_t alignment;
+		uint32_t first_use;
+		uint32_t last_use;
+	};
+
+	struct transient_placement
+	{
+		static constexpr auto no_previous = UINT32_MAX;
+		static constexpr auto any_previous = UINT32_MAX - 1;
+
+		uint64_t offset;
+		// Resource that used this memory last, any_previous when more than one
+		// did. Anything but no_previous needs an aliasing barrier before
+		// first_use, and its contents are undefined until written.
+		// Plans repeat every frame, so memory shared only with resources
+		// that start later was last used by them, a frame ago.
+		uint32_t previous;
+	};
+
+	struct transient_plan
+	{
+		std::vector<transient_placement> placements{};
+		uint64_t heap_size{};   // peak memory with aliasing
+		uint64_t naive_size{};  // every resource in memory of its own
+		uint32_t aliased_count{};
+	};
+
+	// Packs resources into one heap, letting resources whose lifetimes
+	// don't overlap share memory. Largest first, each one goes at the
+	// lowest offset that is clear of every resource alive at the same time.
+	auto plan_transient_memory(const std::vector<transient_request> &requests) -> transient_plan;
+}
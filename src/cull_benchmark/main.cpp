@@ -0,0 +1,189 @@
+#include "frustum_culling.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+// Times frustum culling of random bounds with each instruction set, on one
+// thread and across all of them, after checking they all agree with the
+// scalar reference.
+// Usage: cull_benchmark [<bound count> [<runs>]]
+
+namespace
+{
+	using namespace learning_dx12;
+
+	constexpr auto default_bound_count = size_t{ 1'000'000 };
+	constexpr auto default_runs = 50;
+	constexpr auto scene_extent = 1000.0f;
+
+	using matrix = float[4][4];
+
+	// Row vectors, as DirectXMath's XMMatrixPerspectiveFovLH and XMMatrixRotationY.
+	void make_view_projection(float yaw, float field_of_view, float aspect_ratio, float near_z, float far_z,
+	                          matrix &view_projection)
+	{
+		auto height = 1.0f / std::tan(field_of_view / 2.0f);
+		auto width = height / aspect_ratio;
+		auto range = far_z / (far_z - near_z);
+		const matrix projection = {
+			{ width, 0.0f,   0.0f,            0.0f },
+			{ 0.0f,  height, 0.0f,            0.0f },
+			{ 0.0f,  0.0f,   range,           1.0f },
+			{ 0.0f,  0.0f,   -range * near_z, 0.0f },
+		};
+
+		auto c = std::cos(yaw), s = std::sin(yaw);
+		const matrix view = {
+			{ c,    0.0f, -s,   0.0f },
+			{ 0.0f, 1.0f, 0.0f, 0.0f },
+			{ s,    0.0f, c,    0.0f },
+			{ 0.0f, 0.0f, 0.0f, 1.0f },
+		};
+
+		for (auto row = 0; row < 4; row++)
+		{
+			for (auto column = 0; column < 4; column++)
+			{
+				view_projection[row][column] = 0.0f;
+				for (auto k = 0; k < 4; k++)
+				{
+					view_projection[row][column] += view[row][k] * projection[k][column];
+				}
+			}
+		}
+	}
+
+	// Scattered evenly through a cube around the camera.
+	void make_bounds(size_t count, sphere_bounds &spheres, box_bounds &boxes)
+	{
+		auto random = std::mt19937{ 42 };
+		auto position = std::uniform_real_distribution<float>{ -scene_extent / 2.0f, scene_extent / 2.0f };
+		auto size = std::uniform_real_distribution<float>{ 0.5f, 2.0f };
+
+		spheres.resize(count);
+		boxes.resize(count);
+		for (auto i = size_t{}; i < count; i++)
+		{
+			auto x = position(random), y = position(random), z = position(random);
+			spheres.set(i, x, y, z, size(random));
+			boxes.set(i, x, y, z, size(random), size(random), size(random));
+		}
+	}
+
+	auto get_name(cull_instruction_set instructions) -> const char *
+	{
+		switch (instructions)
+		{
+		case cull_instruction_set::avx:
+			return "avx";
+		case cull_instruction_set::sse:
+			return "sse";
+		default:
+			return "scalar";
+		}
+	}
+
+	template <typename function>
+	auto time_median_ms(int runs, const function &run) -> double
+	{
+		auto times = std::vector<double>{};
+		for (auto i = 0; i < runs; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			run();
+			auto end = std::chrono::steady_clock::now();
+			times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		}
+
+		std::sort(times.begin(), times.end());
+		return times[times.size() / 2];
+	}
+
+	template <typename bounds_type, typename cull_function>
+	void cull_single_thread(const frustum &planes, const bounds_type &bounds, cull_instruction_set instructions,
+	                        const cull_function &cull, std::vector<uint32_t> &visible)
+	{
+		visible.resize(bounds.size() + 8);
+		auto count = cull(planes, bounds, 0, bounds.size(), visible.data(), instructions);
+		visible.resize(count);
+	}
+
+	template <typename bounds_type, typename cull_function>
+	auto benchmark(const char *kind, const frustum &planes, const bounds_type &bounds, const cull_function &cull,
+	               frustum_culler &culler, int runs) -> bool
+	{
+		auto reference = std::vector<uint32_t>{};
+		cull_single_thread(planes, bounds, cull_instruction_set::scalar, cull, reference);
+		fmt::print("{}: {} of {} visible\n", kind, reference.size(), bounds.size());
+
+		auto instruction_sets = std::vector<cull_instruction_set>{ cull_instruction_set::scalar };
+		if (get_cull_instruction_set() != cull_instruction_set::scalar)
+		{
+			instruction_sets.push_back(cull_instruction_set::sse);
+		}
+		if (get_cull_instruction_set() == cull_instruction_set::avx)
+		{
+			instruction_sets.push_back(cull_instruction_set::avx);
+		}
+
+		auto visible = std::vector<uint32_t>{};
+		auto agree = true;
+		for (auto instructions : instruction_sets)
+		{
+			cull_single_thread(planes, bounds, instructions, cull, visible);
+			agree = agree and visible == reference;
+
+			auto ms = time_median_ms(runs, [&]
+			{
+				cull_single_thread(planes, bounds, instructions, cull, visible);
+			});
+			fmt::print("  {:<7} 1 thread   {:8.3f} ms\n", get_name(instructions), ms);
+		}
+
+		culler.cull(planes, bounds, visible);
+		agree = agree and visible == reference;
+
+		// A pool of one thread would only repeat the line above.
+		if (culler.get_thread_count() > 1)
+		{
+			auto ms = time_median_ms(runs, [&]
+			{
+				culler.cull(planes, bounds, visible);
+			});
+			auto threads = fmt::format("{} threads", culler.get_thread_count());
+			fmt::print("  {:<7} {:<10} {:8.3f} ms\n", get_name(get_cull_instruction_set()), threads, ms);
+		}
+
+		if (not agree)
+		{
+			fmt::print(stderr, "  visible bounds differ from the scalar reference\n");
+		}
+		return agree;
+	}
+}
+
+auto main(int argc, char *argv[]) -> int
+{
+	auto count = argc > 1 ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : default_bound_count;
+	auto runs = argc > 2 ? std::max(1, std::atoi(argv[2])) : default_runs;
+
+	auto spheres = sphere_bounds{};
+	auto boxes = box_bounds{};
+	make_bounds(count, spheres, boxes);
+
+	matrix view_projection{};
+	make_view_projection(0.6f, 1.0f, 16.0f / 10.0f, 0.1f, scene_extent / 2.0f, view_projection);
+	auto planes = extract_frustum_planes(view_projection);
+
+	auto culler = frustum_culler{};
+	auto spheres_agree = benchmark("spheres", planes, spheres, &cull_spheres, culler, runs);
+	auto boxes_agree = benchmark("boxes", planes, boxes, &cull_boxes, culler, runs);
+	return spheres_agree and boxes_agree ? 0 : 1;
+}
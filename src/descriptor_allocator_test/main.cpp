@@ -0,0 +1,249 @@
+#include "free_list_allocator.h"
+#include "ring_allocator.h"
+#include "test_checks.h"
+
+#include <fmt/format.h>
+
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <vector>
+
+// Checks the index bookkeeping behind the descriptor heaps without a device.
+// free_list_allocator hands out the staging pages' and the shader visible
+// heap's persistent ranges, ring_allocator its per-frame tables.
+
+namespace
+{
+	using namespace learning_dx12;
+
+	void test_first_fit(test_checks &checks)
+	{
+		auto allocator = free_list_allocator{ 16 };
+
+		checks.check_equal(allocator.allocate(4).value_or(UINT32_MAX), 0u, "first range starts at 0");
+		checks.check_equal(allocator.allocate(4).value_or(UINT32_MAX), 4u, "second one right after it");
+		checks.check_equal(allocator.get_free_count(), 8u, "free count");
+
+		allocator.free(0, 4);
+		checks.check_equal(allocator.allocate(2).value_or(UINT32_MAX), 0u, "a smaller range reuses the first hole");
+		checks.check_equal(allocator.allocate(4).value_or(UINT32_MAX), 8u, "one too large for the hole goes past it");
+		checks.check(not allocator.allocate(5), "nothing left that large");
+		checks.check_equal(allocator.allocate(4).value_or(UINT32_MAX), 12u, "the exact rest of the heap");
+	}
+
+	void test_merge(test_checks &checks)
+	{
+		auto allocator = free_list_allocator{ 12 };
+		for (auto i = 0; i < 3; i++)
+		{
+			allocator.allocate(4);
+		}
+
+		// Freed middle last, so it merges with both neighbours
+		allocator.free(0, 4);
+		allocator.free(8, 4);
+		checks.check(not allocator.allocate(8), "two separate holes don't make one range");
+		allocator.free(4, 4);
+		checks.check_equal(allocator.allocate(12).value_or(UINT32_MAX), 0u, "merged back into the whole heap");
+		allocator.free(0, 12);
+
+		// Each one merging with the one before
+		for (auto i = 0; i < 3; i++)
+		{
+			allocator.allocate(4);
+		}
+		for (auto start : { 0u, 4u, 8u })
+		{
+			allocator.free(start, 4);
+		}
+		checks.check_equal(allocator.allocate(12).value_or(UINT32_MAX), 0u, "merged with the previous range");
+		allocator.free(0, 12);
+
+		// And with the one after
+		for (auto i = 0; i < 3; i++)
+		{
+			allocator.allocate(4);
+		}
+		for (auto start : { 8u, 4u, 0u })
+		{
+			allocator.free(start, 4);
+		}
+		checks.check_equal(allocator.allocate(12).value_or(UINT32_MAX), 0u, "merged with the next range");
+		checks.check_equal(allocator.get_free_count(), 0u, "free count");
+
+		auto empty = free_list_allocator{ 0 };
+		checks.check(not empty.allocate(1), "an empty heap has nothing to give");
+	}
+
+	// Ranges never overlap and stay in the heap, allocations only fail when
+	// no free run is long enough, and a range is first fit.
+	void test_fuzz(test_checks &checks, uint32_t seed)
+	{
+		constexpr auto capacity = 1024u;
+		constexpr auto operation_count = 20'000;
+
+		struct range
+		{
+			uint32_t start;
+			uint32_t count;
+		};
+
+		auto allocator = free_list_allocator{ capacity };
+		auto used = std::vector<bool>(capacity, false);
+		auto live = std::vector<range>{};
+
+		auto first_fit = [&](uint32_t count) -> uint32_t
+		{
+			auto run = 0u;
+			for (auto i = 0u; i < capacity; i++)
+			{
+				run = used[i] ? 0 : run + 1;
+				if (run == count)
+				{
+					return i + 1 - count;
+				}
+			}
+			return UINT32_MAX;
+		};
+
+		auto random = std::mt19937{ seed };
+		auto pick_count = std::geometric_distribution<uint32_t>{ 0.1 };
+		auto coin = std::uniform_int_distribution<int>{ 0, 99 };
+
+		auto valid = true;
+		auto failed_count = 0, allocated_count = 0;
+		for (auto operation = 0; operation < operation_count and valid; operation++)
+		{
+			if (not live.empty() and coin(random) < 45)
+			{
+				auto victim = std::uniform_int_distribution<size_t>{ 0, live.size() - 1 }(random);
+				auto [start, count] = live[victim];
+				allocator.free(start, count);
+				for (auto i = start; i < start + count; i++)
+				{
+					used[i] = false;
+				}
+				live[victim] = live.back();
+				live.pop_back();
+				continue;
+			}
+
+			auto count = pick_count(random) + 1;
+			auto expected = first_fit(count);
+			auto start = allocator.allocate(count);
+			if (not start)
+			{
+				failed_count++;
+				valid = expected == UINT32_MAX;
+				continue;
+			}
+			allocated_count++;
+
+			valid = *start == expected;
+			for (auto i = *start; i < *start + count; i++)
+			{
+				used[i] = true;
+			}
+			live.push_back({ *start, count });
+
+			auto free_count = 0u;
+			for (auto u : used)
+			{
+				free_count += u ? 0 : 1;
+			}
+			valid = valid and allocator.get_free_count() == free_count;
+		}
+
+		auto what = fmt::format("seed {}: ", seed);
+		checks.check(valid, what + "ranges are first fit, apart, and counted");
+		checks.check(allocated_count > operation_count / 4 and failed_count > 0, what + "the fuzz both filled and emptied the heap");
+
+		for (auto [start, count] : live)
+		{
+			allocator.free(start, count);
+		}
+		checks.check_equal(allocator.allocate(capacity).value_or(UINT32_MAX), 0u, what + "merged back into the whole heap");
+	}
+
+	// What gpu_descriptor_heap does with its dynamic region: a few tables
+	// per frame, a table never wraps around the end of the heap, and a
+	// frame's tables are only reused once its fence completes.
+	void test_frame_tables(test_checks &checks)
+	{
+		constexpr auto capacity = 400u;
+		constexpr auto frames_in_flight = 3u;
+
+		struct table
+		{
+			uint64_t start;
+			uint64_t count;
+			uint64_t fence_value;
+		};
+
+		auto ring = ring_allocator{ capacity };
+		auto in_flight = std::deque<table>{};
+
+		auto random = std::mt19937{ 7 };
+		auto pick_count = std::uniform_int_distribution<uint64_t>{ 1, 64 };
+		auto pick_tables = std::uniform_int_distribution<int>{ 1, 6 };
+
+		auto contiguous = true, apart = true;
+		auto failed_count = 0;
+		auto completed_value = uint64_t{};
+		for (auto fence_value = uint64_t{ 1 }; fence_value <= 2000; fence_value++)
+		{
+			if (fence_value > frames_in_flight)
+			{
+				completed_value = fence_value - frames_in_flight;
+				ring.release_completed(completed_value);
+				while (not in_flight.empty() and in_flight.front().fence_value <= completed_value)
+				{
+					in_flight.pop_front();
+				}
+			}
+
+			for (auto t = pick_tables(random); t > 0; t--)
+			{
+				auto count = pick_count(random);
+				auto start = ring.allocate(count, 1);
+				if (not start)
+				{
+					failed_count++;
+					continue;
+				}
+
+				contiguous = contiguous and *start + count <= capacity;
+				for (auto &other : in_flight)
+				{
+					apart = apart and (*start + count <= other.start or other.start + other.count <= *start);
+				}
+				in_flight.push_back({ *start, count, fence_value });
+			}
+			ring.finish_batch(fence_value);
+		}
+
+		checks.check(contiguous, "tables never wrap around the end of the heap");
+		checks.check(apart, "tables of frames still in flight are never handed out again");
+		checks.check(failed_count > 0, "the ring filled up at times");
+
+		ring.release_completed(UINT64_MAX);
+		checks.check_equal(ring.get_stats().used, uint64_t{}, "everything free once the gpu is idle");
+		checks.check(ring.allocate(capacity, 1).has_value(), "the whole region fits again");
+	}
+}
+
+auto main() -> int
+{
+	auto checks = test_checks{};
+
+	test_first_fit(checks);
+	test_merge(checks);
+	for (auto seed : { 1u, 2u, 3u, 42u })
+	{
+		test_fuzz(checks, seed);
+	}
+	test_frame_tables(checks);
+
+	return checks.get_exit_code();
+}
@@ -0,0 +1,256 @@
+#include "fence_waiter.h"
+#include "test_checks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Drives fence_waiter with a fence the test signals itself, so no device
+// is needed. Signaling the fake sets the events waiting on it, the same
+// way a queue reaching its Signal would.
+
+namespace
+{
+	using namespace learning_dx12;
+	using namespace std::chrono_literals;
+
+	constexpr auto time_out = 5s;
+	constexpr auto still_pending = 50ms;
+
+	class fake_fence final : public ID3D12Fence
+	{
+	public:
+		fake_fence(uint64_t completed_value_) :
+			completed_value{ completed_value_ }
+		{}
+
+		HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **object) override
+		{
+			if (riid == __uuidof(IUnknown)
+			    or riid == __uuidof(ID3D12Object)
+			    or riid == __uuidof(ID3D12DeviceChild)
+			    or riid == __uuidof(ID3D12Fence))
+			{
+				AddRef();
+				*object = this;
+				return S_OK;
+			}
+
+			*object = nullptr;
+			return E_NOINTERFACE;
+		}
+
+		ULONG STDMETHODCALLTYPE AddRef() override
+		{
+			return ++reference_count;
+		}
+
+		ULONG STDMETHODCALLTYPE Release() override
+		{
+			auto remaining = --reference_count;
+			if (remaining == 0)
+			{
+				delete this;
+			}
+			return remaining;
+		}
+
+		HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, UINT *, void *) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, UINT, const void *) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown *) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT STDMETHODCALLTYPE SetName(LPCWSTR) override
+		{
+			return S_OK;
+		}
+
+		HRESULT STDMETHODCALLTYPE GetDevice(REFIID, void **device) override
+		{
+			*device = nullptr;
+			return E_NOTIMPL;
+		}
+
+		UINT64 STDMETHODCALLTYPE GetCompletedValue() override
+		{
+			auto lock = std::lock_guard{ fence_mutex };
+			return completed_value;
+		}
+
+		HRESULT STDMETHODCALLTYPE SetEventOnCompletion(UINT64 value, HANDLE event) override
+		{
+			auto lock = std::lock_guard{ fence_mutex };
+			if (value <= completed_value)
+			{
+				::SetEvent(event);
+				return S_OK;
+			}
+
+			waiting_events.push_back({ value, event });
+			return S_OK;
+		}
+
+		HRESULT STDMETHODCALLTYPE Signal(UINT64 value) override
+		{
+			auto lock = std::lock_guard{ fence_mutex };
+			completed_value = value;
+
+			auto reached = std::stable_partition(waiting_events.begin(), waiting_events.end(), [&](const waiting_event &w)
+			{
+				return w.value > completed_value;
+			});
+			for (auto it = reached; it != waiting_events.end(); it++)
+			{
+				::SetEvent(it->event);
+			}
+			waiting_events.erase(reached, waiting_events.end());
+
+			return S_OK;
+		}
+
+	private:
+		struct waiting_event
+		{
+			uint64_t value;
+			HANDLE event;
+		};
+
+		std::atomic<ULONG> reference_count{ 1 };
+
+		std::mutex fence_mutex{};
+		uint64_t completed_value{};
+		std::vector<waiting_event> waiting_events{};
+	};
+
+	auto create_fake_fence(uint64_t completed_value) -> dx_fence
+	{
+		auto fence = dx_fence{};
+		fence.attach(new fake_fence{ completed_value });
+		return fence;
+	}
+
+	auto is_ready(std::future<void> &future, std::chrono::milliseconds wait) -> bool
+	{
+		return future.wait_for(wait) == std::future_status::ready;
+	}
+
+	void test_already_reached(test_checks &checks)
+	{
+		auto waiter = fence_waiter{};
+		auto fence = create_fake_fence(5);
+
+		auto ran_on = std::promise<std::thread::id>{};
+		auto ran_on_future = ran_on.get_future();
+		waiter.when_reached(fence, 3, [&ran_on]()
+		{
+			ran_on.set_value(std::this_thread::get_id());
+		});
+
+		checks.check(ran_on_future.wait_for(time_out) == std::future_status::ready, "a reached value still runs its callback");
+		checks.check(ran_on_future.get() != std::this_thread::get_id(), "callbacks for reached values run on the waiter thread");
+
+		auto reached = waiter.when_reached(fence, 5);
+		checks.check(is_ready(reached, time_out), "a future for the completed value becomes ready");
+	}
+
+	void test_pending(test_checks &checks)
+	{
+		auto waiter = fence_waiter{};
+		auto fence = create_fake_fence(0);
+
+		auto reached = waiter.when_reached(fence, 10);
+		checks.check(not is_ready(reached, still_pending), "not ready before the fence is signaled");
+		checks.check_equal(waiter.pending_count(), size_t{ 1 }, "the wait is pending");
+
+		fence->Signal(9);
+		checks.check(not is_ready(reached, still_pending), "not ready before the value is reached");
+
+		fence->Signal(10);
+		checks.check(is_ready(reached, time_out), "ready once the value is reached");
+		checks.check_equal(waiter.pending_count(), size_t{ 0 }, "nothing pending after it ran");
+	}
+
+	// One thread and one event serve every fence.
+	void test_many_fences(test_checks &checks)
+	{
+		auto waiter = fence_waiter{};
+		auto first = create_fake_fence(0);
+		auto second = create_fake_fence(0);
+
+		auto first_one = waiter.when_reached(first, 1);
+		auto first_two = waiter.when_reached(first, 2);
+		auto first_three = waiter.when_reached(first, 3);
+		auto second_one = waiter.when_reached(second, 1);
+		auto second_two = waiter.when_reached(second, 2);
+
+		first->Signal(2);
+		checks.check(is_ready(first_one, time_out) and is_ready(first_two, time_out), "waits up to the signaled value run");
+		checks.check(not is_ready(first_three, still_pending), "later waits on the same fence stay pending");
+		checks.check(not is_ready(second_one, still_pending), "waits on other fences stay pending");
+
+		second->Signal(2);
+		first->Signal(3);
+		checks.check(is_ready(second_one, time_out) and is_ready(second_two, time_out), "both waits on the second fence run");
+		checks.check(is_ready(first_three, time_out), "the last wait on the first fence runs");
+		checks.check_equal(waiter.pending_count(), size_t{ 0 }, "nothing left pending");
+	}
+
+	// What frame_graph relies on, a callback holding on to something
+	// keeps it alive until the value is reached, then lets go of it.
+	void test_lifetimes(test_checks &checks)
+	{
+		auto fence = create_fake_fence(0);
+		auto held = std::make_shared<int>(0);
+		auto run_count = std::atomic<int>{};
+
+		{
+			auto waiter = fence_waiter{};
+			auto reached = std::promise<void>{};
+			auto reached_future = reached.get_future();
+
+			waiter.when_reached(fence, 1, [held, &run_count, &reached]()
+			{
+				run_count++;
+				reached.set_value();
+			});
+			waiter.when_reached(fence, 2, [held, &run_count]()
+			{
+				run_count++;
+			});
+			checks.check_equal(held.use_count(), long{ 3 }, "pending callbacks hold what they captured");
+
+			fence->Signal(1);
+			checks.check(reached_future.wait_for(time_out) == std::future_status::ready, "the reached wait runs");
+		}
+
+		checks.check_equal(run_count.load(), 1, "waits still pending at destruction are dropped, not run");
+		checks.check_equal(held.use_count(), long{ 1 }, "dropped waits let go of their captures");
+	}
+}
+
+auto main() -> int
+{
+	auto checks = test_checks{};
+
+	test_already_reached(checks);
+	test_pending(checks);
+	test_many_fences(checks);
+	test_lifetimes(checks);
+
+	return checks.get_exit_code();
+}
@@ -0,0 +1,175 @@
+#include "indirect_draw.h"
+#include "test_checks.h"
+
+#include <fmt/format.h>
+
+#include <random>
+#include <vector>
+
+// Checks the CPU reference for the indirect argument buffers: commands
+// built from draw items, compacted to the visible ones, and their
+// instances packed back to back. Commands are only built in memory.
+
+namespace
+{
+	using namespace learning_dx12;
+
+	// A cube and a mesh with nothing to draw, their views told apart by address.
+	auto make_meshes() -> std::vector<indirect_mesh>
+	{
+		return {
+			{ { 0x1000, 8 * 28, 28 }, { 0x2000, 36 * 4, DXGI_FORMAT_R32_UINT }, 36 },
+			{ { 0x3000, 0, 28 }, { 0x4000, 0, DXGI_FORMAT_R32_UINT }, 0 },
+		};
+	}
+
+	auto same_views(const indirect_draw_command &command, const indirect_mesh &mesh) -> bool
+	{
+		return command.vertex_buffer.BufferLocation == mesh.vertex_buffer.BufferLocation
+		   and command.vertex_buffer.StrideInBytes == mesh.vertex_buffer.StrideInBytes
+		   and command.index_buffer.BufferLocation == mesh.index_buffer.BufferLocation
+		   and command.index_buffer.Format == mesh.index_buffer.Format;
+	}
+
+	void test_build(test_checks &checks)
+	{
+		auto meshes = make_meshes();
+		auto commands = build_indirect_commands(meshes, { { 0, 0, 64 }, { 1, 64, 64 }, { 0, 128, 10 }, { 0, 138, 0 } });
+
+		checks.check_equal(commands.size(), size_t{ 4 }, "a command per item");
+		checks.check(same_views(commands[0], meshes[0]) and same_views(commands[1], meshes[1]), "each with its mesh's views");
+		checks.check(commands[0].draw.IndexCountPerInstance == 36 and commands[1].draw.IndexCountPerInstance == 0, "and index count");
+		checks.check(commands[2].first_instance == 128 and commands[2].draw.InstanceCount == 10, "the item's instances");
+		checks.check(commands[2].draw.StartInstanceLocation == commands[2].first_instance, "start instance matches the root constant");
+		checks.check(commands[2].draw.StartIndexLocation == 0 and commands[2].draw.BaseVertexLocation == 0, "whole meshes");
+		checks.check(build_indirect_commands(meshes, {}).empty(), "no items, no commands");
+	}
+
+	void test_compact(test_checks &checks)
+	{
+		auto meshes = make_meshes();
+		auto commands = build_indirect_commands(meshes, {
+			{ 0, 0, 64 }, { 0, 64, 64 }, { 1, 128, 64 }, { 0, 192, 0 }, { 0, 192, 64 }, { 0, 256, 7 } });
+
+		auto compacted = compact_indirect_commands(commands, { 1, 0, 1, 1, 1, 1 });
+		checks.check_equal(compacted.size(), size_t{ 3 }, "hidden draws and ones with nothing to draw are dropped");
+		if (compacted.size() == 3)
+		{
+			checks.check(compacted[0].first_instance == 0 and compacted[1].first_instance == 192 and compacted[2].first_instance == 256,
+			             "the rest keep their order");
+		}
+
+		checks.check(compact_indirect_commands(commands, std::vector<uint8_t>(commands.size(), 0)).empty(), "nothing visible");
+		checks.check(compact_indirect_commands({}, {}).empty(), "no commands");
+		checks.check_equal(compact_indirect_commands(commands, std::vector<uint8_t>(commands.size(), 2)).size(), size_t{ 4 },
+		                   "any non-zero byte is visible");
+	}
+
+	// Instances are numbered by their index in the scene, so packed ones
+	// show where they were copied from.
+	void test_pack(test_checks &checks)
+	{
+		auto meshes = make_meshes();
+		auto commands = compact_indirect_commands(build_indirect_commands(meshes, { { 0, 0, 64 }, { 0, 64, 64 }, { 0, 128, 64 }, { 0, 192, 30 } }),
+		                                          { 0, 1, 0, 1 });
+		auto runs = pack_indirect_instances(commands);
+
+		checks.check_equal(runs.size(), size_t{ 2 }, "a run per command");
+		if (runs.size() != 2 or commands.size() != 2)
+		{
+			return;
+		}
+		checks.check(runs[0].first_instance == 64 and runs[0].instance_count == 64, "the first run is where the instances were");
+		checks.check(runs[1].first_instance == 192 and runs[1].instance_count == 30, "so is the second");
+		checks.check(commands[0].first_instance == 0 and commands[1].first_instance == 64, "commands read them packed");
+		checks.check(commands[1].draw.StartInstanceLocation == 64, "start instance moves along with the root constant");
+		checks.check(commands[1].draw.InstanceCount == 30 and commands[1].draw.IndexCountPerInstance == 36, "the draws themselves don't change");
+	}
+
+	// Random items and visibility against a straightforward model: a kept
+	// command's instance k, at first_instance + k of the packed copy, is
+	// instance k of its item in the scene.
+	void test_fuzz(test_checks &checks, uint32_t seed)
+	{
+		auto meshes = make_meshes();
+		auto random = std::mt19937{ seed };
+		auto pick = [&](uint32_t count) { return std::uniform_int_distribution<uint32_t>{ 0, count - 1 }(random); };
+
+		auto valid = true;
+		auto kept_total = size_t{}, dropped_total = size_t{};
+		for (auto run = 0; run < 200 and valid; run++)
+		{
+			auto items = std::vector<indirect_draw_item>{};
+			auto visible = std::vector<uint8_t>{};
+			auto scene_count = uint32_t{};
+			for (auto i = pick(40); i > 0; i--)
+			{
+				auto mesh = pick(8) == 0 ? 1u : 0u;
+				auto count = pick(4) == 0 ? 0u : pick(64) + 1;
+				items.push_back({ mesh, scene_count, count });
+				visible.push_back(static_cast<uint8_t>(pick(3) != 0));
+				scene_count += count;
+			}
+
+			auto kept = std::vector<indirect_draw_item>{};
+			for (auto i = size_t{}; i < items.size(); i++)
+			{
+				if (visible[i] and meshes[items[i].mesh].index_count > 0 and items[i].instance_count > 0)
+				{
+					kept.push_back(items[i]);
+				}
+			}
+
+			auto commands = compact_indirect_commands(build_indirect_commands(meshes, items), visible);
+			auto runs = pack_indirect_instances(commands);
+			valid = commands.size() == kept.size() and runs.size() == kept.size();
+
+			auto scene = std::vector<uint32_t>(scene_count);
+			for (auto i = 0u; i < scene_count; i++)
+			{
+				scene[i] = i;
+			}
+			auto packed = std::vector<uint32_t>{};
+			for (auto &r : runs)
+			{
+				packed.insert(packed.end(), scene.begin() + r.first_instance, scene.begin() + r.first_instance + r.instance_count);
+			}
+
+			for (auto i = size_t{}; i < kept.size() and valid; i++)
+			{
+				auto &command = commands[i];
+				valid = same_views(command, meshes[kept[i].mesh])
+				    and command.draw.InstanceCount == kept[i].instance_count
+				    and command.draw.StartInstanceLocation == command.first_instance
+				    and command.first_instance + command.draw.InstanceCount <= packed.size()
+				    and (i == 0 or command.first_instance == commands[i - 1].first_instance + commands[i - 1].draw.InstanceCount);
+				for (auto k = 0u; k < command.draw.InstanceCount and valid; k++)
+				{
+					valid = packed[command.first_instance + k] == kept[i].first_instance + k;
+				}
+			}
+
+			kept_total += kept.size();
+			dropped_total += items.size() - kept.size();
+		}
+
+		auto what = fmt::format("seed {}: ", seed);
+		checks.check(valid, what + "kept commands draw their own instances, packed in order");
+		checks.check(kept_total > 0 and dropped_total > 0, what + "some draws were kept and some dropped");
+	}
+}
+
+auto main() -> int
+{
+	auto checks = test_checks{};
+
+	test_build(checks);
+	test_compact(checks);
+	test_pack(checks);
+	for (auto seed : { 1u, 2u, 3u })
+	{
+		test_fuzz(checks, seed);
+	}
+
+	return checks.get_exit_code();
+}
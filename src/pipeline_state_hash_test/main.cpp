@@ -0,0 +1,373 @@
+#include "pipeline_state_hash.h"
+#include "test_checks.h"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Checks what does and doesn't change the hashes pipelines and root
+// signatures are cached by, and when a stored pipeline library is thrown
+// away. Only descriptions are built, no device is needed.
+
+namespace
+{
+	using namespace learning_dx12;
+
+	// Owns everything a pipeline description points to. Every instance has
+	// its own copies, so equal hashes can't come from equal pointers.
+	struct pipeline_parts
+	{
+		std::vector<uint8_t> vs{ 0x44, 0x58, 0x42, 0x43, 0x01, 0x02, 0x03, 0x04 };
+		std::vector<uint8_t> ps{ 0x44, 0x58, 0x42, 0x43, 0x05, 0x06 };
+		std::array<std::string, 2> semantics{ "POSITION", "COLOR" };
+		std::array<D3D12_INPUT_ELEMENT_DESC, 2> elements{};
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC desc{};
+	};
+
+	using pipeline_change = std::function<void(pipeline_parts &)>;
+
+	// What draw_cube's pipeline looks like. Bytes the fields leave out, as
+	// padding, are filled with fill first.
+	auto make_pipeline(uint8_t fill, const pipeline_change &change = {}) -> std::unique_ptr<pipeline_parts>
+	{
+		auto parts = std::make_unique<pipeline_parts>();
+		std::memset(&parts->desc, fill, sizeof(parts->desc));
+		std::memset(parts->elements.data(), fill, sizeof(parts->elements));
+
+		auto &desc = parts->desc;
+		desc.pRootSignature = nullptr;
+		desc.DS = desc.HS = desc.GS = {};
+		desc.StreamOutput = {};
+		desc.CachedPSO = {};
+
+		desc.BlendState.AlphaToCoverageEnable = FALSE;
+		desc.BlendState.IndependentBlendEnable = FALSE;
+		for (auto &target : desc.BlendState.RenderTarget)
+		{
+			target.BlendEnable = FALSE;
+			target.LogicOpEnable = FALSE;
+			target.SrcBlend = D3D12_BLEND_ONE;
+			target.DestBlend = D3D12_BLEND_ZERO;
+			target.BlendOp = D3D12_BLEND_OP_ADD;
+			target.SrcBlendAlpha = D3D12_BLEND_ONE;
+			target.DestBlendAlpha = D3D12_BLEND_ZERO;
+			target.BlendOpAlpha = D3D12_BLEND_OP_ADD;
+			target.LogicOp = D3D12_LOGIC_OP_NOOP;
+			target.RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
+		}
+		desc.SampleMask = UINT_MAX;
+
+		auto &rasterizer = desc.RasterizerState;
+		rasterizer.FillMode = D3D12_FILL_MODE_SOLID;
+		rasterizer.CullMode = D3D12_CULL_MODE_BACK;
+		rasterizer.FrontCounterClockwise = FALSE;
+		rasterizer.DepthBias = 0;
+		rasterizer.DepthBiasClamp = 0.0f;
+		rasterizer.SlopeScaledDepthBias = 0.0f;
+		rasterizer.DepthClipEnable = TRUE;
+		rasterizer.MultisampleEnable = FALSE;
+		rasterizer.AntialiasedLineEnable = FALSE;
+		rasterizer.ForcedSampleCount = 0;
+		rasterizer.ConservativeRaster = D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF;
+
+		auto &depth_stencil = desc.DepthStencilState;
+		depth_stencil.DepthEnable = TRUE;
+		depth_stencil.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
+		depth_stencil.DepthFunc = D3D12_COMPARISON_FUNC_LESS;
+		depth_stencil.StencilEnable = FALSE;
+		depth_stencil.StencilReadMask = 0xff;
+		depth_stencil.StencilWriteMask = 0xff;
+		depth_stencil.FrontFace = { D3D12_STENCIL_OP_KEEP, D3D12_STENCIL_OP_KEEP, D3D12_STENCIL_OP_KEEP, D3D12_COMPARISON_FUNC_ALWAYS };
+		depth_stencil.BackFace = depth_stencil.FrontFace;
+
+		for (auto i = 0u; i < parts->elements.size(); i++)
+		{
+			auto &element = parts->elements[i];
+			element.SemanticIndex = 0;
+			element.Format = DXGI_FORMAT_R32G32B32_FLOAT;
+			element.InputSlot = 0;
+			element.AlignedByteOffset = i * 12;
+			element.InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
+			element.InstanceDataStepRate = 0;
+		}
+
+		desc.IBStripCutValue = D3D12_INDEX_BUFFER_STRIP_CUT_VALUE_DISABLED;
+		desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+		desc.NumRenderTargets = 1;
+		desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
+		desc.SampleDesc = { 1, 0 };
+		desc.NodeMask = 0;
+		desc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+
+		if (change)
+		{
+			change(*parts);
+		}
+
+		// Pointers last, changes may have resized what they point to
+		desc.VS = { parts->vs.data(), parts->vs.size() };
+		desc.PS = { parts->ps.data(), parts->ps.size() };
+		for (auto i = 0u; i < parts->elements.size(); i++)
+		{
+			parts->elements[i].SemanticName = parts->semantics[i].c_str();
+		}
+		desc.InputLayout = { parts->elements.data(), static_cast<UINT>(parts->elements.size()) };
+		return parts;
+	}
+
+	constexpr auto root_signature_hash = uint64_t{ 0x1234 };
+
+	auto pipeline_hash_of(const pipeline_change &change, uint64_t signature_hash = root_signature_hash) -> uint64_t
+	{
+		return hash_pipeline_desc(make_pipeline(0, change)->desc, signature_hash);
+	}
+
+	void test_hash_bytes(test_checks &checks)
+	{
+		// Published FNV-1a 64 test vectors
+		checks.check_equal(hash_bytes("", 0), hash_seed, "nothing hashes to the offset basis");
+		checks.check_equal(hash_bytes("a", 1), uint64_t{ 0xaf63dc4c8601ec8c }, "\"a\"");
+		checks.check_equal(hash_bytes("foobar", 6), uint64_t{ 0x85944171f73967e8 }, "\"foobar\"");
+		checks.check_equal(hash_bytes("bar", 3, hash_bytes("foo", 3)), hash_bytes("foobar", 6), "hashing in parts continues the hash");
+	}
+
+	void test_pipeline_same(test_checks &checks)
+	{
+		auto base = pipeline_hash_of({});
+		checks.check_equal(hash_pipeline_desc(make_pipeline(0)->desc, root_signature_hash), base,
+		                   "the same description, stored elsewhere");
+		checks.check_equal(hash_pipeline_desc(make_pipeline(0xcd)->desc, root_signature_hash), base,
+		                   "padding doesn't count");
+
+		auto ignored = std::vector<std::pair<const char *, pipeline_change>>{
+			{ "the root signature pointer", [](pipeline_parts &p) { p.desc.pRootSignature = reinterpret_cast<ID3D12RootSignature *>(uintptr_t{ 0x1000 }); } },
+			{ "CachedPSO", [](pipeline_parts &p) { p.desc.CachedPSO = { p.vs.data(), p.vs.size() }; } },
+			{ "formats past NumRenderTargets", [](pipeline_parts &p) { p.desc.RTVFormats[3] = DXGI_FORMAT_R16G16B16A16_FLOAT; } },
+		};
+		for (auto &[what, change] : ignored)
+		{
+			checks.check_equal(pipeline_hash_of(change), base, std::string{ what } + " doesn't count");
+		}
+	}
+
+	// Any one of these makes a different pipeline, so a different hash.
+	void test_pipeline_changes(test_checks &checks)
+	{
+		auto base = pipeline_hash_of({});
+		checks.check(pipeline_hash_of({}, root_signature_hash + 1) != base, "root signature changes the hash");
+
+		auto changes = std::vector<std::pair<const char *, pipeline_change>>{
+			{ "a vertex shader byte", [](pipeline_parts &p) { p.vs.back() ^= 1; } },
+			{ "the pixel shader's length", [](pipeline_parts &p) { p.ps.push_back(0); } },
+			{ "a pixel shader moved to the vertex stage", [](pipeline_parts &p) { std::swap(p.vs, p.ps); } },
+			{ "blending", [](pipeline_parts &p) { p.desc.BlendState.RenderTarget[0].BlendEnable = TRUE; } },
+			{ "the last target's write mask", [](pipeline_parts &p) { p.desc.BlendState.RenderTarget[7].RenderTargetWriteMask = 0; } },
+			{ "sample mask", [](pipeline_parts &p) { p.desc.SampleMask = 1; } },
+			{ "cull mode", [](pipeline_parts &p) { p.desc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE; } },
+			{ "depth bias clamp", [](pipeline_parts &p) { p.desc.RasterizerState.DepthBiasClamp = 1.0f; } },
+			{ "depth func", [](pipeline_parts &p) { p.desc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_GREATER; } },
+			{ "back face stencil", [](pipeline_parts &p) { p.desc.DepthStencilState.BackFace.StencilPassOp = D3D12_STENCIL_OP_INCR; } },
+			{ "a semantic name", [](pipeline_parts &p) { p.semantics[1] = "TEXCOORD"; } },
+			{ "a semantic index", [](pipeline_parts &p) { p.elements[1].SemanticIndex = 1; } },
+			{ "an element format", [](pipeline_parts &p) { p.elements[1].Format = DXGI_FORMAT_R32G32B32A32_FLOAT; } },
+			{ "an element offset", [](pipeline_parts &p) { p.elements[1].AlignedByteOffset = D3D12_APPEND_ALIGNED_ELEMENT; } },
+			{ "per instance data", [](pipeline_parts &p) { p.elements[1].InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA; } },
+			{ "topology type", [](pipeline_parts &p) { p.desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_LINE; } },
+			{ "render target count", [](pipeline_parts &p) { p.desc.NumRenderTargets = 2; } },
+			{ "render target format", [](pipeline_parts &p) { p.desc.RTVFormats[0] = DXGI_FORMAT_B8G8R8A8_UNORM; } },
+			{ "depth format", [](pipeline_parts &p) { p.desc.DSVFormat = DXGI_FORMAT_D24_UNORM_S8_UINT; } },
+			{ "sample count", [](pipeline_parts &p) { p.desc.SampleDesc.Count = 4; } },
+		};
+
+		auto hashes = std::vector<uint64_t>{ base };
+		for (auto &[what, change] : changes)
+		{
+			auto hash = pipeline_hash_of(change);
+			checks.check(hash != base, std::string{ what } + " changes the hash");
+			hashes.push_back(hash);
+		}
+
+		std::sort(hashes.begin(), hashes.end());
+		checks.check(std::adjacent_find(hashes.begin(), hashes.end()) == hashes.end(), "every change hashes differently");
+	}
+
+	// A table of one CBV and one SRV range, a root CBV and a static
+	// sampler, like root_signature_registry builds.
+	struct root_signature_parts
+	{
+		std::array<D3D12_DESCRIPTOR_RANGE1, 2> ranges{};
+		std::array<D3D12_ROOT_PARAMETER1, 2> parameters{};
+		D3D12_STATIC_SAMPLER_DESC sampler{};
+		D3D12_VERSIONED_ROOT_SIGNATURE_DESC desc{};
+	};
+
+	using root_signature_change = std::function<void(root_signature_parts &)>;
+
+	auto make_root_signature(uint8_t fill, const root_signature_change &change = {}) -> std::unique_ptr<root_signature_parts>
+	{
+		auto parts = std::make_unique<root_signature_parts>();
+		std::memset(parts->parameters.data(), fill, sizeof(parts->parameters));
+
+		parts->ranges[0] = { D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 1, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, 0 };
+		parts->ranges[1] = { D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 4, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_NONE, 1 };
+
+		auto &table = parts->parameters[0];
+		table.ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+		table.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+
+		// The descriptor is smaller than the table, fill stays in the rest of the union
+		auto &cbv = parts->parameters[1];
+		cbv.ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+		cbv.Descriptor = { 0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE };
+		cbv.ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+
+		auto &sampler = parts->sampler;
+		sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
+		sampler.AddressU = sampler.AddressV = sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+		sampler.MipLODBias = 0.0f;
+		sampler.MaxAnisotropy = 1;
+		sampler.ComparisonFunc = D3D12_COMPARISON_FUNC_NEVER;
+		sampler.BorderColor = D3D12_STATIC_BORDER_COLOR_OPAQUE_BLACK;
+		sampler.MinLOD = 0.0f;
+		sampler.MaxLOD = D3D12_FLOAT32_MAX;
+		sampler.ShaderRegister = 0;
+		sampler.RegisterSpace = 0;
+		sampler.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+		parts->desc.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
+		auto &desc_1_1 = parts->desc.Desc_1_1;
+		desc_1_1.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
+
+		if (change)
+		{
+			change(*parts);
+		}
+
+		table.DescriptorTable = { static_cast<UINT>(parts->ranges.size()), parts->ranges.data() };
+		desc_1_1.NumParameters = static_cast<UINT>(parts->parameters.size());
+		desc_1_1.pParameters = parts->parameters.data();
+		desc_1_1.NumStaticSamplers = 1;
+		desc_1_1.pStaticSamplers = &parts->sampler;
+		return parts;
+	}
+
+	auto root_signature_hash_of(const root_signature_change &change) -> uint64_t
+	{
+		return hash_root_signature_desc(make_root_signature(0, change)->desc);
+	}
+
+	void test_root_signature(test_checks &checks)
+	{
+		auto base = root_signature_hash_of({});
+		checks.check_equal(hash_root_signature_desc(make_root_signature(0)->desc), base,
+		                   "the same root signature, stored elsewhere");
+		checks.check_equal(hash_root_signature_desc(make_root_signature(0xcd)->desc), base,
+		                   "only the union member the parameter type selects counts");
+
+		auto changes = std::vector<std::pair<const char *, root_signature_change>>{
+			{ "a range's register", [](root_signature_parts &p) { p.ranges[1].BaseShaderRegister = 1; } },
+			{ "a range's size", [](root_signature_parts &p) { p.ranges[1].NumDescriptors = 5; } },
+			{ "a range's flags", [](root_signature_parts &p) { p.ranges[0].Flags = D3D12_DESCRIPTOR_RANGE_FLAG_NONE; } },
+			{ "the root descriptor's space", [](root_signature_parts &p) { p.parameters[1].Descriptor.RegisterSpace = 1; } },
+			{ "the root descriptor's flags", [](root_signature_parts &p) { p.parameters[1].Descriptor.Flags = D3D12_ROOT_DESCRIPTOR_FLAG_NONE; } },
+			{ "the root descriptor's type", [](root_signature_parts &p) { p.parameters[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV; } },
+			{ "a visibility", [](root_signature_parts &p) { p.parameters[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL; } },
+			{ "the sampler's filter", [](root_signature_parts &p) { p.sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_POINT; } },
+			{ "the signature's flags", [](root_signature_parts &p) { p.desc.Desc_1_1.Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE; } },
+		};
+		for (auto &[what, change] : changes)
+		{
+			checks.check(root_signature_hash_of(change) != base, std::string{ what } + " changes the hash");
+		}
+
+		// One table, as version 1.0 and as version 1.1
+		auto parts = make_root_signature(0);
+		auto ranges = std::array<D3D12_DESCRIPTOR_RANGE, 2>{};
+		for (auto i = 0u; i < ranges.size(); i++)
+		{
+			auto &range = parts->ranges[i];
+			ranges[i] = { range.RangeType, range.NumDescriptors, range.BaseShaderRegister, range.RegisterSpace, range.OffsetInDescriptorsFromTableStart };
+		}
+
+		auto parameter_1_0 = D3D12_ROOT_PARAMETER{};
+		parameter_1_0.ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+		parameter_1_0.DescriptorTable = { static_cast<UINT>(ranges.size()), ranges.data() };
+		parameter_1_0.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+
+		auto desc_1_0 = D3D12_VERSIONED_ROOT_SIGNATURE_DESC{};
+		desc_1_0.Version = D3D_ROOT_SIGNATURE_VERSION_1_0;
+		desc_1_0.Desc_1_0 = { 1, &parameter_1_0, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_NONE };
+
+		auto desc_1_1 = D3D12_VERSIONED_ROOT_SIGNATURE_DESC{};
+		desc_1_1.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
+		desc_1_1.Desc_1_1 = { 1, &parts->parameters[0], 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_NONE };
+
+		auto hash_1_0 = hash_root_signature_desc(desc_1_0);
+		checks.check(hash_1_0 != hash_root_signature_desc(desc_1_1), "version 1.0 and 1.1 hash differently");
+
+		ranges[1].NumDescriptors = 5;
+		checks.check(hash_root_signature_desc(desc_1_0) != hash_1_0, "version 1.0 ranges count too");
+	}
+
+	void test_pipeline_names(test_checks &checks)
+	{
+		checks.check(make_pipeline_name(0x0123456789abcdef) == L"0123456789abcdef", "names are the hash in hex");
+		checks.check(make_pipeline_name(0) == L"0000000000000000", "with leading zeros");
+		checks.check(make_pipeline_name(UINT64_MAX) == L"ffffffffffffffff", "and all 16 digits");
+	}
+
+	// A stored library only loads on the adapter, driver and shaders it was
+	// made with, and only if nothing was cut off the end of the file.
+	void test_library_header(test_checks &checks)
+	{
+		auto expected = pipeline_library_header{
+			pipeline_library_header::file_magic, pipeline_library_header::file_version,
+			0x10de, 0x2204, 0x001f000e000a1234, 0xfeedface, 4096 };
+		checks.check(is_library_current(expected, expected, 4096), "the library it expects");
+
+		using header_change = std::function<void(pipeline_library_header &)>;
+		auto stale = std::vector<std::pair<const char *, header_change>>{
+			{ "another file", [](pipeline_library_header &h) { h.magic = 0; } },
+			{ "an older file version", [](pipeline_library_header &h) { h.version--; } },
+			{ "another vendor", [](pipeline_library_header &h) { h.vendor_id = 0x1002; } },
+			{ "another device", [](pipeline_library_header &h) { h.device_id++; } },
+			{ "another driver", [](pipeline_library_header &h) { h.driver_version++; } },
+			{ "changed shaders", [](pipeline_library_header &h) { h.content_hash++; } },
+		};
+		for (auto &[what, change] : stale)
+		{
+			auto header = expected;
+			change(header);
+			checks.check(not is_library_current(header, expected, 4096), std::string{ what } + " isn't loaded");
+		}
+
+		checks.check(not is_library_current(expected, expected, 4000), "a cut off library isn't loaded");
+		checks.check(not is_library_current(expected, expected, 5000), "one with more bytes than it says isn't either");
+
+		auto empty = expected;
+		empty.library_size = 0;
+		checks.check(not is_library_current(empty, expected, 0), "an empty library isn't loaded");
+	}
+}
+
+auto main() -> int
+{
+	auto checks = test_checks{};
+
+	test_hash_bytes(checks);
+	test_pipeline_same(checks);
+	test_pipeline_changes(checks);
+	test_root_signature(checks);
+	test_pipeline_names(checks);
+	test_library_header(checks);
+
+	return checks.get_exit_code();
+}
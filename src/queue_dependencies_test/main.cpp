@@ -0,0 +1,272 @@
+#include "queue_dependencies.h"
+#include "test_checks.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+// Drives queue_dependencies with queues the test executes itself.
+// Commands run in submission order, and a wait holds everything behind
+// it until the other queue's fence reaches its value, as
+// ID3D12CommandQueue::Wait does on the GPU.
+
+namespace
+{
+	using namespace learning_dx12;
+
+	struct sim_queue
+	{
+		enum class command_type
+		{
+			work,
+			signal,
+			wait,
+		};
+
+		struct command
+		{
+			command_type type;
+			std::string work;
+			const sim_queue *other;
+			uint64_t value;
+		};
+
+		// Like cmd_queue::execute_commands, the work and then a signal.
+		void submit(std::string work)
+		{
+			fence_value++;
+			commands.push_back({ command_type::work, std::move(work), nullptr, 0 });
+			commands.push_back({ command_type::signal, {}, nullptr, fence_value });
+		}
+
+		// Same steps as cmd_queue::wait_on_gpu.
+		void wait_on_gpu(const sim_queue &other, uint64_t value)
+		{
+			if (not waits.needs_wait(other, value, other.completed_value))
+			{
+				return;
+			}
+
+			commands.push_back({ command_type::wait, {}, &other, value });
+			issued_wait_count++;
+
+			waits.add_wait(other, value);
+		}
+
+		// Runs the next command, unless it is a wait that isn't satisfied yet.
+		auto step(std::vector<std::string> &executed) -> bool
+		{
+			if (commands.empty())
+			{
+				return false;
+			}
+
+			auto &next = commands.front();
+			switch (next.type)
+			{
+			case command_type::work:
+				executed.push_back(next.work);
+				break;
+			case command_type::signal:
+				completed_value = next.value;
+				break;
+			case command_type::wait:
+				if (next.other->completed_value < next.value)
+				{
+					return false;
+				}
+				break;
+			}
+
+			commands.pop_front();
+			return true;
+		}
+
+		std::deque<command> commands{};
+		uint64_t fence_value{};
+		uint64_t completed_value{};
+
+		queue_dependencies<sim_queue> waits{};
+		size_t issued_wait_count{};
+	};
+
+	// Each round gives one queue, picked by the scheduler, as many steps as
+	// it can take. Stops when every queue is idle or none can move, which
+	// with work left means the waits deadlocked.
+	template <typename scheduler_type>
+	auto run_gpu(std::vector<sim_queue *> queues, scheduler_type scheduler) -> std::vector<std::string>
+	{
+		auto executed = std::vector<std::string>{};
+
+		while (true)
+		{
+			auto progressed = false;
+			for (auto attempt = size_t{}; attempt < queues.size(); attempt++)
+			{
+				auto &queue = *queues[scheduler(queues.size())];
+				while (queue.step(executed))
+				{
+					progressed = true;
+				}
+			}
+
+			if (not progressed)
+			{
+				for (auto queue : queues)
+				{
+					while (queue->step(executed))
+					{
+						progressed = true;
+					}
+				}
+			}
+
+			if (not progressed)
+			{
+				return executed;
+			}
+		}
+	}
+
+	// Always tries the last queue, the one doing the waiting, first.
+	auto waiting_queue_first(size_t count) -> size_t
+	{
+		return count - 1;
+	}
+
+	auto is_idle(const std::vector<sim_queue *> &queues) -> bool
+	{
+		return std::all_of(queues.begin(), queues.end(), [](const sim_queue *q)
+		{
+			return q->commands.empty();
+		});
+	}
+
+	void test_copy_before_draw(test_checks &checks)
+	{
+		auto copy = sim_queue{};
+		auto direct = sim_queue{};
+
+		copy.submit("upload");
+		direct.wait_on_gpu(copy, copy.fence_value);
+		direct.submit("draw");
+
+		auto executed = run_gpu({ &copy, &direct }, waiting_queue_first);
+		checks.check(executed == std::vector<std::string>{ "upload", "draw" }, "the draw waits for the upload");
+		checks.check(is_idle({ &copy, &direct }), "both queues ran dry");
+		checks.check_equal(direct.issued_wait_count, size_t{ 1 }, "one wait issued");
+	}
+
+	void test_covered_waits(test_checks &checks)
+	{
+		auto copy = sim_queue{};
+		auto direct = sim_queue{};
+
+		copy.submit("upload 1");
+		copy.submit("upload 2");
+		copy.submit("upload 3");
+
+		direct.wait_on_gpu(copy, 2);
+		direct.wait_on_gpu(copy, 1);
+		direct.wait_on_gpu(copy, 2);
+		checks.check_equal(direct.issued_wait_count, size_t{ 1 }, "waits covered by a larger one are skipped");
+		checks.check_equal(direct.waits.get_wait_value(copy), uint64_t{ 2 }, "largest value waited on");
+
+		direct.wait_on_gpu(copy, 3);
+		checks.check_equal(direct.issued_wait_count, size_t{ 2 }, "a larger value is waited on again");
+		checks.check_equal(direct.waits.get_wait_value(copy), uint64_t{ 3 }, "and raises what is covered");
+	}
+
+	void test_completed_work(test_checks &checks)
+	{
+		auto copy = sim_queue{};
+		auto direct = sim_queue{};
+
+		copy.submit("upload");
+		run_gpu({ &copy }, waiting_queue_first);
+
+		direct.wait_on_gpu(copy, 1);
+		checks.check_equal(direct.issued_wait_count, size_t{ 0 }, "no wait for work that has already finished");
+		checks.check_equal(direct.waits.get_wait_value(copy), uint64_t{ 0 }, "nothing recorded for a skipped wait");
+	}
+
+	void test_per_queue(test_checks &checks)
+	{
+		auto copy = sim_queue{};
+		auto compute = sim_queue{};
+		auto direct = sim_queue{};
+
+		copy.submit("upload");
+		compute.submit("skin");
+
+		direct.wait_on_gpu(copy, 1);
+		direct.wait_on_gpu(compute, 1);
+		direct.submit("draw");
+		checks.check_equal(direct.issued_wait_count, size_t{ 2 }, "waits on different queues don't cover each other");
+
+		auto executed = run_gpu({ &copy, &compute, &direct }, waiting_queue_first);
+		auto draw = std::find(executed.begin(), executed.end(), "draw");
+		checks.check(draw == executed.end() - 1 and executed.size() == 3, "the draw waits for both queues");
+	}
+
+	// Uploads streamed in every frame while the GPU runs the queues in
+	// arbitrary interleavings, each frame's draw still follows its upload.
+	void test_streaming(test_checks &checks)
+	{
+		constexpr auto frame_count = 200;
+
+		auto copy = sim_queue{};
+		auto direct = sim_queue{};
+
+		auto random = std::minstd_rand{ 7 };
+		auto scheduler = [&random](size_t count)
+		{
+			return static_cast<size_t>(random() % count);
+		};
+
+		auto executed = std::vector<std::string>{};
+		for (auto frame = 0; frame < frame_count; frame++)
+		{
+			copy.submit("upload " + std::to_string(frame));
+			direct.wait_on_gpu(copy, copy.fence_value);
+			direct.submit("draw " + std::to_string(frame));
+
+			if (frame % 3 == 0)
+			{
+				auto ran = run_gpu({ &copy, &direct }, scheduler);
+				executed.insert(executed.end(), ran.begin(), ran.end());
+			}
+		}
+		auto ran = run_gpu({ &copy, &direct }, scheduler);
+		executed.insert(executed.end(), ran.begin(), ran.end());
+
+		checks.check(is_idle({ &copy, &direct }), "no deadlock, both queues ran dry");
+		checks.check_equal(executed.size(), size_t{ frame_count * 2 }, "everything executed");
+
+		auto in_order = true;
+		for (auto frame = 0; frame < frame_count; frame++)
+		{
+			auto upload = std::find(executed.begin(), executed.end(), "upload " + std::to_string(frame));
+			auto draw = std::find(executed.begin(), executed.end(), "draw " + std::to_string(frame));
+			in_order = in_order and upload < draw;
+		}
+		checks.check(in_order, "every draw follows its upload");
+		checks.check(direct.issued_wait_count <= size_t{ frame_count }, "at most one wait per upload");
+	}
+}
+
+auto main() -> int
+{
+	auto checks = test_checks{};
+
+	test_copy_before_draw(checks);
+	test_covered_waits(checks);
+	test_completed_work(checks);
+	test_per_queue(checks);
+	test_streaming(checks);
+
+	return checks.get_exit_code();
+}
@@ -0,0 +1,448 @@
+#include "resource_state_tracker.h"
+#include "test_checks.h"
+
+#include <fmt/format.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Runs every short sequence of state uses, from every starting state, through
+// cmd_list_state_tracker and resource_state_registry, and replays the barriers
+// they hand out against a model of what the GPU does with them. A barrier has
+// to start from the state the subresource is really in, every use has to find
+// it in a state that covers it, and the registry has to agree with the model
+// after the implicit promotions and decays.
+
+namespace
+{
+	using namespace learning_dx12;
+
+	constexpr auto all_subresources = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+
+	constexpr auto combine(D3D12_RESOURCE_STATES a, D3D12_RESOURCE_STATES b) -> D3D12_RESOURCE_STATES
+	{
+		return static_cast<D3D12_RESOURCE_STATES>(a | b);
+	}
+
+	constexpr auto states = std::array{
+		D3D12_RESOURCE_STATE_COMMON,
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+		D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+		combine(D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+		D3D12_RESOURCE_STATE_COPY_SOURCE,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		D3D12_RESOURCE_STATE_RENDER_TARGET,
+	};
+
+	// For the longer runs of lists, enough to promote, widen and transition.
+	constexpr auto few_states = std::array{
+		D3D12_RESOURCE_STATE_COMMON,
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+		combine(D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+		D3D12_RESOURCE_STATE_RENDER_TARGET,
+	};
+
+	struct resource_kind
+	{
+		const char *name;
+		resource_traits traits;
+	};
+
+	constexpr auto kinds = std::array{
+		resource_kind{ "buffer", { 1, true, false } },
+		resource_kind{ "texture", { 1, false, false } },
+		resource_kind{ "texture with two mips", { 2, false, false } },
+		resource_kind{ "simultaneous-access texture", { 2, false, true } },
+	};
+
+	struct state_use
+	{
+		D3D12_RESOURCE_STATES state;
+		uint32_t subresource;
+	};
+
+	using list_uses = std::vector<state_use>;
+
+	// The rules as the D3D12 documentation states them, written out
+	// separately from the tracker's own.
+	auto is_read_only(D3D12_RESOURCE_STATES state) -> bool
+	{
+		constexpr auto read_states = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE
+		                           | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE
+		                           | D3D12_RESOURCE_STATE_COPY_SOURCE;
+		return state != D3D12_RESOURCE_STATE_COMMON and (state & ~read_states) == 0;
+	}
+
+	auto satisfies(D3D12_RESOURCE_STATES current, D3D12_RESOURCE_STATES wanted) -> bool
+	{
+		return current == wanted
+		    or (is_read_only(current) and is_read_only(wanted) and (current & wanted) == wanted);
+	}
+
+	auto promotes(const resource_traits &traits, D3D12_RESOURCE_STATES state) -> bool
+	{
+		if (state == D3D12_RESOURCE_STATE_COMMON)
+		{
+			return false;
+		}
+		return traits.is_buffer
+		    or traits.simultaneous_access
+		    or state == D3D12_RESOURCE_STATE_COPY_DEST
+		    or is_read_only(state);
+	}
+
+	// What the GPU holds for one subresource within an ExecuteCommandLists call.
+	struct gpu_subresource
+	{
+		D3D12_RESOURCE_STATES state;
+		bool promoted;
+		bool accessed;
+	};
+
+	class gpu_model
+	{
+	public:
+		gpu_model(const resource_traits &traits_, D3D12_RESOURCE_STATES initial) :
+			traits{ traits_ }, subresources(traits_.subresource_count, { initial, false, false })
+		{}
+
+		void barrier(const D3D12_RESOURCE_BARRIER &barrier)
+		{
+			auto &transition = barrier.Transition;
+			valid = valid
+			    and barrier.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION
+			    and transition.StateBefore != transition.StateAfter;
+
+			for_each(transition.Subresource, [&](gpu_subresource &sub)
+			{
+				valid = valid and sub.state == transition.StateBefore;
+				sub = { transition.StateAfter, false, true };
+			});
+		}
+
+		void use(const state_use &use)
+		{
+			for_each(use.subresource, [&](gpu_subresource &sub)
+			{
+				sub.accessed = true;
+				if (satisfies(sub.state, use.state))
+				{
+					return;
+				}
+
+				valid = valid and sub.state == D3D12_RESOURCE_STATE_COMMON and promotes(traits, use.state);
+				sub.state = use.state;
+				sub.promoted = true;
+			});
+		}
+
+		void finish_submission(bool copy_queue)
+		{
+			for (auto &sub : subresources)
+			{
+				auto decays = copy_queue
+				           or traits.is_buffer
+				           or traits.simultaneous_access
+				           or (sub.promoted and is_read_only(sub.state));
+				if (sub.accessed and decays)
+				{
+					sub.state = D3D12_RESOURCE_STATE_COMMON;
+				}
+				sub.promoted = false;
+				sub.accessed = false;
+			}
+		}
+
+		auto get_state(uint32_t subresource) const -> D3D12_RESOURCE_STATES
+		{
+			return subresources.at(subresource).state;
+		}
+
+		auto is_valid() const -> bool
+		{
+			return valid;
+		}
+
+	private:
+		void for_each(uint32_t subresource, const std::function<void(gpu_subresource &)> &function)
+		{
+			if (subresource != all_subresources)
+			{
+				function(subresources.at(subresource));
+				return;
+			}
+			for (auto &sub : subresources)
+			{
+				function(sub);
+			}
+		}
+
+	private:
+		resource_traits traits;
+		std::vector<gpu_subresource> subresources;
+		bool valid{ true };
+	};
+
+	// Each inner vector of submissions is one ExecuteCommandLists call.
+	struct scenario
+	{
+		const resource_kind *kind;
+		bool copy_queue;
+		D3D12_RESOURCE_STATES initial;
+		std::vector<std::vector<list_uses>> submissions;
+	};
+
+	auto describe(const scenario &s) -> std::string
+	{
+		auto text = fmt::format("{}{}, from {:#x}", s.kind->name, s.copy_queue ? " on a copy queue" : "", uint32_t(s.initial));
+		for (auto &lists : s.submissions)
+		{
+			text += ", submit";
+			for (auto &uses : lists)
+			{
+				text += " [";
+				for (auto &use : uses)
+				{
+					auto sub = use.subresource == all_subresources ? std::string{ "all" } : std::to_string(use.subresource);
+					text += fmt::format(" {:#x}:{}", uint32_t(use.state), sub);
+				}
+				text += " ]";
+			}
+		}
+		return text;
+	}
+
+	struct scenario_result
+	{
+		bool barriers_valid;
+		bool registry_valid;
+	};
+
+	auto run(const scenario &s) -> scenario_result
+	{
+		auto resource = reinterpret_cast<ID3D12Resource *>(uintptr_t{ 0x1000 });
+		auto &traits = s.kind->traits;
+
+		auto registry = resource_state_registry{};
+		registry.add(resource, traits, s.initial);
+		auto gpu = gpu_model{ traits, s.initial };
+
+		auto registry_valid = true;
+		for (auto &lists : s.submissions)
+		{
+			auto submission = state_submission{ s.copy_queue };
+			for (auto &uses : lists)
+			{
+				auto tracker = cmd_list_state_tracker{};
+				auto recorded = std::vector<std::vector<D3D12_RESOURCE_BARRIER>>{};
+				for (auto &use : uses)
+				{
+					tracker.transition(resource, traits, use.state, use.subresource, recorded.emplace_back());
+				}
+
+				// Fix-ups run ahead of the list, after the lists before it.
+				for (auto &fixup : registry.resolve(tracker, submission))
+				{
+					gpu.barrier(fixup);
+				}
+				for (auto i = 0u; i < uses.size(); i++)
+				{
+					for (auto &barrier : recorded[i])
+					{
+						gpu.barrier(barrier);
+					}
+					gpu.use(uses[i]);
+				}
+			}
+
+			registry.finish_submission(submission);
+			gpu.finish_submission(s.copy_queue);
+
+			for (auto sub = 0u; sub < traits.subresource_count; sub++)
+			{
+				registry_valid = registry_valid and registry.get_state(resource, sub) == gpu.get_state(sub);
+			}
+		}
+
+		return { gpu.is_valid(), registry_valid };
+	}
+
+	template <size_t count>
+	auto uses_for(const resource_kind &kind, const std::array<D3D12_RESOURCE_STATES, count> &use_states) -> std::vector<state_use>
+	{
+		auto uses = std::vector<state_use>{};
+		for (auto state : use_states)
+		{
+			uses.push_back({ state, all_subresources });
+			for (auto sub = 0u; sub < kind.traits.subresource_count; sub++)
+			{
+				uses.push_back({ state, sub });
+			}
+		}
+		return uses;
+	}
+
+	// Every list of 1 to max_length uses.
+	auto lists_for(const std::vector<state_use> &choices, size_t max_length) -> std::vector<list_uses>
+	{
+		auto lists = std::vector<list_uses>{};
+		auto grow = std::function<void(list_uses &)>{};
+		grow = [&](list_uses &list)
+		{
+			if (not list.empty())
+			{
+				lists.push_back(list);
+			}
+			if (list.size() == max_length)
+			{
+				return;
+			}
+			for (auto &use : choices)
+			{
+				list.push_back(use);
+				grow(list);
+				list.pop_back();
+			}
+		};
+		auto list = list_uses{};
+		grow(list);
+		return lists;
+	}
+
+	// Runs make_submissions' scenarios for every kind, queue and starting
+	// state, reporting the first failure of each kind of check.
+	void run_all(test_checks &checks, std::string_view what,
+	             const std::function<void(const resource_kind &, const std::function<void(std::vector<std::vector<list_uses>>)> &)> &make_submissions)
+	{
+		auto first_bad_barriers = std::string{}, first_bad_registry = std::string{};
+		auto count = 0u;
+
+		for (auto &kind : kinds)
+		{
+			for (auto copy_queue : { false, true })
+			{
+				for (auto initial : states)
+				{
+					make_submissions(kind, [&](std::vector<std::vector<list_uses>> submissions)
+					{
+						auto s = scenario{ &kind, copy_queue, initial, std::move(submissions) };
+						auto result = run(s);
+						count++;
+
+						if (not result.barriers_valid and first_bad_barriers.empty())
+						{
+							first_bad_barriers = describe(s);
+						}
+						if (not result.registry_valid and first_bad_registry.empty())
+						{
+							first_bad_registry = describe(s);
+						}
+					});
+				}
+			}
+		}
+
+		checks.check(first_bad_barriers.empty(), fmt::format("{}: every barrier starts from the subresource's state, every use finds it in a state covering it", what));
+		if (not first_bad_barriers.empty())
+		{
+			fmt::print(stderr, "    first one wrong: {}\n", first_bad_barriers);
+		}
+		checks.check(first_bad_registry.empty(), fmt::format("{}: the registry agrees with the gpu after each submission", what));
+		if (not first_bad_registry.empty())
+		{
+			fmt::print(stderr, "    first one wrong: {}\n", first_bad_registry);
+		}
+		fmt::print("{}: {} scenarios\n", what, count);
+	}
+
+	// Lists that reuse a wider read state need no barrier for it,
+	// whether the state came from the registry or an earlier list.
+	void test_no_redundant_fixups(test_checks &checks)
+	{
+		auto resource = reinterpret_cast<ID3D12Resource *>(uintptr_t{ 0x1000 });
+		auto traits = resource_traits{ 1, false, false };
+		auto read_states = combine(D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+
+		auto registry = resource_state_registry{};
+		registry.add(resource, traits, read_states);
+
+		auto submission = state_submission{ false };
+		auto tracker = cmd_list_state_tracker{};
+		auto barriers = std::vector<D3D12_RESOURCE_BARRIER>{};
+		tracker.transition(resource, traits, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, all_subresources, barriers);
+
+		checks.check(registry.resolve(tracker, submission).empty(), "a read state inside the current one needs no fix-up");
+		registry.finish_submission(submission);
+		checks.check_equal(uint32_t(registry.get_state(resource, 0)), uint32_t(read_states), "and the wider state is kept");
+
+		tracker.reset();
+		tracker.transition(resource, traits, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, all_subresources, barriers);
+		tracker.transition(resource, traits, D3D12_RESOURCE_STATE_RENDER_TARGET, all_subresources, barriers);
+		auto fixups = registry.resolve(tracker, submission);
+		checks.check_equal(fixups.size(), size_t{ 1 }, "but it is narrowed when the list's barriers start from the narrow state");
+	}
+}
+
+auto main() -> int
+{
+	auto checks = test_checks{};
+
+	run_all(checks, "one list", [](const resource_kind &kind, auto &&emit)
+	{
+		for (auto &list : lists_for(uses_for(kind, states), 3))
+		{
+			emit({ { list } });
+		}
+	});
+
+	run_all(checks, "two lists in one submission", [](const resource_kind &kind, auto &&emit)
+	{
+		auto lists = lists_for(uses_for(kind, states), kind.traits.subresource_count == 1 ? 2 : 1);
+		for (auto &first : lists)
+		{
+			for (auto &second : lists)
+			{
+				emit({ { first, second } });
+			}
+		}
+	});
+
+	run_all(checks, "two submissions", [](const resource_kind &kind, auto &&emit)
+	{
+		auto lists = lists_for(uses_for(kind, states), kind.traits.subresource_count == 1 ? 2 : 1);
+		for (auto &first : lists)
+		{
+			for (auto &second : lists)
+			{
+				emit({ { first }, { second } });
+			}
+		}
+	});
+
+	// Long enough for subresources to reach the same state with different
+	// decays pending, before a list uses the whole resource.
+	run_all(checks, "four lists in one submission", [](const resource_kind &kind, auto &&emit)
+	{
+		auto uses = uses_for(kind, few_states);
+		for (auto &a : uses)
+		{
+			for (auto &b : uses)
+			{
+				for (auto &c : uses)
+				{
+					for (auto &d : uses)
+					{
+						emit({ { { a }, { b }, { c }, { d } } });
+					}
+				}
+			}
+		}
+	});
+
+	test_no_redundant_fixups(checks);
+
+	return checks.get_exit_code();
+}
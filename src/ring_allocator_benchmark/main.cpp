@@ -0,0 +1,221 @@
+#include "ring_allocator.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Times a streaming upload workload, a few uploads of mixed sizes each
+// frame with the GPU a couple of frames behind, through ring_allocator and
+// through one heap allocation per upload, as the staging buffers used to be
+// made. A first pass checks every placement against the ones still in use.
+// Usage: ring_allocator_benchmark [<frames> [<runs>]]
+
+namespace
+{
+	using namespace learning_dx12;
+
+	constexpr auto default_frame_count = 10'000;
+	constexpr auto default_runs = 5;
+
+	constexpr auto capacity = uint64_t{ 16 * 1024 * 1024 }; // upload_ring_buffer's default
+	constexpr auto frames_in_flight = uint64_t{ 2 };
+	constexpr auto max_uploads_per_frame = 32;
+	constexpr auto min_upload_size = 64.0;
+	constexpr auto max_upload_size = 512.0 * 1024.0;
+
+	struct upload
+	{
+		uint64_t size;
+		uint64_t alignment;
+	};
+
+	using frame_uploads = std::vector<upload>;
+
+	// Sizes spread evenly across orders of magnitude, buffer and texture alignments.
+	auto make_workload(int frame_count) -> std::vector<frame_uploads>
+	{
+		auto random = std::mt19937{ 42 };
+		auto count = std::uniform_int_distribution<int>{ 0, max_uploads_per_frame };
+		auto log_size = std::uniform_real_distribution<double>{ std::log(min_upload_size), std::log(max_upload_size) };
+		auto alignments = std::array{ uint64_t{ 16 }, uint64_t{ 256 }, uint64_t{ 512 } };
+		auto alignment = std::uniform_int_distribution<size_t>{ 0, alignments.size() - 1 };
+
+		auto workload = std::vector<frame_uploads>(frame_count);
+		for (auto &frame : workload)
+		{
+			frame.resize(count(random));
+			for (auto &u : frame)
+			{
+				u = { static_cast<uint64_t>(std::exp(log_size(random))), alignments[alignment(random)] };
+			}
+		}
+		return workload;
+	}
+
+	// Frame n is fence value n + 1, and the GPU has completed the
+	// frame frames_in_flight before the one being recorded.
+	auto completed_value(uint64_t frame) -> uint64_t
+	{
+		return frame >= frames_in_flight ? frame - frames_in_flight + 1 : 0;
+	}
+
+	struct ring_result
+	{
+		uint64_t failed_count;
+		uint64_t peak_used;
+		uint64_t wasted_bytes;
+		uint64_t uploaded_bytes;
+	};
+
+	auto run_ring(const std::vector<frame_uploads> &workload) -> ring_result
+	{
+		auto ring = ring_allocator{ capacity };
+		auto peak_used = uint64_t{};
+		auto uploaded_bytes = uint64_t{};
+
+		for (auto frame = uint64_t{}; frame < workload.size(); frame++)
+		{
+			ring.release_completed(completed_value(frame));
+			for (auto &u : workload[frame])
+			{
+				ring.allocate(u.size, u.alignment);
+				uploaded_bytes += u.size;
+			}
+			peak_used = std::max(peak_used, ring.get_stats().used);
+			ring.finish_batch(frame + 1);
+		}
+
+		auto stats = ring.get_stats();
+		return { stats.failed_count, peak_used, stats.wasted_bytes, uploaded_bytes };
+	}
+
+	auto run_heap(const std::vector<frame_uploads> &workload) -> uint64_t
+	{
+		auto in_flight = std::deque<std::vector<std::unique_ptr<uint8_t[]>>>{};
+		auto allocation_count = uint64_t{};
+
+		for (auto frame = uint64_t{}; frame < workload.size(); frame++)
+		{
+			while (in_flight.size() > frames_in_flight)
+			{
+				in_flight.pop_front();
+			}
+
+			auto &staging = in_flight.emplace_back();
+			for (auto &u : workload[frame])
+			{
+				staging.push_back(std::make_unique<uint8_t[]>(u.size));
+				allocation_count++;
+			}
+		}
+		return allocation_count;
+	}
+
+	// Every placement is aligned, inside the ring, and clear of
+	// everything the GPU may still be reading.
+	auto check_placements(const std::vector<frame_uploads> &workload) -> bool
+	{
+		struct placement
+		{
+			uint64_t fence_value;
+			uint64_t begin;
+			uint64_t end;
+		};
+
+		auto ring = ring_allocator{ capacity };
+		auto live = std::deque<placement>{};
+		auto valid = true;
+
+		for (auto frame = uint64_t{}; frame < workload.size(); frame++)
+		{
+			auto completed = completed_value(frame);
+			ring.release_completed(completed);
+			while (not live.empty() and live.front().fence_value <= completed)
+			{
+				live.pop_front();
+			}
+
+			for (auto &u : workload[frame])
+			{
+				auto offset = ring.allocate(u.size, u.alignment);
+				if (not offset)
+				{
+					continue;
+				}
+
+				auto begin = *offset, end = *offset + u.size;
+				valid = valid
+				    and begin % u.alignment == 0
+				    and end <= capacity
+				    and std::none_of(live.begin(), live.end(), [&](const placement &p)
+				        {
+				            return begin < p.end and p.begin < end;
+				        });
+				live.push_back({ frame + 1, begin, end });
+			}
+			ring.finish_batch(frame + 1);
+		}
+
+		return valid;
+	}
+
+	template <typename function>
+	auto time_median_ms(int runs, const function &run) -> double
+	{
+		auto times = std::vector<double>{};
+		for (auto i = 0; i < runs; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			run();
+			auto end = std::chrono::steady_clock::now();
+			times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		}
+
+		std::sort(times.begin(), times.end());
+		return times[times.size() / 2];
+	}
+}
+
+auto main(int argc, char *argv[]) -> int
+{
+	auto frame_count = argc > 1 ? std::max(1, std::atoi(argv[1])) : default_frame_count;
+	auto runs = argc > 2 ? std::max(1, std::atoi(argv[2])) : default_runs;
+
+	auto workload = make_workload(frame_count);
+
+	if (not check_placements(workload))
+	{
+		fmt::print(stderr, "ring placed an upload over one still in use\n");
+		return 1;
+	}
+
+	auto result = ring_result{};
+	auto ring_ms = time_median_ms(runs, [&]
+	{
+		result = run_ring(workload);
+	});
+
+	auto heap_count = uint64_t{};
+	auto heap_ms = time_median_ms(runs, [&]
+	{
+		heap_count = run_heap(workload);
+	});
+
+	fmt::print("{} frames, {} uploads, {} frames in flight, {} MB ring\n",
+	           frame_count, heap_count, frames_in_flight, capacity / (1024 * 1024));
+	fmt::print("  ring  {:8.3f} ms  {:6.1f} ns per upload\n", ring_ms, ring_ms * 1e6 / heap_count);
+	fmt::print("  heap  {:8.3f} ms  {:6.1f} ns per upload\n", heap_ms, heap_ms * 1e6 / heap_count);
+	fmt::print("  ring peak {:.2f} MB, {} failed, {:.2f}% of uploaded bytes lost to alignment and wrap\n",
+	           result.peak_used / (1024.0 * 1024.0),
+	           result.failed_count,
+	           100.0 * result.wasted_bytes / result.uploaded_bytes);
+	return 0;
+}
@@ -0,0 +1,264 @@
+#include "root_layout_planner.h"
+#include "test_checks.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+// Checks the layouts plan_root_layout picks, the HLSL it writes for them
+// and the root signature descriptions made from them, without a device.
+
+namespace
+{
+	using namespace learning_dx12;
+
+	auto make_declaration(std::string name, root_data_kind kind, update_frequency frequency, uint32_t size_dwords = 0,
+	                      D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_VERTEX) -> root_parameter_declaration
+	{
+		auto type = kind == root_data_kind::texture_srv ? std::string{ "Texture2D" }
+		          : kind == root_data_kind::buffer_srv  ? std::string{ "StructuredBuffer<float4>" }
+		          : kind == root_data_kind::buffer_uav  ? std::string{ "RWStructuredBuffer<float4>" }
+		                                                : name + "_data";
+		return { std::move(name), std::move(type), kind, frequency, size_dwords, visibility };
+	}
+
+	// What draw_cube declares, root_layout.hlsli beside its shaders is this plan.
+	void test_cube_layout(test_checks &checks)
+	{
+		auto layout = plan_root_layout({
+			{ "draw_cb", "draw_constants", root_data_kind::constants, update_frequency::per_draw, 1, D3D12_SHADER_VISIBILITY_VERTEX },
+			{ "view_projection_cb", "view_projection", root_data_kind::constants, update_frequency::per_frame, 16, D3D12_SHADER_VISIBILITY_VERTEX },
+			{ "instances", "StructuredBuffer<cube_instance>", root_data_kind::buffer_srv, update_frequency::per_frame, 0, D3D12_SHADER_VISIBILITY_VERTEX },
+		});
+
+		checks.check(layout.fits, "fits");
+		checks.check_equal(layout.size_dwords, 19u, "two constant blocks and a root descriptor");
+		checks.check_equal(layout.per_draw_updates, 1u, "only the draw constants change per draw");
+		checks.check(layout.parameters[0].binding == root_binding::constants and layout.parameters[0].root_index == 0,
+		             "draw constants first, inline");
+		checks.check(layout.parameters[1].binding == root_binding::constants and layout.parameters[1].root_index == 1,
+		             "view projection next, inline");
+		checks.check(layout.parameters[2].binding == root_binding::descriptor and layout.parameters[2].root_index == 2,
+		             "instances as a root descriptor");
+
+		checks.check_equal(emit_hlsl(layout),
+		                   std::string{ "// Generated by plan_root_layout, 19 DWORDs, 1 root arguments set per draw.\n"
+		                                "ConstantBuffer<draw_constants> draw_cb : register(b0);\n"
+		                                "ConstantBuffer<view_projection> view_projection_cb : register(b1);\n"
+		                                "StructuredBuffer<cube_instance> instances : register(t0);\n" },
+		                   "the HLSL root_layout.hlsli holds");
+	}
+
+	// Over budget, what changes least often moves out first, constants
+	// into a root descriptor, descriptors into a table.
+	void test_demotion(test_checks &checks)
+	{
+		auto layout = plan_root_layout({
+			make_declaration("object", root_data_kind::constants, update_frequency::per_draw, 4),
+			make_declaration("frame", root_data_kind::constants, update_frequency::per_frame, 40),
+			make_declaration("material", root_data_kind::constants, update_frequency::per_material, 30),
+		});
+		checks.check(layout.fits and layout.size_dwords <= root_signature_budget_dwords, "fits after one move");
+		checks.check(layout.parameters[1].binding == root_binding::descriptor, "per frame constants move into a buffer");
+		checks.check(layout.parameters[2].binding == root_binding::constants, "per material ones stay, moving one was enough");
+		checks.check(layout.parameters[0].binding == root_binding::constants, "per draw ones stay");
+
+		layout = plan_root_layout({
+			make_declaration("object", root_data_kind::constants, update_frequency::per_draw, 2),
+			make_declaration("albedo_buffer", root_data_kind::buffer_srv, update_frequency::per_material),
+			make_declaration("normal_buffer", root_data_kind::buffer_srv, update_frequency::per_material),
+			make_declaration("lights", root_data_kind::buffer_srv, update_frequency::per_frame),
+			make_declaration("skin", root_data_kind::buffer_srv, update_frequency::per_draw),
+		}, 6);
+		checks.check(layout.fits, "fits a 6 DWORD budget");
+		checks.check(layout.parameters[3].binding == root_binding::table, "per frame buffer moves into a table first");
+		checks.check(layout.parameters[1].binding == root_binding::table and layout.parameters[2].binding == root_binding::table,
+		             "per material buffers next");
+		checks.check(layout.parameters[1].root_index == layout.parameters[2].root_index, "sharing one table");
+		checks.check(layout.parameters[1].table_offset == 0 and layout.parameters[2].table_offset == 1, "in declaration order");
+		checks.check(layout.parameters[4].binding == root_binding::descriptor, "the per draw buffer stays in the root");
+		checks.check_equal(layout.size_dwords, 6u, "constants, a root descriptor and two tables");
+
+		// Constants of two DWORDs or less cost no more than a root descriptor
+		auto small = std::vector<root_parameter_declaration>{};
+		for (auto i = 0; i < 40; i++)
+		{
+			small.push_back(make_declaration(fmt::format("c{}", i), root_data_kind::constants, update_frequency::per_frame, 2));
+		}
+		layout = plan_root_layout(small);
+		checks.check(not layout.fits, "what can't move out doesn't fit");
+		checks.check_equal(layout.size_dwords, 80u, "and is left inline");
+
+		layout = plan_root_layout({ make_declaration("albedo", root_data_kind::texture_srv, update_frequency::per_material) });
+		checks.check(layout.parameters[0].binding == root_binding::table, "textures are always in a table");
+	}
+
+	// Most often set first, inline before indirect, registers in root order.
+	void test_order(test_checks &checks)
+	{
+		auto layout = plan_root_layout({
+			make_declaration("albedo", root_data_kind::texture_srv, update_frequency::per_material, 0, D3D12_SHADER_VISIBILITY_PIXEL),
+			make_declaration("frame", root_data_kind::constants, update_frequency::per_frame, 8),
+			make_declaration("particles", root_data_kind::buffer_uav, update_frequency::per_draw),
+			make_declaration("object", root_data_kind::constants, update_frequency::per_draw, 4),
+			make_declaration("normal", root_data_kind::texture_srv, update_frequency::per_material, 0, D3D12_SHADER_VISIBILITY_PIXEL),
+			make_declaration("shadow", root_data_kind::texture_srv, update_frequency::per_frame, 0, D3D12_SHADER_VISIBILITY_PIXEL),
+		});
+
+		auto root_order = std::vector<uint32_t>{};
+		for (auto &parameter : layout.parameters)
+		{
+			root_order.push_back(parameter.root_index);
+		}
+		checks.check(root_order == std::vector<uint32_t>{ 2, 3, 1, 0, 2, 4 }, "per draw, then per material, then per frame");
+		checks.check_equal(layout.slots.size(), size_t{ 5 }, "the material textures share a table");
+		checks.check_equal(layout.per_draw_updates, 2u, "two per draw arguments");
+
+		checks.check(layout.parameters[3].register_type == 'b' and layout.parameters[3].shader_register == 0, "object at b0");
+		checks.check(layout.parameters[1].register_type == 'b' and layout.parameters[1].shader_register == 1, "frame at b1");
+		checks.check(layout.parameters[2].register_type == 'u' and layout.parameters[2].shader_register == 0, "particles at u0");
+		checks.check(layout.parameters[0].shader_register == 0 and layout.parameters[4].shader_register == 1
+		             and layout.parameters[5].shader_register == 2, "textures at t0, t1 and t2");
+
+		auto again = plan_root_layout(layout.declarations);
+		checks.check(emit_hlsl(again) == emit_hlsl(layout), "the same declarations give the same layout");
+	}
+
+	void test_root_signature(test_checks &checks)
+	{
+		auto layout = plan_root_layout({
+			make_declaration("object", root_data_kind::constants, update_frequency::per_draw, 4),
+			make_declaration("skin", root_data_kind::constant_buffer, update_frequency::per_draw),
+			make_declaration("particles", root_data_kind::buffer_uav, update_frequency::per_draw),
+			make_declaration("albedo", root_data_kind::texture_srv, update_frequency::per_material, 0, D3D12_SHADER_VISIBILITY_PIXEL),
+			make_declaration("output", root_data_kind::buffer_uav, update_frequency::per_material, 0, D3D12_SHADER_VISIBILITY_PIXEL),
+		}, 9);
+
+		auto signature = root_signature_layout{ layout, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT };
+		auto &desc = signature.get_desc();
+		checks.check(desc.Version == D3D_ROOT_SIGNATURE_VERSION_1_1, "version 1.1, for the data flags");
+		checks.check_equal(desc.Desc_1_1.NumParameters, static_cast<UINT>(layout.slots.size()), "a parameter per slot");
+		checks.check(desc.Desc_1_1.Flags == D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT, "flags passed through");
+
+		auto &object = desc.Desc_1_1.pParameters[layout.parameters[0].root_index];
+		checks.check(object.ParameterType == D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS
+		             and object.Constants.Num32BitValues == 4 and object.Constants.ShaderRegister == 0,
+		             "constants at b0, 4 values");
+
+		auto &skin = desc.Desc_1_1.pParameters[layout.parameters[1].root_index];
+		checks.check(skin.ParameterType == D3D12_ROOT_PARAMETER_TYPE_CBV and skin.Descriptor.ShaderRegister == 1
+		             and skin.Descriptor.Flags == D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE,
+		             "a root CBV at b1, static while set");
+
+		auto &particles = desc.Desc_1_1.pParameters[layout.parameters[2].root_index];
+		checks.check(particles.ParameterType == D3D12_ROOT_PARAMETER_TYPE_UAV
+		             and particles.Descriptor.Flags == D3D12_ROOT_DESCRIPTOR_FLAG_NONE,
+		             "a root UAV, shaders write it so it isn't static");
+
+		auto &table = desc.Desc_1_1.pParameters[layout.parameters[3].root_index];
+		checks.check(layout.parameters[3].root_index == layout.parameters[4].root_index, "pixel shader material data in one table");
+		checks.check(table.ParameterType == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE
+		             and table.ShaderVisibility == D3D12_SHADER_VISIBILITY_PIXEL
+		             and table.DescriptorTable.NumDescriptorRanges == 2, "a pixel shader table of two ranges");
+		if (table.ParameterType == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE and table.DescriptorTable.NumDescriptorRanges == 2)
+		{
+			auto &srv = table.DescriptorTable.pDescriptorRanges[0];
+			auto &uav = table.DescriptorTable.pDescriptorRanges[1];
+			checks.check(srv.RangeType == D3D12_DESCRIPTOR_RANGE_TYPE_SRV and srv.OffsetInDescriptorsFromTableStart == 0
+			             and srv.Flags == D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, "texture first, static");
+			checks.check(uav.RangeType == D3D12_DESCRIPTOR_RANGE_TYPE_UAV and uav.OffsetInDescriptorsFromTableStart == 1
+			             and uav.BaseShaderRegister == 1 and uav.Flags == D3D12_DESCRIPTOR_RANGE_FLAG_NONE, "then the UAV at u1");
+		}
+	}
+
+	// Random declarations and budgets. Every declaration is placed once,
+	// slots are in frequency order, registers never repeat, sizes add up,
+	// and a layout only misses its budget when nothing more can move out.
+	void test_fuzz(test_checks &checks, uint32_t seed)
+	{
+		auto random = std::mt19937{ seed };
+		auto pick = [&](uint32_t count) { return std::uniform_int_distribution<uint32_t>{ 0, count - 1 }(random); };
+		auto visibilities = std::array{ D3D12_SHADER_VISIBILITY_ALL, D3D12_SHADER_VISIBILITY_VERTEX, D3D12_SHADER_VISIBILITY_PIXEL };
+
+		auto valid = true, some_missed = false, some_fit = false;
+		for (auto run = 0; run < 500 and valid; run++)
+		{
+			auto declarations = std::vector<root_parameter_declaration>{};
+			for (auto i = pick(16) + 1; i > 0; i--)
+			{
+				auto kind = static_cast<root_data_kind>(pick(5));
+				auto size = kind == root_data_kind::constants ? pick(24) + 1 : 0;
+				declarations.push_back(make_declaration(fmt::format("p{}", declarations.size()), kind,
+				                                        static_cast<update_frequency>(pick(3)), size, visibilities[pick(3)]));
+			}
+			auto budget = pick(64) + 1;
+			auto layout = plan_root_layout(declarations, budget);
+
+			auto placed = std::vector<int>(declarations.size());
+			auto size = uint32_t{};
+			for (auto root_index = 0u; root_index < layout.slots.size(); root_index++)
+			{
+				auto &slot = layout.slots[root_index];
+				size += slot.size_dwords;
+				valid = valid and not slot.declarations.empty()
+				    and (slot.declarations.size() == 1 or slot.binding == root_binding::table)
+				    and (root_index == 0 or layout.slots[root_index - 1].frequency >= slot.frequency);
+				for (auto offset = 0u; offset < slot.declarations.size(); offset++)
+				{
+					auto declaration = slot.declarations[offset];
+					auto &parameter = layout.parameters[declaration];
+					placed[declaration]++;
+					valid = valid and parameter.root_index == root_index and parameter.table_offset == offset
+					    and parameter.binding == slot.binding
+					    and declarations[declaration].frequency == slot.frequency
+					    and declarations[declaration].visibility == slot.visibility;
+				}
+			}
+			valid = valid and std::all_of(placed.begin(), placed.end(), [](int count) { return count == 1; });
+			valid = valid and size == layout.size_dwords and layout.fits == (size <= budget);
+
+			auto registers = std::set<std::pair<char, uint32_t>>{};
+			for (auto i = 0u; i < declarations.size(); i++)
+			{
+				auto &parameter = layout.parameters[i];
+				valid = valid and registers.insert({ parameter.register_type, parameter.shader_register }).second
+				    and (declarations[i].kind != root_data_kind::texture_srv or parameter.binding == root_binding::table)
+				    and (parameter.binding != root_binding::constants or declarations[i].kind == root_data_kind::constants);
+				if (not layout.fits)
+				{
+					auto movable = parameter.binding == root_binding::descriptor
+					            or (parameter.binding == root_binding::constants and declarations[i].size_dwords > 2);
+					valid = valid and not movable;
+				}
+			}
+
+			some_missed = some_missed or not layout.fits;
+			some_fit = some_fit or (layout.fits and layout.slots.size() > 1);
+		}
+
+		auto what = fmt::format("seed {}: ", seed);
+		checks.check(valid, what + "layouts place everything once, in order, and only miss the budget when stuck");
+		checks.check(some_missed and some_fit, what + "some layouts fit and some couldn't");
+	}
+}
+
+auto main() -> int
+{
+	auto checks = test_checks{};
+
+	test_cube_layout(checks);
+	test_demotion(checks);
+	test_order(checks);
+	test_root_signature(checks);
+	for (auto seed : { 1u, 2u, 3u })
+	{
+		test_fuzz(checks, seed);
+	}
+
+	return checks.get_exit_code();
+}
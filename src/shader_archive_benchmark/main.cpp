@@ -0,0 +1,227 @@
+#include "shader_archive.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+// Packs generated shaders, a quarter of them copies of others, into a
+// stored and a compressed archive, and times opening each and finding
+// every shader in it against reading them as loose files the way the
+// lessons did before, one byte at a time through std::istream_iterator.
+// Every shader is checked to come back as it went in. Files are written
+// to the temp directory.
+// Usage: shader_archive_benchmark [<shaders> [<runs>]]
+
+namespace
+{
+	using namespace learning_dx12;
+	using bytes = std::vector<uint8_t>;
+
+	constexpr auto default_shader_count = 400;
+	constexpr auto default_runs = 20;
+
+	constexpr auto min_shader_size = 2'000u;
+	constexpr auto max_shader_size = 22'000u;
+	constexpr auto duplicate_percent = 25;
+	constexpr auto snippet_count = 128;
+	constexpr auto constant_percent = 12;
+	constexpr auto register_percent = 20;
+
+	// Compiled shaders repeat the same short instruction sequences with
+	// different registers, and carry the odd constant, in 32 bit words.
+	auto make_shaders(int shader_count) -> std::vector<bytes>
+	{
+		auto random = std::mt19937{ 42 };
+		auto percent = std::uniform_int_distribution<int>{ 0, 99 };
+		auto size = std::uniform_int_distribution<uint32_t>{ min_shader_size / 4, max_shader_size / 4 };
+		auto snippet_length = std::uniform_int_distribution<uint32_t>{ 3, 12 };
+		auto reg = std::uniform_int_distribution<uint32_t>{ 0, 15 };
+
+		auto snippets = std::vector<std::vector<uint32_t>>(snippet_count);
+		for (auto &snippet : snippets)
+		{
+			snippet.resize(snippet_length(random));
+			for (auto &word : snippet)
+			{
+				word = static_cast<uint32_t>(random());
+			}
+		}
+		auto pick_snippet = std::uniform_int_distribution<size_t>{ 0, snippets.size() - 1 };
+
+		auto shaders = std::vector<bytes>{};
+		for (auto i = 0; i < shader_count; i++)
+		{
+			if (not shaders.empty() and percent(random) < duplicate_percent)
+			{
+				auto original = std::uniform_int_distribution<size_t>{ 0, shaders.size() - 1 }(random);
+				shaders.push_back(shaders[original]);
+				continue;
+			}
+
+			auto words = std::vector<uint32_t>(size(random));
+			for (auto word = words.begin(); word != words.end();)
+			{
+				auto roll = percent(random);
+				if (roll < constant_percent)
+				{
+					*word++ = static_cast<uint32_t>(random());
+				}
+				else if (roll < constant_percent + register_percent)
+				{
+					*word++ = 0x0010'0000u | reg(random);
+				}
+				else
+				{
+					auto &snippet = snippets[pick_snippet(random)];
+					auto count = std::min(snippet.size(), static_cast<size_t>(words.end() - word));
+					word = std::copy_n(snippet.begin(), count, word);
+				}
+			}
+			auto &shader = shaders.emplace_back(words.size() * sizeof(uint32_t));
+			std::memcpy(shader.data(), words.data(), shader.size());
+		}
+		return shaders;
+	}
+
+	auto shader_name(size_t i) -> std::string
+	{
+		return fmt::format("shader_{:04}", i);
+	}
+
+	auto write_file(const std::filesystem::path &path, const bytes &data) -> bool
+	{
+		auto file = std::ofstream(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char *>(data.data()), data.size());
+		return static_cast<bool>(file);
+	}
+
+	// How draw_cube read a .cso before there was an archive.
+	auto read_loose(const std::filesystem::path &path) -> bytes
+	{
+		auto buffer = bytes{};
+		auto file = std::ifstream(path, std::ios::in | std::ios::binary);
+		file.unsetf(std::ios::skipws);
+
+		file.seekg(0, std::ios::end);
+		buffer.reserve(static_cast<size_t>(file.tellg()));
+		file.seekg(0, std::ios::beg);
+
+		std::copy(std::istream_iterator<uint8_t>(file),
+		          std::istream_iterator<uint8_t>(),
+		          std::back_inserter(buffer));
+		return buffer;
+	}
+
+	// Opened afresh, so compressed shaders are expanded every time.
+	auto check_archive(const std::filesystem::path &path, const std::vector<bytes> &shaders) -> bool
+	{
+		auto archive = shader_archive{ path };
+		if (not archive.is_open() or archive.get_shader_count() != shaders.size())
+		{
+			return false;
+		}
+
+		for (auto i = size_t{}; i < shaders.size(); i++)
+		{
+			auto found = archive.find(shader_name(i));
+			if (not found or found->size != shaders[i].size()
+			    or std::memcmp(found->data, shaders[i].data(), found->size) != 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	template <typename function>
+	auto time_median_ms(int runs, const function &run) -> double
+	{
+		auto times = std::vector<double>{};
+		for (auto i = 0; i < runs; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			run();
+			auto end = std::chrono::steady_clock::now();
+			times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		}
+
+		std::sort(times.begin(), times.end());
+		return times[times.size() / 2];
+	}
+}
+
+auto main(int argc, char *argv[]) -> int
+{
+	auto shader_count = argc > 1 ? std::max(1, std::atoi(argv[1])) : default_shader_count;
+	auto runs = argc > 2 ? std::max(1, std::atoi(argv[2])) : default_runs;
+
+	auto shaders = make_shaders(shader_count);
+
+	auto directory = std::filesystem::temp_directory_path() / "shader_archive_benchmark";
+	std::filesystem::create_directories(directory);
+	auto stored_path = directory / "stored.shaders";
+	auto compressed_path = directory / "compressed.shaders";
+
+	auto writer = shader_archive_writer{};
+	for (auto i = size_t{}; i < shaders.size(); i++)
+	{
+		writer.add(shader_name(i), shaders[i].data(), shaders[i].size());
+		if (not write_file(directory / (shader_name(i) + ".cso"), shaders[i]))
+		{
+			fmt::print(stderr, "can't write the loose shaders to {}\n", directory.string());
+			return 1;
+		}
+	}
+
+	auto pack_ms = time_median_ms(runs, [&] { writer.build(false); });
+	auto stored = writer.build(false);
+	auto compress_ms = time_median_ms(runs, [&] { writer.build(true); });
+	auto compressed = writer.build(true);
+	auto stats = writer.get_stats();
+
+	if (not write_file(stored_path, stored) or not write_file(compressed_path, compressed))
+	{
+		fmt::print(stderr, "can't write the archives to {}\n", directory.string());
+		return 1;
+	}
+	if (not check_archive(stored_path, shaders) or not check_archive(compressed_path, shaders))
+	{
+		fmt::print(stderr, "a shader found in an archive differs from what was packed\n");
+		return 1;
+	}
+
+	auto found_size = size_t{};
+	auto find_all = [&](const std::filesystem::path &path)
+	{
+		auto archive = shader_archive{ path };
+		for (auto i = size_t{}; i < shaders.size(); i++)
+		{
+			found_size += archive.find(shader_name(i))->size;
+		}
+	};
+	auto stored_ms = time_median_ms(runs, [&] { find_all(stored_path); });
+	auto compressed_ms = time_median_ms(runs, [&] { find_all(compressed_path); });
+	auto loose_ms = time_median_ms(runs, [&]
+	{
+		for (auto i = size_t{}; i < shaders.size(); i++)
+		{
+			found_size += read_loose(directory / (shader_name(i) + ".cso")).size();
+		}
+	});
+
+	auto to_mb = [](uint64_t size) { return size / (1024.0 * 1024.0); };
+	fmt::print("{} shaders, {} unique, {:.1f} MB\n", stats.entry_count, stats.blob_count, to_mb(stats.input_size));
+	fmt::print("  stored       {:6.1f} MB  packed in {:8.3f} ms, all found in {:8.3f} ms\n", to_mb(stored.size()), pack_ms, stored_ms);
+	fmt::print("  compressed   {:6.1f} MB  packed in {:8.3f} ms, all found in {:8.3f} ms\n", to_mb(compressed.size()), compress_ms, compressed_ms);
+	fmt::print("  loose files  {:6.1f} MB  {:26}all read in {:8.3f} ms\n", to_mb(stats.input_size), "", loose_ms);
+	return found_size > 0 ? 0 : 1;
+}
@@ -0,0 +1,277 @@
+#include "shader_archive.h"
+#include "test_checks.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Builds archives with shader_archive_writer, reads them back through a
+// memory mapped shader_archive, and damages them to check the reader and
+// the lz decoder turn them down. Archives are written to the temp directory.
+
+namespace
+{
+	using namespace learning_dx12;
+	using namespace learning_dx12::shader_archive_format;
+	using bytes = std::vector<uint8_t>;
+
+	// Runs of repeated instructions between random constants, about as
+	// compressible as compiled shaders, or nothing but noise.
+	auto make_shader(uint32_t seed, size_t size, bool compressible) -> bytes
+	{
+		auto random = std::mt19937{ seed };
+		auto shader = bytes(size);
+		for (auto i = size_t{}; i < size; i++)
+		{
+			auto noise = static_cast<uint8_t>(random());
+			shader[i] = (compressible and i % 64 < 48) ? static_cast<uint8_t>(i % 16 + seed) : noise;
+		}
+		return shader;
+	}
+
+	auto temp_path(std::string_view name) -> std::filesystem::path
+	{
+		return std::filesystem::temp_directory_path() / fmt::format("shader_archive_test_{}.shaders", name);
+	}
+
+	void write_file(const std::filesystem::path &path, const bytes &data)
+	{
+		auto file = std::ofstream(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char *>(data.data()), data.size());
+	}
+
+	auto finds(shader_archive &archive, std::string_view name, const bytes &expected) -> bool
+	{
+		auto found = archive.find(name);
+		return found and found->size == expected.size()
+		   and std::memcmp(found->data, expected.data(), expected.size()) == 0;
+	}
+
+	void test_round_trip(test_checks &checks, bool compress)
+	{
+		auto what = [&](std::string_view check) { return fmt::format("{}: {}", compress ? "compressed" : "stored", check); };
+
+		auto shaders = std::vector<bytes>{
+			make_shader(1, 12'000, true),
+			make_shader(2, 5'000, false),
+			make_shader(3, 3, true),
+			{},
+		};
+		auto names = std::vector<std::string>{ "vertex_shader", "pixel_shader", "tiny", "empty" };
+
+		auto writer = shader_archive_writer{};
+		for (auto i = size_t{}; i < shaders.size(); i++)
+		{
+			writer.add(names[i], shaders[i].data(), shaders[i].size());
+		}
+		auto data = writer.build(compress);
+		auto path = temp_path(compress ? "compressed" : "stored");
+		write_file(path, data);
+
+		auto archive = shader_archive{ path };
+		checks.check(archive.is_open(), what("opens"));
+		checks.check_equal(archive.get_shader_count(), 4u, what("every shader"));
+
+		auto all_found = true;
+		for (auto i = size_t{}; i < shaders.size(); i++)
+		{
+			all_found = all_found and finds(archive, names[i], shaders[i]);
+		}
+		checks.check(all_found, what("each found by name, with its own bytes"));
+		checks.check(finds(archive, "vertex_shader", shaders[0]), what("and again, once expanded"));
+		checks.check(not archive.find("geometry_shader") and not archive.find("vertex"), what("names it doesn't have"));
+
+		auto stats = writer.get_stats();
+		checks.check_equal(stats.archive_size, uint64_t{ data.size() }, what("archive size"));
+		if (compress)
+		{
+			auto stored = shader_archive_writer{};
+			for (auto i = size_t{}; i < shaders.size(); i++)
+			{
+				stored.add(names[i], shaders[i].data(), shaders[i].size());
+			}
+			checks.check(data.size() < stored.build(false).size(), what("smaller than stored as is"));
+		}
+	}
+
+	void test_dedup_and_replace(test_checks &checks)
+	{
+		auto shared = make_shader(4, 2'000, true);
+		auto other = make_shader(5, 2'000, true);
+
+		auto writer = shader_archive_writer{};
+		writer.add("cube_vs", shared.data(), shared.size());
+		writer.add("sky_vs", shared.data(), shared.size());
+		writer.add("cube_ps", other.data(), other.size());
+		writer.add("cube_ps", shared.data(), shared.size());
+		auto path = temp_path("dedup");
+		write_file(path, writer.build(false));
+
+		auto stats = writer.get_stats();
+		checks.check_equal(stats.entry_count, 3u, "adding a name again replaces it");
+		checks.check_equal(stats.blob_count, 2u, "identical shaders share a blob");
+		checks.check_equal(stats.input_size, uint64_t{ 4 * 2'000 }, "input counts every shader added");
+
+		auto archive = shader_archive{ path };
+		checks.check(finds(archive, "cube_ps", shared), "a replaced name has what it was given last");
+		auto cube = archive.find("cube_vs"), sky = archive.find("sky_vs");
+		checks.check(cube and sky and cube->data == sky->data, "shared blobs are the same bytes in the mapping");
+	}
+
+	// Each corruption on its own copy of a good archive, all must be turned
+	// down when the archive is opened.
+	void test_damaged_archives(test_checks &checks)
+	{
+		auto shader = make_shader(6, 4'000, true);
+		auto writer = shader_archive_writer{};
+		writer.add("vs", shader.data(), shader.size());
+		writer.add("ps", shader.data(), 1'000);
+		auto good = writer.build(false);
+
+		auto entries_at = sizeof(header);
+		auto blobs_at = entries_at + 2 * sizeof(entry);
+
+		auto opens = [&](std::string_view name, const bytes &data)
+		{
+			auto path = temp_path(name);
+			write_file(path, data);
+			return shader_archive{ path }.is_open();
+		};
+		auto patched = [&](size_t offset, const auto &value)
+		{
+			auto data = good;
+			std::memcpy(data.data() + offset, &value, sizeof(value));
+			return data;
+		};
+
+		checks.check(opens("good", good), "the undamaged archive opens");
+		checks.check(not opens("missing", {}) and not shader_archive{ temp_path("not_there") }.is_open(), "empty or missing file");
+		checks.check(not opens("short_header", bytes(good.begin(), good.begin() + sizeof(header) - 1)), "shorter than the header");
+		checks.check(not opens("short_tables", bytes(good.begin(), good.begin() + blobs_at)), "tables cut off");
+		checks.check(not opens("short_blobs", bytes(good.begin(), good.end() - 1)), "last blob cut off");
+
+		checks.check(not opens("magic", patched(offsetof(header, magic), uint32_t{ 0x12345678 })), "wrong magic");
+		checks.check(not opens("version", patched(offsetof(header, version), file_version + 1)), "newer version");
+		checks.check(not opens("entry_count", patched(offsetof(header, entry_count), uint32_t{ 0x1000'0000 })), "entry count past the end");
+		checks.check(not opens("names_size", patched(offsetof(header, names_size), uint64_t{ 1 } << 40)), "names past the end");
+
+		checks.check(not opens("entry_blob", patched(entries_at + offsetof(entry, blob), uint32_t{ 2 })), "entry of a blob that isn't there");
+		checks.check(not opens("entry_name", patched(entries_at + offsetof(entry, name_offset), uint32_t{ 3 })), "name past the name table");
+
+		checks.check(not opens("blob_offset", patched(blobs_at + offsetof(blob, offset), uint64_t{ good.size() + 1 })), "blob offset past the end");
+		checks.check(not opens("blob_overflow", patched(blobs_at + offsetof(blob, offset), UINT64_MAX - 8)), "blob offset wrapping around");
+		checks.check(not opens("blob_size", patched(blobs_at + offsetof(blob, stored_size), uint64_t{ good.size() })), "blob running past the end");
+		checks.check(not opens("blob_method", patched(blobs_at + offsetof(blob, method), uint32_t{ 7 })), "unknown compression");
+		checks.check(not opens("blob_stored", patched(blobs_at + offsetof(blob, size), uint64_t{ 5 })), "stored blob sizes disagree");
+	}
+
+	// The tables are in bounds but the compressed bytes don't expand to
+	// the size they claim, found when the blob is first asked for.
+	void test_damaged_blob(test_checks &checks)
+	{
+		auto shader = make_shader(7, 4'000, true);
+		auto writer = shader_archive_writer{};
+		writer.add("vs", shader.data(), shader.size());
+		auto data = writer.build(true);
+
+		auto table_at = sizeof(header) + sizeof(entry);
+		auto table = blob{};
+		std::memcpy(&table, data.data() + table_at, sizeof(table));
+		checks.check(table.method == compression::lz, "compressible blob is stored compressed");
+
+		table.size++;
+		std::memcpy(data.data() + table_at, &table, sizeof(table));
+		auto path = temp_path("damaged_blob");
+		write_file(path, data);
+
+		auto archive = shader_archive{ path };
+		checks.check(archive.is_open(), "a compressed blob is only checked once expanded");
+		checks.check(not archive.find("vs") and not archive.find("vs"), "one that doesn't expand is never returned");
+	}
+
+	void test_lz_round_trip(test_checks &checks)
+	{
+		auto valid = true;
+		for (auto size : { 0u, 1u, 3u, 4u, 5u, 15u, 16u, 300u, 70'000u, 200'000u })
+		{
+			for (auto compressible : { true, false })
+			{
+				auto source = make_shader(size, size, compressible);
+				auto packed = lz_compress(source.data(), source.size());
+				auto unpacked = bytes(source.size());
+				valid = valid and lz_decompress(packed.data(), packed.size(), unpacked.data(), unpacked.size())
+				        and unpacked == source;
+			}
+		}
+		checks.check(valid, "lz: every size comes back as it went in");
+
+		// Long runs need lengths of several bytes, and matches overlapping
+		// what they copy, in both literals and matches.
+		auto runs = bytes(100'000, 7);
+		auto noise = make_shader(8, 1'000, false);
+		runs.insert(runs.begin() + 50'000, noise.begin(), noise.end());
+		auto packed = lz_compress(runs.data(), runs.size());
+		auto unpacked = bytes(runs.size());
+		checks.check(lz_decompress(packed.data(), packed.size(), unpacked.data(), unpacked.size()) and unpacked == runs,
+		             "lz: long runs and literals");
+		checks.check(packed.size() < 2'000, "lz: runs compress");
+	}
+
+	// Hand written streams. Token: literals << 4 | (match length - 4),
+	// then literals, a 16 bit offset, and extra length bytes for nibbles
+	// of 15. Each stream is followed by bytes the decoder mustn't read,
+	// chosen so a decoder reading them would succeed, and the output by
+	// bytes it mustn't write. Either counts as decoding.
+	void test_lz_damaged(test_checks &checks)
+	{
+		constexpr auto guard_size = size_t{ 1024 };
+
+		auto decodes = [](const bytes &stream, size_t out_size, uint8_t beyond = 0)
+		{
+			auto in = stream;
+			in.resize(stream.size() + guard_size, 0);
+			in[stream.size()] = beyond;
+			auto out = bytes(out_size + guard_size, 0xcd);
+			auto decoded = lz_decompress(in.data(), stream.size(), out.data(), out_size);
+			return decoded or std::any_of(out.begin() + out_size, out.end(), [](uint8_t b) { return b != 0xcd; });
+		};
+
+		// "abcd" then 4 more copied from 4 back, "abcdabcd"
+		checks.check(decodes({ 0x40, 'a', 'b', 'c', 'd', 4, 0 }, 8), "lz: a well formed match");
+		checks.check(decodes({ 0x10, 'a', 1, 0 }, 5), "lz: a match overlapping itself");
+		checks.check(decodes({}, 0) and not decodes({}, 1), "lz: nothing at all");
+
+		checks.check(not decodes({ 0x40, 'a', 'b', 'c', 'd', 0, 0 }, 8), "lz: offset of zero");
+		checks.check(not decodes({ 0x40, 'a', 'b', 'c', 'd', 5, 0 }, 8), "lz: offset before the start");
+		checks.check(not decodes({ 0x41, 'a', 'b', 'c', 'd', 4, 0 }, 8), "lz: match past the end of the output");
+		checks.check(not decodes({ 0x4f, 'a', 'b', 'c', 'd', 4, 0, 255, 255, 10 }, 8), "lz: over-long match length");
+		checks.check(not decodes({ 0x4f, 'a', 'b', 'c', 'd', 4, 0, 255 }, 4 + 4 + 15 + 255 + 30, 30), "lz: match length bytes cut off");
+		checks.check(not decodes({ 0xf0, 255 }, 15 + 255 + 30, 30), "lz: literal length bytes cut off");
+		checks.check(not decodes({ 0x40, 'a', 'b' }, 4), "lz: literals cut off");
+		checks.check(not decodes({ 0x40, 'a', 'b', 'c', 'd', 4 }, 8), "lz: offset cut off");
+		checks.check(not decodes({ 0x40, 'a', 'b', 'c', 'd' }, 3), "lz: more literals than the output holds");
+		checks.check(not decodes({ 0x40, 'a', 'b', 'c', 'd' }, 5), "lz: output not filled");
+	}
+}
+
+auto main() -> int
+{
+	auto checks = test_checks{};
+
+	test_round_trip(checks, false);
+	test_round_trip(checks, true);
+	test_dedup_and_replace(checks);
+	test_damaged_archives(checks);
+	test_damaged_blob(checks);
+	test_lz_round_trip(checks);
+	test_lz_damaged(checks);
+
+	return checks.get_exit_code();
+}
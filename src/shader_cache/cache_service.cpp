@@ -0,0 +1,406 @@
+#include "cache_service.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <string>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif // _WIN32
+
+using namespace learning_dx12;
+using namespace learning_dx12::cache_service_protocol;
+
+namespace
+{
+	constexpr auto max_transfer_size = size_t{ 1 } << 20;
+
+	// Closes itself, reads and writes all of what it's given or fail.
+	class connection
+	{
+	public:
+#ifdef _WIN32
+		using native_handle = HANDLE;
+		static inline const auto closed = INVALID_HANDLE_VALUE;
+#else
+		using native_handle = int;
+		static inline const auto closed = -1;
+#endif // _WIN32
+
+	public:
+		explicit connection(native_handle handle_) :
+			handle{ handle_ }
+		{}
+		connection(const connection &) = delete;
+		auto operator=(const connection &) -> connection & = delete;
+		~connection();
+
+		auto is_open() const -> bool
+		{
+			return handle != closed;
+		}
+
+		auto get() const -> native_handle
+		{
+			return handle;
+		}
+
+		auto read(void *data, size_t size) -> bool;
+		auto write(const void *data, size_t size) -> bool;
+
+	private:
+		native_handle handle;
+	};
+
+#ifdef _WIN32
+
+	constexpr auto pipe_name = L"\\\\.\\pipe\\learning_dx12_shader_cache";
+	constexpr auto pipe_buffer_size = DWORD{ 64 * 1024 };
+	constexpr auto busy_wait_ms = DWORD{ 2000 };
+
+	connection::~connection()
+	{
+		if (is_open())
+		{
+			::CloseHandle(handle);
+		}
+	}
+
+	auto connection::read(void *data, size_t size) -> bool
+	{
+		auto bytes = static_cast<uint8_t *>(data);
+		while (size > 0)
+		{
+			auto chunk = DWORD{};
+			if (not ::ReadFile(handle, bytes, static_cast<DWORD>(std::min(size, max_transfer_size)), &chunk, nullptr)
+			    or chunk == 0)
+			{
+				return false;
+			}
+			bytes += chunk;
+			size -= chunk;
+		}
+		return true;
+	}
+
+	auto connection::write(const void *data, size_t size) -> bool
+	{
+		auto bytes = static_cast<const uint8_t *>(data);
+		while (size > 0)
+		{
+			auto chunk = DWORD{};
+			if (not ::WriteFile(handle, bytes, static_cast<DWORD>(std::min(size, max_transfer_size)), &chunk, nullptr))
+			{
+				return false;
+			}
+			bytes += chunk;
+			size -= chunk;
+		}
+		return true;
+	}
+
+	// Every instance is busy while the service answers someone else.
+	auto connect_to_service() -> connection::native_handle
+	{
+		auto pipe = ::CreateFileW(pipe_name, GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+		if (pipe == INVALID_HANDLE_VALUE
+		    and ::GetLastError() == ERROR_PIPE_BUSY
+		    and ::WaitNamedPipeW(pipe_name, busy_wait_ms))
+		{
+			pipe = ::CreateFileW(pipe_name, GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+		}
+		return pipe;
+	}
+
+	// Only the first instance may create the pipe, a second
+	// service fails here instead of sharing the name.
+	auto create_pipe_instance(bool first) -> HANDLE
+	{
+		return ::CreateNamedPipeW(pipe_name,
+		                          PIPE_ACCESS_DUPLEX | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+		                          PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+		                          PIPE_UNLIMITED_INSTANCES,
+		                          pipe_buffer_size,
+		                          pipe_buffer_size,
+		                          0,
+		                          nullptr);
+	}
+
+#else
+
+	connection::~connection()
+	{
+		if (is_open())
+		{
+			::close(handle);
+		}
+	}
+
+	auto connection::read(void *data, size_t size) -> bool
+	{
+		auto bytes = static_cast<uint8_t *>(data);
+		while (size > 0)
+		{
+			auto chunk = ::read(handle, bytes, std::min(size, max_transfer_size));
+			if (chunk < 0 and errno == EINTR)
+			{
+				continue;
+			}
+			if (chunk <= 0)
+			{
+				return false;
+			}
+			bytes += chunk;
+			size -= static_cast<size_t>(chunk);
+		}
+		return true;
+	}
+
+	auto connection::write(const void *data, size_t size) -> bool
+	{
+		auto bytes = static_cast<const uint8_t *>(data);
+		while (size > 0)
+		{
+			auto chunk = ::send(handle, bytes, std::min(size, max_transfer_size), MSG_NOSIGNAL);
+			if (chunk < 0 and errno == EINTR)
+			{
+				continue;
+			}
+			if (chunk <= 0)
+			{
+				return false;
+			}
+			bytes += chunk;
+			size -= static_cast<size_t>(chunk);
+		}
+		return true;
+	}
+
+	auto get_socket_address() -> sockaddr_un
+	{
+		auto socket_path = (std::filesystem::temp_directory_path() / "learning_dx12_shader_cache.sock").string();
+
+		auto address = sockaddr_un{};
+		address.sun_family = AF_UNIX;
+		socket_path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+		return address;
+	}
+
+	auto connect_to_service() -> connection::native_handle
+	{
+		auto address = get_socket_address();
+		auto socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (socket < 0)
+		{
+			return connection::closed;
+		}
+
+		if (::connect(socket, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0)
+		{
+			::close(socket);
+			return connection::closed;
+		}
+		return socket;
+	}
+
+#endif // _WIN32
+
+	// False once asked to stop. A request that can't be read is dropped.
+	auto handle_request(connection &client, compile_cache &cache) -> bool
+	{
+		auto request = cache_service_protocol::request{};
+		if (not client.read(&request, sizeof(request)))
+		{
+			return true;
+		}
+
+		auto response = cache_service_protocol::response{};
+		auto bytecode = std::vector<uint8_t>{};
+		switch (request.type)
+		{
+		case request_type::find:
+			if (auto found = cache.find(request.key))
+			{
+				bytecode = std::move(*found);
+				response.found = 1;
+				response.size = bytecode.size();
+			}
+			cache.record(response.found != 0);
+			break;
+
+		case request_type::store:
+			if (request.size == 0 or request.size > max_bytecode_size)
+			{
+				return true;
+			}
+			bytecode.resize(static_cast<size_t>(request.size));
+			if (not client.read(bytecode.data(), bytecode.size()))
+			{
+				return true;
+			}
+			cache.store(request.key, bytecode);
+			bytecode.clear();
+			break;
+
+		case request_type::stats:
+			response.stats = cache.read_stats(request.reset_stats != 0);
+			break;
+
+		case request_type::stop:
+			client.write(&response, sizeof(response));
+			return false;
+
+		default:
+			return true;
+		}
+
+		client.write(&response, sizeof(response))
+			and client.write(bytecode.data(), bytecode.size());
+		return true;
+	}
+
+	// Bytecode, if asked for, is whatever follows the response.
+	auto send_request(const cache_service_protocol::request &request, const void *payload,
+	                  cache_service_protocol::response &response, std::vector<uint8_t> *bytecode = nullptr) -> bool
+	{
+		auto service = connection{ connect_to_service() };
+		if (not service.is_open()
+		    or not service.write(&request, sizeof(request))
+		    or (payload and not service.write(payload, static_cast<size_t>(request.size)))
+		    or not service.read(&response, sizeof(response)))
+		{
+			return false;
+		}
+
+		if (not bytecode)
+		{
+			return true;
+		}
+		if (response.size > max_bytecode_size)
+		{
+			return false;
+		}
+		bytecode->resize(static_cast<size_t>(response.size));
+		return service.read(bytecode->data(), bytecode->size());
+	}
+}
+
+#ifdef _WIN32
+
+// The next pipe instance is created before a client is answered,
+// so there is always one for another build to connect to.
+auto learning_dx12::serve_cache(compile_cache &cache) -> bool
+{
+	auto pipe = create_pipe_instance(true);
+	if (pipe == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	while (true)
+	{
+		auto client = connection{ pipe };
+		auto connected = ::ConnectNamedPipe(client.get(), nullptr) or ::GetLastError() == ERROR_PIPE_CONNECTED;
+
+		pipe = create_pipe_instance(false);
+		if (pipe == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		auto keep_serving = not connected or handle_request(client, cache);
+		::FlushFileBuffers(client.get());
+		::DisconnectNamedPipe(client.get());
+
+		if (not keep_serving)
+		{
+			::CloseHandle(pipe);
+			return true;
+		}
+	}
+}
+
+#else
+
+// A socket something answers on belongs to a running service,
+// one nothing answers on was left by a service that didn't stop.
+auto learning_dx12::serve_cache(compile_cache &cache) -> bool
+{
+	if (cache_service::is_running())
+	{
+		return false;
+	}
+
+	auto address = get_socket_address();
+	::unlink(address.sun_path);
+
+	auto listener = connection{ ::socket(AF_UNIX, SOCK_STREAM, 0) };
+	if (not listener.is_open()
+	    or ::bind(listener.get(), reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0
+	    or ::listen(listener.get(), SOMAXCONN) != 0)
+	{
+		return false;
+	}
+
+	auto keep_serving = true;
+	while (keep_serving)
+	{
+		auto client = connection{ ::accept(listener.get(), nullptr, nullptr) };
+		if (not client.is_open())
+		{
+			if (errno == EINTR or errno == ECONNABORTED)
+			{
+				continue;
+			}
+			break;
+		}
+		keep_serving = handle_request(client, cache);
+	}
+
+	::unlink(address.sun_path);
+	return not keep_serving;
+}
+
+#endif // _WIN32
+
+auto cache_service::is_running() -> bool
+{
+	return connection{ connect_to_service() }.is_open();
+}
+
+auto cache_service::find(uint64_t key, std::vector<uint8_t> &bytecode) -> std::optional<bool>
+{
+	auto response = cache_service_protocol::response{};
+	if (not send_request({ request_type::find, 0, key, 0 }, nullptr, response, &bytecode))
+	{
+		return std::nullopt;
+	}
+	return response.found != 0;
+}
+
+auto cache_service::store(uint64_t key, const std::vector<uint8_t> &bytecode) -> bool
+{
+	auto response = cache_service_protocol::response{};
+	return send_request({ request_type::store, 0, key, bytecode.size() }, bytecode.data(), response);
+}
+
+auto cache_service::get_stats(bool reset) -> std::optional<cache_stats>
+{
+	auto response = cache_service_protocol::response{};
+	if (not send_request({ request_type::stats, reset ? 1u : 0u, 0, 0 }, nullptr, response))
+	{
+		return std::nullopt;
+	}
+	return response.stats;
+}
+
+auto cache_service::stop() -> bool
+{
+	auto response = cache_service_protocol::response{};
+	return send_request({ request_type::stop, 0, 0, 0 }, nullptr, response);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "compile_cache.h"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace learning_dx12
+{
+	// One process serving a compile_cache to every build on this machine,
+	// through a named pipe on Windows and a unix domain socket elsewhere.
+	// Builds find it by that fixed name and use it instead of their own
+	// cache directory, so separate build trees share compiled shaders.
+	namespace cache_service_protocol
+	{
+		enum class request_type : uint32_t
+		{
+			find,
+			store,  // bytecode follows the request
+			stats,
+			stop,
+		};
+
+		struct request
+		{
+			request_type type;
+			uint32_t reset_stats;
+			uint64_t key;
+			uint64_t size;
+		};
+
+		struct response
+		{
+			uint32_t found;
+			uint32_t reserved;
+			uint64_t size;      // bytecode follows the response
+			cache_stats stats;
+		};
+
+		constexpr auto max_bytecode_size = uint64_t{ 64 } << 20;
+	}
+
+	// Serves requests one connection at a time, until asked to stop.
+	// False if another service is running already, or it couldn't start.
+	auto serve_cache(compile_cache &cache) -> bool;
+
+	// Each call is its own connection, nothing is held between them,
+	// so a build compiling a shader doesn't keep others waiting.
+	// Every call returns nothing, or false, if no service is running.
+	namespace cache_service
+	{
+		auto is_running() -> bool;
+		auto find(uint64_t key, std::vector<uint8_t> &bytecode) -> std::optional<bool>;
+		auto store(uint64_t key, const std::vector<uint8_t> &bytecode) -> bool;
+		auto get_stats(bool reset) -> std::optional<cache_stats>;
+		auto stop() -> bool;
+	}
+}
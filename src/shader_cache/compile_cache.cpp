@@ -0,0 +1,117 @@
+#include "compile_cache.h"
+
+#include <fmt/format.h>
+
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <system_error>
+
+using namespace learning_dx12;
+
+namespace
+{
+	// One byte per lookup, 'h' for a hit and 'm' for a miss. Builds running
+	// at once all append to it, at worst a count is lost, never an entry.
+	constexpr auto stats_file_name = "lookups.log";
+
+	auto read_file(const std::filesystem::path &file_path) -> std::optional<std::vector<uint8_t>>
+	{
+		auto file = std::ifstream(file_path, std::ios::in | std::ios::binary | std::ios::ate);
+		if (not file.is_open())
+		{
+			return std::nullopt;
+		}
+
+		auto bytes = std::vector<uint8_t>(static_cast<size_t>(file.tellg()));
+		file.seekg(0, std::ios::beg);
+		if (bytes.empty() or not file.read(reinterpret_cast<char *>(bytes.data()), bytes.size()))
+		{
+			return std::nullopt;
+		}
+		return bytes;
+	}
+}
+
+compile_cache::compile_cache(std::filesystem::path directory_) :
+	directory{ std::move(directory_) }
+{
+	auto error = std::error_code{};
+	std::filesystem::create_directories(directory, error);
+}
+
+compile_cache::~compile_cache() = default;
+
+// An entry that can't be read is a miss, the shader is compiled and stored again.
+auto compile_cache::find(uint64_t key) const -> std::optional<std::vector<uint8_t>>
+{
+	return read_file(get_entry_path(key));
+}
+
+// Written beside the entry and renamed into place, so a build reading it
+// at the same time sees all of it or none of it. Two builds storing the
+// same key store the same bytes, whichever rename wins.
+void compile_cache::store(uint64_t key, const std::vector<uint8_t> &bytecode)
+{
+	auto entry_path = get_entry_path(key);
+
+	auto error = std::error_code{};
+	std::filesystem::create_directories(entry_path.parent_path(), error);
+
+	auto temp_path = entry_path;
+	temp_path += fmt::format(".{:08x}.tmp", std::random_device{}());
+	{
+		auto file = std::ofstream(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char *>(bytecode.data()), bytecode.size());
+		if (not file)
+		{
+			file.close();
+			std::filesystem::remove(temp_path, error);
+			return;
+		}
+	}
+
+	std::filesystem::rename(temp_path, entry_path, error);
+	if (error)
+	{
+		std::filesystem::remove(temp_path, error);
+	}
+}
+
+void compile_cache::record(bool hit)
+{
+	auto file = std::ofstream(directory / stats_file_name, std::ios::out | std::ios::binary | std::ios::app);
+	file.put(hit ? 'h' : 'm');
+}
+
+auto compile_cache::read_stats(bool reset) -> cache_stats
+{
+	auto stats = cache_stats{};
+	auto stats_path = directory / stats_file_name;
+	{
+		auto file = std::ifstream(stats_path, std::ios::in | std::ios::binary);
+		for (auto lookup = std::istreambuf_iterator<char>{ file }; lookup != std::istreambuf_iterator<char>{}; ++lookup)
+		{
+			(*lookup == 'h' ? stats.hits : stats.misses)++;
+		}
+	}
+
+	if (reset)
+	{
+		auto error = std::error_code{};
+		std::filesystem::remove(stats_path, error);
+	}
+	return stats;
+}
+
+// Spread over 256 subdirectories, keeping each one small.
+auto compile_cache::get_entry_path(uint64_t key) const -> std::filesystem::path
+{
+	return directory / fmt::format("{:02x}", key >> 56) / fmt::format("{:016x}.cso", key);
+}
+
+auto learning_dx12::hit_rate(const cache_stats &stats) -> double
+{
+	auto lookups = stats.hits + stats.misses;
+	return lookups ? 100.0 * static_cast<double>(stats.hits) / static_cast<double>(lookups) : 0.0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+namespace learning_dx12
+{
+	struct cache_stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+	};
+
+	// Compiled shaders in a directory, each file named after the key of
+	// everything that went into compiling it, so an entry never changes once
+	// written. Several builds may use the same directory at once.
+	class compile_cache
+	{
+	public:
+		compile_cache(std::filesystem::path directory);
+		compile_cache() = delete;
+		~compile_cache();
+
+		auto find(uint64_t key) const -> std::optional<std::vector<uint8_t>>;
+		void store(uint64_t key, const std::vector<uint8_t> &bytecode);
+
+		// Counts survive between runs, until read with reset.
+		void record(bool hit);
+		auto read_stats(bool reset) -> cache_stats;
+
+	private:
+		auto get_entry_path(uint64_t key) const -> std::filesystem::path;
+
+	private:
+		std::filesystem::path directory{};
+	};
+
+	auto hit_rate(const cache_stats &stats) -> double;
+}
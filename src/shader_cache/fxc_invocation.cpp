@@ -0,0 +1,228 @@
+#include "fxc_invocation.h"
+
+#include "fnv_hash.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iterator>
+#include <string_view>
+#include <system_error>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+extern char **environ;
+#endif // _WIN32
+
+using namespace learning_dx12;
+
+namespace
+{
+	// Options followed by a separate value.
+	constexpr auto options_with_values = std::array<std::string_view, 11>{
+		"/E", "/T", "/D", "/I", "/Fo", "/Fd", "/Fe", "/Fh", "/Fc", "/Fx", "/Vn",
+	};
+
+	// Defines and include directories change what the source preprocesses to.
+	constexpr auto preprocessor_options = std::array<std::string_view, 2>{ "/D", "/I" };
+
+	// Strings are hashed with their terminator, so "ab" "c" and "a" "bc" differ.
+	auto hash_string(std::string_view text, uint64_t hash) -> uint64_t
+	{
+		hash = hash_bytes(text.data(), text.size(), hash);
+		return hash_bytes("", 1, hash);
+	}
+
+	template <size_t count>
+	auto is_one_of(std::string_view arg, const std::array<std::string_view, count> &options) -> bool
+	{
+		return std::find(options.begin(), options.end(), arg) != options.end();
+	}
+
+	template <size_t count>
+	auto starts_with_one_of(std::string_view arg, const std::array<std::string_view, count> &options) -> bool
+	{
+		return std::any_of(options.begin(), options.end(), [&](std::string_view option)
+		{
+			return arg.size() > option.size() and arg.substr(0, option.size()) == option;
+		});
+	}
+
+	auto read_file(const std::filesystem::path &file_path) -> std::optional<std::vector<uint8_t>>
+	{
+		auto file = std::ifstream(file_path, std::ios::in | std::ios::binary | std::ios::ate);
+		if (not file.is_open())
+		{
+			return std::nullopt;
+		}
+
+		auto bytes = std::vector<uint8_t>(static_cast<size_t>(file.tellg()));
+		file.seekg(0, std::ios::beg);
+		if (not file.read(reinterpret_cast<char *>(bytes.data()), bytes.size()))
+		{
+			return std::nullopt;
+		}
+		return bytes;
+	}
+
+#ifdef _WIN32
+	// The C runtime joins arguments with spaces, quoting is up to the caller.
+	// Backslashes are only special when they come before a quote.
+	auto quote_argument(const std::string &arg) -> std::string
+	{
+		if (not arg.empty() and arg.find_first_of(" \t\"") == std::string::npos)
+		{
+			return arg;
+		}
+
+		auto quoted = std::string{ "\"" };
+		auto backslashes = size_t{};
+		for (auto c : arg)
+		{
+			if (c == '\\')
+			{
+				backslashes++;
+				continue;
+			}
+			quoted.append(c == '"' ? backslashes * 2 + 1 : backslashes, '\\');
+			quoted.push_back(c);
+			backslashes = 0;
+		}
+		quoted.append(backslashes * 2, '\\');
+		quoted.push_back('"');
+		return quoted;
+	}
+#endif // _WIN32
+}
+
+fxc_invocation::fxc_invocation(std::vector<std::string> command_) :
+	command{ std::move(command_) }
+{
+	for (auto i = size_t{ 1 }; i + 1 < command.size(); i++)
+	{
+		if (command[i] == "/Fo")
+		{
+			output_index = ++i;
+		}
+		else if (is_one_of(command[i], options_with_values))
+		{
+			i++;
+		}
+	}
+
+	// Paths can start with a slash too, so the source is only known by being last.
+	if (command.size() > 2 and output_index != command.size() - 1)
+	{
+		source_index = command.size() - 1;
+	}
+}
+
+fxc_invocation::~fxc_invocation() = default;
+
+auto fxc_invocation::is_valid() const -> bool
+{
+	return output_index > 0 and source_index > 0;
+}
+
+auto fxc_invocation::get_output() const -> std::filesystem::path
+{
+	return command.at(output_index);
+}
+
+// fxc preprocesses the source itself, into a file beside the output,
+// so includes and defines are resolved exactly as a compile would.
+// The compiler's size stands in for its version.
+auto fxc_invocation::compute_key() const -> std::optional<uint64_t>
+{
+	auto preprocessed_path = get_output();
+	preprocessed_path += ".i";
+
+	auto preprocess = std::vector<std::string>{ command.front(), "/nologo" };
+	for (auto i = size_t{ 1 }; i < command.size(); i++)
+	{
+		if (is_one_of(command[i], preprocessor_options) and i + 1 < command.size())
+		{
+			preprocess.push_back(command[i]);
+			preprocess.push_back(command[++i]);
+		}
+		else if (starts_with_one_of(command[i], preprocessor_options))
+		{
+			preprocess.push_back(command[i]);
+		}
+	}
+	preprocess.push_back("/P");
+	preprocess.push_back(preprocessed_path.string());
+	preprocess.push_back(command[source_index]);
+
+	auto error = std::error_code{};
+	auto preprocessed = run_process(preprocess) == 0 ? read_file(preprocessed_path) : std::nullopt;
+	std::filesystem::remove(preprocessed_path, error);
+	if (not preprocessed)
+	{
+		return std::nullopt;
+	}
+
+	auto compiler_size = std::filesystem::file_size(command.front(), error);
+	auto key = hash_bytes(&compiler_size, sizeof(compiler_size));
+	for (auto i = size_t{ 1 }; i < command.size(); i++)
+	{
+		if (i != output_index and i != source_index)
+		{
+			key = hash_string(command[i], key);
+		}
+	}
+	return hash_bytes(preprocessed->data(), preprocessed->size(), key);
+}
+
+auto fxc_invocation::compile() const -> int
+{
+	return run_process(command);
+}
+
+#ifdef _WIN32
+
+auto learning_dx12::run_process(const std::vector<std::string> &command) -> int
+{
+	auto quoted = std::vector<std::string>{};
+	std::transform(command.begin(), command.end(), std::back_inserter(quoted), quote_argument);
+
+	auto argv = std::vector<const char *>{};
+	for (auto &arg : quoted)
+	{
+		argv.push_back(arg.c_str());
+	}
+	argv.push_back(nullptr);
+
+	auto result = ::_spawnvp(_P_WAIT, command.front().c_str(), argv.data());
+	return static_cast<int>(result);
+}
+
+#else
+
+auto learning_dx12::run_process(const std::vector<std::string> &command) -> int
+{
+	auto argv = std::vector<char *>{};
+	for (auto &arg : command)
+	{
+		argv.push_back(const_cast<char *>(arg.c_str()));
+	}
+	argv.push_back(nullptr);
+
+	auto pid = pid_t{};
+	if (::posix_spawnp(&pid, argv.front(), nullptr, nullptr, argv.data(), environ) != 0)
+	{
+		return -1;
+	}
+
+	auto status = 0;
+	if (::waitpid(pid, &status, 0) != pid or not WIFEXITED(status))
+	{
+		return -1;
+	}
+	return WEXITSTATUS(status);
+}
+
+#endif // _WIN32
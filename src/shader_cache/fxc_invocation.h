@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace learning_dx12
+{
+	// One fxc command line, as target_shader_sources writes it:
+	// <fxc> [<option> ...] /Fo <output> <source>
+	// Only the /Fo output is cached, other files fxc may be asked to write aren't.
+	class fxc_invocation
+	{
+	public:
+		fxc_invocation(std::vector<std::string> command);
+		fxc_invocation() = delete;
+		~fxc_invocation();
+
+		auto is_valid() const -> bool;
+		auto get_output() const -> std::filesystem::path;
+
+		// Hash of the preprocessed source, and every option but where the
+		// output goes. Empty if the source doesn't preprocess, fxc is then
+		// run as it is to report why.
+		auto compute_key() const -> std::optional<uint64_t>;
+		auto compile() const -> int;
+
+	private:
+		std::vector<std::string> command{};
+		size_t output_index{};
+		size_t source_index{};
+	};
+
+	auto run_process(const std::vector<std::string> &command) -> int;
+}
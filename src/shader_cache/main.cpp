@@ -0,0 +1,161 @@
+#include "cache_service.h"
+#include "compile_cache.h"
+#include "fxc_invocation.h"
+
+#include <fmt/format.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Runs fxc through a cache of shaders it compiled before, keyed by their
+// preprocessed source and options, so unchanged shaders aren't compiled again.
+// Usage: shader_cache compile <cache dir> <fxc> [<fxc option> ...]
+//        shader_cache stats [--reset] <cache dir>
+//        shader_cache serve <cache dir>
+//        shader_cache stop
+
+namespace
+{
+	using namespace learning_dx12;
+
+	auto read_file(const std::filesystem::path &file_path, std::vector<uint8_t> &bytes) -> bool
+	{
+		auto file = std::ifstream(file_path, std::ios::in | std::ios::binary | std::ios::ate);
+		if (not file.is_open())
+		{
+			return false;
+		}
+
+		bytes.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0, std::ios::beg);
+		return static_cast<bool>(file.read(reinterpret_cast<char *>(bytes.data()), bytes.size()));
+	}
+
+	auto write_file(const std::filesystem::path &file_path, const std::vector<uint8_t> &bytes) -> bool
+	{
+		auto file = std::ofstream(file_path, std::ios::out | std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+		return static_cast<bool>(file);
+	}
+
+	void print_usage()
+	{
+		fmt::print(stderr,
+		           "usage: shader_cache compile <cache dir> <fxc> [<fxc option> ...]\n"
+		           "       shader_cache stats [--reset] <cache dir>\n"
+		           "       shader_cache serve <cache dir>\n"
+		           "       shader_cache stop\n");
+	}
+
+	// A running service is used instead of the cache directory given here.
+	// Hits are copied to the output, misses are compiled and then stored.
+	// fxc's own exit code is returned when it runs.
+	auto compile(const std::filesystem::path &cache_directory, std::vector<std::string> command) -> int
+	{
+		auto fxc = fxc_invocation{ std::move(command) };
+		if (not fxc.is_valid())
+		{
+			fmt::print(stderr, "shader_cache: expected an fxc command line with /Fo <output> and a source\n");
+			return 1;
+		}
+
+		auto key = fxc.compute_key();
+		if (not key)
+		{
+			return fxc.compile();
+		}
+
+		auto cache = compile_cache{ cache_directory };
+		auto bytecode = std::vector<uint8_t>{};
+		auto found = cache_service::find(*key, bytecode);
+		auto use_service = found.has_value();
+		if (not use_service)
+		{
+			auto stored = cache.find(*key);
+			found = stored.has_value();
+			if (stored)
+			{
+				bytecode = std::move(*stored);
+			}
+			cache.record(*found);
+		}
+
+		if (*found and write_file(fxc.get_output(), bytecode))
+		{
+			return 0;
+		}
+
+		auto result = fxc.compile();
+		if (result == 0 and read_file(fxc.get_output(), bytecode) and not bytecode.empty())
+		{
+			if (not use_service or not cache_service::store(*key, bytecode))
+			{
+				cache.store(*key, bytecode);
+			}
+		}
+		return result;
+	}
+
+	// Reported by the service if it is running, it counts every build using it.
+	auto print_stats(const std::filesystem::path &cache_directory, bool reset) -> int
+	{
+		auto stats = cache_service::get_stats(reset);
+		if (not stats)
+		{
+			stats = compile_cache{ cache_directory }.read_stats(reset);
+		}
+
+		fmt::print("shader_cache: {} hits, {} misses, {:.1f}% hit rate\n",
+		           stats->hits, stats->misses, hit_rate(*stats));
+		return 0;
+	}
+
+	auto serve(const std::filesystem::path &cache_directory) -> int
+	{
+		auto cache = compile_cache{ cache_directory };
+		if (not serve_cache(cache))
+		{
+			fmt::print(stderr, "shader_cache: can't serve {}, is another service running?\n", cache_directory.string());
+			return 1;
+		}
+		return 0;
+	}
+}
+
+auto main(int argc, char *argv[]) -> int
+{
+	auto args = std::vector<std::string>(argv + 1, argv + argc);
+	if (args.empty())
+	{
+		print_usage();
+		return 1;
+	}
+
+	auto action = std::string_view{ args.front() };
+	if (action == "compile" and args.size() >= 3)
+	{
+		return compile(args[1], { args.begin() + 2, args.end() });
+	}
+	if (action == "stats" and args.size() == 3 and args[1] == "--reset")
+	{
+		return print_stats(args[2], true);
+	}
+	if (action == "stats" and args.size() == 2)
+	{
+		return print_stats(args[1], false);
+	}
+	if (action == "serve" and args.size() == 2)
+	{
+		return serve(args[1]);
+	}
+	if (action == "stop" and args.size() == 1)
+	{
+		return cache_service::stop() ? 0 : 1;
+	}
+
+	print_usage();
+	return 1;
+}
@@ -0,0 +1,217 @@
+#include "shader_dependency_graph.h"
+#include "test_checks.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+// Checks which shaders and pipelines shader_reload_service rebuilds when
+// files change, with made up paths, nothing is read from disk.
+
+namespace
+{
+	using namespace learning_dx12;
+	using path = std::filesystem::path;
+	using shader_list = std::vector<std::string>;
+	using pipeline_list = std::vector<reloadable_pipeline>;
+
+	// Two pipelines sharing a vertex shader, both stages include common.hlsli.
+	auto make_graph() -> shader_dependency_graph
+	{
+		auto graph = shader_dependency_graph{};
+		graph.set_shader_files("vs", { "shaders/vertex_shader.hlsl", "shaders/common.hlsli", "shaders/root_layout.hlsli" });
+		graph.set_shader_files("ps", { "shaders/pixel_shader.hlsl", "shaders/common.hlsli" });
+		graph.set_shader_files("ps_shadow", { "shaders/shadow.hlsl" });
+		graph.set_pipeline_shaders(0, { "vs", "ps" });
+		graph.set_pipeline_shaders(1, { "vs", "ps_shadow" });
+		return graph;
+	}
+
+	void test_affected_shaders(test_checks &checks)
+	{
+		auto graph = make_graph();
+
+		checks.check(graph.get_affected_shaders({ "shaders/vertex_shader.hlsl" }) == shader_list{ "vs" }, "a shader's own file");
+		checks.check(graph.get_affected_shaders({ "shaders/common.hlsli" }) == shader_list{ "ps", "vs" }, "an include, every shader using it, sorted");
+		checks.check(graph.get_affected_shaders({ "shaders/common.hlsli", "shaders/vertex_shader.hlsl", "shaders/root_layout.hlsli" })
+		             == shader_list{ "ps", "vs" }, "each shader once, however many of its files changed");
+		checks.check(graph.get_affected_shaders({ "shaders/unrelated.hlsl", "readme.md" }).empty(), "files no shader uses");
+		checks.check(graph.get_affected_shaders({}).empty(), "nothing changed");
+
+		// Watchers and compilers spell paths their own way
+		checks.check(graph.get_affected_shaders({ "shaders/./shadow.hlsl" }) == shader_list{ "ps_shadow" }, "a path through .");
+		checks.check(graph.get_affected_shaders({ "shaders/lights/../shadow.hlsl" }) == shader_list{ "ps_shadow" }, "a path through ..");
+		checks.check(graph.get_affected_shaders({ "shaders/Shadow.hlsl" }).empty(), "paths are compared as they are, case included");
+
+		checks.check(graph.get_files() == std::vector<path>{ "shaders/common.hlsli", "shaders/pixel_shader.hlsl", "shaders/root_layout.hlsli",
+		                                                      "shaders/shadow.hlsl", "shaders/vertex_shader.hlsl" },
+		             "watched files, each once, sorted");
+	}
+
+	void test_affected_pipelines(test_checks &checks)
+	{
+		auto graph = make_graph();
+
+		checks.check(graph.get_affected_pipelines({ "vs" }) == pipeline_list{ 0, 1 }, "a shared shader rebuilds both pipelines");
+		checks.check(graph.get_affected_pipelines({ "ps_shadow" }) == pipeline_list{ 1 }, "a shader only one pipeline uses");
+		checks.check(graph.get_affected_pipelines({ "ps", "vs", "ps_shadow" }) == pipeline_list{ 0, 1 }, "each pipeline once");
+		checks.check(graph.get_affected_pipelines({ "cs" }).empty(), "a shader no pipeline uses");
+
+		// From changed files to pipelines, as shader_reload_service does
+		auto shaders = graph.get_affected_shaders({ "shaders/pixel_shader.hlsl" });
+		checks.check(graph.get_affected_pipelines(shaders) == pipeline_list{ 0 }, "a pixel shader file, only its pipeline");
+		shaders = graph.get_affected_shaders({ "shaders/root_layout.hlsli" });
+		checks.check(graph.get_affected_pipelines(shaders) == pipeline_list{ 0, 1 }, "an include of the shared shader, both");
+	}
+
+	// A compile can find different includes than the last one, and a
+	// shader or pipeline can go away.
+	void test_changes(test_checks &checks)
+	{
+		auto graph = make_graph();
+
+		graph.set_shader_files("vs", { "shaders/vertex_shader.hlsl", "shaders/skinning.hlsli" });
+		checks.check(graph.get_affected_shaders({ "shaders/common.hlsli" }) == shader_list{ "ps" }, "an include the shader dropped");
+		checks.check(graph.get_affected_shaders({ "shaders/root_layout.hlsli" }).empty(), "an include nothing uses any more");
+		checks.check(graph.get_affected_shaders({ "shaders/skinning.hlsli" }) == shader_list{ "vs" }, "an include it picked up");
+		auto files = graph.get_files();
+		checks.check(std::find(files.begin(), files.end(), path{ "shaders/root_layout.hlsli" }) == files.end(), "stops watching it");
+
+		// Pipelines keep their link, the shader may come back
+		graph.remove_shader("vs");
+		checks.check(graph.get_affected_shaders({ "shaders/vertex_shader.hlsl" }).empty(), "a removed shader's files");
+		checks.check(graph.get_affected_pipelines({ "vs" }) == pipeline_list{ 0, 1 }, "pipelines still use a removed shader");
+		graph.set_shader_files("vs", { "shaders/vertex_shader.hlsl" });
+		checks.check(graph.get_affected_shaders({ "shaders/vertex_shader.hlsl" }) == shader_list{ "vs" }, "added again");
+		graph.remove_shader("never_added");
+
+		graph.set_pipeline_shaders(1, { "ps_shadow" });
+		checks.check(graph.get_affected_pipelines({ "vs" }) == pipeline_list{ 0 }, "a pipeline's shaders are replaced");
+		graph.remove_pipeline(0);
+		checks.check(graph.get_affected_pipelines({ "vs" }).empty(), "a removed pipeline");
+		checks.check(graph.get_affected_pipelines({ "ps_shadow" }) == pipeline_list{ 1 }, "the other one stays");
+		graph.remove_pipeline(7);
+	}
+
+	// Random edits, mirrored in two plain maps. After every edit the answer
+	// for every file and shader is worked out from the maps and compared.
+	void test_fuzz(test_checks &checks, uint32_t seed)
+	{
+		constexpr auto shader_count = 6u;
+		constexpr auto file_count = 8u;
+		constexpr auto pipeline_count = 5u;
+		constexpr auto edit_count = 2000;
+
+		auto shader_name = [](uint32_t i) { return fmt::format("shader_{}", i); };
+		auto file_name = [](uint32_t i) { return path{ fmt::format("shaders/file_{}.hlsl", i) }; };
+
+		auto graph = shader_dependency_graph{};
+		auto files_by_shader = std::map<std::string, std::set<path>>{};
+		auto shaders_by_pipeline = std::map<reloadable_pipeline, std::set<std::string>>{};
+
+		auto random = std::mt19937{ seed };
+		auto pick = [&](uint32_t count) { return std::uniform_int_distribution<uint32_t>{ 0, count - 1 }(random); };
+
+		auto valid = true;
+		for (auto edit = 0; edit < edit_count and valid; edit++)
+		{
+			switch (pick(4))
+			{
+				case 0:
+				{
+					auto shader = shader_name(pick(shader_count));
+					auto files = std::vector<path>{};
+					for (auto i = pick(4); i > 0; i--)
+					{
+						files.push_back(file_name(pick(file_count)));
+					}
+					graph.set_shader_files(shader, files);
+					files_by_shader[shader] = { files.begin(), files.end() };
+					break;
+				}
+				case 1:
+				{
+					auto shader = shader_name(pick(shader_count));
+					graph.remove_shader(shader);
+					files_by_shader.erase(shader);
+					break;
+				}
+				case 2:
+				{
+					auto pipeline = pick(pipeline_count);
+					auto shaders = shader_list{};
+					for (auto i = pick(3); i > 0; i--)
+					{
+						shaders.push_back(shader_name(pick(shader_count)));
+					}
+					graph.set_pipeline_shaders(pipeline, shaders);
+					shaders_by_pipeline[pipeline] = { shaders.begin(), shaders.end() };
+					break;
+				}
+				default:
+				{
+					auto pipeline = pick(pipeline_count);
+					graph.remove_pipeline(pipeline);
+					shaders_by_pipeline.erase(pipeline);
+					break;
+				}
+			}
+
+			auto watched = std::set<path>{};
+			for (auto &[shader, files] : files_by_shader)
+			{
+				watched.insert(files.begin(), files.end());
+			}
+			valid = graph.get_files() == std::vector<path>{ watched.begin(), watched.end() };
+
+			for (auto i = 0u; i < file_count; i++)
+			{
+				auto expected = shader_list{};
+				for (auto &[shader, files] : files_by_shader)
+				{
+					if (files.count(file_name(i)))
+					{
+						expected.push_back(shader);
+					}
+				}
+				valid = valid and graph.get_affected_shaders({ file_name(i) }) == expected;
+			}
+
+			for (auto i = 0u; i < shader_count; i++)
+			{
+				auto expected = pipeline_list{};
+				for (auto &[pipeline, shaders] : shaders_by_pipeline)
+				{
+					if (shaders.count(shader_name(i)))
+					{
+						expected.push_back(pipeline);
+					}
+				}
+				valid = valid and graph.get_affected_pipelines({ shader_name(i) }) == expected;
+			}
+		}
+
+		checks.check(valid, fmt::format("seed {}: affected shaders, pipelines and watched files match the model", seed));
+	}
+}
+
+auto main() -> int
+{
+	auto checks = test_checks{};
+
+	test_affected_shaders(checks);
+	test_affected_pipelines(checks);
+	test_changes(checks);
+	for (auto seed : { 1u, 2u, 3u })
+	{
+		test_fuzz(checks, seed);
+	}
+
+	return checks.get_exit_code();
+}
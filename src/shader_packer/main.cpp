@@ -0,0 +1,86 @@
+#include "shader_archive.h"
+
+#include <fmt/format.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <vector>
+
+// Packs compiled shaders into one archive, each named after its file stem.
+// Usage: shader_packer [--compress] <archive> <shader> [<shader> ...]
+
+namespace
+{
+	auto read_file(const std::filesystem::path &file_path, std::vector<uint8_t> &bytes) -> bool
+	{
+		auto file = std::ifstream(file_path, std::ios::in | std::ios::binary | std::ios::ate);
+		if (not file.is_open())
+		{
+			return false;
+		}
+
+		bytes.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0, std::ios::beg);
+		return static_cast<bool>(file.read(reinterpret_cast<char *>(bytes.data()), bytes.size()));
+	}
+}
+
+auto main(int argc, char *argv[]) -> int
+{
+	using namespace learning_dx12;
+
+	auto arg = 1;
+	auto compress = false;
+	if (arg < argc and std::string_view{ argv[arg] } == "--compress")
+	{
+		compress = true;
+		arg++;
+	}
+
+	if (argc - arg < 2)
+	{
+		fmt::print(stderr, "usage: shader_packer [--compress] <archive> <shader> [<shader> ...]\n");
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	auto archive_path = std::filesystem::path{ argv[arg++] };
+	auto writer = shader_archive_writer{};
+	auto bytes = std::vector<uint8_t>{};
+
+	for (; arg < argc; arg++)
+	{
+		auto shader_path = std::filesystem::path{ argv[arg] };
+		if (not read_file(shader_path, bytes))
+		{
+			fmt::print(stderr, "shader_packer: can't read {}\n", shader_path.string());
+			return 1;
+		}
+		writer.add(shader_path.stem().string(), bytes.data(), bytes.size());
+	}
+
+	auto archive = writer.build(compress);
+
+	auto temp_path = archive_path;
+	temp_path += ".tmp";
+	{
+		auto file = std::ofstream(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char *>(archive.data()), archive.size());
+		if (not file)
+		{
+			fmt::print(stderr, "shader_packer: can't write {}\n", temp_path.string());
+			return 1;
+		}
+	}
+	std::filesystem::rename(temp_path, archive_path);
+
+	auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+	auto stats = writer.get_stats();
+	fmt::print("shader_packer: {} shaders, {} unique, {} -> {} bytes in {:.1f} ms\n",
+	           stats.entry_count, stats.blob_count, stats.input_size, stats.archive_size, elapsed.count());
+
+	return 0;
+}
@@ -0,0 +1,149 @@
+#include "shader_permutations.h"
+#include "test_checks.h"
+
+#include <fmt/format.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+// Writes manifests laid out the way target_shader_sources does, reads them
+// with shader_permutations, and checks one with any variant missing, listed
+// twice or badly written is refused as a whole. Manifests are written to the
+// temp directory.
+
+namespace
+{
+	using namespace learning_dx12;
+
+	constexpr auto manifest_header = "# shader\tbits\tname\tprofile\tsource\t[key=value ...]\n";
+
+	// Two keys, so four variants, then a shader without keys.
+	constexpr auto well_formed_lines = std::string_view{
+		"vertex_shader\t0\tvertex_shader.0\tvs_5_1\tsrc/vertex_shader.hlsl\tINDIRECT=0\tSKINNED=0\n"
+		"vertex_shader\t1\tvertex_shader.1\tvs_5_1\tsrc/vertex_shader.hlsl\tINDIRECT=1\tSKINNED=0\n"
+		"vertex_shader\t2\tvertex_shader.2\tvs_5_1\tsrc/vertex_shader.hlsl\tINDIRECT=0\tSKINNED=1\n"
+		"vertex_shader\t3\tvertex_shader.3\tvs_5_1\tsrc/vertex_shader.hlsl\tINDIRECT=1\tSKINNED=1\n"
+		"pixel_shader\t0\tpixel_shader\tps_5_1\tsrc/pixel_shader.hlsl\n"
+	};
+
+	auto write_manifest(std::string_view name, std::string_view lines) -> std::filesystem::path
+	{
+		auto path = std::filesystem::temp_directory_path() / fmt::format("shader_permutations_test_{}.permutations", name);
+		auto file = std::ofstream(path, std::ios::out | std::ios::trunc);
+		file << manifest_header << lines;
+		return path;
+	}
+
+	// The well formed lines with one of them changed or left out.
+	auto replace_line(std::string_view line, std::string_view replacement) -> std::string
+	{
+		auto lines = std::string{ well_formed_lines };
+		auto at = lines.find(line);
+		return lines.replace(at, line.size(), replacement);
+	}
+
+	void test_well_formed(test_checks &checks)
+	{
+		auto permutations = shader_permutations{ write_manifest("well_formed", well_formed_lines) };
+		checks.check(permutations.is_open(), "well formed: opens");
+		checks.check_equal(permutations.get_variant_count(), 5u, "well formed: every variant");
+
+		checks.check_equal(permutations.get_key_bit("vertex_shader", "INDIRECT"), permutation_bits{ 1 }, "first key is bit 0");
+		checks.check_equal(permutations.get_key_bit("vertex_shader", "SKINNED"), permutation_bits{ 2 }, "second key is bit 1");
+		checks.check_equal(permutations.get_key_bit("vertex_shader", "MISSING"), permutation_bits{}, "no such key");
+		checks.check_equal(permutations.get_key_bit("pixel_shader", "INDIRECT"), permutation_bits{}, "key of another shader");
+		checks.check_equal(permutations.get_key_bit("compute_shader", "INDIRECT"), permutation_bits{}, "no such shader");
+
+		auto variant = permutations.find("vertex_shader", 2);
+		checks.check(variant != nullptr, "variant found by bits");
+		if (variant)
+		{
+			checks.check(variant->name == "vertex_shader.2", "variant archive name");
+			checks.check_equal(variant->bits, permutation_bits{ 2 }, "variant bits");
+			checks.check(variant->profile == "vs_5_1", "variant profile");
+			checks.check(variant->source_file == std::filesystem::path{ "src/vertex_shader.hlsl" }, "variant source");
+			checks.check_equal(variant->defines.size(), size_t{ 2 }, "a define per key");
+			if (variant->defines.size() == 2)
+			{
+				checks.check(variant->defines[0].name == "INDIRECT" and variant->defines[0].value == "0", "first define");
+				checks.check(variant->defines[1].name == "SKINNED" and variant->defines[1].value == "1", "second define");
+			}
+		}
+
+		auto plain = permutations.find("pixel_shader", 0);
+		checks.check(plain != nullptr and plain->name == "pixel_shader" and plain->defines.empty(), "shader without keys");
+		checks.check(permutations.find("pixel_shader", 1) == nullptr, "bits beyond a shader's variants");
+		checks.check(permutations.find("vertex_shader", 4) == nullptr, "bits beyond the keys");
+		checks.check(permutations.find("compute_shader", 0) == nullptr, "unknown shader");
+
+		// Blank lines and comments anywhere are skipped.
+		auto spaced = shader_permutations{ write_manifest("spaced", fmt::format("\n# comment\n{}\n", well_formed_lines)) };
+		checks.check(spaced.is_open(), "blank lines and comments");
+		checks.check_equal(spaced.get_variant_count(), 5u, "blank lines and comments: every variant");
+	}
+
+	void check_refused(test_checks &checks, std::string_view name, std::string_view lines)
+	{
+		auto permutations = shader_permutations{ write_manifest(name, lines) };
+		checks.check(not permutations.is_open(), fmt::format("{}: refused", name));
+		checks.check_equal(permutations.get_variant_count(), 0u, fmt::format("{}: nothing kept", name));
+		checks.check(permutations.find("pixel_shader", 0) == nullptr, fmt::format("{}: nothing found", name));
+	}
+
+	void test_missing_variant(test_checks &checks)
+	{
+		auto third = std::string_view{ "vertex_shader\t2\tvertex_shader.2\tvs_5_1\tsrc/vertex_shader.hlsl\tINDIRECT=0\tSKINNED=1\n" };
+		auto last = std::string_view{ "vertex_shader\t3\tvertex_shader.3\tvs_5_1\tsrc/vertex_shader.hlsl\tINDIRECT=1\tSKINNED=1\n" };
+		check_refused(checks, "missing_middle", replace_line(third, ""));
+		check_refused(checks, "missing_last", replace_line(last, ""));
+
+		auto missing = shader_permutations{ std::filesystem::temp_directory_path() / "shader_permutations_test_none.permutations" };
+		checks.check(not missing.is_open(), "missing file");
+	}
+
+	void test_duplicate_bits(test_checks &checks)
+	{
+		auto third = std::string_view{ "vertex_shader\t2\tvertex_shader.2\tvs_5_1\tsrc/vertex_shader.hlsl\tINDIRECT=0\tSKINNED=1\n" };
+		auto first = std::string_view{ "vertex_shader\t0\tvertex_shader.0\tvs_5_1\tsrc/vertex_shader.hlsl\tINDIRECT=0\tSKINNED=0\n" };
+		check_refused(checks, "duplicate_bits", replace_line(third, first));
+
+		// All four are there, but one more lists a shader's bits twice.
+		check_refused(checks, "duplicate_extra", fmt::format("{}{}", well_formed_lines, first));
+
+		// Bits a shader's keys can't reach, and variants with fewer or more keys than the rest.
+		auto last = std::string_view{ "vertex_shader\t3\tvertex_shader.3\tvs_5_1\tsrc/vertex_shader.hlsl\tINDIRECT=1\tSKINNED=1\n" };
+		auto beyond = std::string_view{ "vertex_shader\t4\tvertex_shader.4\tvs_5_1\tsrc/vertex_shader.hlsl\tINDIRECT=0\tSKINNED=1\n" };
+		auto fewer_keys = std::string_view{ "vertex_shader\t0\tvertex_shader.0\tvs_5_1\tsrc/vertex_shader.hlsl\tINDIRECT=0\n" };
+		auto more_keys = std::string_view{ "vertex_shader\t3\tvertex_shader.3\tvs_5_1\tsrc/vertex_shader.hlsl\tINDIRECT=1\tSKINNED=1\tLIT=0\n" };
+		check_refused(checks, "bits_beyond_keys", replace_line(third, beyond));
+		check_refused(checks, "fewer_keys", replace_line(first, fewer_keys));
+		check_refused(checks, "more_keys", replace_line(last, more_keys));
+	}
+
+	void test_malformed(test_checks &checks)
+	{
+		auto first = std::string_view{ "vertex_shader\t0\tvertex_shader.0\tvs_5_1\tsrc/vertex_shader.hlsl\tINDIRECT=0\tSKINNED=0\n" };
+		check_refused(checks, "define_without_value",
+		              replace_line(first, "vertex_shader\t0\tvertex_shader.0\tvs_5_1\tsrc/vertex_shader.hlsl\tINDIRECT\tSKINNED=0\n"));
+		check_refused(checks, "bits_not_a_number",
+		              replace_line(first, "vertex_shader\tzero\tvertex_shader.0\tvs_5_1\tsrc/vertex_shader.hlsl\tINDIRECT=0\tSKINNED=0\n"));
+		check_refused(checks, "bits_trailing",
+		              replace_line(first, "vertex_shader\t0x\tvertex_shader.0\tvs_5_1\tsrc/vertex_shader.hlsl\tINDIRECT=0\tSKINNED=0\n"));
+		check_refused(checks, "too_few_fields",
+		              replace_line(first, "vertex_shader\t0\tvertex_shader.0\tvs_5_1\n"));
+	}
+}
+
+auto main() -> int
+{
+	auto checks = test_checks{};
+
+	test_well_formed(checks);
+	test_missing_variant(checks);
+	test_duplicate_bits(checks);
+	test_malformed(checks);
+
+	return checks.get_exit_code();
+}
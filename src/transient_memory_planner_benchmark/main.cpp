@@ -0,0 +1,197 @@
+#include "transient_memory_planner.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// Plans random sets of frame graph transients, render targets and buffers
+// alive for a few batches each, and reports the peak heap size against one
+// allocation per resource and against the most memory alive in any one
+// batch, which no plan can go below. Every plan is checked first.
+// Usage: transient_memory_planner_benchmark [<plans> [<runs>]]
+
+namespace
+{
+	using namespace learning_dx12;
+
+	constexpr auto default_plan_count = 1'000;
+	constexpr auto default_runs = 5;
+
+	constexpr auto kb = uint64_t{ 1024 };
+	constexpr auto mb = 1024 * kb;
+	constexpr auto transients_per_plan = 64;
+	constexpr auto batch_count = 24u;
+	constexpr auto placement_alignment = 64 * kb; // D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT
+	constexpr auto msaa_alignment = 4 * mb;       // D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT
+
+	// Sizes from one tile to a 4K HDR target, spread evenly across orders of
+	// magnitude, one in ten MSAA aligned. Most live a few batches, some
+	// the whole frame, like a depth buffer or a history target would.
+	auto make_workload(int plan_count) -> std::vector<std::vector<transient_request>>
+	{
+		auto random = std::mt19937{ 42 };
+		auto log_size = std::uniform_real_distribution<double>{ std::log2(double(placement_alignment)), std::log2(64.0 * mb) };
+		auto first_use = std::uniform_int_distribution<uint32_t>{ 0, batch_count - 1 };
+		auto lifetime = std::geometric_distribution<uint32_t>{ 0.4 };
+		auto percent = std::uniform_int_distribution<int>{ 0, 99 };
+
+		auto workload = std::vector<std::vector<transient_request>>(plan_count);
+		for (auto &requests : workload)
+		{
+			requests.resize(transients_per_plan);
+			for (auto &request : requests)
+			{
+				request.size = static_cast<uint64_t>(std::exp2(log_size(random)));
+				request.alignment = percent(random) < 10 ? msaa_alignment : placement_alignment;
+				request.first_use = first_use(random);
+				request.last_use = percent(random) < 5
+				                 ? batch_count - 1
+				                 : std::min(batch_count - 1, request.first_use + lifetime(random));
+				if (percent(random) < 5)
+				{
+					request.first_use = 0;
+				}
+			}
+		}
+		return workload;
+	}
+
+	auto lifetimes_overlap(const transient_request &a, const transient_request &b) -> bool
+	{
+		return a.first_use <= b.last_use and b.first_use <= a.last_use;
+	}
+
+	// The most memory alive in any one batch, alignment ignored.
+	auto live_peak(const std::vector<transient_request> &requests) -> uint64_t
+	{
+		auto peak = uint64_t{};
+		for (auto batch = 0u; batch < batch_count; batch++)
+		{
+			auto live = uint64_t{};
+			for (auto &request : requests)
+			{
+				live += (request.first_use <= batch and batch <= request.last_use) ? request.size : 0;
+			}
+			peak = std::max(peak, live);
+		}
+		return peak;
+	}
+
+	// Placements are aligned and inside the heap, resources alive at the
+	// same time never share memory, and whatever shares memory with another
+	// one is aliased in, from the one resource that ended before it if
+	// the plan names it.
+	auto check_plan(const std::vector<transient_request> &requests, const transient_plan &plan) -> bool
+	{
+		if (plan.placements.size() != requests.size() or plan.heap_size > plan.naive_size)
+		{
+			return false;
+		}
+
+		auto aliased_count = 0u;
+		for (auto i = 0u; i < requests.size(); i++)
+		{
+			auto &request = requests[i];
+			auto &placement = plan.placements[i];
+			auto begin = placement.offset, end = placement.offset + request.size;
+			if (begin % request.alignment != 0 or end > plan.heap_size)
+			{
+				return false;
+			}
+
+			auto shares_any = false;
+			for (auto other = 0u; other < requests.size(); other++)
+			{
+				auto other_begin = plan.placements[other].offset;
+				auto other_end = other_begin + requests[other].size;
+				if (other == i or not (other_begin < end and begin < other_end))
+				{
+					continue;
+				}
+				if (lifetimes_overlap(request, requests[other]))
+				{
+					return false;
+				}
+				shares_any = true;
+			}
+
+			if (shares_any != (placement.previous != transient_placement::no_previous))
+			{
+				return false;
+			}
+			if (placement.previous < requests.size()
+			    and requests[placement.previous].last_use >= request.first_use)
+			{
+				return false;
+			}
+			aliased_count += shares_any ? 1 : 0;
+		}
+
+		return aliased_count == plan.aliased_count;
+	}
+
+	template <typename function>
+	auto time_median_ms(int runs, const function &run) -> double
+	{
+		auto times = std::vector<double>{};
+		for (auto i = 0; i < runs; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			run();
+			auto end = std::chrono::steady_clock::now();
+			times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		}
+
+		std::sort(times.begin(), times.end());
+		return times[times.size() / 2];
+	}
+}
+
+auto main(int argc, char *argv[]) -> int
+{
+	auto plan_count = argc > 1 ? std::max(1, std::atoi(argv[1])) : default_plan_count;
+	auto runs = argc > 2 ? std::max(1, std::atoi(argv[2])) : default_runs;
+
+	auto workload = make_workload(plan_count);
+
+	auto heap_size = uint64_t{}, naive_size = uint64_t{}, live_size = uint64_t{};
+	auto aliased_count = uint64_t{};
+	for (auto &requests : workload)
+	{
+		auto plan = plan_transient_memory(requests);
+		if (not check_plan(requests, plan))
+		{
+			fmt::print(stderr, "planner placed live resources over each other, or named the wrong previous one\n");
+			return 1;
+		}
+
+		heap_size += plan.heap_size;
+		naive_size += plan.naive_size;
+		live_size += live_peak(requests);
+		aliased_count += plan.aliased_count;
+	}
+
+	auto plan = transient_plan{};
+	auto plan_ms = time_median_ms(runs, [&]
+	{
+		for (auto &requests : workload)
+		{
+			plan = plan_transient_memory(requests);
+		}
+	});
+
+	auto to_mb = [&](uint64_t size) { return size / (double(mb) * plan_count); };
+	fmt::print("{} plans, {} transients each over {} batches, {:.1f} aliased on average\n",
+	           plan_count, transients_per_plan, batch_count, double(aliased_count) / plan_count);
+	fmt::print("  plan   {:8.3f} ms  {:6.1f} us per plan\n", plan_ms, plan_ms * 1e3 / plan_count);
+	fmt::print("  peak   {:8.1f} MB per plan, {:.1f}% of naive, {:.1f}% over the live peak\n",
+	           to_mb(heap_size), 100.0 * heap_size / naive_size, 100.0 * heap_size / live_size - 100.0);
+	fmt::print("  naive  {:8.1f} MB per plan\n", to_mb(naive_size));
+	fmt::print("  live   {:8.1f} MB per plan, the most alive in one batch\n", to_mb(live_size));
+	return 0;
+}